@@ -59,6 +59,7 @@
 #include "cg-gpu-info-private.h"
 #include "cg-gl-header.h"
 #include "cg-framebuffer-private.h"
+#include "cg-vertex-stream-private.h"
 #include "cg-onscreen-private.h"
 #include "cg-fence-private.h"
 #include "cg-loop-private.h"
@@ -208,6 +209,10 @@ struct _cg_device_t {
     cg_indices_t *rectangle_short_indices;
     int rectangle_short_indices_len;
 
+    /* Transient vertex data for rectangles is streamed through here */
+    cg_vertex_stream_t *vertex_stream;
+    cg_rectangle_batch_t rectangle_batch;
+
     cg_pipeline_t *texture_download_pipeline;
     cg_pipeline_t *blit_texture_pipeline;
 
@@ -348,6 +348,9 @@ cg_device_connect(cg_device_t *dev, cg_error_t **error)
     dev->rectangle_short_indices = NULL;
     dev->rectangle_short_indices_len = 0;
 
+    dev->vertex_stream = _cg_vertex_stream_new(dev);
+    dev->rectangle_batch.vertices = c_array_new(false, false, sizeof(float));
+
     dev->texture_download_pipeline = NULL;
     dev->blit_texture_pipeline = NULL;
 
@@ -442,6 +445,9 @@ _cg_device_free(cg_device_t *dev)
     if (dev->rectangle_short_indices)
         cg_object_unref(dev->rectangle_short_indices);
 
+    _cg_rectangle_batch_destroy(dev);
+    _cg_vertex_stream_free(dev->vertex_stream);
+
     if (dev->default_pipeline)
         cg_object_unref(dev->default_pipeline);
 
@@ -45,6 +45,8 @@ typedef enum {
     FENCE_TYPE_ERROR
 } cg_fence_type_t;
 
+typedef void (*cg_fence_cancel_callback_t)(void *user_data);
+
 struct _cg_fence_closure_t {
     c_list_t link;
     cg_framebuffer_t *framebuffer;
@@ -54,10 +56,17 @@ struct _cg_fence_closure_t {
 
     cg_fence_callback_t callback;
     void *user_data;
+
+    /* Called, after the closure has been freed, if the fence is
+     * cancelled because its framebuffer is destroyed */
+    cg_fence_cancel_callback_t cancel_callback;
 };
 
 void _cg_fence_submit(cg_fence_closure_t *fence);
 
+void _cg_fence_closure_set_cancel_callback(cg_fence_closure_t *closure,
+                                           cg_fence_cancel_callback_t callback);
+
 void _cg_fence_cancel_fences_for_framebuffer(cg_framebuffer_t *framebuffer);
 
 #endif /* __CG_FENCE_PRIVATE_H__ */
@@ -146,6 +146,7 @@ cg_framebuffer_add_fence_callback(cg_framebuffer_t *framebuffer,
     fence->framebuffer = framebuffer;
     fence->callback = callback;
     fence->user_data = user_data;
+    fence->cancel_callback = NULL;
     fence->fence_obj = NULL;
 
     _cg_fence_submit(fence);
@@ -179,6 +180,13 @@ cg_framebuffer_cancel_fence_callback(cg_framebuffer_t *framebuffer,
     c_slice_free(cg_fence_closure_t, fence);
 }
 
+void
+_cg_fence_closure_set_cancel_callback(cg_fence_closure_t *closure,
+                                      cg_fence_cancel_callback_t callback)
+{
+    closure->cancel_callback = callback;
+}
+
 void
 _cg_fence_cancel_fences_for_framebuffer(cg_framebuffer_t *framebuffer)
 {
@@ -186,7 +194,18 @@ _cg_fence_cancel_fences_for_framebuffer(cg_framebuffer_t *framebuffer)
     cg_fence_closure_t *fence, *tmp;
 
     c_list_for_each_safe(fence, tmp, &dev->fences, link) {
-        if (fence->framebuffer == framebuffer)
-            cg_framebuffer_cancel_fence_callback(framebuffer, fence);
+        cg_fence_cancel_callback_t cancel_callback;
+        void *user_data;
+
+        if (fence->framebuffer != framebuffer)
+            continue;
+
+        cancel_callback = fence->cancel_callback;
+        user_data = fence->user_data;
+
+        cg_framebuffer_cancel_fence_callback(framebuffer, fence);
+
+        if (cancel_callback)
+            cancel_callback(user_data);
     }
 }
@@ -195,6 +195,35 @@ struct _cg_offscreen_t {
     cg_offscreen_flags_t create_flags;
 };
 
+/* Consecutive rectangles drawn to the same framebuffer with the same
+ * pipeline are accumulated here and then drawn as a single primitive
+ * when something else needs to draw or when framebuffer state that
+ * affects the rectangles changes.
+ *
+ * The modelview transform is applied to the vertices as they are
+ * batched so that modelview changes don't need to break a batch.
+ */
+typedef struct _cg_rectangle_batch_t {
+    /* NULL while there are no pending rectangles */
+    cg_framebuffer_t *framebuffer;
+    cg_pipeline_t *pipeline;
+    int n_layers;
+
+    /* When drawing regions of a meta texture we draw with a copy of
+     * the user's pipeline overriding the layer 0 texture so we track
+     * what that copy was derived from to see if it can be reused. */
+    cg_pipeline_t *source_pipeline;
+    unsigned long source_age;
+    cg_texture_t *source_texture;
+
+    /* A cache of the last modelview matrix we transformed by */
+    cg_matrix_entry_t *modelview_entry;
+    c_matrix_t modelview;
+
+    c_array_t *vertices;
+    int n_rectangles;
+} cg_rectangle_batch_t;
+
 void _cg_framebuffer_init(cg_framebuffer_t *framebuffer,
                           cg_device_t *dev,
                           cg_framebuffer_type_t type,
@@ -462,6 +491,17 @@ _cg_framebuffer_get_projection_entry(cg_framebuffer_t *framebuffer)
  */
 void _cg_framebuffer_flush(cg_framebuffer_t *framebuffer);
 
+/*
+ * _cg_rectangle_batch_flush:
+ * @dev: A #cg_device_t
+ *
+ * Draws any rectangles that have been batched, regardless of which
+ * framebuffer they target.
+ */
+void _cg_rectangle_batch_flush(cg_device_t *dev);
+
+void _cg_rectangle_batch_destroy(cg_device_t *dev);
+
 /*
  * _cg_framebuffer_get_stencil_bits:
  * @framebuffer: a pointer to a #cg_framebuffer_t
@@ -288,6 +288,8 @@ void
 _cg_framebuffer_set_clip_stack(cg_framebuffer_t *framebuffer,
                                cg_clip_stack_t *stack)
 {
+    _cg_framebuffer_flush(framebuffer);
+
     _cg_clip_stack_ref(stack);
     _cg_clip_stack_unref(framebuffer->clip_stack);
     framebuffer->clip_stack = stack;
@@ -306,6 +308,8 @@ cg_framebuffer_set_viewport(
         framebuffer->viewport_height == height)
         return;
 
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->viewport_x = x;
     framebuffer->viewport_y = y;
     framebuffer->viewport_width = width;
@@ -402,7 +406,10 @@ _cg_framebuffer_remove_all_dependencies(cg_framebuffer_t *framebuffer)
 void
 _cg_framebuffer_flush(cg_framebuffer_t *framebuffer)
 {
-    /* Currently a NOP */
+    cg_device_t *dev = framebuffer->dev;
+
+    if (dev->rectangle_batch.framebuffer == framebuffer)
+        _cg_rectangle_batch_flush(dev);
 }
 
 cg_offscreen_t *
@@ -883,6 +890,10 @@ _cg_framebuffer_flush_state(cg_framebuffer_t *draw_buffer,
 {
     cg_device_t *dev = draw_buffer->dev;
 
+    /* Any batched rectangles need to be drawn before something else
+     * gets drawn, read or cleared */
+    _cg_rectangle_batch_flush(dev);
+
     dev->driver_vtable->framebuffer_flush_state(
         draw_buffer, read_buffer, state);
 }
@@ -966,6 +977,8 @@ cg_framebuffer_set_color_mask(cg_framebuffer_t *framebuffer,
     if (framebuffer->color_mask == color_mask)
         return;
 
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->color_mask = color_mask;
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -986,6 +999,8 @@ cg_framebuffer_set_depth_write_enabled(cg_framebuffer_t *framebuffer,
     if (framebuffer->depth_writing_enabled == depth_write_enabled)
         return;
 
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->depth_writing_enabled = depth_write_enabled;
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -1006,6 +1021,8 @@ cg_framebuffer_set_dither_enabled(cg_framebuffer_t *framebuffer,
     if (framebuffer->dither_enabled == dither_enabled)
         return;
 
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->dither_enabled = dither_enabled;
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -1218,6 +1235,8 @@ cg_framebuffer_discard_buffers(cg_framebuffer_t *framebuffer,
 
     c_return_if_fail(buffers & CG_BUFFER_BIT_COLOR);
 
+    _cg_framebuffer_flush(framebuffer);
+
     dev->driver_vtable->framebuffer_discard_buffers(framebuffer, buffers);
 }
 
@@ -1380,6 +1399,8 @@ cg_framebuffer_frustum(cg_framebuffer_t *framebuffer,
     cg_matrix_stack_t *projection_stack =
         _cg_framebuffer_get_projection_stack(framebuffer);
 
+    _cg_framebuffer_flush(framebuffer);
+
     cg_matrix_stack_load_identity(projection_stack);
 
     cg_matrix_stack_frustum(
@@ -1403,6 +1424,8 @@ cg_framebuffer_orthographic(cg_framebuffer_t *framebuffer,
     cg_matrix_stack_t *projection_stack =
         _cg_framebuffer_get_projection_stack(framebuffer);
 
+    _cg_framebuffer_flush(framebuffer);
+
     c_matrix_init_identity(&ortho);
     c_matrix_orthographic(&ortho, x_1, y_1, x_2, y_2, near, far);
     cg_matrix_stack_set(projection_stack, &ortho);
@@ -1417,6 +1440,8 @@ _cg_framebuffer_push_projection(cg_framebuffer_t *framebuffer)
 {
     cg_matrix_stack_t *projection_stack =
         _cg_framebuffer_get_projection_stack(framebuffer);
+
+    _cg_framebuffer_flush(framebuffer);
     cg_matrix_stack_push(projection_stack);
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -1429,6 +1454,8 @@ _cg_framebuffer_pop_projection(cg_framebuffer_t *framebuffer)
 {
     cg_matrix_stack_t *projection_stack =
         _cg_framebuffer_get_projection_stack(framebuffer);
+
+    _cg_framebuffer_flush(framebuffer);
     cg_matrix_stack_pop(projection_stack);
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -1478,6 +1505,8 @@ cg_framebuffer_set_projection_matrix(cg_framebuffer_t *framebuffer,
     cg_matrix_stack_t *projection_stack =
         _cg_framebuffer_get_projection_stack(framebuffer);
 
+    _cg_framebuffer_flush(framebuffer);
+
     cg_matrix_stack_set(projection_stack, matrix);
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -1491,6 +1520,8 @@ void
 cg_framebuffer_push_scissor_clip(
     cg_framebuffer_t *framebuffer, int x, int y, int width, int height)
 {
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->clip_stack = _cg_clip_stack_push_window_rectangle(
         framebuffer->clip_stack, x, y, width, height);
 
@@ -1514,6 +1545,8 @@ cg_framebuffer_push_rectangle_clip(
                          framebuffer->viewport_width,
                          framebuffer->viewport_height };
 
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->clip_stack =
         _cg_clip_stack_push_rectangle(framebuffer->clip_stack,
                                       x_1,
@@ -1548,6 +1581,8 @@ cg_framebuffer_push_primitive_clip(cg_framebuffer_t *framebuffer,
                          framebuffer->viewport_width,
                          framebuffer->viewport_height };
 
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->clip_stack =
         _cg_clip_stack_push_primitive(framebuffer->clip_stack,
                                       primitive,
@@ -1567,6 +1602,8 @@ cg_framebuffer_push_primitive_clip(cg_framebuffer_t *framebuffer,
 void
 cg_framebuffer_pop_clip(cg_framebuffer_t *framebuffer)
 {
+    _cg_framebuffer_flush(framebuffer);
+
     framebuffer->clip_stack = _cg_clip_stack_pop(framebuffer->clip_stack);
 
     if (framebuffer->dev->current_draw_buffer == framebuffer)
@@ -1577,6 +1614,11 @@ cg_framebuffer_pop_clip(cg_framebuffer_t *framebuffer)
 void
 _cg_framebuffer_unref(cg_framebuffer_t *framebuffer)
 {
+    /* Draw any batched rectangles before the framebuffer is destroyed
+     * since an offscreen framebuffer's texture may outlive it */
+    if (((cg_object_t *)framebuffer)->ref_count == 1)
+        _cg_framebuffer_flush(framebuffer);
+
     /* Chain-up */
     _cg_object_default_unref(framebuffer);
 }
@@ -1864,45 +1906,299 @@ _cg_framebuffer_draw_indexed_attributes(cg_framebuffer_t *framebuffer,
     }
 }
 
-/* These rectangle drawing apis are horribly in-efficient but simple
- * and are only providing a stop-gap while we strip out the journal
- * from cg.
+/* Rectangles are drawn via a per-device vertex stream and, where
+ * possible, consecutive rectangles drawn with the same pipeline are
+ * batched into a single primitive. See cg_rectangle_batch_t.
  */
 
-void
-_cg_rectangle_immediate(cg_framebuffer_t *framebuffer,
+#define MAX_RECTANGLE_LAYERS 8
+
+static const char *tex_attrib_names[MAX_RECTANGLE_LAYERS] = {
+    "cg_tex_coord0_in",
+    "cg_tex_coord1_in",
+    "cg_tex_coord2_in",
+    "cg_tex_coord3_in",
+    "cg_tex_coord4_in",
+    "cg_tex_coord5_in",
+    "cg_tex_coord6_in",
+    "cg_tex_coord7_in",
+};
+
+/* The corners of a rectangle in the order expected by
+ * cg_get_rectangle_indices(), as indices into x1, y1, x2, y2
+ * coordinates */
+static const int rectangle_corners[4][2] = {
+    { 0, 1 }, { 0, 3 }, { 2, 3 }, { 2, 1 }
+};
+
+static void
+emit_rectangle_vertices(float *vertices,
+                        int n_position_components,
+                        int n_layers,
+                        const float *position,
+                        const float *tex_coords)
+{
+    int stride = n_position_components + 2 * n_layers;
+    int i, j;
+
+    for (i = 0; i < 4; i++) {
+        float *v = vertices + stride * i;
+        int x = rectangle_corners[i][0];
+        int y = rectangle_corners[i][1];
+
+        v[0] = position[x];
+        v[1] = position[y];
+        if (n_position_components == 3)
+            v[2] = 0;
+        v += n_position_components;
+
+        for (j = 0; j < n_layers; j++) {
+            v[0] = tex_coords[4 * j + x];
+            v[1] = tex_coords[4 * j + y];
+            v += 2;
+        }
+    }
+}
+
+static void
+draw_rectangle_vertices(cg_framebuffer_t *framebuffer,
                         cg_pipeline_t *pipeline,
-                        float x_1,
-                        float y_1,
-                        float x_2,
-                        float y_2)
+                        int n_position_components,
+                        int n_layers,
+                        const float *vertices,
+                        int n_rectangles,
+                        cg_draw_flags_t flags)
 {
     cg_device_t *dev = framebuffer->dev;
-    float vertices[8] = { x_1, y_1, x_1, y_2, x_2, y_1, x_2, y_2 };
+    size_t stride = sizeof(float) * (n_position_components + 2 * n_layers);
+    cg_attribute_t *attributes[MAX_RECTANGLE_LAYERS + 1];
     cg_attribute_buffer_t *attribute_buffer;
-    cg_attribute_t *attributes[1];
+    size_t offset;
+    int i;
+
+    attribute_buffer = _cg_vertex_stream_upload(dev->vertex_stream,
+                                                framebuffer,
+                                                vertices,
+                                                stride * 4 * n_rectangles,
+                                                stride,
+                                                &offset);
+    c_return_if_fail(attribute_buffer != NULL);
 
-    attribute_buffer = cg_attribute_buffer_new(dev, sizeof(vertices),
-                                               vertices);
     attributes[0] = cg_attribute_new(attribute_buffer,
                                      "cg_position_in",
-                                     sizeof(float) * 2, /* stride */
-                                     0, /* offset */
-                                     2, /* n_components */
+                                     stride,
+                                     offset,
+                                     n_position_components,
                                      CG_ATTRIBUTE_TYPE_FLOAT);
 
-    _cg_framebuffer_draw_attributes(framebuffer,
-                                    pipeline,
-                                    CG_VERTICES_MODE_TRIANGLE_STRIP,
-                                    0, /* first_index */
-                                    4, /* n_vertices */
-                                    attributes,
-                                    1, /* n attributes */
-                                    1, /* n instances */
-                                    CG_DRAW_SKIP_FRAMEBUFFER_FLUSH);
+    for (i = 0; i < n_layers; i++) {
+        size_t tex_offset =
+            sizeof(float) * (n_position_components + 2 * i);
+
+        attributes[i + 1] = cg_attribute_new(attribute_buffer,
+                                             tex_attrib_names[i],
+                                             stride,
+                                             offset + tex_offset,
+                                             2, /* n components */
+                                             CG_ATTRIBUTE_TYPE_FLOAT);
+    }
+
+    _cg_framebuffer_draw_indexed_attributes(
+        framebuffer,
+        pipeline,
+        CG_VERTICES_MODE_TRIANGLES,
+        0, /* first_vertex */
+        6 * n_rectangles,
+        cg_get_rectangle_indices(dev, n_rectangles),
+        attributes,
+        n_layers + 1,
+        1, /* n instances */
+        flags);
+
+    for (i = 0; i < n_layers + 1; i++)
+        cg_object_unref(attributes[i]);
+}
+
+static void
+reset_rectangle_batch(cg_rectangle_batch_t *batch)
+{
+    if (batch->pipeline) {
+        cg_object_unref(batch->pipeline);
+        batch->pipeline = NULL;
+    }
+    if (batch->source_pipeline) {
+        cg_object_unref(batch->source_pipeline);
+        batch->source_pipeline = NULL;
+    }
+    if (batch->source_texture) {
+        cg_object_unref(batch->source_texture);
+        batch->source_texture = NULL;
+    }
 
-    cg_object_unref(attributes[0]);
-    cg_object_unref(attribute_buffer);
+    batch->framebuffer = NULL;
+    batch->n_rectangles = 0;
+    c_array_set_size(batch->vertices, 0);
+}
+
+void
+_cg_rectangle_batch_flush(cg_device_t *dev)
+{
+    cg_rectangle_batch_t *batch = &dev->rectangle_batch;
+    cg_framebuffer_t *framebuffer = batch->framebuffer;
+
+    if (!framebuffer)
+        return;
+
+    /* Drawing will recurse back here via _cg_framebuffer_flush_state()
+     * so we need to mark the batch as no longer pending first */
+    batch->framebuffer = NULL;
+
+    CG_NOTE(DRAW, "Flushing %d batched rectangles", batch->n_rectangles);
+
+    /* The vertices have already been transformed into eye
+     * coordinates */
+    cg_framebuffer_push_matrix(framebuffer);
+    cg_framebuffer_identity_matrix(framebuffer);
+
+    draw_rectangle_vertices(framebuffer,
+                            batch->pipeline,
+                            3, /* n position components */
+                            batch->n_layers,
+                            (float *)batch->vertices->data,
+                            batch->n_rectangles,
+                            0); /* flags */
+
+    cg_framebuffer_pop_matrix(framebuffer);
+
+    reset_rectangle_batch(batch);
+}
+
+void
+_cg_rectangle_batch_destroy(cg_device_t *dev)
+{
+    cg_rectangle_batch_t *batch = &dev->rectangle_batch;
+
+    c_warn_if_fail(batch->framebuffer == NULL);
+
+    reset_rectangle_batch(batch);
+
+    if (batch->modelview_entry)
+        cg_matrix_entry_unref(batch->modelview_entry);
+
+    c_array_free(batch->vertices, true);
+}
+
+/* Returns space for the vertices of one rectangle in the batch or
+ * NULL if the rectangle can't be batched and should be drawn
+ * immediately */
+static float *
+prepare_batched_rectangle(cg_framebuffer_t *framebuffer,
+                          cg_pipeline_t *pipeline,
+                          int n_layers)
+{
+    cg_device_t *dev = framebuffer->dev;
+    cg_rectangle_batch_t *batch = &dev->rectangle_batch;
+    cg_matrix_entry_t *modelview_entry =
+        _cg_framebuffer_get_modelview_entry(framebuffer);
+    const c_matrix_t *modelview = &batch->modelview;
+    int n_floats = (3 + 2 * n_layers) * 4;
+    int len;
+
+    if (batch->framebuffer &&
+        (batch->framebuffer != framebuffer ||
+         batch->pipeline != pipeline ||
+         batch->n_layers != n_layers ||
+         (batch->vertices->len + n_floats) * sizeof(float) >
+         CG_VERTEX_STREAM_BUFFER_SIZE))
+        _cg_rectangle_batch_flush(dev);
+
+    if (modelview_entry != batch->modelview_entry) {
+        if (batch->modelview_entry)
+            cg_matrix_entry_unref(batch->modelview_entry);
+        batch->modelview_entry = cg_matrix_entry_ref(modelview_entry);
+        cg_matrix_entry_get(modelview_entry, &batch->modelview);
+    }
+
+    /* We can only transform vertices on the CPU for affine transforms */
+    if (modelview->wx != 0 || modelview->wy != 0 || modelview->wz != 0 ||
+        modelview->ww != 1)
+        return NULL;
+
+    if (!batch->framebuffer) {
+        /* Vertex snippets may depend on the modelview matrix which
+         * will be the identity when drawing a batch */
+        if (_cg_pipeline_has_vertex_snippets(pipeline))
+            return NULL;
+
+        batch->framebuffer = framebuffer;
+        batch->pipeline = cg_object_ref(pipeline);
+        batch->n_layers = n_layers;
+    }
+
+    len = batch->vertices->len;
+    c_array_set_size(batch->vertices, len + n_floats);
+    batch->n_rectangles++;
+
+    return &c_array_index(batch->vertices, float, len);
+}
+
+static void
+draw_rectangle(cg_framebuffer_t *framebuffer,
+               cg_pipeline_t *pipeline,
+               int n_layers,
+               const float *position,
+               const float *tex_coords)
+{
+    float *vertices =
+        prepare_batched_rectangle(framebuffer, pipeline, n_layers);
+
+    if (vertices) {
+        cg_rectangle_batch_t *batch = &framebuffer->dev->rectangle_batch;
+        size_t stride = sizeof(float) * (3 + 2 * n_layers);
+
+        emit_rectangle_vertices(vertices, 3, n_layers, position, tex_coords);
+        c_matrix_transform_points(&batch->modelview,
+                                  3, /* n_components */
+                                  stride,
+                                  vertices,
+                                  stride,
+                                  vertices,
+                                  4); /* n_points */
+    } else {
+        float *immediate = c_alloca(sizeof(float) * (2 + 2 * n_layers) * 4);
+
+        emit_rectangle_vertices(immediate, 2, n_layers, position, tex_coords);
+        draw_rectangle_vertices(framebuffer,
+                                pipeline,
+                                2, /* n position components */
+                                n_layers,
+                                immediate,
+                                1, /* n rectangles */
+                                0); /* flags */
+    }
+}
+
+/* NB: this is used while flushing the clip stack so it must not be
+ * batched. */
+void
+_cg_rectangle_immediate(cg_framebuffer_t *framebuffer,
+                        cg_pipeline_t *pipeline,
+                        float x_1,
+                        float y_1,
+                        float x_2,
+                        float y_2)
+{
+    float position[4] = { x_1, y_1, x_2, y_2 };
+    float vertices[8];
+
+    emit_rectangle_vertices(vertices, 2, 0, position, NULL);
+    draw_rectangle_vertices(framebuffer,
+                            pipeline,
+                            2, /* n position components */
+                            0, /* n layers */
+                            vertices,
+                            1, /* n rectangles */
+                            CG_DRAW_SKIP_FRAMEBUFFER_FLUSH);
 }
 
 void
@@ -1913,10 +2209,7 @@ cg_framebuffer_draw_rectangle(cg_framebuffer_t *fb,
                               float x_2,
                               float y_2)
 {
-    cg_device_t *dev = fb->dev;
-    float vertices[8] = { x_1, y_1, x_1, y_2, x_2, y_1, x_2, y_2 };
-    cg_attribute_buffer_t *attribute_buffer;
-    cg_attribute_t *attributes[1];
+    float position[4] = { x_1, y_1, x_2, y_2 };
 
     if (cg_pipeline_get_n_layers(pipeline)) {
         cg_framebuffer_draw_textured_rectangle(fb, pipeline,
@@ -1925,27 +2218,7 @@ cg_framebuffer_draw_rectangle(cg_framebuffer_t *fb,
         return;
     }
 
-    attribute_buffer = cg_attribute_buffer_new(dev, sizeof(vertices),
-                                               vertices);
-    attributes[0] = cg_attribute_new(attribute_buffer,
-                                     "cg_position_in",
-                                     sizeof(float) * 2, /* stride */
-                                     0, /* offset */
-                                     2, /* n_components */
-                                     CG_ATTRIBUTE_TYPE_FLOAT);
-
-    _cg_framebuffer_draw_attributes(fb,
-                                    pipeline,
-                                    CG_VERTICES_MODE_TRIANGLE_STRIP,
-                                    0, /* first_index */
-                                    4, /* n_vertices */
-                                    attributes,
-                                    1, /* n attributes */
-                                    1, /* n instances */
-                                    0); /* flags */
-
-    cg_object_unref(attributes[0]);
-    cg_object_unref(attribute_buffer);
+    draw_rectangle(fb, pipeline, 0, position, NULL);
 }
 
 static void
@@ -1960,106 +2233,26 @@ _cg_framebuffer_draw_textured_rectangle(cg_framebuffer_t *fb,
                                         float tx2,
                                         float ty2)
 {
-    int n_layers = MAX(MIN(cg_pipeline_get_n_layers(pipeline), 8), 1);
-    const char *tex_attrib_names[] = {
-        "cg_tex_coord0_in",
-        "cg_tex_coord1_in",
-        "cg_tex_coord2_in",
-        "cg_tex_coord3_in",
-        "cg_tex_coord4_in",
-        "cg_tex_coord5_in",
-        "cg_tex_coord6_in",
-        "cg_tex_coord7_in",
-    };
-    int vert_n_floats = 2 + 2 * n_layers;
-    int rect_n_floats = vert_n_floats * 4;
-    float *rect = c_alloca(rect_n_floats * sizeof(float));
-    cg_attribute_buffer_t *attribute_buffer;
-    int n_attributes = n_layers + 1;
-    cg_attribute_t *attributes[n_attributes];
-    float *vert;
+    int n_layers = MAX(MIN(cg_pipeline_get_n_layers(pipeline),
+                           MAX_RECTANGLE_LAYERS), 1);
+    float position[4] = { x1, y1, x2, y2 };
+    float tex_coords[4 * MAX_RECTANGLE_LAYERS];
     int i;
 
-    vert = rect;
-    vert[0] = x1;
-    vert[1] = y1;
-    vert[2] = tx1;
-    vert[3] = ty1;
-
-    vert += vert_n_floats;
-    vert[0] = x1;
-    vert[1] = y2;
-    vert[2] = tx1;
-    vert[3] = ty2;
-
-    vert += vert_n_floats;
-    vert[0] = x2;
-    vert[1] = y2;
-    vert[2] = tx2;
-    vert[3] = ty2;
-
-    vert += vert_n_floats;
-    vert[0] = x2;
-    vert[1] = y1;
-    vert[2] = tx2;
-    vert[3] = ty1;
-
-    vert += vert_n_floats;
-    vert[0] = tx1;
-    vert[1] = ty1;
-    vert[2] = tx2;
-    vert[3] = ty2;
+    tex_coords[0] = tx1;
+    tex_coords[1] = ty1;
+    tex_coords[2] = tx2;
+    tex_coords[3] = ty2;
 
+    /* Any additional layers get default texture coordinates */
     for (i = 1; i < n_layers; i++) {
-        vert = rect + 4;
-
-        vert[0] = 0;
-        vert[1] = 0;
-        vert += vert_n_floats;
-        vert[0] = 0;
-        vert[1] = 1;
-        vert += vert_n_floats;
-        vert[0] = 1;
-        vert[1] = 1;
-        vert += vert_n_floats;
-        vert[0] = 1;
-        vert[1] = 0;
-    }
-
-    attribute_buffer = cg_attribute_buffer_new(fb->dev,
-                                               rect_n_floats * sizeof(float),
-                                               rect);
-
-    attributes[0] = cg_attribute_new(attribute_buffer,
-                                     "cg_position_in",
-                                     vert_n_floats * sizeof(float),
-                                     0, /* offset */
-                                     2, /* n components */
-                                     CG_ATTRIBUTE_TYPE_FLOAT);
-
-    for (i = 0; i < n_layers; i++) {
-        attributes[i + 1] = cg_attribute_new(attribute_buffer,
-                                             tex_attrib_names[i],
-                                             vert_n_floats * sizeof(float),
-                                             sizeof(float) * 2 + sizeof(float) * 2 * i,
-                                             2, /* n components */
-                                             CG_ATTRIBUTE_TYPE_FLOAT);
+        tex_coords[4 * i] = 0;
+        tex_coords[4 * i + 1] = 0;
+        tex_coords[4 * i + 2] = 1;
+        tex_coords[4 * i + 3] = 1;
     }
 
-    cg_object_unref(attribute_buffer);
-
-    _cg_framebuffer_draw_attributes(fb,
-                                    pipeline,
-                                    CG_VERTICES_MODE_TRIANGLE_FAN,
-                                    0, /* first_index */
-                                    4, /* n_vertices */
-                                    attributes,
-                                    n_attributes,
-                                    1, /* n instances */
-                                    0); /* flags */
-
-    for (i = 0; i < n_attributes; i++)
-        cg_object_unref(attributes[i]);
+    draw_rectangle(fb, pipeline, n_layers, position, tex_coords);
 }
 
 struct foreach_state {
@@ -2085,7 +2278,9 @@ draw_rectangle_region_cb(cg_texture_t *texture,
 {
     struct foreach_state *state = user_data;
     cg_framebuffer_t *framebuffer = state->framebuffer;
-    cg_pipeline_t *override_pipeline = cg_pipeline_copy(state->pipeline);
+    cg_rectangle_batch_t *batch = &framebuffer->dev->rectangle_batch;
+    cg_pipeline_t *override_pipeline;
+    unsigned long age = _cg_pipeline_get_age(state->pipeline);
     float quad_coords[4];
 
 #define TEX_VIRTUAL_TO_QUAD(V, Q, AXIS)                                        \
@@ -2105,7 +2300,18 @@ draw_rectangle_region_cb(cg_texture_t *texture,
 
 #undef TEX_VIRTUAL_TO_QUAD
 
-    cg_pipeline_set_layer_texture(override_pipeline, 0, texture);
+    /* If the previous region was drawn to the same texture with an
+     * override of the same pipeline then we can reuse that override
+     * so the rectangles can be batched together */
+    if (batch->framebuffer == framebuffer &&
+        batch->source_pipeline == state->pipeline &&
+        batch->source_age == age &&
+        batch->source_texture == texture)
+        override_pipeline = cg_object_ref(batch->pipeline);
+    else {
+        override_pipeline = cg_pipeline_copy(state->pipeline);
+        cg_pipeline_set_layer_texture(override_pipeline, 0, texture);
+    }
 
     _cg_framebuffer_draw_textured_rectangle(framebuffer,
                                             override_pipeline,
@@ -2118,6 +2324,18 @@ draw_rectangle_region_cb(cg_texture_t *texture,
                                             subtexture_coords[2],
                                             subtexture_coords[3]);
 
+    if (batch->framebuffer == framebuffer &&
+        batch->pipeline == override_pipeline &&
+        batch->source_pipeline != state->pipeline) {
+        if (batch->source_pipeline)
+            cg_object_unref(batch->source_pipeline);
+        if (batch->source_texture)
+            cg_object_unref(batch->source_texture);
+        batch->source_pipeline = cg_object_ref(state->pipeline);
+        batch->source_age = age;
+        batch->source_texture = cg_object_ref(texture);
+    }
+
     cg_object_unref(override_pipeline);
 }
 
@@ -2256,45 +2474,18 @@ cg_framebuffer_draw_textured_rectangle(cg_framebuffer_t *fb,
                                             tx_1, ty_1, tx_2, ty_2);
 }
 
-
 void
 cg_framebuffer_draw_rectangles(cg_framebuffer_t *framebuffer,
                                cg_pipeline_t *pipeline,
                                const float *coordinates,
                                unsigned int n_rectangles)
 {
-    cg_vertex_p2_t *verts = c_alloca(n_rectangles * sizeof(cg_vertex_p2_t) * 4);
+    unsigned int i;
 
     c_warn_if_fail(cg_pipeline_get_n_layers(pipeline) == 0);
 
-    for (unsigned int i = 0; i < n_rectangles; i++) {
-        const float *pos = &coordinates[i * 4];
-        cg_vertex_p2_t *rect = verts + 4 * i;
-
-        rect[0].x = pos[0]; /* x1 */
-        rect[0].y = pos[1]; /* y1 */
-
-        rect[1].x = pos[0]; /* x1 */
-        rect[1].y = pos[3]; /* y2 */
-
-        rect[2].x = pos[2]; /* x2 */
-        rect[2].y = pos[3]; /* y2 */
-
-        rect[3].x = pos[2]; /* x2 */
-        rect[3].y = pos[1]; /* y1 */
-    }
-
-#warning "FIXME: cg_framebuffer_draw_rectangles shouldn't need to create a cg_primitive_t"
-    cg_primitive_t *prim = cg_primitive_new_p2(framebuffer->dev,
-                                               CG_VERTICES_MODE_TRIANGLES,
-                                               4 * n_rectangles,
-                                               verts);
-    cg_primitive_set_indices(prim,
-                             cg_get_rectangle_indices(framebuffer->dev,
-                                                      n_rectangles),
-                             n_rectangles * 6);
-    cg_primitive_draw(prim, framebuffer, pipeline);
-    cg_object_unref(prim);
+    for (i = 0; i < n_rectangles; i++)
+        draw_rectangle(framebuffer, pipeline, 0, &coordinates[i * 4], NULL);
 }
 
 void
@@ -2303,47 +2494,16 @@ cg_framebuffer_draw_textured_rectangles(cg_framebuffer_t *framebuffer,
                                         const float *coordinates,
                                         unsigned int n_rectangles)
 {
-    cg_vertex_p2t2_t *verts = c_alloca(n_rectangles * sizeof(cg_vertex_p2t2_t) * 4);
+    unsigned int i;
 
     c_warn_if_fail(cg_pipeline_get_n_layers(pipeline) == 1);
 
-    for (unsigned int i = 0; i < n_rectangles; i++) {
+    for (i = 0; i < n_rectangles; i++) {
         const float *pos = &coordinates[i * 8];
         const float *tex_coords = &coordinates[i * 8 + 4];
-        cg_vertex_p2t2_t *rect = verts + 4 * i;
-
-        rect[0].x = pos[0];
-        rect[0].y = pos[1];
-        rect[0].s = tex_coords[0];
-        rect[0].t = tex_coords[1];
-
-        rect[1].x = pos[0];
-        rect[1].y = pos[3];
-        rect[1].s = tex_coords[0];
-        rect[1].t = tex_coords[3];
-
-        rect[2].x = pos[2];
-        rect[2].y = pos[3];
-        rect[2].s = tex_coords[2];
-        rect[2].t = tex_coords[3];
-
-        rect[3].x = pos[2];
-        rect[3].y = pos[1];
-        rect[3].s = tex_coords[2];
-        rect[3].t = tex_coords[1];
-    }
 
-#warning "FIXME: cg_framebuffer_draw_textured_rectangles shouldn't need to create a cg_primitive_t"
-    cg_primitive_t *prim = cg_primitive_new_p2t2(framebuffer->dev,
-                                                 CG_VERTICES_MODE_TRIANGLES,
-                                                 4 * n_rectangles,
-                                                 verts);
-    cg_primitive_set_indices(prim,
-                             cg_get_rectangle_indices(framebuffer->dev,
-                                                      n_rectangles),
-                             n_rectangles * 6);
-    cg_primitive_draw(prim, framebuffer, pipeline);
-    cg_object_unref(prim);
+        draw_rectangle(framebuffer, pipeline, 1, pos, tex_coords);
+    }
 }
 
 cg_device_t *
@@ -915,6 +915,12 @@ _cg_pipeline_pre_change_notify(cg_pipeline_t *pipeline,
 {
     _CG_GET_DEVICE(dev, NO_RETVAL);
 
+    /* Batched rectangles referencing this pipeline have to be drawn
+     * with its current state */
+    if (dev->rectangle_batch.framebuffer &&
+        dev->rectangle_batch.pipeline == pipeline)
+        _cg_rectangle_batch_flush(dev);
+
     /* XXX:
      * To simplify things for the vertex, fragment and program backends
      * we are careful about how we report STATE_LAYERS changes.
@@ -361,6 +361,9 @@ cg_texture_set_region_from_bitmap(cg_texture_t *texture,
     if (!cg_texture_allocate(texture, error))
         return false;
 
+    /* Batched rectangles may be sampling the current contents */
+    _cg_rectangle_batch_flush(texture->dev);
+
     /* Note that we don't prepare the bitmap for upload here because
        some backends may be internally using a different format for the
        actual GL texture than that reported by
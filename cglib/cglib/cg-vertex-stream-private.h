@@ -0,0 +1,86 @@
+/*
+ * CGlib
+ *
+ * A Low-Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ */
+
+#ifndef __CG_VERTEX_STREAM_PRIVATE_H__
+#define __CG_VERTEX_STREAM_PRIVATE_H__
+
+#include <clib.h>
+
+#include "cg-types.h"
+#include "cg-attribute-buffer.h"
+#include "cg-framebuffer.h"
+
+/* The size of each buffer in the stream and so also the largest
+ * amount of data that can be uploaded at once. */
+#define CG_VERTEX_STREAM_BUFFER_SIZE (256 * 1024)
+
+/*
+ * A vertex stream is a ring of attribute buffers for uploading
+ * transient vertex data, such as for drawing rectangles, without
+ * needing to allocate new buffers for each draw.
+ *
+ * Data is appended to the current buffer using map-range with a
+ * discard-range hint. When a buffer is full it is retired with a
+ * fence and only reused once the GPU is known to have finished with
+ * it. If fences aren't supported (or all buffers are still busy)
+ * then we instead orphan the storage of a buffer so the driver can
+ * keep the old storage alive for any in-flight draws.
+ */
+typedef struct _cg_vertex_stream_t cg_vertex_stream_t;
+
+cg_vertex_stream_t *_cg_vertex_stream_new(cg_device_t *dev);
+
+void _cg_vertex_stream_free(cg_vertex_stream_t *stream);
+
+/*
+ * _cg_vertex_stream_upload:
+ * @stream: A #cg_vertex_stream_t
+ * @framebuffer: The framebuffer the data is about to be drawn to,
+ *               used for fencing the buffer once it is full
+ * @data: The vertex data to upload
+ * @size: The size of @data in bytes, no larger than
+ *        %CG_VERTEX_STREAM_BUFFER_SIZE
+ * @alignment: The required alignment of the data within the buffer,
+ *             typically the vertex stride
+ * @offset: (out): Returns the offset of the uploaded data
+ *
+ * Returns: (transfer none): The attribute buffer containing the
+ *   uploaded data. Attributes referencing it should be created
+ *   immediately since the buffer may be recycled by subsequent
+ *   uploads.
+ */
+cg_attribute_buffer_t *_cg_vertex_stream_upload(cg_vertex_stream_t *stream,
+                                                cg_framebuffer_t *framebuffer,
+                                                const void *data,
+                                                size_t size,
+                                                size_t alignment,
+                                                size_t *offset);
+
+#endif /* __CG_VERTEX_STREAM_PRIVATE_H__ */
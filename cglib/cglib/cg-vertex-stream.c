@@ -0,0 +1,274 @@
+/*
+ * CGlib
+ *
+ * A Low-Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ */
+
+#include <cglib-config.h>
+
+#include <string.h>
+
+#include "cg-vertex-stream-private.h"
+#include "cg-device-private.h"
+#include "cg-fence-private.h"
+#include "cg-buffer-private.h"
+#include "cg-attribute-buffer.h"
+#include "cg-error-private.h"
+
+/* The maximum number of buffers we will allocate before we resort to
+ * orphaning the storage of buffers that are still busy. */
+#define MAX_BUFFERS 4
+
+typedef struct _stream_buffer_t {
+    c_list_t link;
+
+    cg_vertex_stream_t *stream;
+    cg_attribute_buffer_t *buffer;
+
+    /* Set while waiting for the GPU to finish with the buffer */
+    cg_fence_closure_t *fence;
+} stream_buffer_t;
+
+struct _cg_vertex_stream_t {
+    cg_device_t *dev;
+
+    stream_buffer_t *current;
+    size_t offset;
+
+    /* Whether the next write to the current buffer should orphan its
+     * storage */
+    bool discard;
+
+    c_list_t free_buffers;
+    c_list_t busy_buffers;
+    int n_buffers;
+};
+
+cg_vertex_stream_t *
+_cg_vertex_stream_new(cg_device_t *dev)
+{
+    cg_vertex_stream_t *stream = c_slice_new0(cg_vertex_stream_t);
+
+    stream->dev = dev;
+    c_list_init(&stream->free_buffers);
+    c_list_init(&stream->busy_buffers);
+
+    return stream;
+}
+
+static void
+cancel_buffer_fence(stream_buffer_t *sb)
+{
+    if (sb->fence)
+        cg_framebuffer_cancel_fence_callback(sb->fence->framebuffer,
+                                             sb->fence);
+    sb->fence = NULL;
+}
+
+static void
+free_stream_buffer(stream_buffer_t *sb)
+{
+    cancel_buffer_fence(sb);
+    cg_object_unref(sb->buffer);
+    c_slice_free(stream_buffer_t, sb);
+}
+
+void
+_cg_vertex_stream_free(cg_vertex_stream_t *stream)
+{
+    stream_buffer_t *sb, *tmp;
+
+    if (stream->current)
+        free_stream_buffer(stream->current);
+
+    c_list_for_each_safe(sb, tmp, &stream->free_buffers, link)
+        free_stream_buffer(sb);
+    c_list_for_each_safe(sb, tmp, &stream->busy_buffers, link)
+        free_stream_buffer(sb);
+
+    c_slice_free(cg_vertex_stream_t, stream);
+}
+
+static void
+buffer_idle_cb(cg_fence_t *fence, void *user_data)
+{
+    stream_buffer_t *sb = user_data;
+    cg_vertex_stream_t *stream = sb->stream;
+
+    /* NB: the closure is freed once this callback returns */
+    sb->fence = NULL;
+
+    c_list_remove(&sb->link);
+    c_list_insert(stream->free_buffers.prev, &sb->link);
+}
+
+/* If the framebuffer is destroyed before the fence completes we'll
+ * never know when the buffer becomes idle, so we drop the buffer
+ * instead. GL keeps its storage alive for as long as the GPU needs
+ * it. */
+static void
+buffer_fence_cancelled_cb(void *user_data)
+{
+    stream_buffer_t *sb = user_data;
+    cg_vertex_stream_t *stream = sb->stream;
+
+    /* NB: the closure has already been freed */
+    sb->fence = NULL;
+
+    c_list_remove(&sb->link);
+    stream->n_buffers--;
+
+    free_stream_buffer(sb);
+}
+
+static stream_buffer_t *
+new_stream_buffer(cg_vertex_stream_t *stream)
+{
+    stream_buffer_t *sb = c_slice_new0(stream_buffer_t);
+
+    sb->stream = stream;
+    sb->buffer = cg_attribute_buffer_new_with_size(
+        stream->dev, CG_VERTEX_STREAM_BUFFER_SIZE);
+    cg_buffer_set_update_hint(CG_BUFFER(sb->buffer),
+                              CG_BUFFER_UPDATE_HINT_STREAM);
+
+    stream->n_buffers++;
+
+    return sb;
+}
+
+static void
+next_buffer(cg_vertex_stream_t *stream, cg_framebuffer_t *framebuffer)
+{
+    stream_buffer_t *sb;
+
+    stream->offset = 0;
+
+    if (stream->current) {
+        sb = stream->current;
+
+        sb->fence = cg_framebuffer_add_fence_callback(
+            framebuffer, buffer_idle_cb, sb);
+
+        /* Without fences we simply orphan the current buffer's
+         * storage and keep writing to it */
+        if (!sb->fence) {
+            stream->discard = true;
+            return;
+        }
+
+        _cg_fence_closure_set_cancel_callback(sb->fence,
+                                              buffer_fence_cancelled_cb);
+
+        c_list_insert(stream->busy_buffers.prev, &sb->link);
+        stream->current = NULL;
+    }
+
+    if (!c_list_empty(&stream->free_buffers)) {
+        sb = c_container_of(stream->free_buffers.next, stream_buffer_t, link);
+        c_list_remove(&sb->link);
+        stream->discard = false;
+    } else if (stream->n_buffers < MAX_BUFFERS) {
+        sb = new_stream_buffer(stream);
+        stream->discard = true;
+    } else {
+        /* All of our buffers are still in use so reclaim the oldest
+         * and orphan its storage */
+        sb = c_container_of(stream->busy_buffers.next, stream_buffer_t, link);
+        c_list_remove(&sb->link);
+        cancel_buffer_fence(sb);
+        stream->discard = true;
+    }
+
+    stream->current = sb;
+}
+
+static void
+write_data(cg_vertex_stream_t *stream,
+           size_t offset,
+           const void *data,
+           size_t size)
+{
+    cg_buffer_t *buffer = CG_BUFFER(stream->current->buffer);
+    cg_buffer_map_hint_t hints;
+    cg_error_t *ignore_error = NULL;
+    void *dst;
+
+    if (stream->discard)
+        hints = CG_BUFFER_MAP_HINT_DISCARD;
+    else
+        hints = CG_BUFFER_MAP_HINT_DISCARD_RANGE;
+
+    stream->discard = false;
+
+    dst = cg_buffer_map_range(buffer, offset, size,
+                              CG_BUFFER_ACCESS_WRITE, hints, &ignore_error);
+    if (dst) {
+        memcpy(dst, data, size);
+        cg_buffer_unmap(buffer);
+        return;
+    }
+
+    if (ignore_error) {
+        cg_error_free(ignore_error);
+        ignore_error = NULL;
+    }
+
+    if (!cg_buffer_set_data(buffer, offset, data, size, &ignore_error) &&
+        ignore_error)
+        cg_error_free(ignore_error);
+}
+
+cg_attribute_buffer_t *
+_cg_vertex_stream_upload(cg_vertex_stream_t *stream,
+                         cg_framebuffer_t *framebuffer,
+                         const void *data,
+                         size_t size,
+                         size_t alignment,
+                         size_t *offset)
+{
+    size_t aligned_offset;
+
+    c_return_val_if_fail(size <= CG_VERTEX_STREAM_BUFFER_SIZE, NULL);
+
+    aligned_offset = stream->offset;
+    if (alignment > 1)
+        aligned_offset = (aligned_offset + alignment - 1) / alignment * alignment;
+
+    if (!stream->current ||
+        aligned_offset + size > CG_VERTEX_STREAM_BUFFER_SIZE) {
+        next_buffer(stream, framebuffer);
+        aligned_offset = 0;
+    }
+
+    write_data(stream, aligned_offset, data, size);
+
+    stream->offset = aligned_offset + size;
+    *offset = aligned_offset;
+
+    return stream->current->buffer;
+}
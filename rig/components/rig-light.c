@@ -31,9 +31,27 @@
 #include "rig-entity.h"
 #include "rig-entity-inlines.h"
 #include "rig-light.h"
+#include "rig-lighting.h"
 #include "rut-color.h"
 
+static rut_ui_enum_t kind_enum = {
+    .nick = "Kind",
+    .values = { { RIG_LIGHT_KIND_DIRECTIONAL, "Directional",
+                  "Directional Light" },
+                { RIG_LIGHT_KIND_SPOT, "Spot", "Spot Light" },
+                { 0 } }
+};
+
 static rig_property_spec_t _rig_light_prop_specs[] = {
+    { .name = "kind",
+      .nick = "Kind",
+      .type = RUT_PROPERTY_TYPE_ENUM,
+      .getter.any_type = rig_light_get_kind,
+      .setter.any_type = rig_light_set_kind,
+      .flags = RUT_PROPERTY_FLAG_READWRITE |
+          RUT_PROPERTY_FLAG_VALIDATE |
+          RUT_PROPERTY_FLAG_EXPORT_FRONTEND,
+      .validation = { .ui_enum = &kind_enum } },
     { .name = "ambient",
       .nick = "Ambient",
       .type = RUT_PROPERTY_TYPE_COLOR,
@@ -61,49 +79,64 @@ static rig_property_spec_t _rig_light_prop_specs[] = {
     { 0 }
 };
 
-static float *
-get_color_array(cg_color_t *color)
+static void
+get_color_array(const cg_color_t *color, float *array)
 {
-    static float array[4];
-
     array[0] = color->red;
     array[1] = color->green;
     array[2] = color->blue;
     array[3] = color->alpha;
-
-    return array;
 }
 
 void
-rig_light_set_uniforms(rig_light_t *light, cg_pipeline_t *pipeline)
+rig_light_get_uniforms(rig_light_t *light, rig_light_uniforms_t *uniforms)
 {
     rut_componentable_props_t *component =
         rut_object_get_properties(light, RUT_TRAIT_ID_COMPONENTABLE);
     rig_entity_t *entity = component->entity;
     float origin[3] = { 0, 0, 0 };
-    float norm_direction[3] = { 0, 0, 1 };
-    int location;
+    float *norm_direction = uniforms->direction_norm;
+
+    norm_direction[0] = 0;
+    norm_direction[1] = 0;
+    norm_direction[2] = 1;
 
     rig_entity_get_transformed_position(entity, origin);
     rig_entity_get_transformed_position(entity, norm_direction);
     c_vector3_subtract(norm_direction, norm_direction, origin);
     c_vector3_normalize(norm_direction);
 
+    get_color_array(&light->ambient, uniforms->ambient);
+    get_color_array(&light->diffuse, uniforms->diffuse);
+    get_color_array(&light->specular, uniforms->specular);
+
+    uniforms->spot = light->kind == RIG_LIGHT_KIND_SPOT ? 1 : 0;
+}
+
+void
+rig_light_set_uniforms(rig_light_t *light, cg_pipeline_t *pipeline, int index)
+{
+    rig_light_uniforms_t uniforms;
+    int location;
+
+    rig_light_get_uniforms(light, &uniforms);
+
     location =
-        cg_pipeline_get_uniform_location(pipeline, "light0_direction_norm");
-    cg_pipeline_set_uniform_float(pipeline, location, 3, 1, norm_direction);
+        rig_lighting_get_uniform_location(pipeline, index, "direction_norm");
+    cg_pipeline_set_uniform_float(pipeline, location, 3, 1,
+                                  uniforms.direction_norm);
 
-    location = cg_pipeline_get_uniform_location(pipeline, "light0_ambient");
-    cg_pipeline_set_uniform_float(
-        pipeline, location, 4, 1, get_color_array(&light->ambient));
+    location = rig_lighting_get_uniform_location(pipeline, index, "ambient");
+    cg_pipeline_set_uniform_float(pipeline, location, 4, 1, uniforms.ambient);
 
-    location = cg_pipeline_get_uniform_location(pipeline, "light0_diffuse");
-    cg_pipeline_set_uniform_float(
-        pipeline, location, 4, 1, get_color_array(&light->diffuse));
+    location = rig_lighting_get_uniform_location(pipeline, index, "diffuse");
+    cg_pipeline_set_uniform_float(pipeline, location, 4, 1, uniforms.diffuse);
 
-    location = cg_pipeline_get_uniform_location(pipeline, "light0_specular");
-    cg_pipeline_set_uniform_float(
-        pipeline, location, 4, 1, get_color_array(&light->specular));
+    location = rig_lighting_get_uniform_location(pipeline, index, "specular");
+    cg_pipeline_set_uniform_float(pipeline, location, 4, 1, uniforms.specular);
+
+    location = rig_lighting_get_uniform_location(pipeline, index, "spot");
+    cg_pipeline_set_uniform_1f(pipeline, location, uniforms.spot);
 }
 
 static void
@@ -129,6 +162,7 @@ _rig_light_copy(rut_object_t *object)
     rig_engine_t *engine = rig_component_props_get_engine(&light->component);
     rig_light_t *copy = rig_light_new(engine);
 
+    copy->kind = light->kind;
     copy->ambient = light->ambient;
     copy->diffuse = light->diffuse;
     copy->specular = light->specular;
@@ -188,6 +222,30 @@ rig_light_free(rig_light_t *light)
     rut_object_free(rig_light_t, light);
 }
 
+void
+rig_light_set_kind(rut_object_t *obj, int kind)
+{
+    rig_light_t *light = obj;
+    rig_property_context_t *prop_ctx;
+
+    if (light->kind == kind)
+        return;
+
+    light->kind = kind;
+    light->uniforms_age++;
+
+    prop_ctx = rig_component_props_get_property_context(&light->component);
+    rig_property_dirty(prop_ctx, &light->properties[RIG_LIGHT_PROP_KIND]);
+}
+
+int
+rig_light_get_kind(rut_object_t *obj)
+{
+    rig_light_t *light = obj;
+
+    return light->kind;
+}
+
 void
 rig_light_set_ambient(rut_object_t *obj, const cg_color_t *ambient)
 {
@@ -195,6 +253,7 @@ rig_light_set_ambient(rut_object_t *obj, const cg_color_t *ambient)
     rig_property_context_t *prop_ctx;
 
     light->ambient = *ambient;
+    light->uniforms_age++;
 
     prop_ctx = rig_component_props_get_property_context(&light->component);
     rig_property_dirty(prop_ctx, &light->properties[RIG_LIGHT_PROP_AMBIENT]);
@@ -215,6 +274,7 @@ rig_light_set_diffuse(rut_object_t *obj, const cg_color_t *diffuse)
     rig_property_context_t *prop_ctx;
 
     light->diffuse = *diffuse;
+    light->uniforms_age++;
 
     prop_ctx = rig_component_props_get_property_context(&light->component);
     rig_property_dirty(prop_ctx, &light->properties[RIG_LIGHT_PROP_DIFFUSE]);
@@ -233,6 +293,7 @@ rig_light_set_specular(rut_object_t *obj, const cg_color_t *specular)
     rig_property_context_t *prop_ctx;
 
     light->specular = *specular;
+    light->uniforms_age++;
 
     prop_ctx = rig_component_props_get_property_context(&light->component);
     rig_property_dirty(prop_ctx, &light->properties[RIG_LIGHT_PROP_SPECULAR]);
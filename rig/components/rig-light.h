@@ -34,7 +34,15 @@
 typedef struct _rig_light_t rig_light_t;
 extern rut_type_t rig_light_type;
 
+/* A spot light's cone is given by the field of view of the camera
+ * component used to render the light's shadow map */
+typedef enum _rig_light_kind_t {
+    RIG_LIGHT_KIND_DIRECTIONAL,
+    RIG_LIGHT_KIND_SPOT,
+} rig_light_kind_t;
+
 enum {
+    RIG_LIGHT_PROP_KIND,
     RIG_LIGHT_PROP_AMBIENT,
     RIG_LIGHT_PROP_DIFFUSE,
     RIG_LIGHT_PROP_SPECULAR,
@@ -44,10 +52,15 @@ enum {
 struct _rig_light_t {
     rut_object_base_t _base;
     rut_componentable_props_t component;
+    rig_light_kind_t kind;
     cg_color_t ambient;
     cg_color_t diffuse;
     cg_color_t specular;
 
+    /* Bumped whenever a color changes so renderers can tell when
+     * uniforms need re-flushing */
+    int uniforms_age;
+
     rig_introspectable_props_t introspectable;
     rig_property_t properties[RIG_LIGHT_N_PROPS];
 };
@@ -56,6 +69,10 @@ rig_light_t *rig_light_new(rig_engine_t *engine);
 
 void rig_light_free(rig_light_t *light);
 
+void rig_light_set_kind(rut_object_t *light, int kind);
+
+int rig_light_get_kind(rut_object_t *light);
+
 void rig_light_set_ambient(rut_object_t *light, const cg_color_t *ambient);
 
 const cg_color_t *rig_light_get_ambient(rut_object_t *light);
@@ -68,8 +85,22 @@ void rig_light_set_specular(rut_object_t *light, const cg_color_t *specular);
 
 const cg_color_t *rig_light_get_specular(rig_light_t *light);
 
-void rig_light_add_pipeline(rig_light_t *light, cg_pipeline_t *pipeline);
-
-void rig_light_set_uniforms(rig_light_t *light, cg_pipeline_t *pipeline);
+/* The values of the light<index>_* uniforms used by the lighting
+ * snippets */
+typedef struct _rig_light_uniforms_t {
+    float direction_norm[3];
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float spot;
+} rig_light_uniforms_t;
+
+void rig_light_get_uniforms(rig_light_t *light,
+                            rig_light_uniforms_t *uniforms);
+
+/* Sets the light<index>_* uniforms used by the lighting snippets */
+void rig_light_set_uniforms(rig_light_t *light,
+                            cg_pipeline_t *pipeline,
+                            int index);
 
 #endif /* __RIG_LIGHT_H__ */
@@ -482,6 +482,7 @@ rig_material_set_alpha_mask_threshold(rut_object_t *obj, float threshold)
         return;
 
     material->alpha_mask_threshold = threshold;
+    material->uniforms_age++;
 
     prop_ctx = rig_component_props_get_property_context(&material->component);
     rig_property_dirty(prop_ctx, &material->properties[RIG_MATERIAL_PROP_ALPHA_MASK_THRESHOLD]);
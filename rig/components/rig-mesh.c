@@ -365,6 +365,15 @@ rig_mesh_update_bounds(rig_mesh_t *mesh)
     rig_property_dirty(prop_ctx, &mesh->properties[RIG_MESH_PROP_Z_MAX]);
 }
 
+static void
+mesh_changed(rig_mesh_t *mesh)
+{
+    rut_mesh_changed(mesh->rut_mesh);
+
+    if (mesh->component.parented)
+        rig_entity_notify_bounds_changed(mesh->component.entity);
+}
+
 void
 rig_mesh_set_attributes(rig_mesh_t *mesh,
                         rut_attribute_t **attributes,
@@ -373,6 +382,8 @@ rig_mesh_set_attributes(rig_mesh_t *mesh,
     rut_mesh_set_attributes(mesh->rut_mesh,
                             attributes,
                             n_attributes);
+
+    mesh_changed(mesh);
 }
 
 rig_mesh_t *
@@ -531,6 +542,8 @@ rig_mesh_set_n_vertices(rut_object_t *obj, int n_vertices)
 
     mesh->rut_mesh->n_vertices = n_vertices;
 
+    mesh_changed(mesh);
+
     prop_ctx = rig_component_props_get_property_context(&mesh->component);
     rig_property_dirty(prop_ctx, &mesh->properties[RIG_MESH_PROP_N_VERTICES]);
 }
@@ -553,6 +566,8 @@ rig_mesh_set_vertices_mode(rut_object_t *obj, int mode)
 
     mesh->rut_mesh->mode = mode;
 
+    mesh_changed(mesh);
+
     prop_ctx = rig_component_props_get_property_context(&mesh->component);
     rig_property_dirty(prop_ctx, &mesh->properties[RIG_MESH_PROP_VERTICES_MODE]);
 }
@@ -575,6 +590,8 @@ rig_mesh_set_indices(rut_object_t *obj, rut_object_t *buffer)
 
     mesh->rut_mesh->indices_buffer = buffer;
 
+    mesh_changed(mesh);
+
     prop_ctx = rig_component_props_get_property_context(&mesh->component);
     rig_property_dirty(prop_ctx, &mesh->properties[RIG_MESH_PROP_INDICES]);
 }
@@ -597,6 +614,8 @@ rig_mesh_set_indices_type(rut_object_t *obj, int indices_type)
 
     mesh->rut_mesh->indices_type = indices_type;
 
+    mesh_changed(mesh);
+
     prop_ctx = rig_component_props_get_property_context(&mesh->component);
     rig_property_dirty(prop_ctx, &mesh->properties[RIG_MESH_PROP_INDICES_TYPE]);
 }
@@ -619,6 +638,8 @@ rig_mesh_set_n_indices(rut_object_t *obj, int n_indices)
 
     mesh->rut_mesh->n_indices = n_indices;
 
+    mesh_changed(mesh);
+
     prop_ctx = rig_component_props_get_property_context(&mesh->component);
     rig_property_dirty(prop_ctx, &mesh->properties[RIG_MESH_PROP_N_INDICES]);
 }
@@ -293,6 +293,9 @@ free_mesh(rig_nine_slice_t *nine_slice)
     if (nine_slice->mesh) {
         rut_object_unref(nine_slice->mesh);
         nine_slice->mesh = NULL;
+
+        if (nine_slice->component.parented)
+            rig_entity_notify_bounds_changed(nine_slice->component.entity);
     }
 }
 
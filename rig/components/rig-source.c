@@ -89,6 +89,7 @@ enum load_status {
     LOAD_STATE_NONE,
     LOAD_STATE_MIME_QUERY,
     LOAD_STATE_READING,
+    LOAD_STATE_DECODING,
     LOAD_STATE_LOADED,
     LOAD_STATE_ERROR,
 };
@@ -103,6 +104,7 @@ typedef struct load_state
 
     xdgmime_request_t mime_req;
     uv_work_t read_req;
+    uv_work_t decode_req;
 
     char *error;
 } load_state_t;
@@ -153,6 +155,13 @@ struct _rig_source_t {
         uint8_t *dst_frame_buf;
         size_t dst_frame_buf_size;
         AVFrame *dst_frame;
+
+        /* The Y, U and V planes of the latest frame. These either
+         * point into dst_frame, if the decoder already output
+         * YUV420P, or into dst_frame_buf after conversion. */
+        uint8_t *planes[3];
+        int strides[3];
+
         uint64_t age;
     } ff_buffered_state[2];
     int ff_decode_buf;
@@ -171,8 +180,17 @@ struct _rig_source_t {
 
     gif_animation gif;
 
+    /* The start time of each GIF frame in seconds, with one extra
+     * entry at the end for the total duration of the animation */
+    double *gif_frame_starts;
+
+    /* The frame currently uploaded to textures[0] or -1 */
     int gif_current_frame;
-    double gif_current_elapsed;
+
+    /* Decoded RGBA frames, most recently used first */
+    c_list_t gif_frame_cache;
+    int gif_n_cached_frames;
+    int gif_max_cached_frames;
 
     int first_layer;
     bool default_sample;
@@ -187,6 +205,8 @@ struct _rig_source_t {
     rig_property_t properties[RIG_SOURCE_N_PROPS];
 };
 
+static void gif_free_frame_cache(rig_source_t *source);
+
 typedef struct _source_wrappers_t {
     cg_snippet_t *source_vertex_wrapper;
     cg_snippet_t *source_fragment_wrapper;
@@ -385,6 +405,10 @@ destroy_load_state(rig_source_t *source)
     case LOAD_STATE_READING:
         uv_cancel((uv_req_t *)&state->read_req);
         break;
+    case LOAD_STATE_DECODING:
+        /* The source is kept alive while decoding */
+        c_warn_if_reached();
+        break;
     case LOAD_STATE_MIME_QUERY:
         xdgmime_request_cancel(&state->mime_req);
         break;
@@ -425,6 +449,12 @@ _rig_source_free(void *object)
         }
     }
 
+    if (source->type == SOURCE_TYPE_GIF) {
+        gif_free_frame_cache(source);
+        gif_finalise(&source->gif);
+        c_free(source->gif_frame_starts);
+    }
+
     if (source->data)
         c_free(source->data);
 
@@ -489,8 +519,10 @@ _source_set_textures(rig_source_t *source,
     c_return_if_fail(n_textures != 0);
     c_return_if_fail(textures != NULL);
 
-    for (int i = 0; i < source->n_textures; i++)
+    for (int i = 0; i < source->n_textures; i++) {
         cg_object_unref(source->textures[i]);
+        source->textures[i] = NULL;
+    }
 
     for (int i = 0; i < n_textures; i++)
         source->textures[i] = cg_object_ref(textures[i]);
@@ -773,6 +805,131 @@ static gif_bitmap_callback_vt bitmap_callbacks = {
     bitmap_modified
 };
 
+/* Upper bound on the memory used to cache decoded frames for each
+ * animated GIF. Small GIFs will typically have all of their frames
+ * cached so looping them doesn't need to decode anything. */
+#define GIF_FRAME_CACHE_SIZE (4 * 1024 * 1024)
+
+struct gif_cached_frame
+{
+    c_list_t link;
+    int frame;
+    uint8_t *buf;
+};
+
+static double
+gif_frame_delay(gif_frame *frame)
+{
+    /* Delays are in centiseconds and, like browsers, we treat a delay
+     * of zero as 10cs so that the animation still has a duration */
+    unsigned int delay = frame->frame_delay ? frame->frame_delay : 10;
+
+    return delay / 100.0;
+}
+
+static void
+gif_build_frame_index(rig_source_t *source)
+{
+    gif_animation *gif = &source->gif;
+    int frame_size = gif->width * gif->height * 4;
+
+    source->gif_frame_starts = c_new(double, gif->frame_count + 1);
+    source->gif_frame_starts[0] = 0;
+    for (int i = 0; i < gif->frame_count; i++) {
+        source->gif_frame_starts[i + 1] =
+            source->gif_frame_starts[i] + gif_frame_delay(&gif->frames[i]);
+    }
+
+    source->gif_max_cached_frames =
+        MAX(1, GIF_FRAME_CACHE_SIZE / MAX(frame_size, 1));
+}
+
+/* Maps an elapsed time in seconds to a frame index by binary searching
+ * the frame start times */
+static int
+gif_find_frame(rig_source_t *source, double elapsed)
+{
+    gif_animation *gif = &source->gif;
+    int frame_count = gif->frame_count;
+    double duration = source->gif_frame_starts[frame_count];
+    int lo = 0, hi = frame_count - 1;
+
+    if (elapsed <= 0)
+        return 0;
+
+    /* A loop count of zero means loop forever */
+    if (gif->loop_count > 0 && elapsed >= duration * gif->loop_count)
+        return frame_count - 1;
+
+    elapsed = fmod(elapsed, duration);
+
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+
+        if (source->gif_frame_starts[mid] <= elapsed)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+static void
+gif_free_frame_cache(rig_source_t *source)
+{
+    struct gif_cached_frame *cached, *tmp;
+
+    c_list_for_each_safe(cached, tmp, &source->gif_frame_cache, link) {
+        c_free(cached->buf);
+        c_slice_free(struct gif_cached_frame, cached);
+    }
+    c_list_init(&source->gif_frame_cache);
+    source->gif_n_cached_frames = 0;
+}
+
+/* Returns the decoded RGBA data for the given frame, either from the
+ * cache or by decoding it and evicting the least recently used frame
+ * if the cache is full. */
+static uint8_t *
+gif_get_frame(rig_source_t *source, int frame)
+{
+    gif_animation *gif = &source->gif;
+    size_t frame_size = gif->width * gif->height * 4;
+    struct gif_cached_frame *cached;
+    gif_result code;
+
+    c_list_for_each(cached, &source->gif_frame_cache, link) {
+        if (cached->frame == frame) {
+            c_list_remove(&cached->link);
+            c_list_insert(&source->gif_frame_cache, &cached->link);
+            return cached->buf;
+        }
+    }
+
+    code = gif_decode_frame(gif, frame);
+    if (code != GIF_OK) {
+        c_warning("failed to load GIF frame %d", frame);
+        return NULL;
+    }
+
+    if (source->gif_n_cached_frames < source->gif_max_cached_frames) {
+        cached = c_slice_new(struct gif_cached_frame);
+        cached->buf = c_malloc(frame_size);
+        source->gif_n_cached_frames++;
+    } else {
+        cached = c_container_of(source->gif_frame_cache.prev,
+                                struct gif_cached_frame, link);
+        c_list_remove(&cached->link);
+    }
+
+    cached->frame = frame;
+    memcpy(cached->buf, bitmap_get_buffer(gif, gif->frame_image), frame_size);
+    c_list_insert(&source->gif_frame_cache, &cached->link);
+
+    return cached->buf;
+}
+
 static void
 _source_idle_load_cb(rig_source_t *source)
 {
@@ -825,6 +982,9 @@ rig_source_new(rig_engine_t *engine,
     c_list_init(&source->ready_cb_list);
     c_list_init(&source->error_cb_list);
 
+    c_list_init(&source->gif_frame_cache);
+    source->gif_current_frame = -1;
+
     if (engine->frontend) {
         rut_shell_t *shell = engine->shell;
 
@@ -951,10 +1111,82 @@ cleanup_ffmpeg_state(rig_source_t *source)
      * we allocated yet...*/
     av_freep(&source->ff_avio_buf);
 
+    for (int i = 0; i < 2; i++) {
+        struct ff_buffered_state *buffered_state =
+            &source->ff_buffered_state[i];
+
+        if (buffered_state->dst_frame)
+            av_frame_free(&buffered_state->dst_frame);
+        av_freep(&buffered_state->dst_frame_buf);
+        buffered_state->dst_frame_buf_size = 0;
+    }
+
     source->ff_read_pos = 0;
 }
 #endif
 
+/* NB: runs in a worker thread so mustn't touch anything except the
+ * source's gif state */
+static void
+decode_gif_cb(uv_work_t *req)
+{
+    rig_source_t *source = req->data;
+    load_state_t *state = &source->load_state;
+    gif_result code;
+
+    gif_create(&source->gif, &bitmap_callbacks);
+
+    source->gif.priv = rig_component_props_get_engine(&source->component)->shell;
+
+    do {
+        code = gif_initialise(&source->gif, source->data_len, source->data);
+        if (code != GIF_OK && code != GIF_WORKING) {
+            state->error = c_strdup("failed to load GIF");
+            return;
+        }
+    } while (code != GIF_OK);
+
+    gif_build_frame_index(source);
+
+    /* Populate the frame cache so the first attach only needs to
+     * upload */
+    gif_get_frame(source, 0);
+}
+
+static void
+finished_decode_gif_cb(uv_work_t *req, int status)
+{
+    rig_source_t *source = req->data;
+    load_state_t *state = &source->load_state;
+    rig_engine_t *engine = rig_component_props_get_engine(&source->component);
+
+    if (status == UV_ECANCELED && !state->error)
+        state->error = c_strdup("GIF decoding cancelled");
+
+    if (state->error) {
+        c_warning("%s", state->error);
+        state->status = LOAD_STATE_ERROR;
+        gif_finalise(&source->gif);
+
+        rut_closure_list_invoke(&source->error_cb_list,
+                                rig_source_error_callback_t,
+                                source,
+                                state->error);
+    } else {
+        source->timeline = rig_timeline_new(engine, FLT_MAX);
+
+        source->type = SOURCE_TYPE_GIF;
+        state->status = LOAD_STATE_LOADED;
+
+        source->changed = true;
+
+        rut_closure_list_invoke(
+            &source->ready_cb_list, rig_source_ready_callback_t, source);
+    }
+
+    rut_object_unref(source);
+}
+
 static void
 _source_load_progress(rig_source_t *source)
 {
@@ -1094,28 +1326,16 @@ _source_load_progress(rig_source_t *source)
     } else
 #else
     if (strcmp(source->mime, "image/gif") == 0) {
-        gif_result code;
-
-	gif_create(&source->gif, &bitmap_callbacks);
-
-        source->gif.priv = shell;
-
-        /* FIXME: load the GIF asynchronously */
-	do {
-            code = gif_initialise(&source->gif, source->data_len, source->data);
-            if (code != GIF_OK && code != GIF_WORKING) {
-                c_warning("failed to load GIF");
-
-                state->status = LOAD_STATE_ERROR;
-                state->error = c_strdup("failed to load GIF");
-                return;
-            }
-        } while (code != GIF_OK);
-
-        source->timeline = rig_timeline_new(engine, FLT_MAX);
-
-        source->type = SOURCE_TYPE_GIF;
-        state->status = LOAD_STATE_LOADED;
+        /* Parsing the GIF and decoding its first frame is done in the
+         * uv threadpool so that loading a UI with lots of sources can
+         * make use of multiple cores. The texture is only created
+         * on this thread when the first frame is attached. */
+        state->status = LOAD_STATE_DECODING;
+        state->decode_req.data = rut_object_ref(source);
+        uv_queue_work(shell->uv_loop,
+                      &state->decode_req,
+                      decode_gif_cb,
+                      finished_decode_gif_cb);
     } else
 #endif
 #ifdef USE_FFMPEG
@@ -1512,26 +1732,15 @@ rig_source_setup_pipeline(rig_source_t *source,
 }
 
 static cg_texture_2d_t *
-upload_plane(cg_device_t *dev,
-             int width,
-             int height,
-             cg_pixel_format_t format,
-             int rowstride,
-             uint8_t *data)
-{
-    cg_bitmap_t *bmp = cg_bitmap_new_for_data(dev,
-                                              width,
-                                              height,
-                                              format,
-                                              rowstride,
-                                              data);
-    cg_texture_2d_t *tex = cg_texture_2d_new_from_bitmap(bmp);
+new_plane_texture(cg_device_t *dev, int width, int height)
+{
+    cg_texture_2d_t *tex = cg_texture_2d_new_with_size(dev, width, height);
     cg_error_t *error = NULL;
 
-    cg_object_unref(bmp);
+    cg_texture_set_components(tex, CG_TEXTURE_COMPONENTS_A);
 
     if (!cg_texture_allocate(tex, &error)) {
-        c_warning("Failed to upload video plane: %s", error->message);
+        c_warning("Failed to allocate video plane: %s", error->message);
         cg_error_free(error);
         cg_object_unref(tex);
         tex = NULL;
@@ -1540,6 +1749,40 @@ upload_plane(cg_device_t *dev,
     return tex;
 }
 
+static bool
+update_plane(cg_texture_t *tex,
+             int width,
+             int height,
+             int rowstride,
+             const uint8_t *data)
+{
+    cg_error_t *error = NULL;
+
+    if (!cg_texture_set_region(tex,
+                               width,
+                               height,
+                               CG_PIXEL_FORMAT_A_8,
+                               rowstride,
+                               data,
+                               0, 0, /* dst x, y */
+                               0, /* level */
+                               &error)) {
+        c_warning("Failed to upload video plane: %s", error->message);
+        cg_error_free(error);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+plane_textures_match(rig_source_t *source, int width, int height)
+{
+    return (source->n_textures == 3 &&
+            cg_texture_get_width(source->textures[0]) == width &&
+            cg_texture_get_height(source->textures[0]) == height);
+}
+
 void
 rig_source_attach_frame(rig_source_t *source,
                         cg_pipeline_t *pipeline)
@@ -1561,64 +1804,49 @@ rig_source_attach_frame(rig_source_t *source,
 #endif
     case SOURCE_TYPE_GIF: {
         rig_engine_t *engine = rig_component_props_get_engine(&source->component);
-        cg_bitmap_t *bmp;
-        cg_texture_2d_t *tex;
-        gif_result code;
+        cg_texture_2d_t *default_tex = engine->frontend->default_tex2d;
         cg_error_t *error = NULL;
-        uint8_t *buf;
         double elapsed = rig_timeline_get_elapsed(source->timeline);
-        int current_frame = source->gif_current_frame;
-        double current_elapsed = source->gif_current_elapsed;
-        gif_animation *gif = &source->gif;
-        int frame_count = gif->frame_count;
-
-        if (elapsed != current_elapsed) {
-            double e = elapsed;
-
-            if (elapsed > current_elapsed) {
-                for (int i = current_frame + 1;
-                     e <= elapsed && i < (frame_count - 1);
-                     i++)
-                {
-                    gif_frame *f = &gif->frames[i];
-
-                    e += f->frame_delay;
-                    current_frame = i;
-                }
-            } else {
-                for (int i = current_frame - 1; e > elapsed && i > 1; i--) {
-                    gif_frame *f = &gif->frames[i];
+        int frame = gif_find_frame(source, elapsed);
+        uint8_t *buf;
 
-                    e -= f->frame_delay;
-                    current_frame = i;
-                }
+        if (frame != source->gif_current_frame)
+            buf = gif_get_frame(source, frame);
+        else
+            buf = NULL;
+
+        if (buf) {
+            /* All frames are composited to the full size of the GIF so
+             * we allocate a single texture and update it in place */
+            if (source->textures[0] == (cg_texture_t *)default_tex) {
+                cg_texture_2d_t *tex =
+                    cg_texture_2d_new_with_size(engine->shell->cg_device,
+                                                source->gif.width,
+                                                source->gif.height);
+
+                _source_set_textures(source, &tex, 1);
+                cg_object_unref(tex);
             }
 
-            source->gif_current_frame = current_frame;
-            source->gif_current_elapsed = e;
-        }
-
-        code = gif_decode_frame(&source->gif, current_frame);
-        if (code != GIF_OK) {
-            c_warning("failed to load GIF frame %d", current_frame);
-            break;
+            if (cg_texture_set_region(source->textures[0],
+                                      source->gif.width,
+                                      source->gif.height,
+                                      CG_PIXEL_FORMAT_RGBA_8888,
+                                      0, /* rowstride */
+                                      buf,
+                                      0, 0, /* dst x, y */
+                                      0, /* level */
+                                      &error))
+            {
+                source->gif_current_frame = frame;
+            } else {
+                c_warning("Failed to upload GIF frame: %s", error->message);
+                cg_error_free(error);
+                _source_set_textures(source, &default_tex, 1);
+                source->gif_current_frame = -1;
+            }
         }
 
-        buf = bitmap_get_buffer(&source->gif, source->gif.frame_image);
-        bmp = cg_bitmap_new_for_data(engine->shell->cg_device,
-                                     source->gif.width,
-                                     source->gif.height,
-                                     CG_PIXEL_FORMAT_RGBA_8888,
-                                     0,
-                                     buf);
-        tex = cg_texture_2d_new_from_bitmap(bmp);
-        cg_object_unref(bmp);
-
-        if (cg_texture_allocate(tex, &error))
-            _source_set_textures(source, &tex, 1);
-        else
-            _source_set_textures(source, &engine->frontend->default_tex2d, 1);
-
         cg_pipeline_set_layer_texture(pipeline,
                                       source->first_layer,
                                       source->textures[0]);
@@ -1627,44 +1855,49 @@ rig_source_attach_frame(rig_source_t *source,
     case SOURCE_TYPE_FFMPEG: {
         rig_engine_t *engine = rig_component_props_get_engine(&source->component);
         cg_device_t *dev = engine->shell->cg_device;
-        cg_texture_2d_t *planes[3] = { 0 };
         struct ff_buffered_state *buffered_state =
             &source->ff_buffered_state[!source->ff_decode_buf];
-        int y_size = buffered_state->width * buffered_state->height;
-        int u_size = (buffered_state->width/2) * (buffered_state->height/2);
+        int width = buffered_state->width;
+        int height = buffered_state->height;
+        bool uploaded = true;
 
         if (source->ff_current_buffer_age == buffered_state->age)
             break;
 
-        planes[0] = upload_plane(dev,
-                                 buffered_state->width,
-                                 buffered_state->height,
-                                 CG_PIXEL_FORMAT_A_8,
-                                 buffered_state->width,
-                                 buffered_state->dst_frame_buf);
-        planes[1] = upload_plane(dev,
-                                 buffered_state->width / 2,
-                                 buffered_state->height / 2,
-                                 CG_PIXEL_FORMAT_A_8,
-                                 buffered_state->width / 2,
-                                 buffered_state->dst_frame_buf + y_size);
-        planes[2] = upload_plane(dev,
-                                 buffered_state->width / 2,
-                                 buffered_state->height / 2,
-                                 CG_PIXEL_FORMAT_A_8,
-                                 buffered_state->width / 2,
-                                 buffered_state->dst_frame_buf + y_size + u_size);
-
-        if (planes[0] && planes[1] && planes[2]) {
-            _source_set_textures(source, planes, 3);
-        } else
-            _source_set_textures(source, &engine->frontend->default_tex2d, 1);
+        /* The plane textures are only reallocated when the video
+         * resolution changes, otherwise each new frame is uploaded
+         * into the existing textures in place. */
+        if (!plane_textures_match(source, width, height)) {
+            cg_texture_2d_t *planes[3] = {
+                new_plane_texture(dev, width, height),
+                new_plane_texture(dev, width / 2, height / 2),
+                new_plane_texture(dev, width / 2, height / 2)
+            };
+
+            if (planes[0] && planes[1] && planes[2])
+                _source_set_textures(source, planes, 3);
+            else {
+                _source_set_textures(source, &engine->frontend->default_tex2d, 1);
+                uploaded = false;
+            }
 
-        for (int i = 0; i < 3; i++) {
-            if (planes[i]) /* there might have been an error */
-                cg_object_unref(planes[i]);
+            for (int i = 0; i < 3; i++) {
+                if (planes[i]) /* there might have been an error */
+                    cg_object_unref(planes[i]);
+            }
+        }
+
+        for (int i = 0; uploaded && i < 3; i++) {
+            uploaded = update_plane(source->textures[i],
+                                    i ? width / 2 : width,
+                                    i ? height / 2 : height,
+                                    buffered_state->strides[i],
+                                    buffered_state->planes[i]);
         }
 
+        if (!uploaded && source->n_textures == 3)
+            _source_set_textures(source, &engine->frontend->default_tex2d, 1);
+
         for (int i = 0; i < source->n_textures; i++) {
             cg_pipeline_set_layer_texture(pipeline,
                                           source->first_layer + i,
@@ -1829,52 +2062,81 @@ decode_ffmpeg_video(struct decode_work *work)
                            &source->ff_queued_video_packets,
                            avcodec_decode_video2))
     {
-        int y_size = video_frame->width * video_frame->height;
-        int u_size = (video_frame->width/2) * (video_frame->height/2);
-        int dst_size;
-
-        source->sws_ctx = sws_getCachedContext(source->sws_ctx,
-                                               video_frame->width,
-                                               video_frame->height,
-                                               video_frame->format,
-                                               video_frame->width,
-                                               video_frame->height,
-                                               AV_PIX_FMT_YUV420P,
-                                               SWS_BICUBIC, /* flags */
-                                               NULL, /* src filter */
-                                               NULL, /* dst filter */
-                                               NULL); /* param */
-
-        dst_size = y_size + 2 * u_size;
-        if (dst_size > buffered_state->dst_frame_buf_size) {
-            av_freep(&buffered_state->dst_frame_buf);
-            buffered_state->dst_frame_buf = av_malloc(dst_size);
-            buffered_state->dst_frame_buf_size = dst_size;
-        }
+        int width = video_frame->width;
+        int height = video_frame->height;
+
+        buffered_state->width = width;
+        buffered_state->height = height;
+
+        /* Most codecs already output YUV420P in which case we hold on
+         * to a reference to the decoded frame and upload its planes
+         * directly instead of copying them through sws_scale().
+         *
+         * Note: full range AV_PIX_FMT_YUVJ420P frames still need to go
+         * through sws_scale() since the plane shader assumes limited
+         * range YUV. */
+        if (video_frame->format == AV_PIX_FMT_YUV420P) {
+            AVFrame *dst_frame = buffered_state->dst_frame;
+
+            av_frame_unref(dst_frame);
+            av_frame_move_ref(dst_frame, video_frame);
+
+            for (int i = 0; i < 3; i++) {
+                buffered_state->planes[i] = dst_frame->data[i];
+                buffered_state->strides[i] = dst_frame->linesize[i];
+            }
+        } else {
+            int y_size = width * height;
+            int u_size = (width / 2) * (height / 2);
+            int dst_size = y_size + 2 * u_size;
+
+            /* Drop any reference to a previous zero-copy frame */
+            av_frame_unref(buffered_state->dst_frame);
+
+            source->sws_ctx = sws_getCachedContext(source->sws_ctx,
+                                                   width,
+                                                   height,
+                                                   video_frame->format,
+                                                   width,
+                                                   height,
+                                                   AV_PIX_FMT_YUV420P,
+                                                   SWS_BICUBIC, /* flags */
+                                                   NULL, /* src filter */
+                                                   NULL, /* dst filter */
+                                                   NULL); /* param */
+
+            if (dst_size > buffered_state->dst_frame_buf_size) {
+                av_freep(&buffered_state->dst_frame_buf);
+                buffered_state->dst_frame_buf = av_malloc(dst_size);
+                buffered_state->dst_frame_buf_size = dst_size;
+            }
 
-        buffered_state->width = video_frame->width;
-        buffered_state->height = video_frame->height;
-
-        uint8_t * const dst_data[] = {
-            buffered_state->dst_frame_buf, /* Y */
-            buffered_state->dst_frame_buf + y_size, /* U */
-            buffered_state->dst_frame_buf + y_size + u_size, /* V */
-            NULL
-        };
-        int dst_strides[] = {
-            video_frame->width,
-            video_frame->width / 2,
-            video_frame->width / 2,
-            0
-        };
-
-        sws_scale(source->sws_ctx,
-                  (const uint8_t * const *)video_frame->data, /* src slice */
-                  video_frame->linesize, /* src stride */
-                  0, /* src slice Y */
-                  video_frame->height, /* src slice H */
-                  dst_data,
-                  dst_strides);
+            uint8_t * const dst_data[] = {
+                buffered_state->dst_frame_buf, /* Y */
+                buffered_state->dst_frame_buf + y_size, /* U */
+                buffered_state->dst_frame_buf + y_size + u_size, /* V */
+                NULL
+            };
+            int dst_strides[] = {
+                width,
+                width / 2,
+                width / 2,
+                0
+            };
+
+            sws_scale(source->sws_ctx,
+                      (const uint8_t * const *)video_frame->data, /* src slice */
+                      video_frame->linesize, /* src stride */
+                      0, /* src slice Y */
+                      height, /* src slice H */
+                      dst_data,
+                      dst_strides);
+
+            for (int i = 0; i < 3; i++) {
+                buffered_state->planes[i] = dst_data[i];
+                buffered_state->strides[i] = dst_strides[i];
+            }
+        }
 
         buffered_state->age = source->ff_last_buffer_age++;
     }
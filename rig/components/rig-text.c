@@ -192,8 +192,13 @@ _rig_text_set_size(rut_object_t *object, float width, float height)
     text->width = width;
     text->height = height;
 
-    if (text->pick_mesh)
+    if (text->pick_mesh) {
         update_pick_mesh(text);
+        rut_mesh_changed(text->pick_mesh);
+    }
+
+    if (text->component.parented)
+        rig_entity_notify_bounds_changed(text->component.entity);
 
     rig_text_notify_preferred_size_changed(text);
 
@@ -47,6 +47,58 @@
 
 #include "rig-protobuf-c-stream.h"
 
+#ifdef USE_UV
+/* A set of write closures flushed together with one uv_write() or as
+ * one websocket message. Each closure's done_callback is called once
+ * the whole batch has been written. */
+typedef struct _rig_pb_stream_write_batch_t {
+    uv_write_t write_req;
+
+    c_list_t closures;
+
+    /* For feeding the closures to wslay incrementally... */
+    rig_pb_stream_write_closure_t *current;
+    int current_offset;
+
+    int n_bufs;
+    uv_buf_t bufs[];
+} rig_pb_stream_write_batch_t;
+
+static void
+finish_write_batch(rig_pb_stream_write_batch_t *batch)
+{
+    rig_pb_stream_write_closure_t *closure, *tmp;
+
+    c_list_for_each_safe(closure, tmp, &batch->closures, link)
+    {
+        if (closure->done_callback)
+            closure->done_callback(closure);
+    }
+
+    c_free(batch);
+}
+
+static void
+cancel_pending_writes(rig_pb_stream_t *stream)
+{
+    rig_pb_stream_write_closure_t *closure, *tmp;
+
+    if (stream->flush_idle) {
+        rut_poll_shell_remove_idle_FIXME(stream->shell, stream->flush_idle);
+        stream->flush_idle = NULL;
+    }
+
+    /* Let the closures be freed, even though they were never sent */
+    c_list_for_each_safe(closure, tmp, &stream->pending_write_closures, link)
+    {
+        c_list_remove(&closure->link);
+        if (closure->done_callback)
+            closure->done_callback(closure);
+    }
+    stream->n_pending_write_closures = 0;
+}
+#endif
+
 static void
 drain_finished_write_closures(rig_pb_stream_t *stream)
 {
@@ -66,6 +118,10 @@ drain_finished_write_closures(rig_pb_stream_t *stream)
 void
 rig_pb_stream_disconnect(rig_pb_stream_t *stream)
 {
+#ifdef USE_UV
+    cancel_pending_writes(stream);
+#endif
+
     switch (stream->type)
     {
 #ifdef USE_UV
@@ -206,6 +262,10 @@ rig_pb_stream_new(rut_shell_t *shell)
 
     stream->type = STREAM_TYPE_DISCONNECTED;
 
+#ifdef USE_UV
+    c_list_init(&stream->pending_write_closures);
+#endif
+
     c_list_init(&stream->on_connect_closures);
     c_list_init(&stream->on_error_closures);
 
@@ -600,8 +660,9 @@ rig_pb_stream_set_read_callback(rig_pb_stream_t *stream,
 static void
 uv_write_done_cb(uv_write_t *write_req, int status)
 {
-    rig_pb_stream_write_closure_t *closure = write_req->data;
-    closure->done_callback(closure);
+    rig_pb_stream_write_batch_t *batch = write_req->data;
+
+    finish_write_batch(batch);
 }
 #endif
 
@@ -628,67 +689,141 @@ fragmented_wslay_read_cb(wslay_event_context_ptr ctx,
                          int *eof,
                          void *user_data)
 {
-    rig_pb_stream_write_closure_t *closure =
-        (rig_pb_stream_write_closure_t *)source->data;
-    int remaining = closure->buf.len - closure->current_offset;
-    int read_len = MIN(remaining, len);
-
-    memcpy(data, closure->buf.base + closure->current_offset, read_len);
-    closure->current_offset += read_len;
+    rig_pb_stream_write_batch_t *batch = source->data;
+    size_t read_len = 0;
+
+    /* Concatenate the batched closures into a single message */
+    while (read_len < len) {
+        rig_pb_stream_write_closure_t *closure = batch->current;
+        int remaining = closure->buf.len - batch->current_offset;
+        int copy_len = MIN(remaining, len - read_len);
+
+        memcpy(data + read_len,
+               closure->buf.base + batch->current_offset,
+               copy_len);
+        batch->current_offset += copy_len;
+        read_len += copy_len;
+
+        if (batch->current_offset == closure->buf.len) {
+            if (closure->link.next == &batch->closures) {
+                *eof = 1;
+                finish_write_batch(batch);
+                break;
+            }
 
-    if(closure->current_offset == closure->buf.len) {
-        *eof = 1;
-        closure->done_callback(closure);
+            batch->current = rut_container_of(closure->link.next,
+                                              closure, link);
+            batch->current_offset = 0;
+        }
     }
 
     return read_len;
 }
-#endif
 
-void
-rig_pb_stream_write(rig_pb_stream_t *stream,
-                    rig_pb_stream_write_closure_t *closure)
+static void
+flush_pending_writes_idle(void *user_data)
 {
-    c_return_if_fail(stream->type != STREAM_TYPE_DISCONNECTED);
+    rig_pb_stream_t *stream = user_data;
+    rig_pb_stream_write_batch_t *batch;
+    rig_pb_stream_write_closure_t *closure;
+    int n_closures = stream->n_pending_write_closures;
 
-    switch (stream->type) {
-    case STREAM_TYPE_BUFFER: {
-        c_return_if_fail(stream->buffer.other_end != NULL);
-        c_return_if_fail(stream->buffer.other_end->type == STREAM_TYPE_BUFFER);
+    rut_poll_shell_remove_idle_FIXME(stream->shell, stream->flush_idle);
+    stream->flush_idle = NULL;
 
-        c_array_append_val(stream->buffer.other_end->buffer.incoming_write_closures, closure);
+    if (!n_closures)
+        return;
 
-        queue_data_buffer_stream_read(stream->buffer.other_end);
+    batch = c_malloc(sizeof(rig_pb_stream_write_batch_t) +
+                     sizeof(uv_buf_t) * n_closures);
 
-        break;
-    }
+    /* Steal the pending closures */
+    c_list_init(&batch->closures);
+    c_list_append_list(&batch->closures, &stream->pending_write_closures);
+    c_list_init(&stream->pending_write_closures);
+    stream->n_pending_write_closures = 0;
 
-#ifdef USE_UV
+    batch->n_bufs = 0;
+    c_list_for_each(closure, &batch->closures, link)
+        batch->bufs[batch->n_bufs++] = closure->buf;
+
+    stream->n_flushes++;
+
+    switch (stream->type) {
     case STREAM_TYPE_FD:
-    case STREAM_TYPE_TCP: {
-        closure->write_req.data = closure;
+    case STREAM_TYPE_TCP:
+        batch->write_req.data = batch;
 
-        uv_write(&closure->write_req,
+        uv_write(&batch->write_req,
                  (uv_stream_t *)&stream->fd.uv_fd_pipe,
-                 &closure->buf,
-                 1, /* n buffers */
+                 batch->bufs,
+                 batch->n_bufs,
                  uv_write_done_cb);
         break;
-    }
     case STREAM_TYPE_WEBSOCKET_SERVER: {
         struct wslay_event_fragmented_msg arg;
 
+        batch->current = rut_container_of(batch->closures.next,
+                                          closure, link);
+        batch->current_offset = 0;
+
         memset(&arg, 0, sizeof(arg));
         arg.opcode = WSLAY_BINARY_FRAME;
-        arg.source.data = closure;
+        arg.source.data = batch;
         arg.read_callback = fragmented_wslay_read_cb;
 
-        closure->current_offset = 0;
-
         wslay_event_queue_fragmented_msg(stream->websocket_server.ctx, &arg);
         wslay_event_send(stream->websocket_server.ctx);
         break;
     }
+    default:
+        c_warn_if_reached();
+        finish_write_batch(batch);
+        break;
+    }
+}
+
+static void
+queue_write(rig_pb_stream_t *stream, rig_pb_stream_write_closure_t *closure)
+{
+    c_list_insert(stream->pending_write_closures.prev, &closure->link);
+    stream->n_pending_write_closures++;
+    stream->n_write_closures++;
+
+    if (stream->flush_idle == NULL) {
+        stream->flush_idle =
+            rut_poll_shell_add_idle_FIXME(stream->shell,
+                                          flush_pending_writes_idle,
+                                          stream,
+                                          NULL); /* destroy */
+    }
+}
+#endif
+
+void
+rig_pb_stream_write(rig_pb_stream_t *stream,
+                    rig_pb_stream_write_closure_t *closure)
+{
+    c_return_if_fail(stream->type != STREAM_TYPE_DISCONNECTED);
+
+    switch (stream->type) {
+    case STREAM_TYPE_BUFFER: {
+        c_return_if_fail(stream->buffer.other_end != NULL);
+        c_return_if_fail(stream->buffer.other_end->type == STREAM_TYPE_BUFFER);
+
+        c_array_append_val(stream->buffer.other_end->buffer.incoming_write_closures, closure);
+
+        queue_data_buffer_stream_read(stream->buffer.other_end);
+
+        break;
+    }
+
+#ifdef USE_UV
+    case STREAM_TYPE_FD:
+    case STREAM_TYPE_TCP:
+    case STREAM_TYPE_WEBSOCKET_SERVER:
+        queue_write(stream, closure);
+        break;
 #endif
 
 #ifdef __EMSCRIPTEN__
@@ -69,9 +69,11 @@ typedef struct _rig_pb_stream_buf_t {
 struct _rig_pb_stream_write_closure
 {
 #ifdef USE_UV
-    uv_write_t write_req;
     uv_buf_t buf;
-    int current_offset;
+
+    /* Writes to fd, tcp and websocket streams are queued and flushed
+     * together once per mainloop iteration... */
+    c_list_t link;
 #else
     rig_pb_stream_buf_t buf;
 #endif
@@ -154,6 +156,21 @@ struct _rig_pb_stream_t {
 
     /* Common */
 
+#ifdef USE_UV
+    /* Closures written to fd, tcp or websocket streams since the last
+     * flush. These are coalesced into a single uv_write() or websocket
+     * message from an idle callback, so many small rpc messages sent
+     * within one mainloop iteration only pay for one syscall and one
+     * frame header. */
+    c_list_t pending_write_closures;
+    int n_pending_write_closures;
+    rut_closure_t *flush_idle;
+
+    /* Counters for benchmarking */
+    uint64_t n_write_closures;
+    uint64_t n_flushes;
+#endif
+
     c_list_t on_connect_closures;
     c_list_t on_error_closures;
 
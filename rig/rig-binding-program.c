@@ -0,0 +1,882 @@
+/*
+ * Rig
+ *
+ * UI Engine & Editor
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <rig-config.h>
+
+#include <math.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <clib.h>
+
+#include <rut.h>
+
+#include "rig-binding-program.h"
+
+#define MAX_REGISTERS 256
+
+typedef enum _op_t {
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_IDIV,
+    OP_IMOD,
+    OP_NEG,
+    OP_NOT,
+    OP_TRUNC,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+    OP_SELECT, /* dst = a ? b : c */
+    OP_CALL1, /* dst = functions[c](a) */
+    OP_CALL2, /* dst = functions[c](a, b) */
+} op_t;
+
+/* Instructions operate on registers, where the first registers hold
+ * the inputs followed by any constants and temporaries */
+typedef struct _instruction_t {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+} instruction_t;
+
+struct _rig_binding_program_t {
+    rig_property_type_t out_type;
+
+    int n_inputs;
+
+    /* The initial register values, including constants */
+    int n_registers;
+    double *registers;
+
+    int n_instructions;
+    instruction_t *instructions;
+
+    int result;
+};
+
+typedef struct _function_t {
+    const char *name;
+    int n_args;
+    double (*func1)(double a);
+    double (*func2)(double a, double b);
+} function_t;
+
+static const function_t functions[] = {
+    { "sin", 1, sin },
+    { "cos", 1, cos },
+    { "tan", 1, tan },
+    { "asin", 1, asin },
+    { "acos", 1, acos },
+    { "atan", 1, atan },
+    { "atan2", 2, NULL, atan2 },
+    { "sqrt", 1, sqrt },
+    { "pow", 2, NULL, pow },
+    { "exp", 1, exp },
+    { "log", 1, log },
+    { "floor", 1, floor },
+    { "ceil", 1, ceil },
+    { "round", 1, round },
+    { "fabs", 1, fabs },
+    { "abs", 1, fabs }, /* NB: integer typed */
+    { "fmod", 2, NULL, fmod },
+    { "fmin", 2, NULL, fmin },
+    { "fmax", 2, NULL, fmax },
+};
+
+typedef enum _value_type_t {
+    VALUE_TYPE_INT,
+    VALUE_TYPE_FLOAT,
+} value_type_t;
+
+/* An operand is either a register or a constant that hasn't been
+ * allocated a register yet, which lets us fold constant expressions
+ * while compiling */
+typedef struct _operand_t {
+    value_type_t type;
+    bool is_constant;
+    double value;
+    int reg;
+} operand_t;
+
+typedef enum _token_type_t {
+    TOKEN_END,
+    TOKEN_NUMBER,
+    TOKEN_IDENTIFIER,
+    TOKEN_PUNCTUATION,
+} token_type_t;
+
+typedef struct _compiler_t {
+    const char *expression;
+    const char *pos;
+
+    token_type_t token;
+    const char *token_start;
+    int token_len;
+    value_type_t number_type;
+    double number;
+
+    int n_inputs;
+    const char **input_names;
+    const rig_property_type_t *input_types;
+
+    c_array_t *registers;
+    c_array_t *instructions;
+
+    rut_exception_t **e;
+    bool failed;
+} compiler_t;
+
+bool
+rig_binding_program_supports_type(rig_property_type_t type)
+{
+    switch (type) {
+    case RUT_PROPERTY_TYPE_FLOAT:
+    case RUT_PROPERTY_TYPE_DOUBLE:
+    case RUT_PROPERTY_TYPE_INTEGER:
+    case RUT_PROPERTY_TYPE_UINT32:
+    case RUT_PROPERTY_TYPE_ENUM:
+    case RUT_PROPERTY_TYPE_BOOLEAN:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void
+compile_error(compiler_t *compiler,
+              rig_binding_exception_t code,
+              const char *message)
+{
+    /* Only report the first error */
+    if (compiler->failed)
+        return;
+
+    compiler->failed = true;
+    rut_throw(compiler->e,
+              RUT_BINDING_EXCEPTION,
+              code,
+              "%s at offset %d of binding expression \"%s\"",
+              message,
+              (int)(compiler->token_start - compiler->expression),
+              compiler->expression);
+}
+
+static void
+next_token(compiler_t *compiler)
+{
+    static const char *two_char_punctuation[] = {
+        "<=", ">=", "==", "!=", "&&", "||"
+    };
+    const char *p = compiler->pos;
+    int i;
+
+    while (isspace(*p))
+        p++;
+
+    compiler->token_start = p;
+
+    if (*p == '\0') {
+        compiler->token = TOKEN_END;
+        compiler->token_len = 0;
+    } else if (isdigit(*p) || (*p == '.' && isdigit(p[1]))) {
+        char *end;
+
+        compiler->token = TOKEN_NUMBER;
+        compiler->number = strtod(p, &end);
+        compiler->number_type = VALUE_TYPE_INT;
+        for (i = 0; p + i < end; i++) {
+            if (p[i] == '.' || p[i] == 'e' || p[i] == 'E')
+                compiler->number_type = VALUE_TYPE_FLOAT;
+        }
+        /* Hexadecimal numbers are integers */
+        if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+            compiler->number_type = VALUE_TYPE_INT;
+        p = end;
+        if (*p == 'f' || *p == 'F') {
+            compiler->number_type = VALUE_TYPE_FLOAT;
+            p++;
+        }
+        compiler->token_len = p - compiler->token_start;
+    } else if (isalpha(*p) || *p == '_') {
+        while (isalnum(*p) || *p == '_')
+            p++;
+        compiler->token = TOKEN_IDENTIFIER;
+        compiler->token_len = p - compiler->token_start;
+    } else {
+        compiler->token = TOKEN_PUNCTUATION;
+        compiler->token_len = 1;
+        for (i = 0; i < C_N_ELEMENTS(two_char_punctuation); i++) {
+            if (strncmp(p, two_char_punctuation[i], 2) == 0) {
+                compiler->token_len = 2;
+                break;
+            }
+        }
+        p += compiler->token_len;
+    }
+
+    compiler->pos = p;
+}
+
+static bool
+token_is(compiler_t *compiler, const char *str)
+{
+    return (compiler->token == TOKEN_PUNCTUATION ||
+            compiler->token == TOKEN_IDENTIFIER) &&
+           compiler->token_len == strlen(str) &&
+           strncmp(compiler->token_start, str, compiler->token_len) == 0;
+}
+
+static bool
+accept_token(compiler_t *compiler, const char *str)
+{
+    if (token_is(compiler, str)) {
+        next_token(compiler);
+        return true;
+    } else
+        return false;
+}
+
+static void
+expect_token(compiler_t *compiler, const char *str)
+{
+    if (!accept_token(compiler, str)) {
+        char *message = c_strdup_printf("Expected '%s'", str);
+        compile_error(compiler, RIG_BINDING_EXCEPTION_SYNTAX, message);
+        c_free(message);
+    }
+}
+
+static int
+allocate_register(compiler_t *compiler, double initial_value)
+{
+    int reg = compiler->registers->len;
+
+    if (reg >= MAX_REGISTERS) {
+        compile_error(compiler,
+                      RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                      "Expression too complex");
+        return 0;
+    }
+
+    c_array_append_val(compiler->registers, initial_value);
+
+    return reg;
+}
+
+static operand_t
+constant_operand(value_type_t type, double value)
+{
+    operand_t operand = { .type = type, .is_constant = true, .value = value };
+    return operand;
+}
+
+static int
+get_operand_register(compiler_t *compiler, operand_t *operand)
+{
+    if (operand->is_constant) {
+        operand->reg = allocate_register(compiler, operand->value);
+        operand->is_constant = false;
+    }
+
+    return operand->reg;
+}
+
+static double
+run_op(op_t op, double a, double b, double c, int function)
+{
+    switch (op) {
+    case OP_ADD:
+        return a + b;
+    case OP_SUB:
+        return a - b;
+    case OP_MUL:
+        return a * b;
+    case OP_DIV:
+        return a / b;
+    case OP_IDIV:
+        /* NB: Integer division by zero is undefined in C */
+        return b ? trunc(a / b) : 0;
+    case OP_IMOD:
+        return b ? fmod(a, b) : 0;
+    case OP_NEG:
+        return -a;
+    case OP_NOT:
+        return !a;
+    case OP_TRUNC:
+        return trunc(a);
+    case OP_LT:
+        return a < b;
+    case OP_LE:
+        return a <= b;
+    case OP_GT:
+        return a > b;
+    case OP_GE:
+        return a >= b;
+    case OP_EQ:
+        return a == b;
+    case OP_NE:
+        return a != b;
+    case OP_AND:
+        return a && b;
+    case OP_OR:
+        return a || b;
+    case OP_SELECT:
+        return a ? b : c;
+    case OP_CALL1:
+        return functions[function].func1(a);
+    case OP_CALL2:
+        return functions[function].func2(a, b);
+    }
+
+    c_warn_if_reached();
+    return 0;
+}
+
+/* Emits an instruction for the given operation unless all of the
+ * operands are constant, in which case the operation is folded */
+static operand_t
+emit(compiler_t *compiler,
+     op_t op,
+     value_type_t type,
+     int n_operands,
+     operand_t *operands,
+     int function)
+{
+    operand_t result = { .type = type };
+    instruction_t instruction = { .op = op };
+    double values[3] = { 0, 0, 0 };
+    bool all_constant = true;
+    int i;
+
+    for (i = 0; i < n_operands; i++) {
+        values[i] = operands[i].value;
+        if (!operands[i].is_constant)
+            all_constant = false;
+    }
+
+    if (all_constant) {
+        result.is_constant = true;
+        result.value = run_op(op, values[0], values[1], values[2], function);
+        if (type == VALUE_TYPE_INT && op != OP_IDIV && op != OP_IMOD)
+            result.value = trunc(result.value);
+        return result;
+    }
+
+    if (n_operands > 0)
+        instruction.a = get_operand_register(compiler, &operands[0]);
+    if (n_operands > 1)
+        instruction.b = get_operand_register(compiler, &operands[1]);
+    if (n_operands > 2)
+        instruction.c = get_operand_register(compiler, &operands[2]);
+    else
+        instruction.c = function;
+
+    result.reg = allocate_register(compiler, 0);
+    instruction.dst = result.reg;
+
+    c_array_append_val(compiler->instructions, instruction);
+
+    return result;
+}
+
+static operand_t parse_expression(compiler_t *compiler);
+static operand_t parse_unary(compiler_t *compiler);
+
+static operand_t
+parse_call(compiler_t *compiler, const char *name, int name_len)
+{
+    operand_t args[2];
+    int n_args = 0;
+    int i;
+
+    for (i = 0; i < C_N_ELEMENTS(functions); i++) {
+        int len = strlen(functions[i].name);
+
+        /* Also accept the float variants, such as sinf() */
+        if ((name_len == len ||
+             (name_len == len + 1 && name[len] == 'f' &&
+              strcmp(functions[i].name, "abs") != 0)) &&
+            strncmp(name, functions[i].name, len) == 0)
+            break;
+    }
+
+    if (i == C_N_ELEMENTS(functions)) {
+        compile_error(compiler,
+                      RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                      "Unsupported function");
+        return constant_operand(VALUE_TYPE_FLOAT, 0);
+    }
+
+    if (!token_is(compiler, ")")) {
+        do {
+            if (n_args == 2)
+                break;
+            args[n_args++] = parse_expression(compiler);
+        } while (accept_token(compiler, ","));
+    }
+    expect_token(compiler, ")");
+
+    if (n_args != functions[i].n_args) {
+        compile_error(compiler,
+                      RIG_BINDING_EXCEPTION_SYNTAX,
+                      "Wrong number of function arguments");
+        return constant_operand(VALUE_TYPE_FLOAT, 0);
+    }
+
+    /* abs() takes an int */
+    if (strcmp(functions[i].name, "abs") == 0 &&
+        args[0].type == VALUE_TYPE_FLOAT)
+        args[0] = emit(compiler, OP_TRUNC, VALUE_TYPE_INT, 1, args, 0);
+
+    return emit(compiler,
+                n_args == 1 ? OP_CALL1 : OP_CALL2,
+                strcmp(functions[i].name, "abs") == 0 ? VALUE_TYPE_INT :
+                VALUE_TYPE_FLOAT,
+                n_args,
+                args,
+                i);
+}
+
+static operand_t
+parse_identifier(compiler_t *compiler)
+{
+    const char *name = compiler->token_start;
+    int name_len = compiler->token_len;
+    int i;
+
+    next_token(compiler);
+
+    if (accept_token(compiler, "("))
+        return parse_call(compiler, name, name_len);
+
+    for (i = 0; i < compiler->n_inputs; i++) {
+        const char *input_name = compiler->input_names[i];
+
+        if (input_name && strlen(input_name) == name_len &&
+            strncmp(name, input_name, name_len) == 0) {
+            operand_t operand = { .reg = i };
+
+            switch (compiler->input_types[i]) {
+            case RUT_PROPERTY_TYPE_FLOAT:
+            case RUT_PROPERTY_TYPE_DOUBLE:
+                operand.type = VALUE_TYPE_FLOAT;
+                break;
+            default:
+                if (!rig_binding_program_supports_type(
+                        compiler->input_types[i])) {
+                    compile_error(compiler,
+                                  RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                                  "Unsupported dependency type");
+                }
+                operand.type = VALUE_TYPE_INT;
+                break;
+            }
+
+            return operand;
+        }
+    }
+
+    if (name_len == 4 && strncmp(name, "true", 4) == 0)
+        return constant_operand(VALUE_TYPE_INT, 1);
+    if (name_len == 5 && strncmp(name, "false", 5) == 0)
+        return constant_operand(VALUE_TYPE_INT, 0);
+    if (name_len == 4 && strncmp(name, "M_PI", 4) == 0)
+        return constant_operand(VALUE_TYPE_FLOAT, M_PI);
+
+    compile_error(compiler, RIG_BINDING_EXCEPTION_SYNTAX, "Unknown identifier");
+    return constant_operand(VALUE_TYPE_FLOAT, 0);
+}
+
+static operand_t
+parse_primary(compiler_t *compiler)
+{
+    operand_t operand;
+
+    switch (compiler->token) {
+    case TOKEN_NUMBER:
+        operand = constant_operand(compiler->number_type, compiler->number);
+        next_token(compiler);
+        return operand;
+    case TOKEN_IDENTIFIER:
+        return parse_identifier(compiler);
+    case TOKEN_PUNCTUATION:
+        if (accept_token(compiler, "(")) {
+            if (accept_token(compiler, "float") || accept_token(compiler, "double")) {
+                expect_token(compiler, ")");
+                operand = parse_unary(compiler);
+                operand.type = VALUE_TYPE_FLOAT;
+                return operand;
+            } else if (accept_token(compiler, "int")) {
+                expect_token(compiler, ")");
+                operand = parse_unary(compiler);
+                if (operand.type == VALUE_TYPE_FLOAT) {
+                    operand = emit(compiler, OP_TRUNC, VALUE_TYPE_INT,
+                                   1, &operand, 0);
+                }
+                return operand;
+            }
+
+            operand = parse_expression(compiler);
+            expect_token(compiler, ")");
+            return operand;
+        }
+        break;
+    case TOKEN_END:
+        break;
+    }
+
+    compile_error(compiler, RIG_BINDING_EXCEPTION_SYNTAX, "Unexpected token");
+    return constant_operand(VALUE_TYPE_FLOAT, 0);
+}
+
+static operand_t
+parse_unary(compiler_t *compiler)
+{
+    operand_t operand;
+
+    if (accept_token(compiler, "-")) {
+        operand = parse_unary(compiler);
+        return emit(compiler, OP_NEG, operand.type, 1, &operand, 0);
+    } else if (accept_token(compiler, "+")) {
+        return parse_unary(compiler);
+    } else if (accept_token(compiler, "!")) {
+        operand = parse_unary(compiler);
+        return emit(compiler, OP_NOT, VALUE_TYPE_INT, 1, &operand, 0);
+    } else
+        return parse_primary(compiler);
+}
+
+static value_type_t
+arithmetic_type(operand_t *operands)
+{
+    if (operands[0].type == VALUE_TYPE_INT &&
+        operands[1].type == VALUE_TYPE_INT)
+        return VALUE_TYPE_INT;
+    else
+        return VALUE_TYPE_FLOAT;
+}
+
+/* Binary operators by decreasing precedence */
+typedef struct _binary_op_t {
+    const char *token;
+    op_t op;
+    bool arithmetic;
+} binary_op_t;
+
+static const binary_op_t multiplicative_ops[] = {
+    { "*", OP_MUL, true }, { "/", OP_DIV, true }, { "%", OP_IMOD, true },
+    { NULL }
+};
+static const binary_op_t additive_ops[] = {
+    { "+", OP_ADD, true }, { "-", OP_SUB, true }, { NULL }
+};
+static const binary_op_t relational_ops[] = {
+    { "<", OP_LT }, { "<=", OP_LE }, { ">", OP_GT }, { ">=", OP_GE },
+    { NULL }
+};
+static const binary_op_t equality_ops[] = {
+    { "==", OP_EQ }, { "!=", OP_NE }, { NULL }
+};
+static const binary_op_t and_ops[] = { { "&&", OP_AND }, { NULL } };
+static const binary_op_t or_ops[] = { { "||", OP_OR }, { NULL } };
+
+static const binary_op_t *binary_ops[] = {
+    or_ops,
+    and_ops,
+    equality_ops,
+    relational_ops,
+    additive_ops,
+    multiplicative_ops
+};
+
+static operand_t
+parse_binary(compiler_t *compiler, int level)
+{
+    operand_t operands[2];
+
+    if (level == C_N_ELEMENTS(binary_ops))
+        return parse_unary(compiler);
+
+    operands[0] = parse_binary(compiler, level + 1);
+
+    while (!compiler->failed) {
+        const binary_op_t *op;
+        value_type_t type = VALUE_TYPE_INT;
+        op_t opcode;
+
+        for (op = binary_ops[level]; op->token; op++)
+            if (token_is(compiler, op->token))
+                break;
+        if (!op->token)
+            break;
+
+        next_token(compiler);
+        operands[1] = parse_binary(compiler, level + 1);
+
+        opcode = op->op;
+        if (op->arithmetic) {
+            type = arithmetic_type(operands);
+
+            if (opcode == OP_DIV && type == VALUE_TYPE_INT)
+                opcode = OP_IDIV;
+            else if (opcode == OP_IMOD && type != VALUE_TYPE_INT) {
+                compile_error(compiler,
+                              RIG_BINDING_EXCEPTION_SYNTAX,
+                              "Invalid operands to %");
+            }
+        }
+
+        operands[0] = emit(compiler, opcode, type, 2, operands, 0);
+    }
+
+    return operands[0];
+}
+
+static operand_t
+parse_expression(compiler_t *compiler)
+{
+    operand_t operands[3];
+
+    operands[0] = parse_binary(compiler, 0);
+
+    if (!accept_token(compiler, "?"))
+        return operands[0];
+
+    operands[1] = parse_expression(compiler);
+    expect_token(compiler, ":");
+    operands[2] = parse_expression(compiler);
+
+    if (operands[0].is_constant)
+        return operands[0].value ? operands[1] : operands[2];
+
+    return emit(compiler,
+                OP_SELECT,
+                arithmetic_type(operands + 1),
+                3,
+                operands,
+                0);
+}
+
+rig_binding_program_t *
+rig_binding_program_new(const char *expression,
+                        rig_property_type_t out_type,
+                        int n_inputs,
+                        const char **input_names,
+                        const rig_property_type_t *input_types,
+                        rut_exception_t **e)
+{
+    rig_binding_program_t *program;
+    compiler_t compiler;
+    bool has_braces;
+    operand_t result;
+    int i;
+
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.expression = expression;
+    compiler.pos = expression;
+    compiler.token_start = expression;
+    compiler.n_inputs = n_inputs;
+    compiler.input_names = input_names;
+    compiler.input_types = input_types;
+    compiler.e = e;
+
+    if (n_inputs >= MAX_REGISTERS) {
+        compile_error(&compiler,
+                      RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                      "Too many dependencies");
+        return NULL;
+    }
+
+    if (!rig_binding_program_supports_type(out_type)) {
+        compile_error(&compiler,
+                      RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                      "Unsupported property type");
+        return NULL;
+    }
+
+    compiler.registers = c_array_new(false, true, sizeof(double));
+    compiler.instructions = c_array_new(false, false, sizeof(instruction_t));
+
+    /* The inputs are loaded into the first registers */
+    c_array_set_size(compiler.registers, n_inputs);
+
+    next_token(&compiler);
+
+    has_braces = accept_token(&compiler, "{");
+
+    if (accept_token(&compiler, "out") && !accept_token(&compiler, "=")) {
+        compile_error(&compiler,
+                      RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                      "Unsupported statement");
+    }
+
+    result = parse_expression(&compiler);
+
+    accept_token(&compiler, ";");
+    if (has_braces)
+        expect_token(&compiler, "}");
+
+    if (compiler.token != TOKEN_END) {
+        compile_error(&compiler,
+                      RIG_BINDING_EXCEPTION_UNSUPPORTED,
+                      "Unsupported trailing code");
+    }
+
+    /* The result is always read from a register */
+    i = get_operand_register(&compiler, &result);
+
+    if (compiler.failed) {
+        c_array_free(compiler.registers, true);
+        c_array_free(compiler.instructions, true);
+        return NULL;
+    }
+
+    program = c_slice_new(rig_binding_program_t);
+    program->out_type = out_type;
+    program->n_inputs = n_inputs;
+    program->result = i;
+    program->n_registers = compiler.registers->len;
+    program->registers = (double *)c_array_free(compiler.registers, false);
+    program->n_instructions = compiler.instructions->len;
+    program->instructions =
+        (instruction_t *)c_array_free(compiler.instructions, false);
+
+    return program;
+}
+
+void
+rig_binding_program_free(rig_binding_program_t *program)
+{
+    c_free(program->registers);
+    c_free(program->instructions);
+    c_slice_free(rig_binding_program_t, program);
+}
+
+static double
+get_input(rig_property_t *property)
+{
+    switch (property->spec->type) {
+    case RUT_PROPERTY_TYPE_FLOAT:
+        return rig_property_get_float(property);
+    case RUT_PROPERTY_TYPE_DOUBLE:
+        return rig_property_get_double(property);
+    case RUT_PROPERTY_TYPE_INTEGER:
+        return rig_property_get_integer(property);
+    case RUT_PROPERTY_TYPE_UINT32:
+        return rig_property_get_uint32(property);
+    case RUT_PROPERTY_TYPE_ENUM:
+        return rig_property_get_enum(property);
+    case RUT_PROPERTY_TYPE_BOOLEAN:
+        return rig_property_get_boolean(property);
+    default:
+        /* Not referenced by the program */
+        return 0;
+    }
+}
+
+double
+rig_binding_program_run(rig_binding_program_t *program,
+                        rig_property_t **inputs)
+{
+    double regs[MAX_REGISTERS];
+    int i;
+
+    memcpy(regs, program->registers, sizeof(double) * program->n_registers);
+
+    for (i = 0; i < program->n_inputs; i++)
+        regs[i] = get_input(inputs[i]);
+
+    for (i = 0; i < program->n_instructions; i++) {
+        const instruction_t *instruction = &program->instructions[i];
+        double a = regs[instruction->a];
+        double b = regs[instruction->b];
+
+        switch ((op_t)instruction->op) {
+        case OP_ADD:
+            regs[instruction->dst] = a + b;
+            break;
+        case OP_SUB:
+            regs[instruction->dst] = a - b;
+            break;
+        case OP_MUL:
+            regs[instruction->dst] = a * b;
+            break;
+        case OP_SELECT:
+            regs[instruction->dst] = a ? b : regs[instruction->c];
+            break;
+        default:
+            regs[instruction->dst] =
+                run_op(instruction->op, a, b, 0, instruction->c);
+            break;
+        }
+    }
+
+    return regs[program->result];
+}
+
+void
+rig_binding_program_apply(rig_binding_program_t *program,
+                          rig_property_context_t *property_ctx,
+                          rig_property_t *property,
+                          rig_property_t **inputs)
+{
+    double value = rig_binding_program_run(program, inputs);
+
+    switch (program->out_type) {
+    case RUT_PROPERTY_TYPE_FLOAT:
+        rig_property_set_float(property_ctx, property, value);
+        break;
+    case RUT_PROPERTY_TYPE_DOUBLE:
+        rig_property_set_double(property_ctx, property, value);
+        break;
+    case RUT_PROPERTY_TYPE_INTEGER:
+        rig_property_set_integer(property_ctx, property, value);
+        break;
+    case RUT_PROPERTY_TYPE_UINT32:
+        rig_property_set_uint32(property_ctx, property, value);
+        break;
+    case RUT_PROPERTY_TYPE_ENUM:
+        rig_property_set_enum(property_ctx, property, value);
+        break;
+    case RUT_PROPERTY_TYPE_BOOLEAN:
+        rig_property_set_boolean(property_ctx, property, value != 0);
+        break;
+    default:
+        c_warn_if_reached();
+        break;
+    }
+}
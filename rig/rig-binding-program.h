@@ -0,0 +1,100 @@
+/*
+ * Rig
+ *
+ * UI Engine & Editor
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _RIG_BINDING_PROGRAM_H_
+#define _RIG_BINDING_PROGRAM_H_
+
+#include <rut.h>
+
+#include "rig-property.h"
+
+/*
+ * Binding expressions are normally compiled to native code via LLVM
+ * (see rig-code.c) but that takes a long time and isn't available in
+ * all builds, so we can also compile the common subset of expressions
+ * that only deal with scalar properties into a compact register based
+ * bytecode that we can interpret directly.
+ *
+ * The supported subset is a single statement of the form
+ * "out = <expression>;", or simply "<expression>", where the
+ * expression can use the arithmetic, comparison, logical and ternary C
+ * operators, numeric literals, casts to float, double or int, the
+ * dependency variables and the common <math.h> functions. Integer
+ * arithmetic follows C's rules.
+ */
+
+typedef enum _rig_binding_exception_t {
+    RIG_BINDING_EXCEPTION_SYNTAX = 1,
+    RIG_BINDING_EXCEPTION_UNSUPPORTED,
+} rig_binding_exception_t;
+
+typedef struct _rig_binding_program_t rig_binding_program_t;
+
+/* Returns whether properties of the given @type can be used as inputs
+ * or outputs of binding programs */
+bool rig_binding_program_supports_type(rig_property_type_t type);
+
+/**
+ * rig_binding_program_new:
+ * @expression: The C expression code of a binding
+ * @out_type: The type of the bound property
+ * @n_inputs: The number of dependencies
+ * @input_names: The variable names for the dependencies
+ * @input_types: The types of the dependencies
+ * @e: Return location for an exception
+ *
+ * Compiles @expression into a program that can be evaluated with
+ * rig_binding_program_run(). A %RIG_BINDING_EXCEPTION_UNSUPPORTED
+ * exception is thrown for valid code that isn't supported by the
+ * interpreter.
+ *
+ * Returns: A new program or %NULL if the expression couldn't be
+ *          compiled
+ */
+rig_binding_program_t *
+rig_binding_program_new(const char *expression,
+                        rig_property_type_t out_type,
+                        int n_inputs,
+                        const char **input_names,
+                        const rig_property_type_t *input_types,
+                        rut_exception_t **e);
+
+void rig_binding_program_free(rig_binding_program_t *program);
+
+/* Evaluates the program given the dependency properties @inputs, in
+ * the same order as the names given when compiling */
+double rig_binding_program_run(rig_binding_program_t *program,
+                               rig_property_t **inputs);
+
+/* Evaluates the program and sets the result on @property */
+void rig_binding_program_apply(rig_binding_program_t *program,
+                               rig_property_context_t *property_ctx,
+                               rig_property_t *property,
+                               rig_property_t **inputs);
+
+#endif /* _RIG_BINDING_PROGRAM_H_ */
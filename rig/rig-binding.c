@@ -34,6 +34,13 @@
 #include <rut.h>
 
 #include "rig-code.h"
+#include "rig-binding-program.h"
+
+/* Expression bindings are evaluated by the bytecode interpreter, if
+ * the expression is supported, until they have been evaluated this
+ * many times, after which they switch to native code compiled by LLVM
+ * once that's available. */
+#define HOT_BINDING_N_EVALUATIONS 100
 
 typedef struct _rig_binding_t rig_binding_t;
 
@@ -66,8 +73,24 @@ struct _rig_binding_t {
     rig_code_node_t *function_node;
     rig_code_node_t *expression_node;
 
+    /* The expression compiled for the interpreter, NULL if it hasn't
+     * been compiled yet or isn't supported by the interpreter */
+    rig_binding_program_t *program;
+    bool program_unsupported;
+
+    /* The function compiled by LLVM, once it has been linked for the
+     * current expression and dependencies */
+    rut_binding_callback_t native_callback;
+    bool native_stale;
+
+    int n_evaluations;
+
     c_list_t dependencies;
 
+    /* Set between rig_binding_activate() and rig_binding_deactivate()
+     * even if activating failed, since the binding may still become
+     * active once its expression is changed or relinked */
+    unsigned int wants_active : 1;
     unsigned int active : 1;
 };
 
@@ -96,6 +119,9 @@ _rig_binding_free(void *object)
     if (binding->expression)
         c_free(binding->expression);
 
+    if (binding->program)
+        rig_binding_program_free(binding->program);
+
     c_free(binding->function_name);
 
 #ifdef USE_LLVM
@@ -233,7 +259,7 @@ codegen_function_node(rig_binding_t *binding)
     const char *out_var_decl_post;
     const char *out_var_get_pre;
     dependency_t *dependency;
-    int i;
+    int i = 0;
 
     get_property_codegen_info(binding->property,
                               &out_type_name,
@@ -274,7 +300,7 @@ codegen_function_node(rig_binding_t *binding)
                                dep_get_var_pre,
                                dependency->variable_name,
                                dep_type_name,
-                               i);
+                               i++);
     }
 
     c_string_append(engine->codegen_string0, "  {\n");
@@ -294,18 +320,95 @@ codegen_function_node(rig_binding_t *binding)
 }
 #endif /* RIG_EDITOR_ENABLED */
 
-#ifdef USE_LLVM
-void
-rig_binding_activate(rig_binding_t *binding)
+static void
+update_program(rig_binding_t *binding)
+{
+    int n_dependencies = c_list_length(&binding->dependencies);
+    const char **names = c_alloca(sizeof(char *) * n_dependencies);
+    rig_property_type_t *types =
+        c_alloca(sizeof(rig_property_type_t) * n_dependencies);
+    dependency_t *dependency;
+    rut_exception_t *e = NULL;
+    int i = 0;
+
+    if (binding->program || binding->program_unsupported ||
+        !binding->expression)
+        return;
+
+    c_list_for_each(dependency, &binding->dependencies, link) {
+        names[i] = dependency->variable_name;
+        types[i] = dependency->property->spec->type;
+        i++;
+    }
+
+    binding->program = rig_binding_program_new(binding->expression,
+                                               binding->property->spec->type,
+                                               n_dependencies,
+                                               names,
+                                               types,
+                                               &e);
+    if (!binding->program) {
+#ifndef USE_LLVM
+        c_warning("Can't evaluate binding without LLVM support: %s",
+                  e->message);
+#endif
+        rut_exception_free(e);
+        binding->program_unsupported = true;
+    }
+}
+
+static void
+binding_cb(rig_property_t *property, void *user_data)
+{
+    rig_binding_t *binding = user_data;
+    rig_property_context_t *property_ctx = &binding->engine->_property_ctx;
+
+    if (binding->native_callback &&
+        (!binding->program ||
+         binding->n_evaluations >= HOT_BINDING_N_EVALUATIONS)) {
+        binding->native_callback(property, property_ctx);
+        return;
+    }
+
+    binding->n_evaluations++;
+
+    rig_binding_program_apply(binding->program,
+                              property_ctx,
+                              property,
+                              property->binding->dependencies);
+}
+
+static void
+try_activate(rig_binding_t *binding)
 {
     rig_engine_t *engine = binding->engine;
     rig_property_t **dependencies;
-    rut_binding_callback_t callback;
     int n_dependencies;
     dependency_t *dependency;
-    int i;
+    int i = 0;
 
-    c_return_if_fail(!binding->active);
+    if (binding->simple_copy) {
+        dependency = c_list_first(&binding->dependencies, dependency_t, link);
+        if (!dependency) {
+            c_warning("Unable activate simple copy binding with no dependency set");
+            return;
+        }
+
+        if (dependency->property->spec->type ==
+            binding->property->spec->type)
+        {
+            rig_property_set_copy_binding(&engine->_property_ctx,
+                                          binding->property,
+                                          dependency->property);
+        } else {
+            rig_property_set_cast_scalar_binding(&engine->_property_ctx,
+                                                 binding->property,
+                                                 dependency->property);
+        }
+
+        binding->active = true;
+        return;
+    }
 
     /* XXX: maybe we should only explicitly remove the binding if we know
      * we've previously set a binding. If we didn't previously set a binding
@@ -314,68 +417,95 @@ rig_binding_activate(rig_binding_t *binding)
      */
     rig_property_remove_binding(binding->property);
 
-    callback = rig_code_resolve_symbol(engine, binding->function_name);
-    if (!callback) {
-        c_warning("Failed to lookup binding function symbol \"%s\"",
+#ifdef USE_LLVM
+    if (!binding->native_stale && !binding->native_callback) {
+        binding->native_callback =
+            rig_code_resolve_symbol(engine, binding->function_name);
+    }
+#endif
+
+    update_program(binding);
+
+    if (!binding->program && !binding->native_callback) {
+        c_warning("Failed to activate binding function \"%s\"",
                   binding->function_name);
         return;
     }
+
     n_dependencies = c_list_length(&binding->dependencies);
     dependencies = c_alloca(sizeof(rig_property_t *) * n_dependencies);
 
     c_list_for_each(dependency, &binding->dependencies, link) {
-        dependencies[i] = dependency->property;
+        dependencies[i++] = dependency->property;
     }
 
-    _rig_property_set_binding_full_array(
-        binding->property,
-        callback,
-        &engine->_property_ctx, /* user data */
-        NULL, /* destroy */
-        dependencies,
-        n_dependencies);
+    _rig_property_set_binding_full_array(binding->property,
+                                         binding_cb,
+                                         binding, /* user data */
+                                         NULL, /* destroy */
+                                         dependencies,
+                                         n_dependencies);
 
     binding->active = true;
 }
 
-#else /* USE_LLVM */
+/* Reactivates a binding that wants to be active so that it picks up a
+ * new expression, dependencies or native code */
+static void
+reactivate(rig_binding_t *binding)
+{
+    if (!binding->wants_active)
+        return;
+
+    if (binding->active) {
+        rig_property_remove_binding(binding->property);
+        binding->active = false;
+    }
+
+    try_activate(binding);
+}
 
 void
 rig_binding_activate(rig_binding_t *binding)
 {
-    rig_engine_t *engine = binding->engine;
+    c_return_if_fail(!binding->wants_active);
 
-    c_return_if_fail(!binding->active);
+    binding->wants_active = true;
 
-    if (binding->simple_copy) {
-        dependency_t *dependency = c_list_first(&binding->dependencies, dependency_t, link);
-        if (dependency) {
-            if (dependency->property->spec->type ==
-                binding->property->spec->type)
-            {
-                rig_property_set_copy_binding(&engine->_property_ctx,
-                                              binding->property,
-                                              dependency->property);
-            } else {
-                rig_property_set_cast_scalar_binding(&engine->_property_ctx,
-                                                     binding->property,
-                                                     dependency->property);
-            }
-        } else
-            c_warning("Unable activate simple copy binding with no dependency set");
-    } else
-        c_warning("Unable to active expression based binding without LLVM support");
+    try_activate(binding);
 }
 
-#endif /* USE_LLVM */
 void
 rig_binding_deactivate(rig_binding_t *binding)
 {
-    c_return_if_fail(binding->active);
+    c_return_if_fail(binding->wants_active);
 
-    rig_property_remove_binding(binding->property);
+    binding->wants_active = false;
+
+    if (binding->active) {
+        rig_property_remove_binding(binding->property);
+        binding->active = false;
+    }
+}
+
+/* Called whenever the expression or dependencies change. The
+ * interpreter can take over straight away while any native code is
+ * recompiled. */
+static void
+code_changed(rig_binding_t *binding)
+{
+    if (binding->program) {
+        rig_binding_program_free(binding->program);
+        binding->program = NULL;
+    }
+    binding->program_unsupported = false;
 
-    binding->active = false;
+    binding->native_callback = NULL;
+    binding->native_stale = true;
+
+    binding->n_evaluations = 0;
+
+    reactivate(binding);
 }
 
 #ifdef USE_LLVM
@@ -384,10 +514,11 @@ binding_relink_cb(rig_code_node_t *node, void *user_data)
 {
     rig_binding_t *binding = user_data;
 
-    if (binding->active) {
-        rig_binding_deactivate(binding);
-        rig_binding_activate(binding);
-    }
+    /* The newly linked code is up to date with the binding */
+    binding->native_callback = NULL;
+    binding->native_stale = false;
+
+    reactivate(binding);
 }
 
 static void
@@ -426,6 +557,8 @@ rig_binding_remove_dependency(rig_binding_t *binding,
     if (!binding->engine->simulator)
         codegen_function_node(binding);
 #endif
+
+    code_changed(binding);
 }
 
 void
@@ -450,6 +583,8 @@ rig_binding_add_dependency(rig_binding_t *binding,
     if (!binding->engine->simulator)
         codegen_function_node(binding);
 #endif
+
+    code_changed(binding);
 }
 
 char *
@@ -463,10 +598,13 @@ rig_binding_set_expression(rig_binding_t *binding, const char *expression)
 {
     c_return_if_fail(expression);
 
-#ifdef USE_LLVM
     if ((binding->expression && strcmp(binding->expression, expression) == 0))
         return;
 
+    c_free(binding->expression);
+    binding->expression = c_strdup(expression);
+
+#ifdef USE_LLVM
     if (binding->expression_node) {
         rig_code_node_remove_child(binding->expression_node);
         binding->expression_node = NULL;
@@ -479,9 +617,13 @@ rig_binding_set_expression(rig_binding_t *binding, const char *expression)
     rig_code_node_add_child(binding->function_node, binding->expression_node);
     rut_object_unref(binding->expression_node);
 
+#ifdef RIG_EDITOR_ENABLED
     if (!binding->engine->simulator)
         codegen_function_node(binding);
 #endif
+#endif /* USE_LLVM */
+
+    code_changed(binding);
 }
 
 void
@@ -501,6 +643,8 @@ rig_binding_set_dependency_name(rig_binding_t *binding,
     if (!binding->engine->simulator)
         codegen_function_node(binding);
 #endif
+
+    code_changed(binding);
 }
 
 rig_binding_t *
@@ -52,6 +52,8 @@ typedef struct _rut_memory_stack_t rut_memory_stack_t;
  */
 
 typedef struct _c_sllist_t c_sllist_t;
+typedef struct _c_hash_table_t c_hash_table_t;
+typedef struct _c_ptr_array_t c_ptr_array_t;
 #define c_return_if_fail(X)
 #define c_return_val_if_fail(X, Y)
 
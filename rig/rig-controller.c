@@ -118,6 +118,7 @@ static void
 _rig_controller_free(rut_object_t *object)
 {
     rig_controller_t *controller = object;
+    int i;
 
     rut_closure_list_disconnect_all_FIXME(&controller->operation_cb_list);
 
@@ -125,6 +126,11 @@ _rig_controller_free(rut_object_t *object)
 
     c_hash_table_destroy(controller->properties);
 
+    for (i = 0; i < RIG_CONTROLLER_N_PATH_BATCHES; i++)
+        c_ptr_array_free(controller->path_batches[i], true);
+    c_array_free(controller->path_samples, true);
+    c_array_free(controller->path_values, true);
+
     c_free(controller->label);
 
     rut_object_unref(controller->timeline);
@@ -160,6 +166,13 @@ _rig_controller_type_init(void)
 #undef TYPE
 }
 
+typedef struct _path_sample_t {
+    rig_node_t *n0;
+    rig_node_t *n1;
+    float factor;
+    bool dirty;
+} path_sample_t;
+
 static void
 free_prop_data_cb(void *user_data)
 {
@@ -182,6 +195,7 @@ rig_controller_new(rig_engine_t *engine, const char *label)
     rig_controller_t *controller = rut_object_alloc0(
         rig_controller_t, &rig_controller_type, _rig_controller_type_init);
     rig_timeline_t *timeline;
+    int i;
 
     controller->label = c_strdup(label);
 
@@ -200,6 +214,16 @@ rig_controller_new(rig_engine_t *engine, const char *label)
                                                    NULL, /* key_destroy */
                                                    free_prop_data_cb);
 
+    for (i = 0; i < RIG_CONTROLLER_N_PATH_BATCHES; i++)
+        controller->path_batches[i] = c_ptr_array_new();
+    controller->path_samples =
+        c_array_new(false, false, sizeof(path_sample_t));
+    /* Big enough for a batch of the largest batched type */
+    controller->path_values =
+        c_array_new(false, false, sizeof(c_quaternion_t));
+    controller->path_batches_dirty = true;
+    controller->path_values_dirty = true;
+
     rig_property_set_copy_binding(
         &engine->_property_ctx,
         &controller->props[RIG_CONTROLLER_PROP_PROGRESS],
@@ -241,9 +265,8 @@ dummy_binding_cb(rig_property_t *property, void *user_data)
 }
 
 static void
-assert_path_value_cb(rig_property_t *property, void *user_data)
+assert_path_value(rig_controller_prop_data_t *prop_data)
 {
-    rig_controller_prop_data_t *prop_data = user_data;
     rig_controller_t *controller = prop_data->controller;
     rig_property_t *progress_prop =
         &controller->props[RIG_CONTROLLER_PROP_PROGRESS];
@@ -255,6 +278,263 @@ assert_path_value_cb(rig_property_t *property, void *user_data)
     rig_path_lerp_property(prop_data->path, prop_data->property, progress);
 }
 
+static void
+add_to_path_batch_cb(rig_controller_prop_data_t *prop_data, void *user_data)
+{
+    rig_controller_t *controller = user_data;
+    rig_controller_path_batch_t batch = RIG_CONTROLLER_PATH_BATCH_OTHER;
+
+    if (!prop_data->active ||
+        prop_data->method != RIG_CONTROLLER_METHOD_PATH ||
+        !prop_data->path)
+        return;
+
+    /* NB: A mismatched path is left for rig_path_lerp_property() to
+     * complain about */
+    if (prop_data->path->type == prop_data->property->spec->type) {
+        switch (prop_data->path->type) {
+        case RUT_PROPERTY_TYPE_FLOAT:
+            batch = RIG_CONTROLLER_PATH_BATCH_FLOAT;
+            break;
+        case RUT_PROPERTY_TYPE_VEC3:
+            batch = RIG_CONTROLLER_PATH_BATCH_VEC3;
+            break;
+        case RUT_PROPERTY_TYPE_QUATERNION:
+            batch = RIG_CONTROLLER_PATH_BATCH_QUATERNION;
+            break;
+        default:
+            break;
+        }
+    }
+
+    c_ptr_array_add(controller->path_batches[batch], prop_data);
+}
+
+static void
+update_path_batches(rig_controller_t *controller)
+{
+    int i;
+
+    for (i = 0; i < RIG_CONTROLLER_N_PATH_BATCHES; i++)
+        c_ptr_array_set_size(controller->path_batches[i], 0);
+
+    rig_controller_foreach_property(
+        controller, add_to_path_batch_cb, controller);
+
+    controller->path_batches_dirty = false;
+}
+
+/* Finds the control points and interpolation factor for each
+ * property in @batch. The interpolation itself is left to a type
+ * specific loop that doesn't need to look at the nodes' times. */
+static path_sample_t *
+sample_path_batch(rig_controller_t *controller,
+                  c_ptr_array_t *batch,
+                  float progress)
+{
+    path_sample_t *samples;
+    int i;
+
+    c_array_set_size(controller->path_samples, batch->len);
+    c_array_set_size(controller->path_values, batch->len);
+
+    samples = (path_sample_t *)controller->path_samples->data;
+
+    for (i = 0; i < batch->len; i++) {
+        rig_controller_prop_data_t *prop_data = c_ptr_array_index(batch, i);
+        path_sample_t *sample = &samples[i];
+        float range;
+
+        sample->dirty = false;
+
+        if (!rig_path_find_control_points2(prop_data->path,
+                                           progress,
+                                           RIG_PATH_DIRECTION_FORWARDS,
+                                           &sample->n0,
+                                           &sample->n1)) {
+            sample->n0 = NULL;
+            continue;
+        }
+
+        range = sample->n1->t - sample->n0->t;
+        sample->factor = range ? (progress - sample->n0->t) / range : 0;
+    }
+
+    return samples;
+}
+
+/* Notifies changes for the properties of @batch that were written
+ * directly to their storage */
+static void
+dirty_path_batch(rig_controller_t *controller,
+                 c_ptr_array_t *batch,
+                 path_sample_t *samples)
+{
+    rig_property_context_t *prop_ctx = &controller->engine->_property_ctx;
+    int i;
+
+    for (i = 0; i < batch->len; i++) {
+        rig_controller_prop_data_t *prop_data = c_ptr_array_index(batch, i);
+
+        if (samples[i].dirty)
+            rig_property_dirty(prop_ctx, prop_data->property);
+    }
+}
+
+/* Writes to properties without a setter go straight to the property
+ * storage and the changes are notified for the whole batch afterwards
+ * with dirty_path_batch() */
+#define STORE_BATCH_VALUES(SUFFIX, CTYPE, VALUE, ASSIGN)                     \
+    for (i = 0; i < batch->len; i++) {                                     \
+        rig_controller_prop_data_t *prop_data = c_ptr_array_index(batch, i); \
+        rig_property_t *property = prop_data->property;                    \
+        const rig_property_spec_t *spec = property->spec;                  \
+                                                                           \
+        if (!samples[i].n0)                                                \
+            continue;                                                      \
+                                                                           \
+        if (spec->setter.any_type)                                         \
+            spec->setter.SUFFIX##_type(property->object, VALUE);           \
+        else {                                                             \
+            CTYPE *data =                                                  \
+                (CTYPE *)((uint8_t *)property->object + spec->data_offset); \
+            ASSIGN;                                                        \
+            samples[i].dirty = true;                                       \
+        }                                                                  \
+    }
+
+static void
+evaluate_float_batch(rig_controller_t *controller,
+                     c_ptr_array_t *batch,
+                     float progress)
+{
+    path_sample_t *samples = sample_path_batch(controller, batch, progress);
+    float *values = (float *)controller->path_values->data;
+    int i;
+
+    for (i = 0; i < batch->len; i++) {
+        float a, b;
+
+        if (!samples[i].n0)
+            continue;
+
+        a = samples[i].n0->boxed.d.float_val;
+        b = samples[i].n1->boxed.d.float_val;
+        values[i] = a + (b - a) * samples[i].factor;
+    }
+
+    STORE_BATCH_VALUES(float, float, values[i], {
+        if (spec->getter.any_type == NULL && *data == values[i])
+            continue;
+        *data = values[i];
+    });
+
+    dirty_path_batch(controller, batch, samples);
+}
+
+static void
+evaluate_vec3_batch(rig_controller_t *controller,
+                    c_ptr_array_t *batch,
+                    float progress)
+{
+    path_sample_t *samples = sample_path_batch(controller, batch, progress);
+    float (*values)[3] = (float (*)[3])controller->path_values->data;
+    int i, j;
+
+    for (i = 0; i < batch->len; i++) {
+        const float *a, *b;
+
+        if (!samples[i].n0)
+            continue;
+
+        a = samples[i].n0->boxed.d.vec3_val;
+        b = samples[i].n1->boxed.d.vec3_val;
+        for (j = 0; j < 3; j++)
+            values[i][j] = a[j] + (b[j] - a[j]) * samples[i].factor;
+    }
+
+    STORE_BATCH_VALUES(vec3, float, values[i],
+                       memcpy(data, values[i], sizeof(float) * 3));
+
+    dirty_path_batch(controller, batch, samples);
+}
+
+static void
+evaluate_quaternion_batch(rig_controller_t *controller,
+                          c_ptr_array_t *batch,
+                          float progress)
+{
+    path_sample_t *samples = sample_path_batch(controller, batch, progress);
+    c_quaternion_t *values = (c_quaternion_t *)controller->path_values->data;
+    int i;
+
+    for (i = 0; i < batch->len; i++) {
+        if (!samples[i].n0)
+            continue;
+
+        c_quaternion_nlerp(&values[i],
+                           &samples[i].n0->boxed.d.quaternion_val,
+                           &samples[i].n1->boxed.d.quaternion_val,
+                           samples[i].factor);
+    }
+
+    STORE_BATCH_VALUES(quaternion, c_quaternion_t, &values[i],
+                       *data = values[i]);
+
+    dirty_path_batch(controller, batch, samples);
+}
+
+#undef STORE_BATCH_VALUES
+
+static void
+evaluate_paths(rig_controller_t *controller, float progress)
+{
+    c_ptr_array_t **batches = controller->path_batches;
+    c_ptr_array_t *batch;
+    int i;
+
+    if (controller->path_batches_dirty)
+        update_path_batches(controller);
+
+    /* NB: updated first in case setting the properties leads to
+     * re-entering a path binding */
+    controller->path_progress = progress;
+    controller->path_values_dirty = false;
+
+    evaluate_float_batch(
+        controller, batches[RIG_CONTROLLER_PATH_BATCH_FLOAT], progress);
+    evaluate_vec3_batch(
+        controller, batches[RIG_CONTROLLER_PATH_BATCH_VEC3], progress);
+    evaluate_quaternion_batch(
+        controller, batches[RIG_CONTROLLER_PATH_BATCH_QUATERNION], progress);
+
+    batch = batches[RIG_CONTROLLER_PATH_BATCH_OTHER];
+    for (i = 0; i < batch->len; i++) {
+        rig_controller_prop_data_t *prop_data = c_ptr_array_index(batch, i);
+
+        rig_path_lerp_property(prop_data->path, prop_data->property, progress);
+    }
+}
+
+static void
+path_binding_cb(rig_property_t *property, void *user_data)
+{
+    rig_controller_prop_data_t *prop_data = user_data;
+    rig_controller_t *controller = prop_data->controller;
+    rig_property_t *progress_prop =
+        &controller->props[RIG_CONTROLLER_PROP_PROGRESS];
+    float progress = rig_property_get_double(progress_prop);
+
+    c_return_if_fail(prop_data->method == RIG_CONTROLLER_METHOD_PATH);
+    c_return_if_fail(prop_data->path);
+
+    /* All of the path bindings depend on the progress so the first to
+     * be updated for a new progress evaluates all of the paths in
+     * batches and the rest have nothing left to do. */
+    if (controller->path_values_dirty || progress != controller->path_progress)
+        evaluate_paths(controller, progress);
+}
+
 static void
 activate_property_binding(rig_controller_prop_data_t *prop_data,
                           void *user_data)
@@ -306,7 +586,7 @@ activate_property_binding(rig_controller_prop_data_t *prop_data,
             &controller->props[RIG_CONTROLLER_PROP_PROGRESS];
 
         rig_property_set_binding(property,
-                                 assert_path_value_cb,
+                                 path_binding_cb,
                                  prop_data,
                                  progress_prop,
                                  NULL); /* sentinal */
@@ -319,6 +599,11 @@ activate_property_binding(rig_controller_prop_data_t *prop_data,
     }
 
     prop_data->active = true;
+
+    if (prop_data->method == RIG_CONTROLLER_METHOD_PATH) {
+        controller->path_batches_dirty = true;
+        controller->path_values_dirty = true;
+    }
 }
 
 static void
@@ -339,6 +624,9 @@ deactivate_property_binding(rig_controller_prop_data_t *prop_data,
         break;
     }
 
+    if (prop_data->method == RIG_CONTROLLER_METHOD_PATH)
+        prop_data->controller->path_batches_dirty = true;
+
     prop_data->active = false;
 }
 
@@ -799,9 +1087,12 @@ rig_controller_set_property_path(rig_controller_t *controller,
     prop_data->path = rut_object_ref(path);
 #warning "FIXME: what if this changes the length of the controller?"
 
+    /* The path's type determines which batch the property is in */
+    controller->path_batches_dirty = true;
+
     if (effective_active(controller) &&
         prop_data->method == RIG_CONTROLLER_METHOD_PATH) {
-        assert_path_value_cb(prop_data->property, prop_data);
+        assert_path_value(prop_data);
     }
 }
 
@@ -842,10 +1133,10 @@ prop_data_foreach_node(rig_controller_prop_data_t *prop_data,
 {
     if (prop_data->method == RIG_CONTROLLER_METHOD_PATH) {
         foreach_node_state_t *state = user_data;
-        rig_node_t *node;
 
-        c_list_for_each(node, &prop_data->path->nodes, list_node)
-        state->callback(node, state->user_data);
+        rut_path_foreach_node(prop_data->path,
+                              state->callback,
+                              state->user_data);
     }
 }
 
@@ -939,7 +1230,7 @@ rig_controller_insert_path_value(rig_controller_t *controller,
 
     if (effective_active(controller) &&
         prop_data->method == RIG_CONTROLLER_METHOD_PATH) {
-        assert_path_value_cb(property, prop_data);
+        assert_path_value(prop_data);
     }
 }
 
@@ -1011,6 +1302,6 @@ rig_controller_remove_path_value(rig_controller_t *controller,
 
     if (effective_active(controller) &&
         prop_data->method == RIG_CONTROLLER_METHOD_PATH) {
-        assert_path_value_cb(property, prop_data);
+        assert_path_value(prop_data);
     }
 }
@@ -60,6 +60,16 @@ enum {
     RIG_CONTROLLER_N_PROPS
 };
 
+/* Properties controlled by paths are grouped by type so they can be
+ * evaluated together in tight loops when the progress changes */
+typedef enum {
+    RIG_CONTROLLER_PATH_BATCH_FLOAT,
+    RIG_CONTROLLER_PATH_BATCH_VEC3,
+    RIG_CONTROLLER_PATH_BATCH_QUATERNION,
+    RIG_CONTROLLER_PATH_BATCH_OTHER, /* evaluated one by one */
+    RIG_CONTROLLER_N_PATH_BATCHES
+} rig_controller_path_batch_t;
+
 /* State for an individual property that the controller is tracking */
 typedef struct {
     rig_controller_t *controller;
@@ -106,6 +116,20 @@ struct _rig_controller_t {
 
     c_hash_table_t *properties;
 
+    /* Active prop_data using the path method, grouped by type. These
+     * are rebuilt lazily when path_batches_dirty is set. */
+    c_ptr_array_t *path_batches[RIG_CONTROLLER_N_PATH_BATCHES];
+    bool path_batches_dirty;
+
+    /* The progress the paths were last evaluated at, unless
+     * path_values_dirty is set */
+    float path_progress;
+    bool path_values_dirty;
+
+    /* Scratch space for evaluating batches */
+    c_array_t *path_samples;
+    c_array_t *path_values;
+
     c_list_t operation_cb_list;
 
     rig_property_t props[RIG_CONTROLLER_N_PROPS];
@@ -297,6 +297,7 @@ add_entity_apply_real(rig_engine_op_apply_context_t *ctx,
             c_warning("Added entity replaces root node");
         }
         ctx->ui->scene = entity;
+        rig_ui_entity_graph_changed_notify(ctx->ui, entity);
     }
 }
 
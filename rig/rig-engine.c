@@ -111,6 +111,10 @@ _rig_engine_free(void *object)
 
     rut_magazine_free(engine->object_id_magazine);
 
+    c_ptr_array_free(engine->running_timelines, true);
+    c_ptr_array_free(engine->timeline_events, true);
+    c_ptr_array_free(engine->timelines_scratch, true);
+
     rig_introspectable_destroy(engine);
 
     rig_property_context_destroy(&engine->_property_ctx);
@@ -190,6 +194,10 @@ _rig_engine_new_full(rut_shell_t *shell,
 
     engine->queued_deletes = rut_queue_new();
 
+    engine->running_timelines = c_ptr_array_new();
+    engine->timeline_events = c_ptr_array_new();
+    engine->timelines_scratch = c_ptr_array_new();
+
     engine->text_state = rig_text_engine_state_new(engine);
 
     _rig_code_init(engine);
@@ -283,22 +291,13 @@ rig_engine_set_apply_op_context(rig_engine_t *engine,
 void
 rig_engine_progress_timelines(rig_engine_t *engine, double delta)
 {
-    c_sllist_t *l;
-
-    for (l = engine->timelines; l; l = l->next)
-        _rig_timeline_progress(l->data, delta);
+    _rig_timeline_progress_running(engine, delta);
 }
 
 bool
 rig_engine_check_timelines(rig_engine_t *engine)
 {
-    c_sllist_t *l;
-
-    for (l = engine->timelines; l; l = l->next)
-        if (rig_timeline_is_running(l->data))
-            return true;
-
-    return false;
+    return engine->running_timelines->len > 0;
 }
 
 
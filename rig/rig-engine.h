@@ -142,7 +142,14 @@ struct _rig_engine_t {
     char *code_dso_filename;
     bool need_recompile;
 
-    c_sllist_t *timelines;
+    /* Only running timelines are tracked by the engine. They are
+     * kept in a dense array for progressing them and in a min-heap
+     * ordered by when they will next reach their end (to stop or
+     * loop) in terms of timeline_clock, see rig-timeline.c */
+    c_ptr_array_t *running_timelines;
+    c_ptr_array_t *timeline_events;
+    c_ptr_array_t *timelines_scratch;
+    double timeline_clock;
 
     rig_introspectable_props_t introspectable;
     rig_property_t properties[RIG_ENGINE_N_PROPS];
@@ -33,6 +33,7 @@
 #include "rig-entity.h"
 #include "rig-engine.h"
 #include "rig-code-module.h"
+#include "rig-ui.h"
 
 static rig_property_spec_t _rig_entity_prop_specs[] = {
     { .name = "label",
@@ -105,6 +106,13 @@ _rig_entity_free(void *object)
     rut_object_free(rig_entity_t, entity);
 }
 
+static void
+notify_graph_changed(rig_entity_t *entity)
+{
+    if (entity->engine->ui)
+        rig_ui_entity_graph_changed_notify(entity->engine->ui, entity);
+}
+
 void
 rig_entity_reap(rig_entity_t *entity, rig_engine_t *engine)
 {
@@ -133,6 +141,8 @@ rig_entity_reap(rig_entity_t *entity, rig_engine_t *engine)
     }
     c_ptr_array_set_size(entity->components, 0);
 
+    notify_graph_changed(entity);
+
     rig_engine_queue_delete(engine, entity);
 }
 
@@ -178,6 +188,8 @@ rig_entity_add_component(rig_entity_t *entity, rut_object_t *object)
     rut_object_claim(object, entity);
     c_ptr_array_add(entity->components, object);
 
+    notify_graph_changed(entity);
+
     if (entity->renderer_priv) {
         rut_object_t *renderer = *(rut_object_t **)entity->renderer_priv;
         rut_renderer_notify_entity_changed(renderer, entity);
@@ -206,6 +218,8 @@ rig_entity_remove_component(rig_entity_t *entity, rut_object_t *object)
 
     c_warn_if_fail(status);
 
+    notify_graph_changed(entity);
+
     if (entity->renderer_priv) {
         rut_object_t *renderer = *(rut_object_t **)entity->renderer_priv;
         rut_renderer_notify_entity_changed(renderer, entity);
@@ -221,14 +235,32 @@ rig_entity_translate(rig_entity_t *entity, float tx, float ty, float tz)
     rig_entity_set_position(entity, pos);
 }
 
+static void
+_rig_entity_child_removed(rut_object_t *parent, rut_object_t *child)
+{
+    rig_entity_t *entity = parent;
+
+    if (entity->engine->ui)
+        rig_ui_entity_removed_notify(entity->engine->ui, entity, child);
+}
+
+static void
+_rig_entity_child_added(rut_object_t *parent, rut_object_t *child)
+{
+    rig_entity_t *entity = parent;
+
+    if (entity->engine->ui)
+        rig_ui_entity_added_notify(entity->engine->ui, entity, child);
+}
+
 rut_type_t rig_entity_type;
 
 void
 _rig_entity_init_type(void)
 {
     static rut_graphable_vtable_t graphable_vtable = {
-        NULL, /* child_removed */
-        NULL, /* child_added */
+        _rig_entity_child_removed,
+        _rig_entity_child_added,
         NULL, /* parent_changed */
     };
     static rut_transformable_vtable_t transformable_vtable = {
@@ -243,8 +275,10 @@ _rig_entity_init_type(void)
                        RUT_TRAIT_ID_GRAPHABLE,
                        offsetof(TYPE, graphable),
                        &graphable_vtable);
-    rut_type_add_trait(
-        type, RUT_TRAIT_ID_TRANSFORMABLE, 0, &transformable_vtable);
+    rut_type_add_trait(type,
+                       RUT_TRAIT_ID_TRANSFORMABLE,
+                       offsetof(TYPE, transformable),
+                       &transformable_vtable);
     rut_type_add_trait(type,
                        RUT_TRAIT_ID_INTROSPECTABLE,
                        offsetof(TYPE, introspectable),
@@ -274,6 +308,7 @@ rig_entity_new(rig_engine_t *engine)
     entity->components = c_ptr_array_new();
 
     rut_graphable_init(entity);
+    rut_transformable_init(entity);
 
     return entity;
 }
@@ -282,10 +317,15 @@ void
 rig_entity_set_label(rut_object_t *obj, const char *label)
 {
     rig_entity_t *entity = obj;
+    char *old_label = entity->label;
 
-    c_free(entity->label);
     entity->label = c_strdup(label);
 
+    if (entity->engine->ui)
+        rig_ui_entity_label_changed_notify(entity->engine->ui, entity, old_label);
+
+    c_free(old_label);
+
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_LABEL]);
 }
@@ -340,6 +380,8 @@ rig_entity_set_position(rut_object_t *obj, const float position[3])
     entity->position[1] = position[1];
     entity->position[2] = position[2];
     entity->dirty = true;
+    rut_transformable_changed(entity);
+    rig_entity_notify_bounds_changed(entity);
 
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_POSITION]);
@@ -427,6 +469,8 @@ rig_entity_set_rotation(rut_object_t *obj, const c_quaternion_t *rotation)
 
     entity->rotation = *rotation;
     entity->dirty = true;
+    rut_transformable_changed(entity);
+    rig_entity_notify_bounds_changed(entity);
 
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_ROTATION]);
@@ -509,6 +553,8 @@ rig_entity_set_scale(rut_object_t *obj, float scale)
 
     entity->scale = scale;
     entity->dirty = true;
+    rut_transformable_changed(entity);
+    rig_entity_notify_bounds_changed(entity);
 
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_SCALE]);
@@ -573,6 +619,8 @@ rig_entity_rotate_x_axis(rig_entity_t *entity, float x_angle)
     c_quaternion_multiply(&entity->rotation, &entity->rotation, &x_rotation);
 
     entity->dirty = true;
+    rut_transformable_changed(entity);
+    rig_entity_notify_bounds_changed(entity);
 
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_ROTATION]);
@@ -587,6 +635,8 @@ rig_entity_rotate_y_axis(rig_entity_t *entity, float y_angle)
     c_quaternion_multiply(&entity->rotation, &entity->rotation, &y_rotation);
 
     entity->dirty = true;
+    rut_transformable_changed(entity);
+    rig_entity_notify_bounds_changed(entity);
 
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_ROTATION]);
@@ -601,6 +651,8 @@ rig_entity_rotate_z_axis(rig_entity_t *entity, float z_angle)
     c_quaternion_multiply(&entity->rotation, &entity->rotation, &z_rotation);
 
     entity->dirty = true;
+    rut_transformable_changed(entity);
+    rig_entity_notify_bounds_changed(entity);
 
     rig_property_dirty(entity->engine->property_ctx,
                        &entity->properties[RUT_ENTITY_PROP_ROTATION]);
@@ -718,6 +770,13 @@ rig_entity_notify_changed(rig_entity_t *entity)
     }
 }
 
+void
+rig_entity_notify_bounds_changed(rig_entity_t *entity)
+{
+    if (entity->engine->ui)
+        rig_ui_entity_bounds_changed_notify(entity->engine->ui, entity);
+}
+
 void
 rig_entity_set_camera_view_from_transform(rig_entity_t *camera)
 {
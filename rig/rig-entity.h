@@ -99,6 +99,7 @@ struct _rig_entity_t {
     char *label;
 
     rut_graphable_props_t graphable;
+    rut_transformable_props_t transformable;
 
     /* private fields */
     float position[3];
@@ -201,6 +202,10 @@ void rig_entity_foreach_component_safe(rig_entity_t *entity,
 
 void rig_entity_notify_changed(rig_entity_t *entity);
 
+/* Should be called whenever the transform or pickable geometry of an
+ * entity changes */
+void rig_entity_notify_bounds_changed(rig_entity_t *entity);
+
 void rig_entity_reap(rig_entity_t *entity, rig_engine_t *engine);
 
 void rig_component_reap(rut_object_t *component, rig_engine_t *engine);
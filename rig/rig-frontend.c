@@ -58,6 +58,10 @@
 #include <libavformat/avformat.h>
 #endif
 
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <rut.h>
 
 #include "rig-engine.h"
@@ -66,6 +70,7 @@
 #include "rig-load-save.h"
 #include "rig-pb.h"
 #include "rig-logs.h"
+#include "rig-property-delta.h"
 
 #include "components/rig-source.h"
 
@@ -180,8 +185,11 @@ frontend_unregister_object_cb(rig_ui_t *ui, void *object, void *user_data)
 
     c_warn_if_fail(id_ptr);
 
-    if (id_ptr)
+    if (id_ptr) {
+        rig_property_delta_forget_object(frontend->property_delta,
+                                         *(uint64_t *)id_ptr);
         c_hash_table_remove(frontend->id_to_object_map, id_ptr);
+    }
 }
 
 static void
@@ -267,6 +275,146 @@ apply_property_change(rig_frontend_t *frontend,
         &frontend->engine->_property_ctx, property, &boxed);
 }
 
+typedef struct _decoded_change_t {
+    uint64_t object_id;
+    int prop_id;
+    rut_boxed_t value;
+
+    /* Object values are only looked up when the change is applied
+     * since they may refer to an object registered by an edit
+     * operation sequenced before the change */
+    uint64_t value_object_id;
+} decoded_change_t;
+
+static void
+apply_decoded_property_change(rig_frontend_t *frontend,
+                              decoded_change_t *change)
+{
+    void *object = frontend_lookup_object(frontend, change->object_id);
+    rig_property_t *property;
+
+    if (!object) {
+        c_warning("Frontend: Property change for unknown object");
+        return;
+    }
+
+    property = rig_introspectable_get_property(object, change->prop_id);
+    if (!property || property->spec->type != change->value.type) {
+        c_warning("Frontend: Failed to find object property by id");
+        return;
+    }
+
+    if (change->value.type == RUT_PROPERTY_TYPE_OBJECT &&
+        change->value_object_id) {
+        change->value.d.object_val =
+            frontend_lookup_object(frontend, change->value_object_id);
+        if (!change->value.d.object_val) {
+            c_warning("Frontend: Property change refers to unknown object");
+            return;
+        }
+    }
+
+    rig_property_set_boxed(
+        &frontend->engine->_property_ctx, property, &change->value);
+}
+
+/* Called when delta encoded property changes can't be decoded, since
+ * our mirror of the previous values no longer matches the
+ * simulator's */
+static void
+lose_delta_sync(rig_frontend_t *frontend)
+{
+    rig_property_delta_reset(frontend->property_delta);
+    frontend->delta_resync_pending = true;
+}
+
+/* Decodes all of the property changes from a Rig__UIDiff that were
+ * delta encoded by the simulator before any are applied, since they
+ * are interleaved with edit operations.
+ *
+ * Returns: The number of changes successfully decoded
+ */
+static int
+decode_property_changes(rig_frontend_t *frontend,
+                        const Rig__UIDiff *pb_ui_diff,
+                        decoded_change_t **changes_out)
+{
+    rig_engine_t *engine = frontend->engine;
+    int n_changes = pb_ui_diff->n_encoded_property_changes;
+    const uint8_t *data = pb_ui_diff->encoded_property_changes.data;
+    size_t len = pb_ui_diff->encoded_property_changes.len;
+    decoded_change_t *changes;
+    const uint8_t *end;
+    int i;
+
+    if (pb_ui_diff->has_delta_reset && pb_ui_diff->delta_reset) {
+        rig_property_delta_reset(frontend->property_delta);
+        frontend->delta_resync_pending = false;
+    }
+
+    if (n_changes <= 0)
+        return 0;
+
+    /* Changes encoded before the simulator handled our resync request
+     * can't be decoded */
+    if (frontend->delta_resync_pending)
+        return 0;
+
+    if (pb_ui_diff->has_uncompressed_size &&
+        pb_ui_diff->uncompressed_size) {
+#ifdef USE_ZLIB
+        uLongf uncompressed_len = pb_ui_diff->uncompressed_size;
+        uint8_t *uncompressed = rut_memory_stack_alloc(engine->frame_stack,
+                                                       uncompressed_len);
+
+        if (uncompress(uncompressed, &uncompressed_len, data, len) != Z_OK ||
+            uncompressed_len != pb_ui_diff->uncompressed_size) {
+            c_warning("Frontend: Failed to decompress property changes");
+            lose_delta_sync(frontend);
+            return 0;
+        }
+
+        data = uncompressed;
+        len = uncompressed_len;
+#else
+        c_warning("Frontend: Received compressed property changes "
+                  "without zlib support");
+        lose_delta_sync(frontend);
+        return 0;
+#endif
+    }
+
+    end = data + len;
+
+    changes = rut_memory_stack_memalign(engine->frame_stack,
+                                        sizeof(decoded_change_t) * n_changes,
+                                        C_ALIGNOF(decoded_change_t));
+
+    rig_property_delta_begin_frame(frontend->property_delta);
+
+    for (i = 0; i < n_changes; i++) {
+        decoded_change_t *change = &changes[i];
+
+        if (!rig_property_delta_decode(frontend->property_delta,
+                                       &data, end,
+                                       engine->frame_stack,
+                                       &change->object_id,
+                                       &change->prop_id,
+                                       &change->value,
+                                       &change->value_object_id)) {
+            c_warning("Frontend: Invalid encoded property changes received");
+
+            /* The changes decoded so far are still valid */
+            lose_delta_sync(frontend);
+            break;
+        }
+    }
+
+    *changes_out = changes;
+
+    return i;
+}
+
 static void
 frontend__request_frame(Rig__Frontend_Service *service,
                         const Rig__FrameRequest *pb_req,
@@ -300,6 +448,10 @@ frontend__update_ui(Rig__Frontend_Service *service,
     rig_engine_op_map_context_t *map_to_frontend_objects_op_ctx;
     rig_engine_op_apply_context_t *apply_op_ctx;
     Rig__UIEdit *pb_ui_edit;
+    bool encoded = pb_ui_diff && pb_ui_diff->has_encoded_property_changes;
+    decoded_change_t *decoded_changes = NULL;
+    int n_decoded_changes = 0;
+    int64_t start_time = 0, decode_time = 0;
 
 #if 0
     frontend->sim_update_pending = false;
@@ -321,8 +473,23 @@ frontend__update_ui(Rig__Frontend_Service *service,
 
     c_return_if_fail(pb_ui_diff != NULL);
 
+    if (frontend->collect_stats)
+        start_time = c_get_monotonic_time();
+
     n_property_changes = pb_ui_diff->n_property_changes;
 
+    if (encoded) {
+        n_decoded_changes =
+            decode_property_changes(frontend, pb_ui_diff, &decoded_changes);
+
+        /* Note: even if we failed to decode some changes we still
+         * need to count them to sequence the edit operations */
+        n_property_changes = pb_ui_diff->n_encoded_property_changes;
+
+        if (frontend->collect_stats)
+            decode_time = c_get_monotonic_time();
+    }
+
     map_to_frontend_objects_op_ctx = &frontend->map_to_frontend_objects_op_ctx;
     apply_op_ctx = &frontend->apply_op_ctx;
     unserializer = frontend->prop_change_unserializer;
@@ -344,9 +511,15 @@ frontend__update_ui(Rig__Frontend_Service *service,
             int until = pb_op->sequence;
 
             for (; j < until; j++) {
-                Rig__PropertyChange *pb_change =
-                    pb_ui_diff->property_changes[j];
-                apply_property_change(frontend, unserializer, pb_change);
+                if (encoded) {
+                    if (j < n_decoded_changes)
+                        apply_decoded_property_change(frontend,
+                                                      &decoded_changes[j]);
+                } else {
+                    Rig__PropertyChange *pb_change =
+                        pb_ui_diff->property_changes[j];
+                    apply_property_change(frontend, unserializer, pb_change);
+                }
             }
 
             if (!rig_engine_pb_op_map(map_to_frontend_objects_op_ctx,
@@ -368,13 +541,29 @@ frontend__update_ui(Rig__Frontend_Service *service,
         }
     }
 
-    for (; j < n_property_changes; j++) {
-        Rig__PropertyChange *pb_change = pb_ui_diff->property_changes[j];
-        apply_property_change(frontend, unserializer, pb_change);
+    if (encoded) {
+        for (; j < n_decoded_changes; j++)
+            apply_decoded_property_change(frontend, &decoded_changes[j]);
+    } else {
+        for (; j < n_property_changes; j++) {
+            Rig__PropertyChange *pb_change = pb_ui_diff->property_changes[j];
+            apply_property_change(frontend, unserializer, pb_change);
+        }
     }
 
     rig_pb_unserializer_log_errors(apply_op_ctx->unserializer);
 
+    if (frontend->collect_stats) {
+        rig_frontend_ui_update_stats_t *stats = &frontend->stats;
+
+        stats->n_updates++;
+        stats->n_property_changes += n_property_changes;
+        stats->n_ops += pb_ui_edit ? pb_ui_edit->n_ops : 0;
+        stats->apply_ns += c_get_monotonic_time() - start_time;
+        if (decode_time)
+            stats->decode_ns += decode_time - start_time;
+    }
+
 #if 0
     if (pb_ui_edit || n_property_changes) {
         c_debug("UI Updated");
@@ -597,12 +786,53 @@ rig_frontend_run_simulator_frame(rig_frontend_t *frontend,
     simulator_service =
         rig_pb_rpc_client_get_service(frontend->frontend_peer->pb_rpc_client);
 
+    setup->has_ui_diff_encodings = true;
+    setup->ui_diff_encodings = frontend->ui_diff_encodings;
+
+    /* NB: we keep asking until the simulator's reset reaches us in
+     * case a UIDiff was already in flight */
+    if (frontend->delta_resync_pending) {
+        setup->has_delta_resync = true;
+        setup->delta_resync = true;
+    }
+
     rig__simulator__run_frame(
         simulator_service, setup, frame_running_ack, frontend); /* user data */
 
     frontend->sim_update_pending = true;
 }
 
+void
+rig_frontend_set_collect_stats(rig_frontend_t *frontend,
+                               bool collect_stats)
+{
+    frontend->collect_stats = collect_stats;
+}
+
+void
+rig_frontend_set_ui_diff_encodings(rig_frontend_t *frontend,
+                                   uint32_t encodings)
+{
+#ifndef USE_ZLIB
+    encodings &= ~RIG_UI_DIFF_ENCODING_ZLIB;
+#endif
+
+    frontend->ui_diff_encodings = encodings;
+}
+
+void
+rig_frontend_get_stats(rig_frontend_t *frontend,
+                       rig_frontend_ui_update_stats_t *stats)
+{
+    *stats = frontend->stats;
+}
+
+void
+rig_frontend_reset_stats(rig_frontend_t *frontend)
+{
+    memset(&frontend->stats, 0, sizeof(frontend->stats));
+}
+
 static void
 _rig_frontend_free(void *object)
 {
@@ -612,6 +842,8 @@ _rig_frontend_free(void *object)
     rig_engine_op_map_context_destroy(&frontend->map_to_frontend_objects_op_ctx);
     rig_pb_unserializer_destroy(frontend->prop_change_unserializer);
 
+    rig_property_delta_free(frontend->property_delta);
+
     rut_closure_list_disconnect_all_FIXME(&frontend->ui_update_cb_list);
 
     frontend_stop_service(frontend);
@@ -1234,6 +1466,11 @@ rig_frontend_new(rut_shell_t *shell)
                               free_object_id, /* key destroy */
                               NULL); /* value destroy */
 
+    frontend->property_delta = rig_property_delta_new();
+    rig_frontend_set_ui_diff_encodings(frontend,
+                                       RIG_UI_DIFF_ENCODING_DELTA |
+                                       RIG_UI_DIFF_ENCODING_ZLIB);
+
     c_list_init(&frontend->ui_update_cb_list);
 
     rut_shell_set_queue_redraw_callback(shell,
@@ -39,10 +39,24 @@ typedef struct _rig_frontend_t rig_frontend_t;
 #include "rig-engine-op.h"
 #include "rig-camera-view.h"
 #include "rig-rpc-network.h"
+#include "rig-property-delta.h"
 #include "protobuf-c-rpc/rig-protobuf-c-stream.h"
 
 #include "rig.pb-c.h"
 
+/* Counters and timings accumulated for each UI update applied from
+ * the simulator while stats collection is enabled with
+ * rig_frontend_set_collect_stats(), until reset with
+ * rig_frontend_reset_stats() */
+typedef struct _rig_frontend_ui_update_stats_t {
+    int n_updates;
+    int n_property_changes;
+    int n_ops;
+
+    int64_t apply_ns; /* applying ops and property changes */
+    int64_t decode_ns; /* decompressing and decoding property changes */
+} rig_frontend_ui_update_stats_t;
+
 /* The "frontend" is the main process that controls the running
  * of a Rig UI, either in device mode, as a slave or as an editor.
  *
@@ -136,7 +150,22 @@ struct _rig_frontend_t {
     c_hash_table_t *id_to_object_map;
     c_hash_table_t *object_to_id_map;
 
+    /* The rig_ui_diff_encoding_t encodings we advertise to the
+     * simulator and the mirror of the previous property values
+     * needed to decode delta encoded property changes */
+    uint32_t ui_diff_encodings;
+    rig_property_delta_t *property_delta;
+
+    /* Set if we failed to decode delta encoded property changes.
+     * Until a UIDiff with delta_reset arrives we keep asking the
+     * simulator to resync and drop any property changes since they
+     * would be decoded against stale values. */
+    bool delta_resync_pending;
+
     void (*delete_object)(rig_frontend_t *frontend, void *object);
+
+    bool collect_stats;
+    rig_frontend_ui_update_stats_t stats;
 };
 
 rig_frontend_t *rig_frontend_new(rut_shell_t *shell);
@@ -184,6 +213,20 @@ rig_frontend_add_ui_update_callback(rig_frontend_t *frontend,
                                     void *user_data,
                                     rut_closure_destroy_callback_t destroy);
 
+void rig_frontend_set_collect_stats(rig_frontend_t *frontend,
+                                    bool collect_stats);
+
+/* Sets the rig_ui_diff_encoding_t mask of encodings the simulator may
+ * use to send property changes. By default all supported encodings
+ * are enabled. */
+void rig_frontend_set_ui_diff_encodings(rig_frontend_t *frontend,
+                                        uint32_t encodings);
+
+void rig_frontend_get_stats(rig_frontend_t *frontend,
+                            rig_frontend_ui_update_stats_t *stats);
+
+void rig_frontend_reset_stats(rig_frontend_t *frontend);
+
 void rig_frontend_queue_set_play_mode_enabled(rig_frontend_t *frontend,
                                               bool play_mode_enabled);
 
@@ -57,6 +57,73 @@ rig_introspectable_copy_properties(rig_property_context_t *property_ctx,
     rig_introspectable_foreach_property(src, copy_property_cb, &state);
 }
 
+/* All objects of the same type share the same static array of
+ * property specs so we index the property names once per type. The
+ * index maps names to property ids + 1.
+ *
+ * The indices are looked up by type and each one is freed once the
+ * last introspectable object of its type is destroyed. */
+typedef struct _name_index_t {
+    c_hash_table_t *names;
+    int n_objects;
+} name_index_t;
+
+static c_hash_table_t *name_indices;
+
+static void
+free_name_index(void *data)
+{
+    name_index_t *index = data;
+
+    c_hash_table_destroy(index->names);
+    c_slice_free(name_index_t, index);
+}
+
+static void
+ref_name_index(rut_object_t *object, rig_property_spec_t *specs, int n)
+{
+    const rut_type_t *type = rut_object_get_type(object);
+    name_index_t *index;
+    int i;
+
+    if (C_UNLIKELY(name_indices == NULL)) {
+        name_indices = c_hash_table_new_full(c_direct_hash,
+                                             c_direct_equal,
+                                             NULL, /* key destroy */
+                                             free_name_index);
+    }
+
+    index = c_hash_table_lookup(name_indices, type);
+    if (C_LIKELY(index)) {
+        index->n_objects++;
+        return;
+    }
+
+    index = c_slice_new(name_index_t);
+    index->names = c_hash_table_new(c_str_hash, c_str_equal);
+    index->n_objects = 1;
+
+    for (i = 0; i < n; i++) {
+        c_hash_table_insert(index->names,
+                            (char *)specs[i].name,
+                            C_UINT_TO_POINTER(i + 1));
+    }
+
+    c_hash_table_insert(name_indices, (void *)type, index);
+}
+
+static void
+unref_name_index(rut_object_t *object)
+{
+    const rut_type_t *type = rut_object_get_type(object);
+    name_index_t *index = c_hash_table_lookup(name_indices, type);
+
+    c_return_if_fail(index != NULL);
+
+    if (--index->n_objects == 0)
+        c_hash_table_remove(name_indices, type);
+}
+
 void
 rig_introspectable_init(rut_object_t *object,
                         rig_property_spec_t *specs,
@@ -72,6 +139,8 @@ rig_introspectable_init(rut_object_t *object,
 
     props->first_property = properties;
     props->n_properties = n;
+
+    ref_name_index(object, specs, n);
 }
 
 void
@@ -84,6 +153,8 @@ rig_introspectable_destroy(rut_object_t *object)
 
     for (i = 0; i < props->n_properties; i++)
         rig_property_destroy(&properties[i]);
+
+    unref_name_index(object);
 }
 
 rig_property_t *
@@ -92,15 +163,15 @@ rig_introspectable_lookup_property(rut_object_t *object,
 {
     rig_introspectable_props_t *priv =
         rut_object_get_properties(object, RUT_TRAIT_ID_INTROSPECTABLE);
-    int i;
+    name_index_t *index =
+        c_hash_table_lookup(name_indices, rut_object_get_type(object));
+    unsigned int id;
 
-    for (i = 0; i < priv->n_properties; i++) {
-        rig_property_t *property = priv->first_property + i;
-        if (strcmp(property->spec->name, name) == 0)
-            return property;
-    }
+    c_return_val_if_fail(index != NULL, NULL);
+
+    id = C_POINTER_TO_UINT(c_hash_table_lookup(index->names, name));
 
-    return NULL;
+    return id ? priv->first_property + id - 1 : NULL;
 }
 
 void
@@ -0,0 +1,405 @@
+/*
+ * Rig
+ *
+ * UI Engine & Editor
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <rig-config.h>
+
+#include <stdio.h>
+
+#include <clib.h>
+
+#include "rig-lighting.h"
+#include "components/rig-camera.h"
+
+static const char *spot_function =
+    "float\n"
+    "rig_light_spot(vec4 coords)\n"
+    "{\n"
+    "  if (coords.w <= 0.0)\n"
+    "    return 0.0;\n"
+    "  vec2 d = coords.xy / coords.w * 2.0 - 1.0;\n"
+    "  return 1.0 - smoothstep(0.8, 1.0, length(d));\n"
+    "}\n";
+
+/* Fragments outside of a light's frustum aren't shadowed since their
+ * coordinates would otherwise sample another light's tile */
+static const char *shadow_function =
+    "float\n"
+    "rig_light_shadow(vec4 coords, vec4 tile)\n"
+    "{\n"
+    "  vec3 c = coords.xyz / coords.w;\n"
+    "  if (coords.w <= 0.0 ||\n"
+    "      c.x < 0.0 || c.x > 1.0 || c.y < 0.0 || c.y > 1.0)\n"
+    "    return 1.0;\n"
+    "#if __VERSION__ >= 130\n"
+    "  vec4 texel = texture(cg_sampler10, tile.xy + c.xy * tile.zw);\n"
+    "#else\n"
+    "  vec4 texel = texture2D(cg_sampler10, tile.xy + c.xy * tile.zw);\n"
+    "#endif\n"
+    "  if (texel.r + 0.0005 < c.z)\n"
+    "    return 0.5;\n"
+    "  return 1.0;\n"
+    "}\n";
+
+static cg_snippet_t *
+create_light_coords_vertex_snippet(int n_lights)
+{
+    c_string_t *declarations = c_string_new(NULL);
+    c_string_t *post = c_string_new(NULL);
+    cg_snippet_t *snippet;
+    int i;
+
+    for (i = 0; i < n_lights; i++) {
+        c_string_append_printf(declarations,
+                               "uniform mat4 light%d_shadow_matrix;\n"
+                               "out vec4 light%d_coords;\n",
+                               i, i);
+        c_string_append_printf(post,
+                               "light%d_coords = light%d_shadow_matrix *\n"
+                               "                 pos;\n",
+                               i, i);
+    }
+
+    snippet = cg_snippet_new(CG_SNIPPET_HOOK_VERTEX,
+                             declarations->str,
+                             post->str);
+
+    c_string_free(declarations, true);
+    c_string_free(post, true);
+
+    return snippet;
+}
+
+static cg_snippet_t *
+create_normal_map_vertex_snippet(int n_lights)
+{
+    c_string_t *declarations = c_string_new(NULL);
+    c_string_t *post = c_string_new(NULL);
+    cg_snippet_t *snippet;
+    int i;
+
+    c_string_append(post,
+                    "vec3 tangent = normalize(normal_matrix * tangent_in);\n"
+                    "vec3 binormal = cross(normal, tangent);\n"
+                    "vec3 v;\n");
+
+    /* Transform the light directions into tangent space */
+    for (i = 0; i < n_lights; i++) {
+        c_string_append_printf(declarations,
+                               "uniform vec3 light%d_direction_norm;\n"
+                               "out vec3 light%d_direction;\n",
+                               i, i);
+        c_string_append_printf(post,
+                               "v.x = dot(light%d_direction_norm, tangent);\n"
+                               "v.y = dot(light%d_direction_norm, binormal);\n"
+                               "v.z = dot(light%d_direction_norm, normal);\n"
+                               "light%d_direction = normalize(v);\n",
+                               i, i, i, i);
+    }
+
+    /* Transform the eye direction into tangent space */
+    c_string_append(post,
+                    "v.x = dot(eye_direction, tangent);\n"
+                    "v.y = dot(eye_direction, binormal);\n"
+                    "v.z = dot(eye_direction, normal);\n"
+                    "eye_direction = normalize(v);\n");
+
+    snippet = cg_snippet_new(CG_SNIPPET_HOOK_VERTEX,
+                             declarations->str,
+                             post->str);
+
+    c_string_free(declarations, true);
+    c_string_free(post, true);
+
+    return snippet;
+}
+
+static cg_snippet_t *
+create_fragment_snippet(int n_lights,
+                        rig_lighting_model_t model,
+                        bool receive_shadow)
+{
+    c_string_t *declarations = c_string_new(NULL);
+    c_string_t *post = c_string_new(NULL);
+    bool material = model != RIG_LIGHTING_MODEL_SIMPLE;
+    cg_snippet_t *snippet;
+    int i;
+
+    if (model == RIG_LIGHTING_MODEL_NORMAL_MAP)
+        c_string_append(declarations, "in vec3 eye_direction;\n");
+    else
+        c_string_append(declarations, "in vec3 normal, eye_direction;\n");
+
+    if (material) {
+        c_string_append(declarations,
+                        "uniform vec4 material_ambient, material_diffuse,\n"
+                        "             material_specular;\n"
+                        "uniform float material_shininess;\n");
+    }
+
+    for (i = 0; i < n_lights; i++) {
+        c_string_append_printf(declarations,
+                               "uniform vec4 light%d_ambient, light%d_diffuse,\n"
+                               "             light%d_specular;\n"
+                               "uniform float light%d_spot;\n"
+                               "in vec4 light%d_coords;\n",
+                               i, i, i, i, i);
+
+        if (model == RIG_LIGHTING_MODEL_NORMAL_MAP) {
+            c_string_append_printf(declarations,
+                                   "in vec3 light%d_direction;\n", i);
+        } else {
+            c_string_append_printf(declarations,
+                                   "uniform vec3 light%d_direction_norm;\n",
+                                   i);
+        }
+
+        if (receive_shadow) {
+            c_string_append_printf(declarations,
+                                   "uniform vec4 light%d_shadow_tile;\n", i);
+        }
+    }
+
+    c_string_append(declarations, spot_function);
+    if (receive_shadow)
+        c_string_append(declarations, shadow_function);
+
+    c_string_append(post, "vec4 final_color = vec4(0.0);\n");
+
+    if (model == RIG_LIGHTING_MODEL_NORMAL_MAP) {
+        c_string_append(post,
+                        "vec3 N = rig_source_sample7(cg_tex_coord7_in.st).rgb;\n"
+                        "N = normalize(2.0 * N - 1.0);\n");
+    } else
+        c_string_append(post, "vec3 N = normalize(normal);\n");
+
+    c_string_append(post, "vec3 E = normalize(eye_direction);\n");
+
+    for (i = 0; i < n_lights; i++) {
+        c_string_append(post, "{\n");
+
+        if (model == RIG_LIGHTING_MODEL_NORMAL_MAP) {
+            c_string_append_printf(post,
+                                   "  vec3 L = normalize(light%d_direction);\n",
+                                   i);
+        } else {
+            c_string_append_printf(post,
+                                   "  vec3 L = light%d_direction_norm;\n",
+                                   i);
+        }
+
+        c_string_append_printf(post,
+                               "  vec4 color = light%d_ambient%s *\n"
+                               "               cg_color_out;\n"
+                               "  float lambert = dot(N, L);\n"
+                               "  if (lambert > 0.0)\n"
+                               "  {\n"
+                               "    color += cg_color_out * light%d_diffuse%s *\n"
+                               "             lambert;\n"
+                               "    vec3 R = reflect(-L, N);\n"
+                               "    color += light%d_specular * %s *\n"
+                               "             pow(max(dot(R, E), 0.0), %s);\n"
+                               "  }\n"
+                               "  float attenuation =\n"
+                               "    mix(1.0, rig_light_spot(light%d_coords),\n"
+                               "        light%d_spot);\n",
+                               i, material ? " * material_ambient" : "",
+                               i, material ? " * material_diffuse" : "",
+                               i,
+                               material ? "material_specular" :
+                               "vec4(.6, .6, .6, 1.0)",
+                               material ? "material_shininess" : "2.",
+                               i, i);
+
+        if (receive_shadow) {
+            c_string_append_printf(post,
+                                   "  attenuation *=\n"
+                                   "    rig_light_shadow(light%d_coords,\n"
+                                   "                     light%d_shadow_tile);\n",
+                                   i, i);
+        }
+
+        c_string_append(post,
+                        "  final_color += attenuation * color;\n"
+                        "}\n");
+    }
+
+    c_string_append(post, "cg_color_out.rgb = final_color.rgb;\n");
+
+    snippet = cg_snippet_new(CG_SNIPPET_HOOK_FRAGMENT,
+                             declarations->str,
+                             post->str);
+
+    c_string_free(declarations, true);
+    c_string_free(post, true);
+
+    return snippet;
+}
+
+void
+rig_lighting_snippets_init(rig_lighting_snippets_t *snippets, int n_lights)
+{
+    int i;
+
+    c_return_if_fail(n_lights > 0 && n_lights <= RIG_MAX_LIGHTS);
+
+    snippets->n_lights = n_lights;
+
+    snippets->light_coords_vertex =
+        create_light_coords_vertex_snippet(n_lights);
+    snippets->normal_map_vertex = create_normal_map_vertex_snippet(n_lights);
+
+    for (i = 0; i < RIG_N_LIGHTING_MODELS; i++) {
+        snippets->fragment[i][0] =
+            create_fragment_snippet(n_lights, i, false);
+        snippets->fragment[i][1] =
+            create_fragment_snippet(n_lights, i, true);
+    }
+}
+
+void
+rig_lighting_snippets_destroy(rig_lighting_snippets_t *snippets)
+{
+    int i;
+
+    cg_object_unref(snippets->light_coords_vertex);
+    cg_object_unref(snippets->normal_map_vertex);
+
+    for (i = 0; i < RIG_N_LIGHTING_MODELS; i++) {
+        cg_object_unref(snippets->fragment[i][0]);
+        cg_object_unref(snippets->fragment[i][1]);
+    }
+
+    memset(snippets, 0, sizeof(*snippets));
+}
+
+int
+rig_lighting_get_uniform_location(cg_pipeline_t *pipeline,
+                                  int light_index,
+                                  const char *name)
+{
+    char uniform_name[64];
+
+    snprintf(uniform_name, sizeof(uniform_name),
+             "light%d_%s", light_index, name);
+
+    return cg_pipeline_get_uniform_location(pipeline, uniform_name);
+}
+
+void
+rig_lighting_get_shadow_tile(int n_lights, int light_index, float *tile)
+{
+    int side = 1;
+
+    c_return_if_fail(light_index >= 0 && light_index < n_lights);
+
+    /* The atlas is divided into a square grid with enough cells for
+     * all the lights */
+    while (side * side < n_lights)
+        side++;
+
+    tile[0] = (light_index % side) / (float)side;
+    tile[1] = (light_index / side) / (float)side;
+    tile[2] = 1.0f / side;
+    tile[3] = 1.0f / side;
+}
+
+void
+rig_lighting_set_shadow_tile_uniforms(cg_pipeline_t *pipeline, int n_lights)
+{
+    int i;
+
+    for (i = 0; i < n_lights; i++) {
+        float tile[4];
+        int location;
+
+        rig_lighting_get_shadow_tile(n_lights, i, tile);
+
+        location =
+            rig_lighting_get_uniform_location(pipeline, i, "shadow_tile");
+        cg_pipeline_set_uniform_float(pipeline, location, 4, 1, tile);
+    }
+}
+
+int
+rig_lighting_gather_lights(rig_ui_t *ui, rig_entity_t **lights)
+{
+    c_llist_t *l;
+    int n_lights = 0;
+
+    for (l = ui->lights; l; l = l->next) {
+        rig_entity_t *light = l->data;
+
+        if (!rig_entity_get_component(light, RIG_COMPONENT_TYPE_CAMERA))
+            continue;
+
+        if (n_lights == RIG_MAX_LIGHTS) {
+            c_warning("Ignoring lights beyond the maximum of %d",
+                      RIG_MAX_LIGHTS);
+            break;
+        }
+
+        lights[n_lights++] = light;
+    }
+
+    return n_lights;
+}
+
+void
+rig_lighting_set_shadow_camera(rig_entity_t *light,
+                               cg_framebuffer_t *fb,
+                               int n_lights,
+                               int light_index)
+{
+    rut_object_t *camera =
+        rig_entity_get_component(light, RIG_COMPONENT_TYPE_CAMERA);
+    int width = cg_framebuffer_get_width(fb);
+    int height = cg_framebuffer_get_height(fb);
+    float tile[4];
+
+    c_return_if_fail(camera != NULL);
+
+    rig_lighting_get_shadow_tile(n_lights, light_index, tile);
+
+    rut_camera_set_framebuffer(camera, fb);
+    rut_camera_set_viewport(camera,
+                            tile[0] * width, tile[1] * height,
+                            tile[2] * width, tile[3] * height);
+
+    rig_entity_set_camera_view_from_transform(light);
+}
+
+void
+rig_lighting_set_light_uniforms(cg_pipeline_t *pipeline,
+                                rig_light_t **lights,
+                                int n_lights)
+{
+    int i;
+
+    for (i = 0; i < n_lights; i++)
+        rig_light_set_uniforms(lights[i], pipeline, i);
+}
@@ -0,0 +1,108 @@
+/*
+ * Rig
+ *
+ * UI Engine & Editor
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RIG_LIGHTING_H__
+#define __RIG_LIGHTING_H__
+
+#include <cglib/cglib.h>
+
+#include "rig-ui.h"
+#include "rig-entity.h"
+#include "components/rig-light.h"
+
+/* The maximum number of lights that may affect a scene. Each light
+ * gets its own tile of the renderer's shadow map atlas. */
+#define RIG_MAX_LIGHTS 4
+
+typedef enum _rig_lighting_model_t {
+    /* No material uniforms; a fixed specular term */
+    RIG_LIGHTING_MODEL_SIMPLE,
+    /* Phong lighting with the material_* uniforms */
+    RIG_LIGHTING_MODEL_MATERIAL,
+    /* Phong lighting with normals sampled from layer 7 */
+    RIG_LIGHTING_MODEL_NORMAL_MAP,
+
+    RIG_N_LIGHTING_MODELS
+} rig_lighting_model_t;
+
+/* The lighting snippets for a particular number of lights. These
+ * are created once, upfront, so that all pipelines with the same
+ * number of lights use exactly the same snippets and can so share
+ * programs. */
+typedef struct _rig_lighting_snippets_t {
+    int n_lights;
+
+    /* Outputs each light's shadow map coordinates */
+    cg_snippet_t *light_coords_vertex;
+    /* Transforms each light's direction into tangent space */
+    cg_snippet_t *normal_map_vertex;
+
+    /* Indexed by [model][receive_shadow] */
+    cg_snippet_t *fragment[RIG_N_LIGHTING_MODELS][2];
+} rig_lighting_snippets_t;
+
+void rig_lighting_snippets_init(rig_lighting_snippets_t *snippets,
+                                int n_lights);
+
+void rig_lighting_snippets_destroy(rig_lighting_snippets_t *snippets);
+
+/* Gets the location of the given per-light uniform, which is named
+ * "light<index>_<name>" */
+int rig_lighting_get_uniform_location(cg_pipeline_t *pipeline,
+                                      int light_index,
+                                      const char *name);
+
+/* Gets the region of the shadow map atlas used by the given light, in
+ * normalized texture coordinates as { x, y, width, height } */
+void rig_lighting_get_shadow_tile(int n_lights, int light_index, float *tile);
+
+/* Sets up the light<index>_shadow_tile uniforms which only depend on
+ * the number of lights, so only need setting once per pipeline */
+void rig_lighting_set_shadow_tile_uniforms(cg_pipeline_t *pipeline,
+                                           int n_lights);
+
+/* Gathers up to RIG_MAX_LIGHTS of the UI's lights that will affect
+ * the scene into @lights and returns how many there are. Only lights
+ * with a camera component can be used, since the camera defines the
+ * frustum of the light's shadow map (and so the cone of a spot
+ * light). */
+int rig_lighting_gather_lights(rig_ui_t *ui, rig_entity_t **lights);
+
+/* Points the camera of the given light at its tile of the shadow map
+ * atlas @fb, viewed from the light's current transform */
+void rig_lighting_set_shadow_camera(rig_entity_t *light,
+                                    cg_framebuffer_t *fb,
+                                    int n_lights,
+                                    int light_index);
+
+/* Sets the light<index>_* uniforms for each of the given lights */
+void rig_lighting_set_light_uniforms(cg_pipeline_t *pipeline,
+                                     rig_light_t **lights,
+                                     int n_lights);
+
+#endif /* __RIG_LIGHTING_H__ */
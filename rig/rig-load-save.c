@@ -90,6 +90,9 @@ rig_save(rig_engine_t *engine, rig_ui_t *ui, const char *path)
 
     serializer = rig_pb_serializer_new(engine);
 
+    /* Store identical buffer contents (e.g. shared mesh data) once */
+    rig_pb_serializer_set_blobs_enabled(serializer, true);
+
     pb_ui = rig_pb_serialize_ui(serializer, ui);
 
     rig__ui__pack_to_buffer(pb_ui, &buffered_file.base);
@@ -101,18 +104,6 @@ rig_save(rig_engine_t *engine, rig_ui_t *ui, const char *path)
     fclose(fp);
 }
 
-static void
-ignore_free(void *allocator_data, void *ptr)
-{
-    /* NOP */
-}
-
-static void *
-stack_alloc(void *allocator_data, size_t size)
-{
-    return rut_memory_stack_alloc(allocator_data, size);
-}
-
 static void
 unserializer_unregister_object_cb(rig_ui_t *ui,
                                   uint64_t id,
@@ -161,24 +152,12 @@ rig_load(rig_engine_t *engine, const char *file)
     c_error_t *error = NULL;
     bool needs_munmap = false;
     rig_pb_unserializer_t *unserializer;
-    Rig__UI *pb_ui;
     rig_ui_t *ui;
 
     /* This hash table maps from uint64_t ids to objects while loading */
     c_hash_table_t *id_to_object_map = 
         c_hash_table_new(c_int64_hash, c_int64_equal);
 
-    /* We use a special allocator while unpacking protocol buffers
-     * that lets us use the frame_stack. This means much
-     * less mucking about with the heap since the frame_stack
-     * is a persistent, growable stack which we can just rewind
-     * very cheaply before unpacking */
-    ProtobufCAllocator protobuf_c_allocator = {
-        stack_alloc,        ignore_free, stack_alloc, /* tmp_alloc */
-        8192, /* max_alloca */
-        engine->frame_stack /* allocator_data */
-    };
-
     fd = open(file, O_CLOEXEC);
     if (fd > 0 && fstat(fd, &sb) == 0 &&
         (contents = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0))) {
@@ -190,17 +169,16 @@ rig_load(rig_engine_t *engine, const char *file)
         return NULL;
     }
 
-    pb_ui = rig__ui__unpack(&protobuf_c_allocator, len, contents);
-
     unserializer = rig_pb_unserializer_new(engine,
                                            unserializer_register_object_cb,
                                            unserializer_unregister_object_cb,
                                            unserializer_lookup_object_cb,
                                            id_to_object_map);
 
-    ui = rig_pb_unserialize_ui(unserializer, pb_ui);
-
-    rig__ui__free_unpacked(pb_ui, &protobuf_c_allocator);
+    /* We stream through the top-level messages of the mapped file
+     * instead of unpacking the whole Rig__UI up front so we never
+     * need memory for the complete protobuf tree */
+    ui = rig_pb_unserialize_ui_data(unserializer, contents, len);
 
     if (needs_munmap)
         munmap(contents, len);
@@ -425,55 +425,3 @@ rig_node_copy(rig_node_t *node)
 {
     return c_slice_dup(rig_node_t, node);
 }
-
-rig_node_t *
-rig_nodes_find_less_than(rig_node_t *start, c_list_t *end, float t)
-{
-    rig_node_t *node;
-
-    for (node = start; node != rut_container_of(end, node, list_node);
-         node = rut_container_of(node->list_node.prev, node, list_node))
-        if (node->t < t)
-            return node;
-
-    return NULL;
-}
-
-rig_node_t *
-rig_nodes_find_less_than_equal(rig_node_t *start, c_list_t *end, float t)
-{
-    rig_node_t *node;
-
-    for (node = start; node != rut_container_of(end, node, list_node);
-         node = rut_container_of(node->list_node.prev, node, list_node))
-        if (node->t <= t)
-            return node;
-
-    return NULL;
-}
-
-rig_node_t *
-rig_nodes_find_greater_than(rig_node_t *start, c_list_t *end, float t)
-{
-    rig_node_t *node;
-
-    for (node = start; node != rut_container_of(end, node, list_node);
-         node = rut_container_of(node->list_node.next, node, list_node))
-        if (node->t > t)
-            return node;
-
-    return NULL;
-}
-
-rig_node_t *
-rig_nodes_find_greater_than_equal(rig_node_t *start, c_list_t *end, float t)
-{
-    rig_node_t *node;
-
-    for (node = start; node != rut_container_of(end, node, list_node);
-         node = rut_container_of(node->list_node.prev, node, list_node))
-        if (node->t >= t)
-            return node;
-
-    return NULL;
-}
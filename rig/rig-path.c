@@ -38,12 +38,13 @@ static void
 _rig_path_free(void *object)
 {
     rig_path_t *path = object;
-    rig_node_t *node, *t;
+    int i;
 
     rut_closure_list_disconnect_all_FIXME(&path->operation_cb_list);
 
-    c_list_for_each_safe(node, t, &path->nodes, list_node)
-    rig_node_free(node);
+    for (i = 0; i < path->length; i++)
+        rig_node_free(rig_path_get_node(path, i));
+    c_array_free(path->nodes, true);
 
     c_slice_free(rig_path_t, path);
 }
@@ -66,8 +67,8 @@ rig_path_new(rig_engine_t *engine, rig_property_type_t type)
 
     path->type = type;
 
-    c_list_init(&path->nodes);
-    path->pos = NULL;
+    path->nodes = c_array_new(false, false, sizeof(rig_node_t *));
+    path->pos = -1;
     path->length = 0;
 
     c_list_init(&path->operation_cb_list);
@@ -79,18 +80,76 @@ rig_path_t *
 rig_path_copy(rig_path_t *old_path)
 {
     rig_path_t *new_path = rig_path_new(old_path->engine, old_path->type);
-    rig_node_t *node;
+    int i;
 
-    c_list_for_each(node, &old_path->nodes, list_node)
-    {
-        rig_node_t *new_node = rig_node_copy(node);
-        c_list_insert(new_path->nodes.prev, &new_node->list_node);
+    c_array_set_size(new_path->nodes, old_path->length);
+
+    for (i = 0; i < old_path->length; i++) {
+        rig_path_get_node(new_path, i) =
+            rig_node_copy(rig_path_get_node(old_path, i));
     }
     new_path->length = old_path->length;
 
     return new_path;
 }
 
+/* Returns the index of the first node with a time >= t, or
+ * path->length if there is none */
+static int
+find_lower_bound(rig_path_t *path, float t)
+{
+    int lo = 0, hi = path->length;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (rig_path_get_node(path, mid)->t < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Returns the index of the first node with a time > t, or
+ * path->length if there is none */
+static int
+find_upper_bound(rig_path_t *path, float t)
+{
+    int lo = 0, hi = path->length;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (rig_path_get_node(path, mid)->t <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Checks whether the node at index is the last with a time <= t */
+static bool
+is_last_at_or_before(rig_path_t *path, int index, float t)
+{
+    return (index >= 0 && index < path->length &&
+            rig_path_get_node(path, index)->t <= t &&
+            (index + 1 == path->length ||
+             rig_path_get_node(path, index + 1)->t > t));
+}
+
+/* Checks whether the node at index is the first with a time >= t */
+static bool
+is_first_at_or_after(rig_path_t *path, int index, float t)
+{
+    return (index >= 0 && index < path->length &&
+            rig_path_get_node(path, index)->t >= t &&
+            (index == 0 || rig_path_get_node(path, index - 1)->t < t));
+}
+
 /* Finds 1 point either side of the given t using the direction to resolve
  * which points to choose if t corresponds to a specific node.
  */
@@ -101,77 +160,62 @@ rig_path_find_control_points2(rig_path_t *path,
                               rig_node_t **n0,
                               rig_node_t **n1)
 {
-    rig_node_t *pos;
+    int pos = path->pos;
 
-    if (C_UNLIKELY(c_list_empty(&path->nodes)))
+    if (C_UNLIKELY(path->length == 0))
         return false;
 
-    if (C_UNLIKELY(path->pos == NULL))
-        path->pos = rut_container_of(path->nodes.next, path->pos, list_node);
-
-    pos = path->pos;
-
     /*
      * Note:
      *
      * A node with t exactly == t may only be considered as the first control
      * point moving in the current direction.
+     *
+     * For playback t usually stays within the current segment or moves
+     * to a neighbouring one so we check those before falling back to
+     * a binary search.
      */
 
     if (direction == RIG_PATH_DIRECTION_FORWARDS) {
-        if (pos->t > t) {
-            /* > --- T -------- Pos ---- */
-            rig_node_t *tmp =
-                rig_nodes_find_less_than_equal(pos, &path->nodes, t);
-            if (!tmp) {
-                *n0 = *n1 = path->pos =
-                                rut_container_of(path->nodes.next, path->pos, list_node);
-                return true;
-            }
-            pos = tmp;
-        } else {
-            /* > --- Pos -------- T ---- */
-            rig_node_t *tmp = rig_nodes_find_greater_than(pos, &path->nodes, t);
-            if (!tmp) {
-                *n0 = *n1 = path->pos =
-                                rut_container_of(path->nodes.prev, path->pos, list_node);
-                return true;
-            }
-            pos = rut_container_of(tmp->list_node.prev, pos, list_node);
+        if (!is_last_at_or_before(path, pos, t)) {
+            if (is_last_at_or_before(path, pos + 1, t))
+                pos++;
+            else
+                pos = find_upper_bound(path, t) - 1;
         }
 
-        *n0 = pos;
-        if (pos->list_node.next == &path->nodes)
-            *n1 = pos;
+        if (pos < 0) {
+            /* > --- T -------- First ---- */
+            *n0 = *n1 = rig_path_get_node(path, 0);
+            path->pos = 0;
+            return true;
+        }
+
+        *n0 = rig_path_get_node(path, pos);
+        if (pos + 1 == path->length)
+            *n1 = *n0;
         else
-            *n1 = rut_container_of(pos->list_node.next, *n1, list_node);
+            *n1 = rig_path_get_node(path, pos + 1);
     } else {
-        if (pos->t > t) {
-            /* < --- T -------- Pos ---- */
-            rig_node_t *tmp = rig_nodes_find_less_than(pos, &path->nodes, t);
-            if (!tmp) {
-                *n0 = *n1 = path->pos =
-                                rut_container_of(path->nodes.next, path->pos, list_node);
-                return true;
-            }
-            pos = rut_container_of(tmp->list_node.next, pos, list_node);
-        } else {
-            /* < --- Pos -------- T ---- */
-            rig_node_t *tmp =
-                rig_nodes_find_greater_than_equal(pos, &path->nodes, t);
-            if (!tmp) {
-                *n0 = *n1 = path->pos =
-                                rut_container_of(path->nodes.prev, path->pos, list_node);
-                return true;
-            }
-            pos = tmp;
+        if (!is_first_at_or_after(path, pos, t)) {
+            if (is_first_at_or_after(path, pos - 1, t))
+                pos--;
+            else
+                pos = find_lower_bound(path, t);
         }
 
-        *n0 = pos;
-        if (pos->list_node.prev == &path->nodes)
-            *n1 = pos;
+        if (pos == path->length) {
+            /* < --- Last -------- T ---- */
+            *n0 = *n1 = rig_path_get_node(path, path->length - 1);
+            path->pos = path->length - 1;
+            return true;
+        }
+
+        *n0 = rig_path_get_node(path, pos);
+        if (pos == 0)
+            *n1 = *n0;
         else
-            *n1 = rut_container_of(pos->list_node.prev, *n1, list_node);
+            *n1 = rig_path_get_node(path, pos - 1);
     }
 
     path->pos = pos;
@@ -224,11 +268,12 @@ void
 rig_path_print(rig_path_t *path)
 {
     rig_property_type_t type = path->type;
-    rig_node_t *node;
+    int i;
 
     c_debug("path=%p\n", path);
-    c_list_for_each(node, &path->nodes, list_node)
-    {
+    for (i = 0; i < path->length; i++) {
+        rig_node_t *node = rig_path_get_node(path, i);
+
         switch (type) {
         case RUT_PROPERTY_TYPE_FLOAT: {
             c_debug(" t = %f value = %f\n", node->t, node->boxed.d.float_val);
@@ -280,11 +325,10 @@ notify_node_modified(rig_path_t *path, rig_node_t *node)
 rig_node_t *
 rig_path_find_node(rig_path_t *path, float t)
 {
-    rig_node_t *node;
+    int index = find_lower_bound(path, t);
 
-    c_list_for_each(node, &path->nodes, list_node)
-    if (node->t == t)
-        return node;
+    if (index < path->length && rig_path_get_node(path, index)->t == t)
+        return rig_path_get_node(path, index);
 
     return NULL;
 }
@@ -292,40 +336,35 @@ rig_path_find_node(rig_path_t *path, float t)
 rig_node_t *
 rig_path_find_nearest(rig_path_t *path, float t)
 {
-    float min_dt = FLT_MAX;
-    rig_node_t *min_dt_node = NULL;
-    rig_node_t *node;
+    int index = find_lower_bound(path, t);
+    rig_node_t *before, *after;
 
-    c_list_for_each(node, &path->nodes, list_node)
-    {
-        float dt = fabs(node->t - t);
-        if (dt < min_dt) {
-            min_dt = dt;
-            min_dt_node = node;
-        } else
-            return min_dt_node;
-    }
+    if (path->length == 0)
+        return NULL;
+
+    if (index == 0)
+        return rig_path_get_node(path, 0);
+    if (index == path->length)
+        return rig_path_get_node(path, path->length - 1);
+
+    /* Prefer the earlier node if they are equally near */
+    before = rig_path_get_node(path, index - 1);
+    after = rig_path_get_node(path, index);
 
-    return min_dt_node;
-    ;
+    return fabs(after->t - t) < fabs(before->t - t) ? after : before;
 }
 
 static void
 insert_sorted_node(rig_path_t *path, rig_node_t *node)
 {
-    rig_node_t *insertion_point;
-
-    c_list_for_each(insertion_point, &path->nodes, list_node)
-    if (insertion_point->t >= node->t)
-        break;
-
-    /* If no node was found then insertion_point will be pointing to an
-     * imaginary node containing the list head which is what we want
-     * anyway */
+    int index = find_lower_bound(path, node->t);
 
-    c_list_insert(insertion_point->list_node.prev, &node->list_node);
+    c_array_insert_val(path->nodes, index, node);
 
     path->length++;
+
+    if (path->pos >= index)
+        path->pos++;
 }
 
 void
@@ -710,17 +749,28 @@ rig_path_remove(rig_path_t *path, float t)
 void
 rig_path_remove_node(rig_path_t *path, rig_node_t *node)
 {
+    int index;
+
     rut_closure_list_invoke(&path->operation_cb_list,
                             rig_path_operation_callback_t,
                             path,
                             RIG_PATH_OPERATION_REMOVED,
                             node);
-    c_list_remove(&node->list_node);
+
+    index = find_lower_bound(path, node->t);
+    while (index < path->length && rig_path_get_node(path, index) != node)
+        index++;
+
+    c_return_if_fail(index < path->length);
+
+    c_array_remove_index(path->nodes, index);
     rig_node_free(node);
     path->length--;
 
-    if (path->pos == node)
-        path->pos = NULL;
+    if (path->pos == index)
+        path->pos = -1;
+    else if (path->pos > index)
+        path->pos--;
 }
 
 rut_closure_t *
@@ -738,8 +788,8 @@ rut_path_foreach_node(rig_path_t *path,
                       rig_path_node_callback_t callback,
                       void *user_data)
 {
-    rig_node_t *node;
+    int i;
 
-    c_list_for_each(node, &path->nodes, list_node)
-    callback(node, user_data);
+    for (i = 0; i < path->length; i++)
+        callback(rig_path_get_node(path, i), user_data);
 }
@@ -40,12 +40,23 @@ struct _rig_path_t {
 
     rig_engine_t *engine;
     rig_property_type_t type;
-    c_list_t nodes;
+
+    /* Pointers to the nodes, sorted by time. The nodes themselves are
+     * allocated separately so node pointers remain valid while other
+     * nodes are inserted and removed. */
+    c_array_t *nodes;
     int length;
-    rig_node_t *pos;
+
+    /* The index of the node last found as a control point, so that
+     * playback can usually avoid a search, or -1 */
+    int pos;
+
     c_list_t operation_cb_list;
 };
 
+#define rig_path_get_node(path, index)                                  \
+    c_array_index((path)->nodes, rig_node_t *, (index))
+
 typedef enum {
     RIG_PATH_OPERATION_ADDED,
     RIG_PATH_OPERATION_REMOVED,
@@ -130,7 +130,6 @@ static Rig__Path *
 pb_path_new(rig_pb_serializer_t *serializer, rig_path_t *path)
 {
     Rig__Path *pb_path = rig_pb_new(serializer, Rig__Path, rig__path__init);
-    rig_node_t *node;
     int i;
 
     if (!path->length)
@@ -141,9 +140,8 @@ pb_path_new(rig_pb_serializer_t *serializer, rig_path_t *path)
                                                C_ALIGNOF(void *));
     pb_path->n_nodes = path->length;
 
-    i = 0;
-    c_list_for_each(node, &path->nodes, list_node)
-    {
+    for (i = 0; i < path->length; i++) {
+        rig_node_t *node = rig_path_get_node(path, i);
         Rig__Node *pb_node = rig_pb_new(serializer, Rig__Node, rig__node__init);
 
         pb_path->nodes[i] = pb_node;
@@ -209,8 +207,6 @@ pb_path_new(rig_pb_serializer_t *serializer, rig_path_t *path)
             c_warn_if_reached();
             break;
         }
-
-        i++;
     }
 
     return pb_path;
@@ -419,6 +415,61 @@ serialize_instrospectable_properties(rut_object_t *object,
         object, serialize_instrospectables_cb, serializer);
 }
 
+/* 64bit FNV-1a */
+uint64_t
+rig_pb_blob_hash(const uint8_t *data, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/* Returns the content hash of the buffer's data after making sure
+ * there is a corresponding blob, or 0 if the data should be stored
+ * inline because it collides with a different blob */
+static uint64_t
+serialize_buffer_blob(rig_pb_serializer_t *serializer,
+                      rut_buffer_t *buffer)
+{
+    uint64_t hash = rig_pb_blob_hash(buffer->data, buffer->size);
+    Rig__Blob *pb_blob;
+
+    if (!serializer->blobs)
+        serializer->blobs = c_hash_table_new(c_int64_hash, c_int64_equal);
+
+    pb_blob = c_hash_table_lookup(serializer->blobs, &hash);
+    if (pb_blob) {
+        if (pb_blob->has_data &&
+            (pb_blob->data.len != buffer->size ||
+             memcmp(pb_blob->data.data, buffer->data, buffer->size) != 0))
+            return 0;
+
+        return hash;
+    }
+
+    pb_blob = rig_pb_new(serializer, Rig__Blob, rig__blob__init);
+    pb_blob->hash = hash;
+
+    if (!serializer->blob_known_callback ||
+        !serializer->blob_known_callback(hash, serializer->blob_known_data))
+    {
+        pb_blob->has_data = true;
+        pb_blob->data.data = buffer->data;
+        pb_blob->data.len = buffer->size;
+    }
+
+    c_hash_table_insert(serializer->blobs, &pb_blob->hash, pb_blob);
+    serializer->pb_blobs = c_llist_prepend(serializer->pb_blobs, pb_blob);
+    serializer->n_pb_blobs++;
+
+    return hash;
+}
+
 Rig__Buffer *
 rig_pb_serialize_buffer(rig_pb_serializer_t *serializer,
                         rut_buffer_t *buffer,
@@ -432,6 +483,16 @@ rig_pb_serialize_buffer(rig_pb_serializer_t *serializer,
 
     pb_buffer->size = buffer->size;
 
+    if (include_data && serializer->blobs_enabled) {
+        uint64_t hash = serialize_buffer_blob(serializer, buffer);
+
+        if (hash) {
+            pb_buffer->has_data_hash = true;
+            pb_buffer->data_hash = hash;
+            return pb_buffer;
+        }
+    }
+
     if (include_data) {
         pb_buffer->has_data = true;
         pb_buffer->data.data = buffer->data;
@@ -1073,6 +1134,23 @@ rig_pb_serializer_set_use_pointer_ids_enabled(rig_pb_serializer_t *serializer,
     }
 }
 
+void
+rig_pb_serializer_set_blobs_enabled(rig_pb_serializer_t *serializer,
+                                    bool enabled)
+{
+    serializer->blobs_enabled = enabled;
+}
+
+void
+rig_pb_serializer_set_blob_known_callback(
+    rig_pb_serializer_t *serializer,
+    rig_pb_serializer_blob_known_callback_t callback,
+    void *user_data)
+{
+    serializer->blob_known_callback = callback;
+    serializer->blob_known_data = user_data;
+}
+
 void
 rig_pb_serializer_set_object_register_callback(
     rig_pb_serializer_t *serializer,
@@ -1099,6 +1177,10 @@ rig_pb_serializer_destroy(rig_pb_serializer_t *serializer)
     if (serializer->object_to_id_map)
         c_hash_table_destroy(serializer->object_to_id_map);
 
+    if (serializer->blobs)
+        c_hash_table_destroy(serializer->blobs);
+    c_llist_free(serializer->pb_blobs);
+
     c_slice_free(rig_pb_serializer_t, serializer);
 }
 
@@ -1213,6 +1295,20 @@ rig_pb_serialize_ui(rig_pb_serializer_t *serializer,
         pb_ui->dso.len = ui->dso_len;
     }
 
+    /* Blobs are collected from all the buffers serialized above,
+     * including those belonging to mesh components */
+    pb_ui->n_blobs = serializer->n_pb_blobs;
+    if (pb_ui->n_blobs) {
+        pb_ui->blobs =
+            rut_memory_stack_memalign(serializer->stack,
+                                      sizeof(void *) * pb_ui->n_blobs,
+                                      C_ALIGNOF(void *));
+
+        /* NB: pb_blobs is in reverse order */
+        for (i = pb_ui->n_blobs - 1, l = serializer->pb_blobs; l; i--, l = l->next)
+            pb_ui->blobs[i] = l->data;
+    }
+
     return pb_ui;
 }
 
@@ -2245,6 +2341,40 @@ rig_pb_unserialize_controller_bare(rig_pb_unserializer_t *unserializer,
     return controller;
 }
 
+static void
+unserialize_controller_bare(rig_pb_unserializer_t *unserializer,
+                            Rig__Controller *pb_controller)
+{
+    rig_controller_t *controller =
+        rig_pb_unserialize_controller_bare(unserializer, pb_controller);
+
+    if (controller)
+        unserializer->controllers =
+            c_llist_prepend(unserializer->controllers, controller);
+}
+
+static void
+unserialize_controller_properties(rig_pb_unserializer_t *unserializer,
+                                  Rig__Controller *pb_controller)
+{
+    rig_controller_t *controller;
+
+    if (!pb_controller->has_id)
+        return;
+
+    controller = unserializer_find_object(unserializer, pb_controller->id);
+    if (!controller) {
+        c_warn_if_reached();
+        return;
+    }
+
+    /* Properties controlled by the rig_controller_t... */
+    rig_pb_unserialize_controller_properties(unserializer,
+                                             controller,
+                                             pb_controller->n_properties,
+                                             pb_controller->properties);
+}
+
 static void
 unserialize_controllers(rig_pb_unserializer_t *unserializer,
                         int n_controllers,
@@ -2257,37 +2387,11 @@ unserialize_controllers(rig_pb_unserializer_t *unserializer,
      * to other controllers.
      */
 
-    for (i = 0; i < n_controllers; i++) {
-        Rig__Controller *pb_controller = controllers[i];
-        rig_controller_t *controller;
+    for (i = 0; i < n_controllers; i++)
+        unserialize_controller_bare(unserializer, controllers[i]);
 
-        controller =
-            rig_pb_unserialize_controller_bare(unserializer, pb_controller);
-
-        if (controller)
-            unserializer->controllers =
-                c_llist_prepend(unserializer->controllers, controller);
-    }
-
-    for (i = 0; i < n_controllers; i++) {
-        Rig__Controller *pb_controller = controllers[i];
-        rig_controller_t *controller;
-
-        if (!pb_controller->has_id)
-            continue;
-
-        controller = unserializer_find_object(unserializer, pb_controller->id);
-        if (!controller) {
-            c_warn_if_reached();
-            continue;
-        }
-
-        /* Properties controlled by the rig_controller_t... */
-        rig_pb_unserialize_controller_properties(unserializer,
-                                                 controller,
-                                                 pb_controller->n_properties,
-                                                 pb_controller->properties);
-    }
+    for (i = 0; i < n_controllers; i++)
+        unserialize_controller_properties(unserializer, controllers[i]);
 }
 
 rig_pb_unserializer_t *
@@ -2319,6 +2423,16 @@ rig_pb_unserializer_set_stack(rig_pb_unserializer_t *unserializer,
     unserializer->stack = stack;
 }
 
+void
+rig_pb_unserializer_set_blob_lookup_callback(
+    rig_pb_unserializer_t *unserializer,
+    rig_pb_unserializer_blob_lookup_callback_t callback,
+    void *user_data)
+{
+    unserializer->blob_lookup_callback = callback;
+    unserializer->blob_lookup_data = user_data;
+}
+
 void
 rig_pb_unserializer_set_object_register_callback(
     rig_pb_unserializer_t *unserializer,
@@ -2401,23 +2515,14 @@ rig_pb_unserializer_destroy(rig_pb_unserializer_t *unserializer)
     rig_pb_unserializer_clear_errors(unserializer);
 }
 
-rig_ui_t *
-rig_pb_unserialize_ui(rig_pb_unserializer_t *unserializer,
-                      const Rig__UI *pb_ui)
+/* Adds everything gathered while unserializing to a new rig_ui_t */
+static rig_ui_t *
+finish_unserialize_ui(rig_pb_unserializer_t *unserializer)
 {
     rig_ui_t *ui = rig_ui_new(unserializer->engine);
     rig_engine_t *engine = unserializer->engine;
     c_llist_t *l;
 
-    unserialize_buffers(unserializer, pb_ui->n_buffers, pb_ui->buffers);
-
-    unserialize_entities(unserializer, pb_ui->n_entities, pb_ui->entities);
-
-    unserialize_views(unserializer, pb_ui->n_views, pb_ui->views);
-
-    unserialize_controllers(unserializer, pb_ui->n_controllers,
-                            pb_ui->controllers);
-
     ui->scene = rig_entity_new(engine);
 
     int n_roots = 0;
@@ -2458,12 +2563,566 @@ rig_pb_unserialize_ui(rig_pb_unserializer_t *unserializer,
     c_llist_free(unserializer->buffers);
     unserializer->buffers = NULL;
 
+    return ui;
+}
+
+rig_ui_t *
+rig_pb_unserialize_ui(rig_pb_unserializer_t *unserializer,
+                      const Rig__UI *pb_ui)
+{
+    rig_ui_t *ui;
+
+    if (pb_ui->n_blobs) {
+        unserializer->blobs = c_hash_table_new(c_int64_hash, c_int64_equal);
+        for (int i = 0; i < pb_ui->n_blobs; i++) {
+            Rig__Blob *pb_blob = pb_ui->blobs[i];
+            c_hash_table_insert(unserializer->blobs, &pb_blob->hash, pb_blob);
+        }
+    }
+
+    unserialize_buffers(unserializer, pb_ui->n_buffers, pb_ui->buffers);
+
+    unserialize_entities(unserializer, pb_ui->n_entities, pb_ui->entities);
+
+    unserialize_views(unserializer, pb_ui->n_views, pb_ui->views);
+
+    unserialize_controllers(unserializer, pb_ui->n_controllers,
+                            pb_ui->controllers);
+
+    ui = finish_unserialize_ui(unserializer);
+
     if (pb_ui->has_dso)
         rig_ui_set_dso_data(ui, pb_ui->dso.data, pb_ui->dso.len);
 
+    /* The blobs belong to pb_ui */
+    if (unserializer->blobs) {
+        c_hash_table_destroy(unserializer->blobs);
+        unserializer->blobs = NULL;
+    }
+
+    return ui;
+}
+
+/* rig_pb_unserialize_ui_data() walks the top-level fields of a
+ * serialized Rig__UI directly so that only one entity, view,
+ * controller or buffer message needs to be unpacked at a time.
+ * Unpacking a whole Rig__UI first would otherwise need memory for the
+ * complete protobuf tree on top of the serialized data and the
+ * objects being created. */
+
+typedef void (*unserialize_message_func_t)(rig_pb_unserializer_t *unserializer,
+                                           void *message);
+
+static bool
+read_varint(const uint8_t **p, const uint8_t *end, uint64_t *value)
+{
+    uint64_t v = 0;
+    int shift;
+
+    for (shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = v;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Reads the tag of the next field at *p and skips over its value.
+ * The value is returned as a pointer into the serialized data; for
+ * length prefixed fields this excludes the length. */
+static bool
+read_field(const uint8_t **p,
+           const uint8_t *end,
+           unsigned *id,
+           ProtobufCWireType *wire_type,
+           const uint8_t **data,
+           size_t *len)
+{
+    uint64_t tag, value;
+
+    if (!read_varint(p, end, &tag) || (tag >> 3) == 0)
+        return false;
+
+    *id = tag >> 3;
+    *wire_type = tag & 7;
+    *data = *p;
+
+    switch (*wire_type) {
+    case PROTOBUF_C_WIRE_TYPE_VARINT:
+        if (!read_varint(p, end, &value))
+            return false;
+        break;
+    case PROTOBUF_C_WIRE_TYPE_64BIT:
+        if (end - *p < 8)
+            return false;
+        *p += 8;
+        break;
+    case PROTOBUF_C_WIRE_TYPE_32BIT:
+        if (end - *p < 4)
+            return false;
+        *p += 4;
+        break;
+    case PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED:
+        if (!read_varint(p, end, &value) || value > (uint64_t)(end - *p))
+            return false;
+        *data = *p;
+        *p += value;
+        break;
+    default:
+        /* Groups aren't used by rig.proto */
+        return false;
+    }
+
+    *len = *p - *data;
+
+    return true;
+}
+
+static unsigned
+field_id(const ProtobufCMessageDescriptor *descriptor, const char *name)
+{
+    const ProtobufCFieldDescriptor *field =
+        protobuf_c_message_descriptor_get_field_by_name(descriptor, name);
+
+    c_return_val_if_fail(field != NULL, 0);
+
+    return field->id;
+}
+
+/* Blobs are only referenced from the serialized data instead of being
+ * unpacked since they can be large and are only read while
+ * unserializing buffers. */
+static bool
+scan_blob(const uint8_t *data, size_t len, Rig__Blob *pb_blob)
+{
+    unsigned hash_id = field_id(&rig__blob__descriptor, "hash");
+    unsigned data_id = field_id(&rig__blob__descriptor, "data");
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+    bool has_hash = false;
+
+    rig__blob__init(pb_blob);
+
+    while (p < end) {
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            return false;
+
+        if (id == hash_id && wire_type == PROTOBUF_C_WIRE_TYPE_64BIT) {
+            pb_blob->hash = 0;
+            for (int i = 7; i >= 0; i--)
+                pb_blob->hash = (pb_blob->hash << 8) | value[i];
+            has_hash = true;
+        } else if (id == data_id &&
+                   wire_type == PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED) {
+            pb_blob->has_data = true;
+            pb_blob->data.data = (uint8_t *)value;
+            pb_blob->data.len = value_len;
+        }
+    }
+
+    return has_hash;
+}
+
+/* Validates the top-level fields of a serialized Rig__UI and indexes
+ * any blobs it contains. Returns false if anything is malformed,
+ * including any of the blobs. */
+static bool
+scan_ui(rig_pb_unserializer_t *unserializer,
+        const uint8_t *data,
+        size_t len,
+        Rig__Blob **pb_blobs_out)
+{
+    unsigned blobs_id = field_id(&rig__ui__descriptor, "blobs");
+    Rig__Blob *pb_blobs = NULL;
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+    int n_blobs = 0;
+    int i = 0;
+
+    while (p < end) {
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            return false;
+
+        if (id == blobs_id)
+            n_blobs++;
+    }
+
+    *pb_blobs_out = NULL;
+    if (!n_blobs)
+        return true;
+
+    pb_blobs = c_new(Rig__Blob, n_blobs);
+    unserializer->blobs = c_hash_table_new(c_int64_hash, c_int64_equal);
+
+    for (p = data; p < end; ) {
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            break;
+
+        if (id != blobs_id)
+            continue;
+
+        /* Buffers referring to a blob we couldn't read would silently
+         * lose their data so we fail the whole load instead */
+        if (wire_type != PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED ||
+            !scan_blob(value, value_len, &pb_blobs[i])) {
+            rig_pb_unserializer_collect_error(unserializer,
+                                              "Invalid blob in UI data");
+            c_hash_table_destroy(unserializer->blobs);
+            unserializer->blobs = NULL;
+            c_free(pb_blobs);
+            return false;
+        }
+
+        c_hash_table_insert(unserializer->blobs,
+                            &pb_blobs[i].hash, &pb_blobs[i]);
+        i++;
+    }
+
+    *pb_blobs_out = pb_blobs;
+
+    return true;
+}
+
+static void *
+scratch_alloc(void *allocator_data, size_t size)
+{
+    return rut_memory_stack_alloc(allocator_data, size);
+}
+
+static void
+scratch_free(void *allocator_data, void *ptr)
+{
+    /* NOP: the scratch stack is rewound after each message */
+}
+
+static void
+init_scratch_allocator(ProtobufCAllocator *allocator,
+                       rut_memory_stack_t *scratch)
+{
+    allocator->alloc = scratch_alloc;
+    allocator->free = scratch_free;
+    allocator->tmp_alloc = scratch_alloc;
+    allocator->max_alloca = 8192;
+    allocator->allocator_data = scratch;
+}
+
+/* Unpacks each top-level field of the serialized Rig__UI with the
+ * given name one at a time and passes it to @func. Every message is
+ * unpacked onto the @scratch stack which is rewound before the next
+ * one so the unserialize functions must copy anything they keep. */
+static void
+unserialize_each(rig_pb_unserializer_t *unserializer,
+                 const uint8_t *data,
+                 size_t len,
+                 const char *name,
+                 rut_memory_stack_t *scratch,
+                 unserialize_message_func_t func)
+{
+    const ProtobufCFieldDescriptor *field =
+        protobuf_c_message_descriptor_get_field_by_name(&rig__ui__descriptor,
+                                                        name);
+    ProtobufCAllocator allocator;
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+
+    c_return_if_fail(field != NULL);
+
+    init_scratch_allocator(&allocator, scratch);
+
+    while (p < end) {
+        ProtobufCMessage *message;
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            break;
+
+        if (id != field->id ||
+            wire_type != PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+            continue;
+
+        message = protobuf_c_message_unpack(field->descriptor,
+                                            &allocator,
+                                            value_len,
+                                            value);
+        if (!message) {
+            rig_pb_unserializer_collect_error(unserializer,
+                                              "Failed to unpack UI %s message",
+                                              name);
+            continue;
+        }
+
+        func(unserializer, message);
+
+        rut_memory_stack_rewind(scratch);
+    }
+}
+
+static void
+unserialize_buffer_message(rig_pb_unserializer_t *unserializer,
+                           void *message)
+{
+    Rig__Buffer *pb_buffer = message;
+
+    unserialize_buffers(unserializer, 1, &pb_buffer);
+}
+
+static void
+unserialize_entity_message(rig_pb_unserializer_t *unserializer,
+                           void *message)
+{
+    Rig__Entity *pb_entity = message;
+
+    unserialize_entities(unserializer, 1, &pb_entity);
+}
+
+static void
+unserialize_view_message(rig_pb_unserializer_t *unserializer,
+                         void *message)
+{
+    Rig__SimpleObject *pb_view = message;
+
+    unserialize_views(unserializer, 1, &pb_view);
+}
+
+static int64_t
+zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/* Only reads the fields of a serialized Rig__Controller that
+ * rig_pb_unserialize_controller_bare() needs, skipping the
+ * controlled properties and their paths which are only unpacked
+ * once all controllers have been registered. Anything allocated for
+ * @pb_controller comes from the @scratch stack. */
+static bool
+scan_controller_bare(const uint8_t *data,
+                     size_t len,
+                     rut_memory_stack_t *scratch,
+                     Rig__Controller *pb_controller)
+{
+    unsigned id_id = field_id(&rig__controller__descriptor, "id");
+    unsigned name_id = field_id(&rig__controller__descriptor, "name");
+    unsigned props_id =
+        field_id(&rig__controller__descriptor, "controller_properties");
+    ProtobufCAllocator allocator;
+    const uint8_t *p;
+    const uint8_t *end = data + len;
+    int n_props = 0;
+
+    rig__controller__init(pb_controller);
+    init_scratch_allocator(&allocator, scratch);
+
+    for (p = data; p < end; ) {
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            return false;
+
+        if (id == props_id)
+            n_props++;
+    }
+
+    if (n_props) {
+        pb_controller->controller_properties =
+            rut_memory_stack_memalign(scratch,
+                                      sizeof(void *) * n_props,
+                                      C_ALIGNOF(void *));
+    }
+
+    for (p = data; p < end; ) {
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+        uint64_t v;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            return false;
+
+        if (id == id_id && wire_type == PROTOBUF_C_WIRE_TYPE_VARINT) {
+            read_varint(&value, end, &v);
+            pb_controller->has_id = true;
+            pb_controller->id = zigzag_decode(v);
+        } else if (id == name_id &&
+                   wire_type == PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED) {
+            char *name = rut_memory_stack_alloc(scratch, value_len + 1);
+
+            memcpy(name, value, value_len);
+            name[value_len] = '\0';
+            pb_controller->name = name;
+        } else if (id == props_id &&
+                   wire_type == PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED) {
+            ProtobufCMessage *pb_boxed =
+                protobuf_c_message_unpack(&rig__boxed__descriptor,
+                                          &allocator,
+                                          value_len,
+                                          value);
+            if (!pb_boxed)
+                return false;
+
+            pb_controller->controller_properties
+                [pb_controller->n_controller_properties++] =
+                (Rig__Boxed *)pb_boxed;
+        }
+    }
+
+    return true;
+}
+
+/* Creates and registers all the controllers before any of their
+ * properties, which may refer to other controllers, are set up */
+static void
+unserialize_controllers_bare(rig_pb_unserializer_t *unserializer,
+                             const uint8_t *data,
+                             size_t len,
+                             rut_memory_stack_t *scratch)
+{
+    unsigned controllers_id = field_id(&rig__ui__descriptor, "controllers");
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+
+    while (p < end) {
+        Rig__Controller pb_controller;
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            break;
+
+        if (id != controllers_id ||
+            wire_type != PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+            continue;
+
+        if (scan_controller_bare(value, value_len, scratch, &pb_controller))
+            unserialize_controller_bare(unserializer, &pb_controller);
+        else {
+            rig_pb_unserializer_collect_error(unserializer,
+                                              "Failed to unpack UI "
+                                              "controllers message");
+        }
+
+        rut_memory_stack_rewind(scratch);
+    }
+}
+
+static void
+unserialize_controller_properties_message(rig_pb_unserializer_t *unserializer,
+                                          void *message)
+{
+    unserialize_controller_properties(unserializer, message);
+}
+
+rig_ui_t *
+rig_pb_unserialize_ui_data(rig_pb_unserializer_t *unserializer,
+                           const uint8_t *data,
+                           size_t len)
+{
+    unsigned dso_id = field_id(&rig__ui__descriptor, "dso");
+    rut_memory_stack_t *scratch;
+    Rig__Blob *pb_blobs;
+    const uint8_t *p;
+    const uint8_t *end = data + len;
+    rig_ui_t *ui;
+
+    if (!scan_ui(unserializer, data, len, &pb_blobs)) {
+        rig_pb_unserializer_collect_error(unserializer, "Malformed UI data");
+        return NULL;
+    }
+
+    scratch = rut_memory_stack_new(8192);
+
+    unserialize_each(unserializer, data, len, "buffers", scratch,
+                     unserialize_buffer_message);
+
+    unserialize_each(unserializer, data, len, "entities", scratch,
+                     unserialize_entity_message);
+
+    unserialize_each(unserializer, data, len, "views", scratch,
+                     unserialize_view_message);
+
+    /* Controllers are only fully unpacked once they have all been
+     * registered, since their properties may refer to other
+     * controllers */
+    unserialize_controllers_bare(unserializer, data, len, scratch);
+    unserialize_each(unserializer, data, len, "controllers", scratch,
+                     unserialize_controller_properties_message);
+
+    rut_memory_stack_free(scratch);
+
+    ui = finish_unserialize_ui(unserializer);
+
+    for (p = data; p < end; ) {
+        ProtobufCWireType wire_type;
+        const uint8_t *value;
+        size_t value_len;
+        unsigned id;
+
+        if (!read_field(&p, end, &id, &wire_type, &value, &value_len))
+            break;
+
+        if (id == dso_id && wire_type == PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+            rig_ui_set_dso_data(ui, (uint8_t *)value, value_len);
+    }
+
+    /* The blobs point into @data */
+    if (unserializer->blobs) {
+        c_hash_table_destroy(unserializer->blobs);
+        unserializer->blobs = NULL;
+    }
+    c_free(pb_blobs);
+
     return ui;
 }
 
+static const uint8_t *
+lookup_blob(rig_pb_unserializer_t *unserializer, uint64_t hash, size_t *len)
+{
+    Rig__Blob *pb_blob = NULL;
+
+    if (unserializer->blobs)
+        pb_blob = c_hash_table_lookup(unserializer->blobs, &hash);
+
+    if (pb_blob && pb_blob->has_data) {
+        *len = pb_blob->data.len;
+        return pb_blob->data.data;
+    }
+
+    if (unserializer->blob_lookup_callback)
+        return unserializer->blob_lookup_callback(hash, len,
+                                                  unserializer->blob_lookup_data);
+
+    return NULL;
+}
+
 rut_buffer_t *
 rig_pb_unserialize_buffer(rig_pb_unserializer_t *unserializer,
                           Rig__Buffer *pb_buffer)
@@ -2489,6 +3148,25 @@ rig_pb_unserialize_buffer(rig_pb_unserializer_t *unserializer,
             return NULL;
         }
         memcpy(buffer->data, pb_buffer->data.data, pb_buffer->data.len);
+    } else if (pb_buffer->has_data_hash) {
+        size_t len;
+        const uint8_t *data =
+            lookup_blob(unserializer, pb_buffer->data_hash, &len);
+
+        if (!data) {
+            rut_object_unref(buffer);
+            rig_pb_unserializer_collect_error(unserializer,
+                                              "Missing blob %016" PRIx64
+                                              " for buffer data",
+                                              pb_buffer->data_hash);
+            return NULL;
+        }
+        if (len != pb_buffer->size) {
+            rut_object_unref(buffer);
+            rig_pb_unserializer_collect_error(unserializer, "Blob len != buffer size");
+            return NULL;
+        }
+        memcpy(buffer->data, data, len);
     } else
         memset(buffer->data, 0, pb_buffer->size);
 
@@ -48,6 +48,11 @@ typedef uint64_t (*rig_pb_serializer_object_register_callback_t)(
 typedef uint64_t (*rig_pb_serializer_object_to_id_callback_t)(void *object,
                                                               void *user_data);
 
+/* Returns true if the receiver already has the blob with the given
+ * content hash so its data can be omitted */
+typedef bool (*rig_pb_serializer_blob_known_callback_t)(uint64_t hash,
+                                                        void *user_data);
+
 struct _rig_pb_serializer_t {
     rig_engine_t *engine;
 
@@ -73,6 +78,17 @@ struct _rig_pb_serializer_t {
 
     int next_id;
     c_hash_table_t *object_to_id_map;
+
+    /* If enabled then buffer data is stored once per unique content
+     * as a Rig__Blob referenced by its content hash. The blobs are
+     * gathered into Rig__UI::blobs by rig_pb_serialize_ui() */
+    bool blobs_enabled;
+    c_hash_table_t *blobs; /* hash -> Rig__Blob */
+    int n_pb_blobs;
+    c_llist_t *pb_blobs;
+
+    rig_pb_serializer_blob_known_callback_t blob_known_callback;
+    void *blob_known_data;
 };
 
 typedef void (*pb_message_init_func_t)(void *message);
@@ -117,6 +133,8 @@ _rig_pb_dup(rig_pb_serializer_t *serializer,
 
 const char *rig_pb_strdup(rig_pb_serializer_t *serializer, const char *string);
 
+uint64_t rig_pb_blob_hash(const uint8_t *data, size_t len);
+
 rig_pb_serializer_t *rig_pb_serializer_new(rig_engine_t *engine);
 
 void rig_pb_serializer_set_stack(rig_pb_serializer_t *serializer,
@@ -136,6 +154,14 @@ void rig_pb_serializer_set_object_to_id_callback(
     rig_pb_serializer_object_to_id_callback_t callback,
     void *user_data);
 
+void rig_pb_serializer_set_blobs_enabled(rig_pb_serializer_t *serializer,
+                                         bool enabled);
+
+void rig_pb_serializer_set_blob_known_callback(
+    rig_pb_serializer_t *serializer,
+    rig_pb_serializer_blob_known_callback_t callback,
+    void *user_data);
+
 uint64_t rig_pb_serializer_register_object(rig_pb_serializer_t *serializer,
                                            void *object);
 
@@ -202,6 +228,11 @@ typedef void *(*rig_pb_unserializer_id_to_object_callback_t)(rig_ui_t *ui,
                                                              uint64_t id,
                                                              void *user_data);
 
+/* Looks up the data for a blob that was omitted from a Rig__UI
+ * because the receiver was known to already have it */
+typedef const uint8_t *(*rig_pb_unserializer_blob_lookup_callback_t)(
+    uint64_t hash, size_t *len, void *user_data);
+
 struct _rig_pb_unserializer_t {
     rig_engine_t *engine;
 
@@ -222,6 +253,10 @@ struct _rig_pb_unserializer_t {
     c_llist_t *controllers;
     c_llist_t *buffers;
 
+    c_hash_table_t *blobs; /* hash -> Rig__Blob */
+    rig_pb_unserializer_blob_lookup_callback_t blob_lookup_callback;
+    void *blob_lookup_data;
+
     c_llist_t *errors;
 };
 
@@ -247,6 +282,11 @@ void rig_pb_unserializer_set_id_to_object_callback(
     rig_pb_unserializer_id_to_object_callback_t callback,
     void *user_data);
 
+void rig_pb_unserializer_set_blob_lookup_callback(
+    rig_pb_unserializer_t *unserializer,
+    rig_pb_unserializer_blob_lookup_callback_t callback,
+    void *user_data);
+
 void rig_pb_unserializer_collect_error(rig_pb_unserializer_t *unserializer,
                                        const char *format,
                                        ...);
@@ -263,6 +303,15 @@ void rig_pb_unserializer_destroy(rig_pb_unserializer_t *unserializer);
 rig_ui_t *rig_pb_unserialize_ui(rig_pb_unserializer_t *unserializer,
                                 const Rig__UI *pb_ui);
 
+/* Unserializes a UI directly from serialized Rig__UI data without
+ * unpacking the whole message first, so only one top-level entity,
+ * view, controller or buffer message is unpacked at a time. Blob data
+ * is read in place so @data only needs to stay valid for the duration
+ * of the call. Returns NULL if @data is malformed. */
+rig_ui_t *rig_pb_unserialize_ui_data(rig_pb_unserializer_t *unserializer,
+                                     const uint8_t *data,
+                                     size_t len);
+
 rut_buffer_t *
 rig_pb_unserialize_buffer(rig_pb_unserializer_t *unserializer,
                           Rig__Buffer *pb_buffer);
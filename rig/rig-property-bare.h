@@ -78,6 +78,18 @@ typedef struct _rig_property_context_t {
     int magic_marker;
     rut_memory_stack_t *change_log_stack;
     int log_len;
+
+    /* If non-NULL then repeated changes to the same property between
+     * two sequence points are coalesced into a single log entry that
+     * holds the latest value. Maps rig_property_t pointers to their
+     * rig_property_change_t in the change_log_stack. */
+    c_hash_table_t *log_index;
+
+    /* If non-NULL then binding callbacks aren't triggered synchronously
+     * when a dependency changes; instead the dependant properties are
+     * queued here until rig_property_context_flush_bindings() */
+    c_ptr_array_t *dirty_bindings;
+    c_ptr_array_t *binding_schedule;
 } rig_property_context_t;
 
 typedef struct _rig_property_t rig_property_t;
@@ -227,6 +239,10 @@ typedef struct _rig_property_binding_t {
     rut_binding_callback_t callback;
     rut_binding_destroy_notify_t destroy_notify;
     void *user_data;
+    /* The context this property was last queued or scheduled with
+     * while bindings are deferred, so it can be unqueued if the
+     * binding gets destroyed before being flushed */
+    rig_property_context_t *context;
     /* When the property this binding is for gets destroyed we need to
      * know the dependencies so we can remove this property from the
      * corresponding list of dependants for each dependency.
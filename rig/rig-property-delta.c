@@ -0,0 +1,450 @@
+/*
+ * Rig
+ *
+ * UI Engine & Editor
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <rig-config.h>
+
+#include <string.h>
+
+#include <clib.h>
+
+#include "rig-property-delta.h"
+
+/* The most 32 bit words needed to represent a numeric value */
+#define MAX_VALUE_WORDS 4
+
+/* The most bytes needed to encode a change, excluding text */
+#define MAX_CHANGE_BYTES (1 + 10 + 5 + 5 * MAX_VALUE_WORDS)
+
+typedef struct _value_slot_t {
+    rig_property_type_t type;
+    uint32_t words[MAX_VALUE_WORDS];
+} value_slot_t;
+
+/* The previous values of an object's properties, indexed by property
+ * id */
+typedef struct _object_state_t {
+    c_array_t *slots;
+} object_state_t;
+
+struct _rig_property_delta_t {
+    c_hash_table_t *objects;
+
+    /* Consecutive changes are very likely to be for the same object */
+    uint64_t last_object_id;
+    object_state_t *last_object;
+
+    /* The object id of the previous change in the current frame */
+    uint64_t prev_id;
+
+    rig_property_delta_object_to_id_callback_t object_to_id;
+    void *object_to_id_data;
+};
+
+static void
+free_object_state(void *data)
+{
+    object_state_t *state = data;
+
+    c_array_free(state->slots, true);
+    c_slice_free(object_state_t, state);
+}
+
+rig_property_delta_t *
+rig_property_delta_new(void)
+{
+    rig_property_delta_t *delta = c_slice_new0(rig_property_delta_t);
+
+    delta->objects = c_hash_table_new_full(c_int64_hash,
+                                           c_int64_equal,
+                                           c_free, /* key destroy */
+                                           free_object_state);
+
+    return delta;
+}
+
+void
+rig_property_delta_free(rig_property_delta_t *delta)
+{
+    c_hash_table_destroy(delta->objects);
+    c_slice_free(rig_property_delta_t, delta);
+}
+
+void
+rig_property_delta_reset(rig_property_delta_t *delta)
+{
+    c_hash_table_remove_all(delta->objects);
+
+    delta->last_object_id = 0;
+    delta->last_object = NULL;
+    delta->prev_id = 0;
+}
+
+void
+rig_property_delta_forget_object(rig_property_delta_t *delta,
+                                 uint64_t object_id)
+{
+    if (delta->last_object && delta->last_object_id == object_id) {
+        delta->last_object_id = 0;
+        delta->last_object = NULL;
+    }
+
+    c_hash_table_remove(delta->objects, &object_id);
+}
+
+void
+rig_property_delta_set_object_to_id_callback(
+    rig_property_delta_t *delta,
+    rig_property_delta_object_to_id_callback_t callback,
+    void *user_data)
+{
+    delta->object_to_id = callback;
+    delta->object_to_id_data = user_data;
+}
+
+void
+rig_property_delta_begin_frame(rig_property_delta_t *delta)
+{
+    delta->prev_id = 0;
+}
+
+static value_slot_t *
+lookup_slot(rig_property_delta_t *delta,
+            uint64_t object_id,
+            int prop_id,
+            rig_property_type_t type)
+{
+    object_state_t *state;
+    value_slot_t *slot;
+
+    if (delta->last_object && delta->last_object_id == object_id)
+        state = delta->last_object;
+    else {
+        state = c_hash_table_lookup(delta->objects, &object_id);
+        if (!state) {
+            uint64_t *key = c_new(uint64_t, 1);
+
+            *key = object_id;
+
+            state = c_slice_new(object_state_t);
+            state->slots = c_array_new(false, /* nul terminated */
+                                       true, /* clear */
+                                       sizeof(value_slot_t));
+            c_hash_table_insert(delta->objects, key, state);
+        }
+
+        delta->last_object_id = object_id;
+        delta->last_object = state;
+    }
+
+    if (prop_id >= state->slots->len)
+        c_array_set_size(state->slots, prop_id + 1);
+
+    slot = &c_array_index(state->slots, value_slot_t, prop_id);
+
+    /* Since ids may be reused for a different object we may find a
+     * previous value of a different type, which we can't use */
+    if (slot->type != type) {
+        slot->type = type;
+        memset(slot->words, 0, sizeof(slot->words));
+    }
+
+    return slot;
+}
+
+/* Returns the number of words the value of a numeric type is made of
+ * or 0 for other types */
+static int
+get_n_value_words(rig_property_type_t type)
+{
+    switch (type) {
+    case RUT_PROPERTY_TYPE_FLOAT:
+    case RUT_PROPERTY_TYPE_INTEGER:
+    case RUT_PROPERTY_TYPE_ENUM:
+    case RUT_PROPERTY_TYPE_UINT32:
+    case RUT_PROPERTY_TYPE_BOOLEAN:
+        return 1;
+    case RUT_PROPERTY_TYPE_DOUBLE:
+        return 2;
+    case RUT_PROPERTY_TYPE_VEC3:
+        return 3;
+    case RUT_PROPERTY_TYPE_VEC4:
+    case RUT_PROPERTY_TYPE_QUATERNION:
+    case RUT_PROPERTY_TYPE_COLOR:
+        return 4;
+    case RUT_PROPERTY_TYPE_TEXT:
+    case RUT_PROPERTY_TYPE_OBJECT:
+    case RUT_PROPERTY_TYPE_POINTER:
+    case RUT_PROPERTY_TYPE_CONTAINER:
+        return 0;
+    }
+
+    return 0;
+}
+
+static void
+value_to_words(const rut_boxed_t *value, uint32_t *words)
+{
+    switch (value->type) {
+    case RUT_PROPERTY_TYPE_BOOLEAN:
+        words[0] = value->d.boolean_val;
+        break;
+    case RUT_PROPERTY_TYPE_QUATERNION:
+        memcpy(words, &value->d.quaternion_val.w, sizeof(float) * 4);
+        break;
+    case RUT_PROPERTY_TYPE_COLOR:
+        memcpy(words, &value->d.color_val.red, sizeof(float) * 4);
+        break;
+    default:
+        memcpy(words, &value->d, get_n_value_words(value->type) * 4);
+        break;
+    }
+}
+
+static void
+words_to_value(const uint32_t *words, rut_boxed_t *value)
+{
+    switch (value->type) {
+    case RUT_PROPERTY_TYPE_BOOLEAN:
+        value->d.boolean_val = words[0];
+        break;
+    case RUT_PROPERTY_TYPE_QUATERNION:
+        memcpy(&value->d.quaternion_val.w, words, sizeof(float) * 4);
+        break;
+    case RUT_PROPERTY_TYPE_COLOR:
+        memcpy(&value->d.color_val.red, words, sizeof(float) * 4);
+        break;
+    default:
+        memcpy(&value->d, words, get_n_value_words(value->type) * 4);
+        break;
+    }
+}
+
+static uint8_t *
+write_varint(uint8_t *out, uint64_t value)
+{
+    while (value >= 0x80) {
+        *(out++) = value | 0x80;
+        value >>= 7;
+    }
+    *(out++) = value;
+
+    return out;
+}
+
+static bool
+read_varint(const uint8_t **data, const uint8_t *end, uint64_t *value)
+{
+    const uint8_t *pos = *data;
+    uint64_t ret = 0;
+    int shift;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        if (pos == end)
+            return false;
+
+        ret |= (uint64_t)(*pos & 0x7f) << shift;
+
+        if (!(*(pos++) & 0x80)) {
+            *data = pos;
+            *value = ret;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint64_t
+zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (value >> 63);
+}
+
+static int64_t
+zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+void
+rig_property_delta_encode(rig_property_delta_t *delta,
+                          c_byte_array_t *buf,
+                          uint64_t object_id,
+                          int prop_id,
+                          const rut_boxed_t *value)
+{
+    uint8_t change[MAX_CHANGE_BYTES];
+    uint8_t *pos = change;
+    int n_words = get_n_value_words(value->type);
+
+    *(pos++) = value->type;
+    pos = write_varint(pos, zigzag_encode(object_id - delta->prev_id));
+    pos = write_varint(pos, prop_id);
+
+    delta->prev_id = object_id;
+
+    if (n_words) {
+        value_slot_t *slot = lookup_slot(delta, object_id, prop_id,
+                                         value->type);
+        uint32_t words[MAX_VALUE_WORDS];
+        int i;
+
+        value_to_words(value, words);
+
+        for (i = 0; i < n_words; i++) {
+            pos = write_varint(pos, words[i] ^ slot->words[i]);
+            slot->words[i] = words[i];
+        }
+
+        c_byte_array_append(buf, change, pos - change);
+        return;
+    }
+
+    switch (value->type) {
+    case RUT_PROPERTY_TYPE_OBJECT: {
+        uint64_t id = 0;
+
+        if (value->d.object_val) {
+            id = delta->object_to_id(value->d.object_val,
+                                     delta->object_to_id_data);
+            c_warn_if_fail(id != 0);
+        }
+
+        pos = write_varint(pos, zigzag_encode(id));
+        c_byte_array_append(buf, change, pos - change);
+        break;
+    }
+    case RUT_PROPERTY_TYPE_TEXT: {
+        const char *text = value->d.text_val;
+        size_t len = text ? strlen(text) : 0;
+
+        /* 0 is reserved to represent a NULL string */
+        pos = write_varint(pos, text ? len + 1 : 0);
+        c_byte_array_append(buf, change, pos - change);
+        c_byte_array_append(buf, (const uint8_t *)text, len);
+        break;
+    }
+    default:
+        /* We never expect to serialize a pointer or container */
+        c_warn_if_reached();
+
+        /* Still write something so the change stays in sync with the
+         * property changes it is sequenced against */
+        *(pos++) = 0;
+        c_byte_array_append(buf, change, pos - change);
+        break;
+    }
+}
+
+bool
+rig_property_delta_decode(rig_property_delta_t *delta,
+                          const uint8_t **data,
+                          const uint8_t *end,
+                          rut_memory_stack_t *stack,
+                          uint64_t *object_id,
+                          int *prop_id,
+                          rut_boxed_t *value,
+                          uint64_t *value_object_id)
+{
+    const uint8_t *pos = *data;
+    uint64_t tmp;
+    int n_words;
+
+    if (pos == end)
+        return false;
+
+    value->type = *(pos++);
+
+    if (!read_varint(&pos, end, &tmp))
+        return false;
+    *object_id = delta->prev_id + zigzag_decode(tmp);
+    delta->prev_id = *object_id;
+
+    if (!read_varint(&pos, end, &tmp) || tmp > INT32_MAX)
+        return false;
+    *prop_id = tmp;
+
+    n_words = get_n_value_words(value->type);
+    if (n_words) {
+        value_slot_t *slot = lookup_slot(delta, *object_id, *prop_id,
+                                         value->type);
+        int i;
+
+        for (i = 0; i < n_words; i++) {
+            if (!read_varint(&pos, end, &tmp))
+                return false;
+            slot->words[i] ^= tmp;
+        }
+
+        words_to_value(slot->words, value);
+
+        *data = pos;
+        return true;
+    }
+
+    switch (value->type) {
+    case RUT_PROPERTY_TYPE_OBJECT:
+        if (!read_varint(&pos, end, &tmp))
+            return false;
+
+        *value_object_id = zigzag_decode(tmp);
+        value->d.object_val = NULL;
+        break;
+
+    case RUT_PROPERTY_TYPE_TEXT:
+        if (!read_varint(&pos, end, &tmp) || tmp > end - pos + 1)
+            return false;
+
+        if (tmp) {
+            size_t len = tmp - 1;
+            char *text = rut_memory_stack_alloc(stack, len + 1);
+
+            memcpy(text, pos, len);
+            text[len] = '\0';
+            pos += len;
+
+            value->d.text_val = text;
+        } else
+            value->d.text_val = NULL;
+        break;
+
+    case RUT_PROPERTY_TYPE_POINTER:
+    case RUT_PROPERTY_TYPE_CONTAINER:
+        if (pos == end)
+            return false;
+        pos++;
+        value->d.pointer_val = NULL;
+        break;
+
+    default:
+        return false;
+    }
+
+    *data = pos;
+    return true;
+}
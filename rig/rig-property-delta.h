@@ -0,0 +1,147 @@
+/*
+ * Rig
+ *
+ * UI Engine & Editor
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _RIG_PROPERTY_DELTA_H_
+#define _RIG_PROPERTY_DELTA_H_
+
+#include <rut.h>
+
+#include "rig-property.h"
+
+/*
+ * Animated UIs tend to change the same properties every frame by
+ * small amounts, so instead of sending a full Rig__PropertyChange for
+ * every change the simulator can pack them into a compact byte stream
+ * that the frontend decodes.
+ *
+ * Each change is written as the property type in one byte, the object
+ * id as a zigzag varint delta from the previous change's object id
+ * and the property id as a varint, followed by the value:
+ *
+ * Numeric values are split into 32 bit words that are XORed with the
+ * previous value sent for the same object property and written as
+ * varints, so unchanged words only cost one byte. Object values are
+ * written as zigzag varint ids and text as a length prefixed string.
+ *
+ * The encoder and decoder each keep a mirror of the previous values
+ * which must see exactly the same sequence of changes, so they always
+ * need to be reset together (see Rig__UIDiff.delta_reset).
+ */
+
+/* Bitmask of the encodings a frontend can decode, advertised via
+ * Rig__FrameSetup.ui_diff_encodings */
+typedef enum _rig_ui_diff_encoding_t {
+    RIG_UI_DIFF_ENCODING_DELTA = 1 << 0,
+    RIG_UI_DIFF_ENCODING_ZLIB = 1 << 1,
+} rig_ui_diff_encoding_t;
+
+/* Encoded property changes smaller than this aren't worth the cost
+ * of compressing */
+#define RIG_UI_DIFF_ZLIB_THRESHOLD 1024
+
+typedef struct _rig_property_delta_t rig_property_delta_t;
+
+typedef uint64_t (*rig_property_delta_object_to_id_callback_t)(void *object,
+                                                              void *user_data);
+
+rig_property_delta_t *rig_property_delta_new(void);
+
+void rig_property_delta_free(rig_property_delta_t *delta);
+
+/* Forgets all previous values */
+void rig_property_delta_reset(rig_property_delta_t *delta);
+
+/* Forgets the previous values of an object whose id has been
+ * unregistered so they don't accumulate. Both sides must forget an
+ * object before the next frame of changes is encoded or decoded. */
+void rig_property_delta_forget_object(rig_property_delta_t *delta,
+                                      uint64_t object_id);
+
+/* Used to map object property values to ids while encoding */
+void rig_property_delta_set_object_to_id_callback(
+    rig_property_delta_t *delta,
+    rig_property_delta_object_to_id_callback_t callback,
+    void *user_data);
+
+/* Object ids are delta encoded within a frame, so this must be called
+ * before encoding or decoding the first change of each frame */
+void rig_property_delta_begin_frame(rig_property_delta_t *delta);
+
+/**
+ * rig_property_delta_encode:
+ * @delta: The encoder state
+ * @buf: The array to append the encoded change to
+ * @object_id: The id of the object that changed
+ * @prop_id: The id of the property that changed
+ * @value: The new property value
+ *
+ * Appends an encoded property change to @buf and remembers @value
+ * as the previous value of the property.
+ */
+void rig_property_delta_encode(rig_property_delta_t *delta,
+                               c_byte_array_t *buf,
+                               uint64_t object_id,
+                               int prop_id,
+                               const rut_boxed_t *value);
+
+/**
+ * rig_property_delta_decode:
+ * @delta: The decoder state
+ * @data: The position to decode the next change from, which is
+ *        advanced past the change
+ * @end: The end of the encoded changes
+ * @stack: A stack to allocate text values from
+ * @object_id: Return location for the id of the changed object
+ * @prop_id: Return location for the id of the changed property
+ * @value: Return location for the new property value
+ * @value_object_id: Return location for the id of the new value of
+ *                   an object property, or 0 for %NULL
+ *
+ * Decodes the next property change encoded by
+ * rig_property_delta_encode().
+ *
+ * The value of an object property is only returned as an id, in
+ * @value_object_id, with @value's object_val left %NULL. The object
+ * may not be registered until an edit operation that is sequenced
+ * before the change has been applied, so the id should only be mapped
+ * to an object just before the change is applied.
+ *
+ * Returns: %false if the data was truncated or corrupt, in which case
+ *          the state can't be used to decode any more changes until
+ *          it has been reset.
+ */
+bool rig_property_delta_decode(rig_property_delta_t *delta,
+                               const uint8_t **data,
+                               const uint8_t *end,
+                               rut_memory_stack_t *stack,
+                               uint64_t *object_id,
+                               int *prop_id,
+                               rut_boxed_t *value,
+                               uint64_t *value_object_id);
+
+#endif /* _RIG_PROPERTY_DELTA_H_ */
@@ -40,12 +40,185 @@
 
 static int dummy_object;
 
+/* When bindings are deferred, rig_property_t::magic_marker tracks the
+ * state of each bound property while flushing the queued bindings */
+enum {
+    BINDING_STATE_IDLE,
+    BINDING_STATE_VISITING,
+    BINDING_STATE_SCHEDULED,
+    BINDING_STATE_UPDATED,
+};
+
 void
 rig_property_context_init(rig_property_context_t *context)
 {
     context->logging_disabled = 1;
     context->magic_marker = 0;
     context->change_log_stack = rut_memory_stack_new(4096);
+    context->log_len = 0;
+    context->log_index = NULL;
+    context->dirty_bindings = NULL;
+    context->binding_schedule = NULL;
+}
+
+void
+rig_property_context_set_log_coalescing(rig_property_context_t *context,
+                                        bool coalesce)
+{
+    if (coalesce) {
+        if (!context->log_index)
+            context->log_index = c_hash_table_new(NULL, /* direct hash */
+                                                  NULL); /* direct equal */
+    } else if (context->log_index) {
+        c_hash_table_destroy(context->log_index);
+        context->log_index = NULL;
+    }
+}
+
+int
+rig_property_context_log_sequence_point(rig_property_context_t *context)
+{
+    /* Changes logged before a sequence point must not be merged with
+     * changes logged afterwards since the frontend needs to see the
+     * values as they were at the point the corresponding operation
+     * was applied. */
+    if (context->log_index)
+        c_hash_table_remove_all(context->log_index);
+
+    return context->log_len;
+}
+
+/* Appends @property and (recursively) all bound properties that
+ * depend on it to the binding schedule in post-order, such that
+ * walking the schedule backwards gives a topological order */
+static void
+schedule_binding(rig_property_context_t *context, rig_property_t *property)
+{
+    c_sllist_t *l;
+
+    if (property->magic_marker == BINDING_STATE_VISITING) {
+        c_warning("Property binding cycle detected involving \"%s\" property",
+                  property->spec->name);
+        return;
+    }
+
+    if (property->magic_marker != BINDING_STATE_IDLE)
+        return;
+
+    property->magic_marker = BINDING_STATE_VISITING;
+    property->binding->context = context;
+
+    for (l = property->dependants; l; l = l->next) {
+        rig_property_t *dependant = l->data;
+
+        if (dependant->binding && dependant->object != &dummy_object)
+            schedule_binding(context, dependant);
+    }
+
+    property->magic_marker = BINDING_STATE_SCHEDULED;
+    c_ptr_array_add(context->binding_schedule, property);
+}
+
+/* Bindings that are dirtied again after being updated are re-queued
+ * and updated in another iteration of the flush. A real cycle would
+ * keep re-queueing forever so we give up after this many iterations. */
+#define MAX_BINDING_FLUSH_ITERATIONS 100
+
+static void
+reset_binding_schedule(rig_property_context_t *context)
+{
+    c_ptr_array_t *schedule = context->binding_schedule;
+    int i;
+
+    for (i = 0; i < schedule->len; i++) {
+        rig_property_t *property = c_ptr_array_index(schedule, i);
+        if (property)
+            property->magic_marker = BINDING_STATE_IDLE;
+    }
+    c_ptr_array_set_size(schedule, 0);
+}
+
+void
+rig_property_context_flush_bindings(rig_property_context_t *context)
+{
+    c_ptr_array_t *dirty = context->dirty_bindings;
+    c_ptr_array_t *schedule = context->binding_schedule;
+    int n_iterations = 0;
+    int i;
+
+    /* NB: the schedule is only non-empty while we are flushing */
+    if (!dirty || schedule->len)
+        return;
+
+    while (dirty->len) {
+        if (++n_iterations > MAX_BINDING_FLUSH_ITERATIONS) {
+            for (i = 0; i < dirty->len; i++) {
+                rig_property_t *property = c_ptr_array_index(dirty, i);
+
+                if (!property)
+                    continue;
+
+                c_warning("Property \"%s\" binding still dirty after %d "
+                          "updates; binding cycle detected",
+                          property->spec->name,
+                          MAX_BINDING_FLUSH_ITERATIONS);
+                property->queued_count = 0;
+            }
+            c_ptr_array_set_size(dirty, 0);
+            break;
+        }
+
+        for (i = 0; i < dirty->len; i++) {
+            rig_property_t *property = c_ptr_array_index(dirty, i);
+
+            /* NULL if the binding was destroyed while queued */
+            if (!property)
+                continue;
+
+            property->queued_count = 0;
+            schedule_binding(context, property);
+        }
+        c_ptr_array_set_size(dirty, 0);
+
+        /* Any properties that get dirtied by these updates which
+         * aren't still waiting to be updated in this iteration will
+         * be queued in dirty_bindings and updated again in the next
+         * iteration. */
+        for (i = schedule->len - 1; i >= 0; i--) {
+            rig_property_t *property = c_ptr_array_index(schedule, i);
+            rig_property_binding_t *binding;
+
+            if (!property)
+                continue;
+
+            property->magic_marker = BINDING_STATE_UPDATED;
+
+            binding = property->binding;
+            if (binding)
+                binding->callback(property, binding->user_data);
+        }
+
+        reset_binding_schedule(context);
+    }
+}
+
+void
+rig_property_context_set_deferred_bindings(rig_property_context_t *context,
+                                           bool defer)
+{
+    if (defer) {
+        if (!context->dirty_bindings) {
+            context->dirty_bindings = c_ptr_array_new();
+            context->binding_schedule = c_ptr_array_new();
+        }
+    } else if (context->dirty_bindings) {
+        rig_property_context_flush_bindings(context);
+
+        c_ptr_array_free(context->dirty_bindings, true);
+        context->dirty_bindings = NULL;
+        c_ptr_array_free(context->binding_schedule, true);
+        context->binding_schedule = NULL;
+    }
 }
 
 void
@@ -53,12 +226,34 @@ rig_property_context_clear_log(rig_property_context_t *context)
 {
     rut_memory_stack_rewind(context->change_log_stack);
     context->log_len = 0;
+
+    if (context->log_index)
+        c_hash_table_remove_all(context->log_index);
 }
 
 void
 rig_property_context_destroy(rig_property_context_t *context)
 {
     rut_memory_stack_free(context->change_log_stack);
+
+    if (context->log_index)
+        c_hash_table_destroy(context->log_index);
+
+    if (context->dirty_bindings) {
+        int i;
+
+        /* Make sure nothing still refers to the context once it's
+         * gone */
+        for (i = 0; i < context->dirty_bindings->len; i++) {
+            rig_property_t *property =
+                c_ptr_array_index(context->dirty_bindings, i);
+            if (property)
+                property->queued_count = 0;
+        }
+
+        c_ptr_array_free(context->dirty_bindings, true);
+        c_ptr_array_free(context->binding_schedule, true);
+    }
 }
 
 void
@@ -83,14 +278,37 @@ rig_property_init(rig_property_t *property,
     property->id = id;
 }
 
+static void
+remove_from_binding_queue(c_ptr_array_t *queue, rig_property_t *property)
+{
+    int i;
+
+    /* We can't remove entries while the queue may be being iterated
+     * so we leave a NULL in its place instead */
+    for (i = 0; i < queue->len; i++) {
+        if (c_ptr_array_index(queue, i) == property)
+            c_ptr_array_index(queue, i) = NULL;
+    }
+}
+
 static void
 _rig_property_destroy_binding(rig_property_t *property)
 {
     rig_property_binding_t *binding = property->binding;
 
     if (binding) {
+        rig_property_context_t *context = binding->context;
         int i;
 
+        if (property->queued_count) {
+            remove_from_binding_queue(context->dirty_bindings, property);
+            property->queued_count = 0;
+        }
+        if (property->magic_marker != BINDING_STATE_IDLE) {
+            remove_from_binding_queue(context->binding_schedule, property);
+            property->magic_marker = BINDING_STATE_IDLE;
+        }
+
         if (binding->destroy_notify)
             binding->destroy_notify(property, binding->user_data);
 
@@ -110,16 +328,21 @@ _rig_property_destroy_binding(rig_property_t *property)
 void
 rig_property_destroy(rig_property_t *property)
 {
-    c_sllist_t *l;
+    c_sllist_t *l, *next;
 
     _rig_property_destroy_binding(property);
 
     /* XXX: we don't really know if this property was a hard requirement
      * for the bindings associated with dependants so for now we assume
      * it was and we free all bindings associated with them...
+     *
+     * NB: destroying a dependant's binding removes it from our list of
+     * dependants.
      */
-    for (l = property->dependants; l; l = l->next) {
+    for (l = property->dependants; l; l = next) {
         rig_property_t *dependant = l->data;
+
+        next = l->next;
         _rig_property_destroy_binding(dependant);
     }
 }
@@ -233,6 +456,7 @@ _rig_property_set_binding_full_array(
     binding->callback = callback;
     binding->user_data = user_data;
     binding->destroy_notify = destroy_notify;
+    binding->context = NULL;
 
     memcpy(
         binding->dependencies, dependencies, sizeof(void *) * n_dependencies);
@@ -513,33 +737,51 @@ rig_property_dirty(rig_property_context_t *ctx, rig_property_t *property)
     {
         rut_object_t *object = property->object;
         if (object != &dummy_object) {
-            rig_property_change_t *change;
-
+            rig_property_change_t *change = NULL;
+
+            /* If we're coalescing changes then we simply update the
+             * value of any entry already logged for this property
+             * since the last sequence point. */
+            if (ctx->log_index)
+                change = c_hash_table_lookup(ctx->log_index, property);
+
+            if (change) {
+                rut_boxed_destroy(&change->boxed);
+                rig_property_box(property, &change->boxed);
+            } else {
 #if 0
-            c_debug(
-                "Log %d: base=%p, offset=%d: obj = %p(%s), prop id=%d(%s)\n",
-                ctx->log_len,
-                ctx->change_log_stack->sub_stack->data,
-                ctx->change_log_stack->sub_stack->offset,
-                object,
-                rut_object_get_type_name(object),
-                property->id,
-                property->spec->name);
+                c_debug(
+                    "Log %d: base=%p, offset=%d: obj = %p(%s), prop id=%d(%s)\n",
+                    ctx->log_len,
+                    ctx->change_log_stack->sub_stack->data,
+                    ctx->change_log_stack->sub_stack->offset,
+                    object,
+                    rut_object_get_type_name(object),
+                    property->id,
+                    property->spec->name);
 #endif
 
-            change = rut_memory_stack_alloc(ctx->change_log_stack,
-                                            sizeof(rig_property_change_t));
+                change = rut_memory_stack_alloc(ctx->change_log_stack,
+                                                sizeof(rig_property_change_t));
+
+                change->object = object;
+                change->prop_id = property->id;
+                rig_property_box(property, &change->boxed);
+                ctx->log_len++;
 
-            change->object = object;
-            change->prop_id = property->id;
-            rig_property_box(property, &change->boxed);
-            ctx->log_len++;
+                if (ctx->log_index)
+                    c_hash_table_insert(ctx->log_index, property, change);
+            }
         }
     }
 
-    /* FIXME: The plan is for updates to happen asynchronously by
-     * queueing an update with the context but for now we simply
-     * trigger the updates synchronously.
+    /* If bindings are deferred then we queue updates with the context
+     * to be flushed later via rig_property_context_flush_bindings(),
+     * otherwise we trigger the updates synchronously.
+     *
+     * Note: callbacks connected via rig_property_connect_callback()
+     * are notifications rather than bindings and are always triggered
+     * synchronously.
      */
     for (l = property->dependants; l; l = next) {
         rig_property_t *dependant = l->data;
@@ -547,7 +789,20 @@ rig_property_dirty(rig_property_context_t *ctx, rig_property_t *property)
 
         next = l->next;
 
-        if (binding)
+        if (!binding)
+            continue;
+
+        if (ctx->dirty_bindings && dependant->object != &dummy_object) {
+            /* If the binding has already been updated during a flush
+             * then it is queued to be updated again in the next
+             * iteration of the flush. */
+            if (dependant->magic_marker != BINDING_STATE_SCHEDULED &&
+                !dependant->queued_count) {
+                dependant->queued_count = 1;
+                binding->context = ctx;
+                c_ptr_array_add(ctx->dirty_bindings, dependant);
+            }
+        } else
             binding->callback(dependant, binding->user_data);
     }
 }
@@ -140,6 +140,62 @@ void rig_property_context_init(rig_property_context_t *context);
 
 void rig_property_context_clear_log(rig_property_context_t *context);
 
+/**
+ * rig_property_context_set_log_coalescing:
+ * @context: A property context
+ * @coalesce: Whether to coalesce logged changes
+ *
+ * Enables or disables coalescing of the property change log. When
+ * enabled, setting the same exported property multiple times between
+ * two sequence points only results in a single log entry (at the
+ * position of the first change) holding the most recent value.
+ */
+void rig_property_context_set_log_coalescing(rig_property_context_t *context,
+                                             bool coalesce);
+
+/**
+ * rig_property_context_log_sequence_point:
+ * @context: A property context
+ *
+ * Marks a point in the change log that something else (such as a UI
+ * operation) is sequenced against so that no changes logged before
+ * this point will be coalesced with changes logged afterwards.
+ *
+ * Returns: The current length of the change log
+ */
+int rig_property_context_log_sequence_point(rig_property_context_t *context);
+
+/**
+ * rig_property_context_set_deferred_bindings:
+ * @context: A property context
+ * @defer: Whether binding updates should be deferred
+ *
+ * Enables or disables deferred binding updates. When enabled,
+ * dirtying a property doesn't synchronously trigger the binding
+ * callbacks of its dependants; they are instead queued with the
+ * @context until rig_property_context_flush_bindings() is called.
+ *
+ * Disabling deferred bindings will flush any queued updates.
+ */
+void rig_property_context_set_deferred_bindings(rig_property_context_t *context,
+                                                bool defer);
+
+/**
+ * rig_property_context_flush_bindings:
+ * @context: A property context
+ *
+ * Updates all bindings queued while deferred bindings are enabled,
+ * along with any bindings that transitively depend on them. Bindings
+ * are updated in dependency order so that diamond shaped dependencies
+ * only update each binding once. A binding that is dirtied again
+ * after it was updated, such as by a binding callback that changes
+ * some other property, is updated again before the flush returns.
+ * Cycles are reported and broken.
+ *
+ * Bindings that are destroyed while queued are simply dropped.
+ */
+void rig_property_context_flush_bindings(rig_property_context_t *context);
+
 void rig_property_context_destroy(rig_property_context_t *context);
 
 void rig_property_destroy(rig_property_t *property);
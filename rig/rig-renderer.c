@@ -34,10 +34,13 @@
 /* XXX: this is actually in the rig/ directory and we need to
  * rename it... */
 #include "rut-renderer.h"
+#include "rut-volume.h"
+#include "rut-planes.h"
 
 #include "rig-engine.h"
 #include "rig-renderer.h"
 #include "rig-text-renderer.h"
+#include "rig-lighting.h"
 
 #include "components/rig-camera.h"
 #include "components/rig-light.h"
@@ -71,22 +74,47 @@ struct _rig_renderer_t {
     cg_snippet_t *alpha_mask_snippet;
     cg_snippet_t *alpha_mask_video_snippet;
     cg_snippet_t *lighting_vertex_snippet;
-    cg_snippet_t *normal_map_vertex_snippet;
-    cg_snippet_t *shadow_mapping_vertex_snippet;
     cg_snippet_t *blended_discard_snippet;
     cg_snippet_t *unblended_discard_snippet;
     cg_snippet_t *premultiply_snippet;
     cg_snippet_t *unpremultiply_snippet;
-    cg_snippet_t *normal_map_fragment_snippet;
     cg_snippet_t *normal_map_video_snippet;
-    cg_snippet_t *material_lighting_snippet;
-    cg_snippet_t *simple_lighting_snippet;
-    cg_snippet_t *shadow_mapping_fragment_snippet;
     cg_snippet_t *cache_position_snippet;
     cg_snippet_t *layer_skip_snippet;
 
+    /* Indexed by the number of lights - 1 */
+    rig_lighting_snippets_t lighting_snippets[RIG_MAX_LIGHTS];
+
+    /* The lights affecting the scene currently being painted, each
+     * with a tile of the shadow map atlas */
+    rig_entity_t *lights[RIG_MAX_LIGHTS];
+    int n_lights;
+
     c_array_t *journal;
 
+    /* The eye coordinate clip planes of the camera currently being
+     * painted, used to cull entities before logging them into the
+     * journal. */
+    rut_plane_t eye_planes[4];
+
+    /* Used to give pipelines and materials small ids for packing into
+     * journal sort keys */
+    c_hash_table_t *sort_ids;
+
+    /* Maps a pipeline_signature_t to the shared_pipeline_t used by
+     * all entities with that signature */
+    c_hash_table_t *shared_pipelines;
+
+    /* The light state last seen when flushing a journal. light_age is
+     * bumped whenever this changes. */
+    int n_flushed_lights;
+    rig_light_t *flushed_lights[RIG_MAX_LIGHTS];
+    int flushed_light_uniforms_ages[RIG_MAX_LIGHTS];
+    float flushed_light_directions[RIG_MAX_LIGHTS][3];
+    int light_age;
+
+    rig_renderer_pass_stats_t pass_stats[RIG_N_PASSES];
+
     rig_text_renderer_state_t *text_state;
 };
 
@@ -112,11 +140,61 @@ typedef enum _source_type_t {
     MAX_SOURCES,
 } source_type_t;
 
+/* Everything that affects how a pipeline is built. Entities with the
+ * same signature share a single pipeline and any per-entity state is
+ * set as uniforms while flushing the journal. */
+typedef struct _pipeline_signature_t {
+    cache_slot_t slot;
+    int n_lights;
+    bool receive_shadow;
+    bool unshaped;
+    rig_source_t *sources[MAX_SOURCES];
+} pipeline_signature_t;
+
+typedef struct _shared_pipeline_t {
+    pipeline_signature_t signature;
+    cg_pipeline_t *pipeline;
+    rig_renderer_t *renderer;
+    int ref_count;
+
+    /* false once removed from renderer->shared_pipelines, e.g. if one
+     * of its sources has been reloaded */
+    bool cached;
+} shared_pipeline_t;
+
 typedef struct _rig_journal_entry_t {
     rig_entity_t *entity;
     c_matrix_t matrix;
+
+    /* Resolved when flushing the journal */
+    cg_pipeline_t *pipeline;
+    uint64_t sort_key;
 } rig_journal_entry_t;
 
+/* Tracks the uniform state last flushed to a pipeline, attached as
+ * user data. NB: @material is only used for comparison; it's cleared
+ * whenever an entity stops using a shared pipeline so a stale pointer
+ * can't match a new material allocated at the same address. */
+typedef struct _pipeline_uniform_state_t {
+    int light_age;
+
+    rig_material_t *material;
+    int material_age;
+
+    c_matrix_t modelview;
+    bool has_normal_matrix;
+
+    c_matrix_t light_shadow_matrices[RIG_MAX_LIGHTS];
+    bool has_light_shadow_matrices;
+
+    float focal_distance;
+    float depth_of_field;
+    bool has_focal_parameters;
+
+    float alpha_threshold;
+    bool has_alpha_threshold;
+} pipeline_uniform_state_t;
+
 typedef enum _get_pipeline_flags_t {
     GET_PIPELINE_FLAG_N_FLAGS
 } get_pipeline_flags_t;
@@ -146,6 +224,10 @@ typedef enum _get_pipeline_flags_t {
  */
 #define OPAQUE_THRESHOLD 0.9999
 
+/* The width and height of the shadow map atlas which is divided
+ * between all of the scene's lights */
+#define SHADOW_ATLAS_SIZE 2048
+
 #define N_PIPELINE_CACHE_SLOTS 5
 #define N_PRIMITIVE_CACHE_SLOTS 1
 
@@ -154,15 +236,119 @@ typedef enum _get_pipeline_flags_t {
 typedef struct _rig_renderer_priv_t {
     rig_renderer_t *renderer;
 
-    cg_pipeline_t *pipeline_caches[N_PIPELINE_CACHE_SLOTS];
+    shared_pipeline_t *pipeline_caches[N_PIPELINE_CACHE_SLOTS];
     struct source_state source_caches[MAX_SOURCES];
     cg_primitive_t *primitive_caches[N_PRIMITIVE_CACHE_SLOTS];
 
     rut_closure_t preferred_size_closure;
 
     rut_closure_t geom_changed_closure;
+
+    /* A model space bounding volume for the entity's geometry, used
+     * for frustum culling. For meshes this is only re-measured after
+     * the primitive cache has been dirtied and for sizable geometry
+     * it's rebuilt whenever the size changes. */
+    rut_volume_t *volume;
+    float volume_bounds[6];
+    bool volume_valid;
 } rig_renderer_priv_t;
 
+static pipeline_uniform_state_t *
+get_pipeline_uniform_state(cg_pipeline_t *pipeline);
+
+static unsigned int
+pipeline_signature_hash(const void *key)
+{
+    const pipeline_signature_t *signature = key;
+    unsigned int hash = (signature->slot |
+                         signature->receive_shadow << 2 |
+                         signature->unshaped << 3);
+    int i;
+
+    for (i = 0; i < MAX_SOURCES; i++)
+        hash = hash * 31 + (unsigned int)((uintptr_t)signature->sources[i] >> 4);
+
+    return hash;
+}
+
+static bool
+pipeline_signature_equal(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(pipeline_signature_t)) == 0;
+}
+
+static bool
+uncache_shared_pipeline_cb(void *key, void *value, void *user_data)
+{
+    shared_pipeline_t *shared = value;
+    rig_source_t *source = user_data;
+    int i;
+
+    if (source) {
+        for (i = 0; i < MAX_SOURCES; i++)
+            if (shared->signature.sources[i] == source)
+                break;
+        if (i == MAX_SOURCES)
+            return false;
+    }
+
+    shared->cached = false;
+
+    return true;
+}
+
+static shared_pipeline_t *
+lookup_shared_pipeline(rig_renderer_t *renderer,
+                       const pipeline_signature_t *signature)
+{
+    shared_pipeline_t *shared =
+        c_hash_table_lookup(renderer->shared_pipelines, signature);
+
+    if (shared)
+        shared->ref_count++;
+
+    return shared;
+}
+
+/* Takes ownership of @pipeline */
+static shared_pipeline_t *
+add_shared_pipeline(rig_renderer_t *renderer,
+                    const pipeline_signature_t *signature,
+                    cg_pipeline_t *pipeline)
+{
+    shared_pipeline_t *shared = c_slice_new(shared_pipeline_t);
+
+    shared->signature = *signature;
+    shared->pipeline = pipeline;
+    shared->renderer = renderer;
+    shared->ref_count = 1;
+    shared->cached = true;
+
+    c_hash_table_insert(renderer->shared_pipelines, &shared->signature, shared);
+
+    return shared;
+}
+
+static void
+shared_pipeline_unref(shared_pipeline_t *shared)
+{
+    /* The next entity to use the pipeline may have a different
+     * material, which may even be allocated at the same address as
+     * the material we last flushed... */
+    get_pipeline_uniform_state(shared->pipeline)->material = NULL;
+
+    if (--shared->ref_count)
+        return;
+
+    if (shared->cached) {
+        c_hash_table_remove(shared->renderer->shared_pipelines,
+                            &shared->signature);
+    }
+
+    cg_object_unref(shared->pipeline);
+    c_slice_free(shared_pipeline_t, shared);
+}
+
 static void
 _rig_renderer_free(void *object)
 {
@@ -171,24 +357,30 @@ _rig_renderer_free(void *object)
     c_array_free(renderer->journal, true);
     renderer->journal = NULL;
 
+    c_hash_table_destroy(renderer->sort_ids);
+
+    c_hash_table_foreach_steal(renderer->shared_pipelines,
+                               uncache_shared_pipeline_cb,
+                               NULL);
+    c_hash_table_destroy(renderer->shared_pipelines);
+
     rig_text_renderer_state_destroy(renderer->text_state);
 
     rut_object_free(rig_renderer_t, object);
 }
 
+/* Takes ownership of the caller's reference on @shared */
 static void
 set_entity_pipeline_cache(rig_entity_t *entity,
                           int slot,
-                          cg_pipeline_t *pipeline)
+                          shared_pipeline_t *shared)
 {
     rig_renderer_priv_t *priv = entity->renderer_priv;
 
     if (priv->pipeline_caches[slot])
-        cg_object_unref(priv->pipeline_caches[slot]);
+        shared_pipeline_unref(priv->pipeline_caches[slot]);
 
-    priv->pipeline_caches[slot] = pipeline;
-    if (pipeline)
-        cg_object_ref(pipeline);
+    priv->pipeline_caches[slot] = shared;
 }
 
 static void
@@ -203,7 +395,9 @@ static cg_pipeline_t *
 get_entity_pipeline_cache(rig_entity_t *entity, int slot)
 {
     rig_renderer_priv_t *priv = entity->renderer_priv;
-    return priv->pipeline_caches[slot];
+    shared_pipeline_t *shared = priv->pipeline_caches[slot];
+
+    return shared ? shared->pipeline : NULL;
 }
 
 static void
@@ -226,6 +420,7 @@ static void
 source_ready_cb(rig_source_t *source, void *user_data)
 {
     rig_entity_t *entity = user_data;
+    rig_renderer_priv_t *priv = entity->renderer_priv;
     rig_source_t *color_src;
     rut_object_t *geometry;
     rig_material_t *material;
@@ -236,6 +431,12 @@ source_ready_cb(rig_source_t *source, void *user_data)
 
     dirty_entity_pipelines(entity);
 
+    /* Pipelines for this source were set up before it was ready so
+     * make sure other entities don't find them either */
+    c_hash_table_foreach_remove(priv->renderer->shared_pipelines,
+                                uncache_shared_pipeline_cb,
+                                source);
+
     if (material->color_source)
         color_src = get_entity_source_cache(entity, SOURCE_TYPE_COLOR);
     else
@@ -314,8 +515,12 @@ get_entity_primitive_cache(rig_entity_t *entity, int slot)
 static void
 dirty_entity_primitives(rig_entity_t *entity)
 {
+    rig_renderer_priv_t *priv = entity->renderer_priv;
+
     for (int i = 0; i < N_PRIMITIVE_CACHE_SLOTS; i++)
         set_entity_primitive_cache(entity, i, NULL);
+
+    priv->volume_valid = false;
 }
 
 static void
@@ -345,6 +550,9 @@ _rig_renderer_free_priv(rig_entity_t *entity)
 
     _rig_renderer_notify_entity_changed(entity);
 
+    if (priv->volume)
+        rut_volume_free(priv->volume);
+
     c_slice_free(rig_renderer_priv_t, priv);
     entity->renderer_priv = NULL;
 }
@@ -381,6 +589,9 @@ rig_renderer_new(rig_frontend_t *frontend)
     renderer->engine = frontend->engine;
 
     renderer->journal = c_array_new(false, false, sizeof(rig_journal_entry_t));
+    renderer->sort_ids = c_hash_table_new(NULL, NULL);
+    renderer->shared_pipelines = c_hash_table_new(pipeline_signature_hash,
+                                                  pipeline_signature_equal);
 
     renderer->text_state = rig_text_renderer_state_new(frontend);
 
@@ -403,23 +614,6 @@ rig_journal_log(c_array_t *journal,
     entry->matrix = *matrix;
 }
 
-static int
-sort_entry_cb(const rig_journal_entry_t *entry0,
-              const rig_journal_entry_t *entry1)
-{
-    float z0 = entry0->matrix.zw;
-    float z1 = entry1->matrix.zw;
-
-    /* TODO: also sort based on the state */
-
-    if (z0 < z1)
-        return -1;
-    else if (z0 > z1)
-        return 1;
-
-    return 0;
-}
-
 static void
 dirty_geometry_cb(rut_object_t *component, void *user_data)
 {
@@ -615,7 +809,8 @@ ensure_shadow_map(rig_renderer_t *renderer)
     c_warn_if_fail(renderer->shadow_fb == NULL);
 
     renderer->shadow_fb = cg_offscreen_new(engine->shell->cg_device,
-                                           1024, 1024);
+                                           SHADOW_ATLAS_SIZE,
+                                           SHADOW_ATLAS_SIZE);
 
     cg_framebuffer_set_depth_texture_enabled(renderer->shadow_fb, true);
 
@@ -647,6 +842,8 @@ free_shadow_map(rig_renderer_t *renderer)
 void
 rig_renderer_init(rig_renderer_t *renderer)
 {
+    int i;
+
     ensure_shadow_map(renderer);
 
     /* We always want to use exactly the same snippets when creating
@@ -676,45 +873,11 @@ rig_renderer_init(rig_renderer_t *renderer)
                        "eye_direction = -vec3(cg_modelview_matrix *\n"
                        "                      pos);\n");
 
-    renderer->normal_map_vertex_snippet =
-        cg_snippet_new(CG_SNIPPET_HOOK_VERTEX,
-                       /* definitions */
-                       "uniform vec3 light0_direction_norm;\n"
-                       "out vec3 light_direction;\n",
-
-                       /* post */
-                       "vec3 tangent = normalize(normal_matrix * tangent_in);\n"
-                       "vec3 binormal = cross(normal, tangent);\n"
-
-                       /* Transform the light direction into tangent space */
-                       "vec3 v;\n"
-                       "v.x = dot (light0_direction_norm, tangent);\n"
-                       "v.y = dot (light0_direction_norm, binormal);\n"
-                       "v.z = dot (light0_direction_norm, normal);\n"
-                       "light_direction = normalize (v);\n"
-
-                       /* Transform the eye direction into tangent space */
-                       "v.x = dot (eye_direction, tangent);\n"
-                       "v.y = dot (eye_direction, binormal);\n"
-                       "v.z = dot (eye_direction, normal);\n"
-                       "eye_direction = normalize (v);\n");
-
     renderer->cache_position_snippet =
         cg_snippet_new(CG_SNIPPET_HOOK_VERTEX_TRANSFORM,
                        "out vec4 pos;\n",
                        "pos = cg_position_in;\n");
 
-    renderer->shadow_mapping_vertex_snippet =
-        cg_snippet_new(CG_SNIPPET_HOOK_VERTEX,
-
-                       /* definitions */
-                       "uniform mat4 light_shadow_matrix;\n"
-                       "out vec4 shadow_coords;\n",
-
-                       /* post */
-                       "shadow_coords = light_shadow_matrix *\n"
-                       "                pos;\n");
-
     renderer->blended_discard_snippet = cg_snippet_new(
         CG_SNIPPET_HOOK_FRAGMENT,
         /* definitions */
@@ -759,114 +922,13 @@ rig_renderer_init(rig_renderer_t *renderer)
                         * load for example. */
                        "cg_color_out.rgb /= cg_color_out.a;\n");
 
-    renderer->normal_map_fragment_snippet = cg_snippet_new(
-        CG_SNIPPET_HOOK_FRAGMENT,
-        /* definitions */
-        "uniform vec4 light0_ambient, light0_diffuse, light0_specular;\n"
-        "uniform vec4 material_ambient, material_diffuse, material_specular;\n"
-        "uniform float material_shininess;\n"
-        "in vec3 light_direction, eye_direction;\n",
-
-        /* post */
-        "vec4 final_color;\n"
-        "vec3 L = normalize(light_direction);\n"
-        "vec3 N = rig_source_sample7(cg_tex_coord7_in.st).rgb;\n"
-        "N = 2.0 * N - 1.0;\n"
-        "N = normalize(N);\n"
-        "vec4 ambient = light0_ambient * material_ambient;\n"
-        "final_color = ambient * cg_color_out;\n"
-        "float lambert = dot(N, L);\n"
-        "if (lambert > 0.0)\n"
-        "{\n"
-        "  vec4 diffuse = light0_diffuse * material_diffuse;\n"
-        "  vec4 specular = light0_specular * material_specular;\n"
-        "  final_color += cg_color_out * diffuse * lambert;\n"
-        "  vec3 E = normalize(eye_direction);\n"
-        "  vec3 R = reflect (-L, N);\n"
-        "  float specular_factor = pow (max(dot(R, E), 0.0),\n"
-        "                               material_shininess);\n"
-        "  final_color += specular * specular_factor;\n"
-        "}\n"
-        "cg_color_out.rgb = final_color.rgb;\n");
-
-    renderer->material_lighting_snippet = cg_snippet_new(
-        CG_SNIPPET_HOOK_FRAGMENT,
-        /* definitions */
-        "/* material lighting declarations */\n"
-        "in vec3 normal, eye_direction;\n"
-        "uniform vec4 light0_ambient, light0_diffuse, light0_specular;\n"
-        "uniform vec3 light0_direction_norm;\n"
-        "uniform vec4 material_ambient, material_diffuse, material_specular;\n"
-        "uniform float material_shininess;\n",
-
-        /* post */
-        "vec4 final_color;\n"
-        "vec3 L = light0_direction_norm;\n"
-        "vec3 N = normalize(normal);\n"
-        "vec4 ambient = light0_ambient * material_ambient;\n"
-        "final_color = ambient * cg_color_out;\n"
-        "float lambert = dot(N, L);\n"
-        "if (lambert > 0.0)\n"
-        "{\n"
-        "  vec4 diffuse = light0_diffuse * material_diffuse;\n"
-        "  vec4 specular = light0_specular * material_specular;\n"
-        "  final_color += cg_color_out * diffuse * lambert;\n"
-        "  vec3 E = normalize(eye_direction);\n"
-        "  vec3 R = reflect (-L, N);\n"
-        "  float specular_factor = pow (max(dot(R, E), 0.0),\n"
-        "                               material_shininess);\n"
-        "  final_color += specular * specular_factor;\n"
-        "}\n"
-        "cg_color_out.rgb = final_color.rgb;\n");
-
-    renderer->simple_lighting_snippet = cg_snippet_new(
-        CG_SNIPPET_HOOK_FRAGMENT,
-        /* definitions */
-        "/* simple lighting declarations */\n"
-        "in vec3 normal, eye_direction;\n"
-        "uniform vec4 light0_ambient, light0_diffuse, light0_specular;\n"
-        "uniform vec3 light0_direction_norm;\n",
-
-        /* post */
-        "vec4 final_color;\n"
-        "vec3 L = light0_direction_norm;\n"
-        "vec3 N = normalize(normal);\n"
-        "final_color = light0_ambient * cg_color_out;\n"
-        "float lambert = dot(N, L);\n"
-        "if (lambert > 0.0)\n"
-        "{\n"
-        "  final_color += cg_color_out * light0_diffuse * lambert;\n"
-        "  vec3 E = normalize(eye_direction);\n"
-        "  vec3 R = reflect (-L, N);\n"
-        "  float specular = pow (max(dot(R, E), 0.0),\n"
-        "                        2.);\n"
-        "  final_color += light0_specular * vec4(.6, .6, .6, 1.0) *\n"
-        "                 specular;\n"
-        "}\n"
-        "cg_color_out.rgb = final_color.rgb;\n");
-
-    renderer->shadow_mapping_fragment_snippet =
-        cg_snippet_new(CG_SNIPPET_HOOK_FRAGMENT,
-                       /* declarations */
-                       "in vec4 shadow_coords;\n",
-                       /* post */
-                       "#if __VERSION__ >= 130\n"
-                       "  vec4 texel10 =\n"
-                       "    texture (cg_sampler10, shadow_coords.xy);\n"
-                       "#else\n"
-                       "  vec4 texel10 =\n"
-                       "    texture2D (cg_sampler10, shadow_coords.xy);\n"
-                       "#endif\n"
-                       "  float distance_from_light = texel10.r + 0.0005;\n"
-                       "  float shadow = 1.0;\n"
-                       "  if (distance_from_light < shadow_coords.z)\n"
-                       "    shadow = 0.5;\n"
-                       "  cg_color_out.rgb = shadow * cg_color_out.rgb;\n");
-
     renderer->layer_skip_snippet =
         cg_snippet_new(CG_SNIPPET_HOOK_LAYER_FRAGMENT, NULL, NULL);
     cg_snippet_set_replace(renderer->layer_skip_snippet, "");
 
+    for (i = 0; i < RIG_MAX_LIGHTS; i++)
+        rig_lighting_snippets_init(&renderer->lighting_snippets[i], i + 1);
+
     init_dof_pipeline_template(renderer);
 
     init_dof_unshaped_pipeline(renderer);
@@ -882,6 +944,8 @@ rig_renderer_init(rig_renderer_t *renderer)
 void
 rig_renderer_fini(rig_renderer_t *renderer)
 {
+    int i;
+
     rut_object_unref(renderer->composite_camera);
 
     cg_object_unref(renderer->dof_pipeline_template);
@@ -908,12 +972,6 @@ rig_renderer_fini(rig_renderer_t *renderer)
     cg_object_unref(renderer->lighting_vertex_snippet);
     renderer->lighting_vertex_snippet = NULL;
 
-    cg_object_unref(renderer->normal_map_vertex_snippet);
-    renderer->normal_map_vertex_snippet = NULL;
-
-    cg_object_unref(renderer->shadow_mapping_vertex_snippet);
-    renderer->shadow_mapping_vertex_snippet = NULL;
-
     cg_object_unref(renderer->blended_discard_snippet);
     renderer->blended_discard_snippet = NULL;
 
@@ -926,17 +984,8 @@ rig_renderer_fini(rig_renderer_t *renderer)
     cg_object_unref(renderer->unpremultiply_snippet);
     renderer->unpremultiply_snippet = NULL;
 
-    cg_object_unref(renderer->normal_map_fragment_snippet);
-    renderer->normal_map_fragment_snippet = NULL;
-
-    cg_object_unref(renderer->material_lighting_snippet);
-    renderer->material_lighting_snippet = NULL;
-
-    cg_object_unref(renderer->simple_lighting_snippet);
-    renderer->simple_lighting_snippet = NULL;
-
-    cg_object_unref(renderer->shadow_mapping_fragment_snippet);
-    renderer->shadow_mapping_fragment_snippet = NULL;
+    for (i = 0; i < RIG_MAX_LIGHTS; i++)
+        rig_lighting_snippets_destroy(&renderer->lighting_snippets[i]);
 
     cg_object_unref(renderer->cache_position_snippet);
     renderer->cache_position_snippet = NULL;
@@ -965,51 +1014,65 @@ get_entity_mask_pipeline(rig_renderer_t *renderer,
                          rut_object_t *geometry,
                          rig_material_t *material,
                          rig_source_t **sources,
-                         get_pipeline_flags_t flags)
+                         get_pipeline_flags_t flags,
+                         rig_pass_t pass)
 {
     cg_pipeline_t *pipeline;
+    pipeline_signature_t signature;
+    shared_pipeline_t *shared;
 
     pipeline = get_entity_pipeline_cache(entity, CACHE_SLOT_SHADOW);
 
     if (pipeline) {
-        if (sources[SOURCE_TYPE_ALPHA_MASK]) {
-            int location;
-
+        /* NB: the alpha threshold is per-entity so it's set while
+         * flushing the journal */
+        if (sources[SOURCE_TYPE_ALPHA_MASK])
             rig_source_attach_frame(sources[SOURCE_TYPE_ALPHA_MASK], pipeline);
 
-            location = cg_pipeline_get_uniform_location(
-                pipeline, "material_alpha_threshold");
-            cg_pipeline_set_uniform_1f(
-                pipeline, location, material->alpha_mask_threshold);
-        }
-
         return cg_object_ref(pipeline);
     }
 
-    if (rut_object_get_type(geometry) == &rig_nine_slice_type) {
-        pipeline = cg_pipeline_copy(renderer->dof_unshaped_pipeline);
+    memset(&signature, 0, sizeof(signature));
+    signature.slot = CACHE_SLOT_SHADOW;
+    signature.unshaped =
+        rut_object_get_type(geometry) == &rig_nine_slice_type;
 
-        if (material)
-            add_material_for_mask(pipeline, renderer, material, sources);
-    } else 
-        pipeline = cg_object_ref(renderer->dof_pipeline);
+    /* Only unshaped pipelines depend on the material's sources */
+    if (signature.unshaped && material) {
+        signature.sources[SOURCE_TYPE_COLOR] = sources[SOURCE_TYPE_COLOR];
+        signature.sources[SOURCE_TYPE_ALPHA_MASK] =
+            sources[SOURCE_TYPE_ALPHA_MASK];
+    }
 
-    set_entity_pipeline_cache(entity, CACHE_SLOT_SHADOW, pipeline);
+    shared = lookup_shared_pipeline(renderer, &signature);
+    if (!shared) {
+        if (signature.unshaped) {
+            pipeline = cg_pipeline_copy(renderer->dof_unshaped_pipeline);
 
-    return pipeline;
+            if (material)
+                add_material_for_mask(pipeline, renderer, material, sources);
+        } else
+            pipeline = cg_object_ref(renderer->dof_pipeline);
+
+        shared = add_shared_pipeline(renderer, &signature, pipeline);
+        renderer->pass_stats[pass].n_pipelines_created++;
+    }
+
+    set_entity_pipeline_cache(entity, CACHE_SLOT_SHADOW, shared);
+
+    return cg_object_ref(shared->pipeline);
 }
 
+/* Maps from world coordinates into the shadow map coordinates of the
+ * given light, where the light's frustum spans (0,0) to (1,1) */
 static void
-get_light_modelviewprojection(const c_matrix_t *model_transform,
-                              rig_entity_t *light,
-                              const c_matrix_t *light_projection,
-                              c_matrix_t *light_mvp)
+get_light_viewprojection(rig_entity_t *light, c_matrix_t *light_vp)
 {
+    rut_object_t *light_camera =
+        rig_entity_get_component(light, RIG_COMPONENT_TYPE_CAMERA);
     const c_matrix_t *light_transform;
     c_matrix_t light_view;
 
-    /* TODO: cache the bias * light_projection * light_view matrix! */
-
     /* Transform from NDC coords to texture coords (with 0,0)
      * top-left. (column major order) */
     float bias[16] = { .5f,  .0f, .0f, .0f,
@@ -1020,11 +1083,10 @@ get_light_modelviewprojection(const c_matrix_t *model_transform,
     light_transform = rig_entity_get_transform(light);
     c_matrix_get_inverse(light_transform, &light_view);
 
-    c_matrix_init_from_array(light_mvp, bias);
-    c_matrix_multiply(light_mvp, light_mvp, light_projection);
-    c_matrix_multiply(light_mvp, light_mvp, &light_view);
-
-    c_matrix_multiply(light_mvp, light_mvp, model_transform);
+    c_matrix_init_from_array(light_vp, bias);
+    c_matrix_multiply(light_vp, light_vp,
+                      rut_camera_get_projection(light_camera));
+    c_matrix_multiply(light_vp, light_vp, &light_view);
 }
 
 static cg_pipeline_t *
@@ -1037,29 +1099,42 @@ get_entity_color_pipeline(rig_renderer_t *renderer,
                           bool blended)
 {
     rig_engine_t *engine = renderer->engine;
+    cache_slot_t slot =
+        blended ? CACHE_SLOT_COLOR_BLENDED : CACHE_SLOT_COLOR_UNBLENDED;
     cg_depth_state_t depth_state;
     cg_pipeline_t *pipeline;
-    cg_framebuffer_t *shadow_fb;
+    pipeline_signature_t signature;
+    shared_pipeline_t *shared;
     cg_snippet_t *blend = renderer->blended_discard_snippet;
     cg_snippet_t *unblend = renderer->unblended_discard_snippet;
+    rig_lighting_snippets_t *lighting =
+        &renderer->lighting_snippets[renderer->n_lights - 1];
+    rig_lighting_model_t lighting_model;
+    bool receive_shadow = rig_material_get_receive_shadow(material);
+    rig_renderer_priv_t *priv = entity->renderer_priv;
     int i;
 
-    //return cg_pipeline_new(engine->shell->cg_device);
-
-    /* TODO: come up with a scheme for minimizing how many separate
-     * cg_pipeline_ts we create or at least deriving the pipelines
-     * from a small set of templates.
-     */
-
-    if (blended) {
-        pipeline = get_entity_pipeline_cache(entity, CACHE_SLOT_COLOR_BLENDED);
-    } else {
-        pipeline =
-            get_entity_pipeline_cache(entity, CACHE_SLOT_COLOR_UNBLENDED);
+    /* Color pipelines are specific to the number of lights */
+    shared = priv->pipeline_caches[slot];
+    if (shared && shared->signature.n_lights == renderer->n_lights) {
+        pipeline = cg_object_ref(shared->pipeline);
+        goto FOUND;
     }
 
-    if (pipeline) {
-        cg_object_ref(pipeline);
+    /* Pipelines are shared between all entities that would otherwise
+     * build identical pipelines so that the number of pipelines (and
+     * program states for cglib to hash and flush) scales with the
+     * number of distinct looks instead of the number of entities. */
+    memset(&signature, 0, sizeof(signature));
+    signature.slot = slot;
+    signature.n_lights = renderer->n_lights;
+    signature.receive_shadow = receive_shadow;
+    memcpy(signature.sources, sources, sizeof(signature.sources));
+
+    shared = lookup_shared_pipeline(renderer, &signature);
+    if (shared) {
+        set_entity_pipeline_cache(entity, slot, shared);
+        pipeline = cg_object_ref(shared->pipeline);
         goto FOUND;
     }
 
@@ -1090,11 +1165,11 @@ get_entity_color_pipeline(rig_renderer_t *renderer,
     cg_pipeline_add_snippet(pipeline, renderer->lighting_vertex_snippet);
 
     if (sources[SOURCE_TYPE_NORMAL_MAP])
-        cg_pipeline_add_snippet(pipeline, renderer->normal_map_vertex_snippet);
+        cg_pipeline_add_snippet(pipeline, lighting->normal_map_vertex);
 
-    if (rig_material_get_receive_shadow(material))
-        cg_pipeline_add_snippet(pipeline,
-                                renderer->shadow_mapping_vertex_snippet);
+    /* Even without shadows, the light coordinates are used to limit
+     * spot lights to their cone */
+    cg_pipeline_add_snippet(pipeline, lighting->light_coords_vertex);
 
     /* and fragment shader */
 
@@ -1115,15 +1190,13 @@ get_entity_color_pipeline(rig_renderer_t *renderer,
             cg_pipeline_add_snippet(pipeline, renderer->alpha_mask_snippet);
 
         if (sources[SOURCE_TYPE_NORMAL_MAP])
-            cg_pipeline_add_snippet(pipeline,
-                                    renderer->normal_map_fragment_snippet);
+            lighting_model = RIG_LIGHTING_MODEL_NORMAL_MAP;
         else
-            cg_pipeline_add_snippet(pipeline,
-                                    renderer->material_lighting_snippet);
+            lighting_model = RIG_LIGHTING_MODEL_MATERIAL;
     } else
-        cg_pipeline_add_snippet(pipeline, renderer->simple_lighting_snippet);
+        lighting_model = RIG_LIGHTING_MODEL_SIMPLE;
 
-    if (rig_material_get_receive_shadow(material)) {
+    if (receive_shadow) {
         /* Hook the shadow map sampling */
 
         cg_pipeline_set_layer_texture(pipeline, 10, renderer->shadow_map);
@@ -1132,53 +1205,30 @@ get_entity_color_pipeline(rig_renderer_t *renderer,
 
         cg_pipeline_add_layer_snippet(pipeline, 10, renderer->layer_skip_snippet);
 
-        /* Handle shadow mapping */
-        cg_pipeline_add_snippet(pipeline,
-                                renderer->shadow_mapping_fragment_snippet);
+        rig_lighting_set_shadow_tile_uniforms(pipeline, renderer->n_lights);
     }
 
+    /* Lighting and shadow mapping */
+    cg_pipeline_add_snippet(pipeline,
+                            lighting->fragment[lighting_model][receive_shadow]);
+
     cg_pipeline_add_snippet(pipeline, renderer->premultiply_snippet);
 
-    if (!blended) {
+    if (!blended)
         cg_pipeline_set_blend(pipeline, "RGBA = ADD (SRC_COLOR, 0)", NULL);
-        set_entity_pipeline_cache(entity, CACHE_SLOT_COLOR_UNBLENDED, pipeline);
-    } else
-        set_entity_pipeline_cache(entity, CACHE_SLOT_COLOR_BLENDED, pipeline);
-
-FOUND:
-
-    /* FIXME: there's lots to optimize about this! */
-    shadow_fb = renderer->shadow_fb;
-
-    /* update uniforms in pipelines */
-    {
-        c_matrix_t light_shadow_matrix, light_projection;
-        c_matrix_t model_transform;
-        const float *light_matrix;
-        int location;
-
-        cg_framebuffer_get_projection_matrix(shadow_fb, &light_projection);
-
-        /* TODO: use Cogl's MatrixStack api so we can update the entity
-         * model matrix incrementally as we traverse the scenegraph */
-        rut_graphable_get_transform(entity, &model_transform);
 
-        get_light_modelviewprojection(&model_transform,
-                                      engine->ui->light,
-                                      &light_projection,
-                                      &light_shadow_matrix);
+    shared = add_shared_pipeline(renderer, &signature, pipeline);
+    set_entity_pipeline_cache(entity, slot, shared);
+    renderer->pass_stats[blended ? RIG_PASS_COLOR_BLENDED :
+                         RIG_PASS_COLOR_UNBLENDED].n_pipelines_created++;
 
-        light_matrix = c_matrix_get_array(&light_shadow_matrix);
+    cg_object_ref(pipeline);
 
-        location =
-            cg_pipeline_get_uniform_location(pipeline, "light_shadow_matrix");
-        cg_pipeline_set_uniform_matrix(
-            pipeline, location, 4, 1, false, light_matrix);
+FOUND:
 
-        for (i = 0; i < 3; i++)
-            if (sources[i])
-                rig_source_attach_frame(sources[i], pipeline);
-    }
+    for (i = 0; i < 3; i++)
+        if (sources[i])
+            rig_source_attach_frame(sources[i], pipeline);
 
     return pipeline;
 }
@@ -1268,7 +1318,7 @@ get_entity_pipeline(rig_renderer_t *renderer,
                                          sources, flags, true);
     else if (pass == RIG_PASS_DOF_DEPTH || pass == RIG_PASS_SHADOW)
         return get_entity_mask_pipeline(renderer, entity, geometry, material,
-                                        sources, flags);
+                                        sources, flags, pass);
 
     c_warn_if_reached();
     return NULL;
@@ -1341,6 +1391,169 @@ get_entity_primitive(rig_renderer_t *renderer,
     return primitive;
 }
 
+/* Whether the entity's mask pipeline samples an alpha mask and so
+ * needs the material's alpha threshold */
+static bool
+mask_pipeline_has_alpha_mask(rig_entity_t *entity)
+{
+    rig_renderer_priv_t *priv = entity->renderer_priv;
+    shared_pipeline_t *shared = priv->pipeline_caches[CACHE_SLOT_SHADOW];
+
+    return shared && shared->signature.sources[SOURCE_TYPE_ALPHA_MASK];
+}
+
+static void
+pipeline_uniform_state_free_cb(void *user_data)
+{
+    c_slice_free(pipeline_uniform_state_t, user_data);
+}
+
+static pipeline_uniform_state_t *
+get_pipeline_uniform_state(cg_pipeline_t *pipeline)
+{
+    static cg_user_data_key_t uniform_state_key;
+    pipeline_uniform_state_t *state =
+        cg_object_get_user_data(CG_OBJECT(pipeline), &uniform_state_key);
+
+    if (state)
+        return state;
+
+    state = c_slice_new0(pipeline_uniform_state_t);
+    state->light_age = -1;
+
+    cg_object_set_user_data(CG_OBJECT(pipeline),
+                            &uniform_state_key,
+                            state,
+                            pipeline_uniform_state_free_cb);
+
+    return state;
+}
+
+/* Checks whether any of the scene's lights have changed since the
+ * last flush, and if so bumps renderer->light_age so that the light
+ * uniforms of each pipeline will be re-flushed the next time it is
+ * drawn. */
+static void
+update_light_age(rig_renderer_t *renderer)
+{
+    bool changed = renderer->n_lights != renderer->n_flushed_lights;
+    int i;
+
+    for (i = 0; i < renderer->n_lights; i++) {
+        rig_entity_t *light_entity = renderer->lights[i];
+        rig_light_t *light =
+            rig_entity_get_component(light_entity, RIG_COMPONENT_TYPE_LIGHT);
+        float origin[3] = { 0, 0, 0 };
+        float direction[3] = { 0, 0, 1 };
+
+        rig_entity_get_transformed_position(light_entity, origin);
+        rig_entity_get_transformed_position(light_entity, direction);
+        c_vector3_subtract(direction, direction, origin);
+
+        if (light != renderer->flushed_lights[i] ||
+            light->uniforms_age != renderer->flushed_light_uniforms_ages[i] ||
+            memcmp(direction, renderer->flushed_light_directions[i],
+                   sizeof(direction)) != 0) {
+            renderer->flushed_lights[i] = light;
+            renderer->flushed_light_uniforms_ages[i] = light->uniforms_age;
+            memcpy(renderer->flushed_light_directions[i], direction,
+                   sizeof(direction));
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        renderer->n_flushed_lights = renderer->n_lights;
+        renderer->light_age++;
+    }
+}
+
+static uint32_t
+get_sort_id(c_hash_table_t *ids, void *object)
+{
+    uint32_t id = C_POINTER_TO_UINT(c_hash_table_lookup(ids, object));
+
+    if (!id) {
+        id = c_hash_table_size(ids) + 1;
+        c_hash_table_insert(ids, object, C_UINT_TO_POINTER(id));
+    }
+
+    return id;
+}
+
+/* Maps a float to an unsigned integer with the same ordering */
+static uint32_t
+get_sortable_float_bits(float value)
+{
+    union {
+        float f;
+        uint32_t u;
+    } bits;
+
+    bits.f = value;
+
+    if (bits.u & 0x80000000)
+        return ~bits.u;
+    else
+        return bits.u | 0x80000000;
+}
+
+/* The sort key packs the pass, pipeline and material identities and
+ * a depth bucket so that a plain ascending sort of the journal will
+ * give us the order we want to draw in...
+ *
+ * For opaque passes we group primitives by state to minimize pipeline
+ * switches and uniform changes, and within a group we draw
+ * front-to-back (using a coarse depth bucket) so we are more likely to
+ * be able to discard later fragments earlier by depth testing.
+ *
+ * We draw transparent geometry strictly back-to-front so it blends
+ * correctly and only use the state as a tie breaker.
+ */
+static uint64_t
+get_journal_sort_key(rig_renderer_t *renderer,
+                     rig_pass_t pass,
+                     rig_journal_entry_t *entry,
+                     rig_material_t *material)
+{
+    uint64_t pipeline_id = 0;
+    uint64_t material_id = 0;
+    float z = entry->matrix.zw;
+
+    if (entry->pipeline)
+        pipeline_id = get_sort_id(renderer->sort_ids, entry->pipeline);
+    if (material)
+        material_id = get_sort_id(renderer->sort_ids, material);
+
+    if (pass == RIG_PASS_COLOR_BLENDED) {
+        /* NB: in eye coordinates the camera looks down the negative z
+         * axis so the furthest primitives have the lowest z */
+        return ((uint64_t)pass << 61 |
+                (uint64_t)get_sortable_float_bits(z) << 29 |
+                (pipeline_id & 0xffff) << 13 |
+                (material_id & 0x1fff));
+    } else {
+        uint64_t depth_bucket = get_sortable_float_bits(-z) >> 16;
+
+        return ((uint64_t)pass << 61 |
+                (pipeline_id & 0xffffff) << 37 |
+                (material_id & 0x1fffff) << 16 |
+                depth_bucket);
+    }
+}
+
+static int
+sort_entry_cb(const rig_journal_entry_t *entry0,
+              const rig_journal_entry_t *entry1)
+{
+    if (entry0->sort_key < entry1->sort_key)
+        return -1;
+    else if (entry0->sort_key > entry1->sort_key)
+        return 1;
+
+    return 0;
+}
+
 static void
 rig_renderer_flush_journal(rig_renderer_t *renderer,
                            rig_paint_context_t *paint_ctx)
@@ -1348,100 +1561,191 @@ rig_renderer_flush_journal(rig_renderer_t *renderer,
     c_array_t *journal = renderer->journal;
     rut_object_t *camera = paint_ctx->camera;
     cg_framebuffer_t *fb = rut_camera_get_framebuffer(camera);
-    rig_engine_t *engine = paint_ctx->engine;
-    int start, dir, end;
-    int i;
+    rig_pass_t pass = paint_ctx->pass;
+    rig_renderer_pass_stats_t *stats = &renderer->pass_stats[pass];
+    c_matrix_t light_vps[RIG_MAX_LIGHTS];
+    cg_pipeline_t *last_pipeline = NULL;
+    float focal_distance = 0;
+    float depth_of_field = 0;
+    int i, j;
+
+    if (pass == RIG_PASS_DOF_DEPTH || pass == RIG_PASS_SHADOW) {
+        focal_distance = rut_camera_get_focal_distance(camera);
+        depth_of_field = rut_camera_get_depth_of_field(camera);
+    } else {
+        update_light_age(renderer);
 
-    /* TODO: use an inline qsort implementation */
-    c_array_sort(journal, (void *)sort_entry_cb);
+        for (i = 0; i < renderer->n_lights; i++)
+            get_light_viewprojection(renderer->lights[i], &light_vps[i]);
+    }
 
-    /* We draw opaque geometry front-to-back so we are more likely to be
-     * able to discard later fragments earlier by depth testing.
-     *
-     * We draw transparent geometry back-to-front so it blends
-     * correctly.
-     */
-    if (paint_ctx->pass == RIG_PASS_COLOR_BLENDED) {
-        start = 0;
-        dir = 1;
-        end = journal->len;
-    } else {
-        start = journal->len - 1;
-        dir = -1;
-        end = -1;
+    /* Resolve the pipeline for each entry up front so that we can
+     * sort by state... */
+    for (i = 0; i < journal->len; i++) {
+        rig_journal_entry_t *entry =
+            &c_array_index(journal, rig_journal_entry_t, i);
+        rig_entity_t *entity = entry->entity;
+        rut_object_t *geometry =
+            rig_entity_get_component(entity, RIG_COMPONENT_TYPE_GEOMETRY);
+        rig_material_t *material =
+            rig_entity_get_component(entity, RIG_COMPONENT_TYPE_MATERIAL);
+
+        if ((rut_object_get_type(geometry) == &rig_text_type &&
+             pass == RIG_PASS_COLOR_BLENDED) ||
+            !rut_object_is(geometry, RUT_TRAIT_ID_PRIMABLE))
+            entry->pipeline = NULL;
+        else
+            entry->pipeline =
+                get_entity_pipeline(renderer, entity, geometry, pass);
+
+        entry->sort_key =
+            get_journal_sort_key(renderer, pass, entry, material);
     }
 
+    c_hash_table_remove_all(renderer->sort_ids);
+
+    /* TODO: use an inline qsort implementation */
+    c_array_sort(journal, (void *)sort_entry_cb);
+
     cg_framebuffer_push_matrix(fb);
 
-    for (i = start; i != end; i += dir) {
+    for (i = 0; i < journal->len; i++) {
         rig_journal_entry_t *entry =
             &c_array_index(journal, rig_journal_entry_t, i);
         rig_entity_t *entity = entry->entity;
         rut_object_t *geometry =
             rig_entity_get_component(entity, RIG_COMPONENT_TYPE_GEOMETRY);
-        cg_pipeline_t *pipeline;
+        cg_pipeline_t *pipeline = entry->pipeline;
+        pipeline_uniform_state_t *uniform_state;
         cg_primitive_t *primitive;
-        float normal_matrix[9];
         rig_material_t *material;
 
-        if (rut_object_get_type(geometry) == &rig_text_type &&
-            paint_ctx->pass == RIG_PASS_COLOR_BLENDED) {
-            cg_framebuffer_set_modelview_matrix(fb, &entry->matrix);
-            rig_text_renderer_draw(paint_ctx, renderer->text_state, geometry);
-            continue;
-        }
+        if (!pipeline) {
+            if (rut_object_get_type(geometry) == &rig_text_type &&
+                pass == RIG_PASS_COLOR_BLENDED) {
+                cg_framebuffer_set_modelview_matrix(fb, &entry->matrix);
+                rig_text_renderer_draw(paint_ctx, renderer->text_state,
+                                       geometry);
+                stats->n_draws++;
+
+                /* We can't know what pipeline the text renderer left
+                 * flushed */
+                last_pipeline = NULL;
+            }
 
-        if (!rut_object_is(geometry, RUT_TRAIT_ID_PRIMABLE))
+            rut_object_unref(entity);
             continue;
-
-        /*
-         * Setup Pipelines...
-         */
-
-        pipeline =
-            get_entity_pipeline(renderer, entity, geometry, paint_ctx->pass);
+        }
 
         material =
             rig_entity_get_component(entity, RIG_COMPONENT_TYPE_MATERIAL);
 
         /*
          * Update Uniforms...
+         *
+         * Each pipeline tracks what uniform state it last had flushed
+         * so we only upload uniforms that have actually changed.
          */
 
-        if ((paint_ctx->pass == RIG_PASS_DOF_DEPTH ||
-             paint_ctx->pass == RIG_PASS_SHADOW)) {
-            /* FIXME: avoid updating these uniforms for every primitive if
-             * the focal parameters haven't change! */
-            set_focal_parameters(pipeline,
-                                 rut_camera_get_focal_distance(camera),
-                                 rut_camera_get_depth_of_field(camera));
-
-        } else if ((paint_ctx->pass == RIG_PASS_COLOR_UNBLENDED ||
-                    paint_ctx->pass == RIG_PASS_COLOR_BLENDED)) {
-            rig_ui_t *ui = engine->ui;
-            rig_light_t *light =
-                rig_entity_get_component(ui->light, RIG_COMPONENT_TYPE_LIGHT);
-            int location;
-
-            /* FIXME: only update the lighting uniforms when the light has
-             * actually moved! */
-            rig_light_set_uniforms(light, pipeline);
-
-            /* FIXME: only update the material uniforms when the material has
-             * actually changed! */
-            if (material)
+        uniform_state = get_pipeline_uniform_state(pipeline);
+
+        if (pass == RIG_PASS_DOF_DEPTH || pass == RIG_PASS_SHADOW) {
+            if (!uniform_state->has_focal_parameters ||
+                uniform_state->focal_distance != focal_distance ||
+                uniform_state->depth_of_field != depth_of_field) {
+                set_focal_parameters(pipeline, focal_distance, depth_of_field);
+                uniform_state->focal_distance = focal_distance;
+                uniform_state->depth_of_field = depth_of_field;
+                uniform_state->has_focal_parameters = true;
+                stats->n_uniform_uploads++;
+            }
+
+            /* Entities with different thresholds may share a mask
+             * pipeline if their sources match */
+            if (material && mask_pipeline_has_alpha_mask(entity) &&
+                (!uniform_state->has_alpha_threshold ||
+                 uniform_state->alpha_threshold !=
+                 material->alpha_mask_threshold)) {
+                int location = cg_pipeline_get_uniform_location(
+                    pipeline, "material_alpha_threshold");
+
+                cg_pipeline_set_uniform_1f(
+                    pipeline, location, material->alpha_mask_threshold);
+                uniform_state->alpha_threshold = material->alpha_mask_threshold;
+                uniform_state->has_alpha_threshold = true;
+                stats->n_uniform_uploads++;
+            }
+        } else if (pass == RIG_PASS_COLOR_UNBLENDED ||
+                   pass == RIG_PASS_COLOR_BLENDED) {
+            if (uniform_state->light_age != renderer->light_age) {
+                rig_lighting_set_light_uniforms(pipeline,
+                                                renderer->flushed_lights,
+                                                renderer->n_lights);
+                uniform_state->light_age = renderer->light_age;
+                stats->n_uniform_uploads++;
+            }
+
+            if (material &&
+                (uniform_state->material != material ||
+                 uniform_state->material_age != material->uniforms_age)) {
                 rig_material_flush_uniforms(material, pipeline);
+                uniform_state->material = material;
+                uniform_state->material_age = material->uniforms_age;
+                stats->n_uniform_uploads++;
+            }
+
+            if (!uniform_state->has_normal_matrix ||
+                !c_matrix_equal(&uniform_state->modelview, &entry->matrix)) {
+                float normal_matrix[9];
+                int location;
+
+                get_normal_matrix(&entry->matrix, normal_matrix);
+
+                location =
+                    cg_pipeline_get_uniform_location(pipeline, "normal_matrix");
+                cg_pipeline_set_uniform_matrix(pipeline,
+                                               location,
+                                               3, /* dimensions */
+                                               1, /* count */
+                                               false, /* don't transpose again */
+                                               normal_matrix);
+
+                uniform_state->modelview = entry->matrix;
+                uniform_state->has_normal_matrix = true;
+                stats->n_uniform_uploads++;
+            }
+
+            {
+                const c_matrix_t *world =
+                    rut_transformable_get_world_matrix(entity);
+                bool has_matrices = uniform_state->has_light_shadow_matrices;
+
+                for (j = 0; j < renderer->n_lights; j++) {
+                    c_matrix_t light_shadow_matrix;
+                    int location;
+
+                    c_matrix_multiply(&light_shadow_matrix,
+                                      &light_vps[j], world);
 
-            get_normal_matrix(&entry->matrix, normal_matrix);
+                    if (has_matrices &&
+                        c_matrix_equal(
+                            &uniform_state->light_shadow_matrices[j],
+                            &light_shadow_matrix))
+                        continue;
 
-            location =
-                cg_pipeline_get_uniform_location(pipeline, "normal_matrix");
-            cg_pipeline_set_uniform_matrix(pipeline,
-                                           location,
-                                           3, /* dimensions */
-                                           1, /* count */
-                                           false, /* don't transpose again */
-                                           normal_matrix);
+                    location = rig_lighting_get_uniform_location(
+                        pipeline, j, "shadow_matrix");
+                    cg_pipeline_set_uniform_matrix(
+                        pipeline, location, 4, 1, false,
+                        c_matrix_get_array(&light_shadow_matrix));
+
+                    uniform_state->light_shadow_matrices[j] =
+                        light_shadow_matrix;
+                    stats->n_uniform_uploads++;
+                }
+
+                uniform_state->has_light_shadow_matrices = true;
+            }
         }
 
         /*
@@ -1453,9 +1757,15 @@ rig_renderer_flush_journal(rig_renderer_t *renderer,
 
         cg_primitive_draw(primitive, fb, pipeline);
 
+        if (pipeline != last_pipeline) {
+            stats->n_pipeline_switches++;
+            last_pipeline = pipeline;
+        }
+        stats->n_draws++;
+
         cg_object_unref(pipeline);
 
-        rut_object_unref(entry->entity);
+        rut_object_unref(entity);
     }
 
     cg_framebuffer_pop_matrix(fb);
@@ -1463,6 +1773,22 @@ rig_renderer_flush_journal(rig_renderer_t *renderer,
     c_array_set_size(journal, 0);
 }
 
+void
+rig_renderer_get_pass_stats(rig_renderer_t *renderer,
+                            rig_pass_t pass,
+                            rig_renderer_pass_stats_t *stats)
+{
+    c_return_if_fail(pass < RIG_N_PASSES);
+
+    *stats = renderer->pass_stats[pass];
+}
+
+void
+rig_renderer_reset_stats(rig_renderer_t *renderer)
+{
+    memset(renderer->pass_stats, 0, sizeof(renderer->pass_stats));
+}
+
 static void
 draw_entity_camera_frustum(rig_engine_t *engine,
                            rig_entity_t *entity,
@@ -1503,6 +1829,160 @@ text_preferred_size_changed_cb(rut_object_t *sizable,
     rut_sizable_set_size(text, width, height);
 }
 
+static bool
+measure_volume_x_cb(void **attribute_data, int vertex_index, void *user_data)
+{
+    float *bounds = user_data;
+    float *pos = attribute_data[0];
+
+    bounds[0] = MIN(bounds[0], pos[0]);
+    bounds[3] = MAX(bounds[3], pos[0]);
+
+    return true;
+}
+
+static bool
+measure_volume_xy_cb(void **attribute_data, int vertex_index, void *user_data)
+{
+    float *bounds = user_data;
+    float *pos = attribute_data[0];
+
+    for (int i = 0; i < 2; i++) {
+        bounds[i] = MIN(bounds[i], pos[i]);
+        bounds[i + 3] = MAX(bounds[i + 3], pos[i]);
+    }
+
+    return true;
+}
+
+static bool
+measure_volume_xyz_cb(void **attribute_data, int vertex_index, void *user_data)
+{
+    float *bounds = user_data;
+    float *pos = attribute_data[0];
+
+    for (int i = 0; i < 3; i++) {
+        bounds[i] = MIN(bounds[i], pos[i]);
+        bounds[i + 3] = MAX(bounds[i + 3], pos[i]);
+    }
+
+    return true;
+}
+
+/* Measures the model space extents of a mesh's "cg_position_in"
+ * attribute as { min_x, min_y, min_z, max_x, max_y, max_z }
+ *
+ * Returns false if the bounds can't be determined, in which case the
+ * entity should never be culled. */
+static bool
+measure_mesh_bounds(rut_mesh_t *mesh, float *bounds)
+{
+    rut_attribute_t *attribute =
+        rut_mesh_find_attribute(mesh, "cg_position_in");
+    rut_mesh_vertex_callback_t measure_callback;
+
+    if (!attribute || !attribute->is_buffered ||
+        attribute->buffered.type != RUT_ATTRIBUTE_TYPE_FLOAT ||
+        mesh->n_vertices == 0)
+        return false;
+
+    bounds[0] = bounds[1] = bounds[2] = FLT_MAX;
+    bounds[3] = bounds[4] = bounds[5] = -FLT_MAX;
+
+    switch (attribute->buffered.n_components) {
+    case 1:
+        bounds[1] = bounds[2] = bounds[4] = bounds[5] = 0;
+        measure_callback = measure_volume_x_cb;
+        break;
+    case 2:
+        bounds[2] = bounds[5] = 0;
+        measure_callback = measure_volume_xy_cb;
+        break;
+    case 3:
+        measure_callback = measure_volume_xyz_cb;
+        break;
+    default:
+        /* With a 4th, w, component we can't trivially derive a
+         * bounding box */
+        return false;
+    }
+
+    rut_mesh_foreach_vertex(mesh, measure_callback, bounds,
+                            "cg_position_in", NULL);
+
+    return true;
+}
+
+/* Returns a model space bounding volume for the given geometry, or
+ * NULL if the geometry's extents are unknown and so the entity
+ * should not be culled. */
+static rut_volume_t *
+get_entity_volume(rig_entity_t *entity, rut_object_t *geometry)
+{
+    rig_renderer_priv_t *priv = entity->renderer_priv;
+    const rut_type_t *type = rut_object_get_type(geometry);
+    float bounds[6];
+    rut_vector3_t origin;
+
+    if (type == &rig_mesh_type) {
+        if (priv->volume_valid)
+            return priv->volume;
+
+        if (!measure_mesh_bounds(rig_mesh_get_rut_mesh(geometry), bounds))
+            return NULL;
+    } else if (type == &rig_text_type || type == &rig_nine_slice_type) {
+        float width, height;
+
+        rut_sizable_get_size(geometry, &width, &height);
+
+        bounds[0] = bounds[1] = bounds[2] = 0;
+        bounds[3] = width;
+        bounds[4] = height;
+        bounds[5] = 0;
+
+        if (priv->volume_valid &&
+            memcmp(bounds, priv->volume_bounds, sizeof(bounds)) == 0)
+            return priv->volume;
+    } else
+        return NULL;
+
+    if (!priv->volume)
+        priv->volume = rut_volume_new();
+
+    origin.x = bounds[0];
+    origin.y = bounds[1];
+    origin.z = bounds[2];
+    rut_volume_set_origin(priv->volume, &origin);
+    rut_volume_set_width(priv->volume, bounds[3] - bounds[0]);
+    rut_volume_set_height(priv->volume, bounds[4] - bounds[1]);
+    rut_volume_set_depth(priv->volume, bounds[5] - bounds[2]);
+
+    memcpy(priv->volume_bounds, bounds, sizeof(bounds));
+    priv->volume_valid = true;
+
+    return priv->volume;
+}
+
+static void
+update_eye_planes(rig_renderer_t *renderer, rut_object_t *camera)
+{
+    const float *viewport = rut_camera_get_viewport(camera);
+    float x = viewport[0];
+    float y = viewport[1];
+    float width = viewport[2];
+    float height = viewport[3];
+    float polygon[8] = { x, y,
+                         x + width, y,
+                         x + width, y + height,
+                         x, y + height };
+
+    rut_get_eye_planes_for_screen_poly(polygon, 4,
+                                       (float *)viewport,
+                                       rut_camera_get_projection(camera),
+                                       rut_camera_get_inverse_projection(camera),
+                                       renderer->eye_planes);
+}
+
 static rut_traverse_visit_flags_t
 entitygraph_pre_paint_cb(rut_object_t *object, int depth, void *user_data)
 {
@@ -1523,6 +2003,7 @@ entitygraph_pre_paint_cb(rut_object_t *object, int depth, void *user_data)
         rut_object_t *geometry;
         c_matrix_t matrix;
         rig_renderer_priv_t *priv;
+        rut_volume_t *volume;
 
         material =
             rig_entity_get_component(entity, RIG_COMPONENT_TYPE_MATERIAL);
@@ -1562,6 +2043,17 @@ entitygraph_pre_paint_cb(rut_object_t *object, int depth, void *user_data)
         }
 
         cg_framebuffer_get_modelview_matrix(fb, &matrix);
+
+        /* The modelview matrix here maps into the eye coordinates of
+         * the camera being painted (which is the light's camera for
+         * the shadow pass) so we can cull against its frustum... */
+        volume = get_entity_volume(entity, geometry);
+        if (volume &&
+            rut_volume_cull_with_modelview(volume, &matrix,
+                                           renderer->eye_planes) ==
+            RUT_CULL_RESULT_OUT)
+            return RUT_TRAVERSE_VISIT_CONTINUE;
+
         rig_journal_log(renderer->journal, paint_ctx, entity, &matrix);
 
         return RUT_TRAVERSE_VISIT_CONTINUE;
@@ -1596,6 +2088,7 @@ paint_camera_entity_pass(rig_paint_context_t *paint_ctx,
     paint_ctx->camera = camera;
 
     rut_camera_flush(camera);
+    update_eye_planes(renderer, camera);
 
     rut_graphable_traverse(engine->ui->scene,
                            RUT_TRAVERSE_DEPTH_FIRST,
@@ -1610,17 +2103,26 @@ paint_camera_entity_pass(rig_paint_context_t *paint_ctx,
     paint_ctx->camera = saved_camera;
 }
 
+/* Renders the shadow map for each light into its own tile of the
+ * shadow map atlas. Since each light's pass culls against the light's
+ * own frustum, casters outside of a light's volume are skipped. */
 static void
-set_light_framebuffer(rig_renderer_t *renderer, rig_entity_t *light)
+paint_shadow_maps(rig_paint_context_t *paint_ctx)
 {
-    rut_object_t *light_camera =
-        rig_entity_get_component(light, RIG_COMPONENT_TYPE_CAMERA);
+    rig_renderer_t *renderer = paint_ctx->renderer;
     cg_framebuffer_t *fb = renderer->shadow_fb;
-    int width = cg_framebuffer_get_width(fb);
-    int height = cg_framebuffer_get_height(fb);
+    int i;
+
+    cg_framebuffer_clear4f(fb, CG_BUFFER_BIT_DEPTH, 0, 0, 0, 1);
+
+    paint_ctx->pass = RIG_PASS_SHADOW;
+
+    for (i = 0; i < renderer->n_lights; i++) {
+        rig_entity_t *light = renderer->lights[i];
 
-    rut_camera_set_framebuffer(light_camera, fb);
-    rut_camera_set_viewport(light_camera, 0, 0, width, height);
+        rig_lighting_set_shadow_camera(light, fb, renderer->n_lights, i);
+        paint_camera_entity_pass(paint_ctx, light);
+    }
 }
 
 void
@@ -1634,16 +2136,14 @@ rig_renderer_paint_camera(rig_paint_context_t *paint_ctx,
     rig_engine_t *engine = paint_ctx->engine;
     rig_ui_t *ui = engine->ui;
 
-    if (!ui->light) {
+    renderer->n_lights = rig_lighting_gather_lights(ui, renderer->lights);
+
+    if (!renderer->n_lights) {
         c_warning("Can't render scene without any light");
         return;
     }
 
-    /* TODO: support multiple lights */
-    paint_ctx->pass = RIG_PASS_SHADOW;
-    set_light_framebuffer(renderer, ui->light); /* FIXME: should have per-light fb */
-    rig_entity_set_camera_view_from_transform(ui->light);
-    paint_camera_entity_pass(paint_ctx, ui->light);
+    paint_shadow_maps(paint_ctx);
 
     //if (paint_ctx->enable_dof) {
     if (0) {
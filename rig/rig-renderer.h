@@ -37,9 +37,20 @@ typedef enum _rig_pass_t {
     RIG_PASS_COLOR_UNBLENDED,
     RIG_PASS_COLOR_BLENDED,
     RIG_PASS_SHADOW,
-    RIG_PASS_DOF_DEPTH
+    RIG_PASS_DOF_DEPTH,
+
+    RIG_N_PASSES
 } rig_pass_t;
 
+/* Counters accumulated while flushing the journal for each pass,
+ * until reset with rig_renderer_reset_stats() */
+typedef struct _rig_renderer_pass_stats_t {
+    int n_draws;
+    int n_pipeline_switches;
+    int n_uniform_uploads;
+    int n_pipelines_created;
+} rig_renderer_pass_stats_t;
+
 typedef struct _rig_paint_context_t {
     rut_object_t *camera;
 
@@ -75,4 +86,10 @@ void rig_renderer_fini(rig_renderer_t *renderer);
 void rig_renderer_paint_camera(rig_paint_context_t *paint_ctx,
                                rig_entity_t *camera_entity);
 
+void rig_renderer_get_pass_stats(rig_renderer_t *renderer,
+                                 rig_pass_t pass,
+                                 rig_renderer_pass_stats_t *stats);
+
+void rig_renderer_reset_stats(rig_renderer_t *renderer);
+
 #endif /* _RIG_RENDERER_H_ */
@@ -32,6 +32,10 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <clib.h>
 
 #include <rut.h>
@@ -181,6 +185,12 @@ simulator_garbage_collect_object_cb(void *object, void *user_data)
     rig_simulator_t *simulator = user_data;
 
     c_hash_table_remove(simulator->object_registry, object);
+
+    /* Objects are collected after the frame's changes have been sent
+     * and the frontend forgets them as it collects its own copy
+     * before decoding the next frame's changes. */
+    rig_property_delta_forget_object(simulator->property_delta,
+                                     (intptr_t)object);
 }
 
 #if 0
@@ -219,6 +229,25 @@ simulator__run_frame(Rig__Simulator_Service *service,
 
     simulator->frame_info.progress = setup->progress;
 
+    if (setup->has_ui_diff_encodings) {
+        uint32_t encodings = setup->ui_diff_encodings;
+
+        /* The frontend's mirror of our previous values can't be
+         * trusted if we weren't delta encoding the last frame */
+        if ((encodings & RIG_UI_DIFF_ENCODING_DELTA) &&
+            !(simulator->frontend_features.ui_diff_encodings &
+              RIG_UI_DIFF_ENCODING_DELTA))
+            simulator->delta_reset_pending = true;
+
+        simulator->frontend_features.ui_diff_encodings = encodings;
+    }
+
+    /* The frontend couldn't decode our delta encoded changes */
+    if (setup->has_delta_resync && setup->delta_resync) {
+        rig_property_delta_reset(simulator->property_delta);
+        simulator->delta_reset_pending = true;
+    }
+
     for (i = 0; i < setup->n_view_updates; i++) {
         Rig__ViewUpdate *pb_update = setup->view_updates[i];
         rig_view_t *view = simulator_lookup_object(simulator, pb_update->id);
@@ -424,9 +453,12 @@ log_op_cb(Rig__Operation *pb_op, void *user_data)
     /* We sequence all operations relative to the property updates that
      * are being logged, so that the frontend will be able to replay
      * operation and property updates in the same order.
+     *
+     * Note: this also ensures that property changes logged before
+     * this operation won't be coalesced with changes logged after.
      */
     pb_op->has_sequence = true;
-    pb_op->sequence = prop_ctx->log_len;
+    pb_op->sequence = rig_property_context_log_sequence_point(prop_ctx);
 
 #ifdef RIG_ENABLE_DEBUG
     {
@@ -464,6 +496,9 @@ _rig_simulator_free(void *object)
 
     c_hash_table_destroy(simulator->object_registry);
 
+    rig_property_delta_free(simulator->property_delta);
+    c_byte_array_free(simulator->encoded_changes, true);
+
     rig_engine_op_apply_context_destroy(&simulator->apply_op_ctx);
 
     rut_object_unref(simulator->engine);
@@ -518,6 +553,17 @@ simulator_on_run_cb(rut_shell_t *shell, void *user_data)
         rig_engine_new_for_simulator(simulator->shell, simulator);
     engine = simulator->engine;
 
+    /* We only need to forward the latest value of each property to the
+     * frontend each frame (relative to any operations that are
+     * sequenced against property changes) so we avoid logging
+     * intermediate values. */
+    rig_property_context_set_log_coalescing(engine->property_ctx, true);
+
+    /* Similarly we only need to update bindings once per frame, before
+     * we send our updates to the frontend, which avoids re-evaluating
+     * bindings that have multiple dependencies changed in a frame. */
+    rig_property_context_set_deferred_bindings(engine->property_ctx, true);
+
     simulator->object_registry = c_hash_table_new(NULL, /* direct hash */
                                                   NULL); /* direct key equal */
 
@@ -571,6 +617,12 @@ rig_simulator_new(rut_shell_t *main_shell)
 
     c_list_init(&simulator->actions);
 
+    simulator->property_delta = rig_property_delta_new();
+    rig_property_delta_set_object_to_id_callback(simulator->property_delta,
+                                                 lookup_frontend_id_cb,
+                                                 simulator);
+    simulator->encoded_changes = c_byte_array_new();
+
     /* On platforms where we must run everything in a single thread
      * 'main_shell' associates the simulator's shell with the frontend
      * shell whose mainloop we will share... */
@@ -752,6 +804,85 @@ stack_region_cb(uint8_t *data, size_t bytes, void *user_data)
     state->i = i;
 }
 
+static void
+encode_region_cb(uint8_t *data, size_t bytes, void *user_data)
+{
+    serialize_changes_state_t *state = user_data;
+    rig_simulator_t *simulator = state->simulator;
+    size_t step = sizeof(rig_property_change_t);
+    size_t offset;
+    int i;
+
+    for (i = state->i, offset = 0;
+         i < state->n_changes && (offset + step) <= bytes;
+         i++, offset += step) {
+        rig_property_change_t *change =
+            (rig_property_change_t *)(data + offset);
+
+        rig_property_delta_encode(simulator->property_delta,
+                                  simulator->encoded_changes,
+                                  simulator_lookup_object_id(simulator,
+                                                             change->object),
+                                  change->prop_id,
+                                  &change->boxed);
+
+        rut_boxed_destroy(&change->boxed);
+    }
+
+    state->i = i;
+}
+
+/* Delta encodes the property changes logged this frame into
+ * ui_diff->encoded_property_changes, instead of serializing a
+ * Rig__PropertyChange for each change. */
+static void
+encode_property_changes(rig_simulator_t *simulator,
+                        Rig__UIDiff *ui_diff,
+                        int n_changes)
+{
+    rig_engine_t *engine = simulator->engine;
+    rig_property_context_t *prop_ctx = &engine->_property_ctx;
+    c_byte_array_t *encoded = simulator->encoded_changes;
+    serialize_changes_state_t state;
+
+    state.simulator = simulator;
+    state.i = 0;
+    state.n_changes = n_changes;
+
+    c_byte_array_set_size(encoded, 0);
+
+    rig_property_delta_begin_frame(simulator->property_delta);
+
+    rut_memory_stack_foreach_region(
+        prop_ctx->change_log_stack, encode_region_cb, &state);
+
+    ui_diff->has_encoded_property_changes = true;
+    ui_diff->encoded_property_changes.data = encoded->data;
+    ui_diff->encoded_property_changes.len = encoded->len;
+    ui_diff->has_n_encoded_property_changes = true;
+    ui_diff->n_encoded_property_changes = n_changes;
+
+#ifdef USE_ZLIB
+    if ((simulator->frontend_features.ui_diff_encodings &
+         RIG_UI_DIFF_ENCODING_ZLIB) &&
+        encoded->len >= RIG_UI_DIFF_ZLIB_THRESHOLD) {
+        uLongf compressed_len = compressBound(encoded->len);
+        uint8_t *compressed = rut_memory_stack_alloc(engine->frame_stack,
+                                                     compressed_len);
+
+        if (compress2(compressed, &compressed_len,
+                      encoded->data, encoded->len,
+                      Z_BEST_SPEED) == Z_OK &&
+            compressed_len < encoded->len) {
+            ui_diff->encoded_property_changes.data = compressed;
+            ui_diff->encoded_property_changes.len = compressed_len;
+            ui_diff->has_uncompressed_size = true;
+            ui_diff->uncompressed_size = encoded->len;
+        }
+    }
+#endif
+}
+
 void
 rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
 {
@@ -764,6 +895,10 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
     int n_changes;
     rig_pb_serializer_t *serializer;
     rut_queue_t *ops;
+    int n_ops;
+    int64_t start_time = 0, update_time = 0, serialize_time = 0;
+    int64_t encode_time = 0;
+    bool delta_encode;
 
     simulator->redraw_queued = false;
     rut_shell_remove_paint_idle(shell);
@@ -773,6 +908,9 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
 
     simulator->in_frame = true;
 
+    if (simulator->collect_stats)
+        start_time = c_get_monotonic_time();
+
     /* Setup the property context to log all property changes so they
      * can be sent back to the frontend process each frame. */
     engine->_property_ctx.logging_disabled--;
@@ -816,6 +954,11 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
     if (rig_engine_check_timelines(engine))
         rut_shell_queue_redraw(shell);
 
+    rig_property_context_flush_bindings(prop_ctx);
+
+    if (simulator->collect_stats)
+        update_time = c_get_monotonic_time();
+
     // c_debug ("Simulator: Sending UI Update\n");
 
     n_changes = prop_ctx->log_len;
@@ -827,11 +970,33 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
 
     rig__uidiff__init(&ui_diff);
 
-    ui_diff.n_property_changes = n_changes;
-    if (n_changes) {
+    delta_encode = simulator->frontend_features.ui_diff_encodings &
+        RIG_UI_DIFF_ENCODING_DELTA;
+
+    /* Edits may delete objects, so we take the opportunity to forget
+     * all previous values instead of letting them accumulate */
+    if (delta_encode && simulator->ops->len) {
+        rig_property_delta_reset(simulator->property_delta);
+        simulator->delta_reset_pending = true;
+    }
+
+    if (delta_encode && simulator->delta_reset_pending) {
+        ui_diff.has_delta_reset = true;
+        ui_diff.delta_reset = true;
+        simulator->delta_reset_pending = false;
+    }
+
+    if (delta_encode) {
+        encode_property_changes(simulator, &ui_diff, n_changes);
+
+        if (simulator->collect_stats)
+            encode_time = c_get_monotonic_time();
+    } else if (n_changes) {
         serialize_changes_state_t state;
         int i;
 
+        ui_diff.n_property_changes = n_changes;
+
         state.simulator = simulator;
         state.serializer = serializer;
 
@@ -862,10 +1027,11 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
     }
 
     ops = simulator->ops;
-    if (ops->len) {
+    n_ops = ops->len;
+    if (n_ops) {
         ui_diff.edit =
             rig_pb_new(engine->ops_serializer, Rig__UIEdit, rig__uiedit__init);
-        ui_diff.edit->n_ops = ops->len;
+        ui_diff.edit->n_ops = n_ops;
         ui_diff.edit->ops =
             rig_pb_serialize_ops_queue(engine->ops_serializer, ops);
         rut_queue_clear(ops);
@@ -922,9 +1088,32 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
         ui_diff.queue_frame = true;
     }
 
+    if (simulator->collect_stats) {
+        rig_simulator_frame_stats_t *stats = &simulator->stats;
+        size_t ui_diff_bytes = rig__uidiff__get_packed_size(&ui_diff);
+
+        serialize_time = c_get_monotonic_time();
+
+        stats->n_frames++;
+        stats->n_property_changes += n_changes;
+        stats->n_ops += n_ops;
+        stats->update_ns += update_time - start_time;
+        stats->serialize_ns += serialize_time - update_time;
+        if (encode_time)
+            stats->encode_ns += encode_time - update_time;
+        stats->ui_diff_bytes += ui_diff_bytes;
+        if (ui_diff_bytes > stats->max_ui_diff_bytes)
+            stats->max_ui_diff_bytes = ui_diff_bytes;
+    }
+
     rig__frontend__update_ui(
         frontend_service, &ui_diff, handle_update_ui_ack, NULL);
 
+    if (simulator->collect_stats) {
+        simulator->stats.send_ns +=
+            c_get_monotonic_time() - serialize_time;
+    }
+
     simulator->in_frame = false;
 
     rig_pb_serializer_destroy(serializer);
@@ -943,9 +1132,37 @@ rig_simulator_run_frame(rut_shell_t *shell, void *user_data)
      */
     rig_engine_garbage_collect(engine);
 
+    if (simulator->collect_stats) {
+        size_t frame_stack_bytes =
+            rut_memory_stack_get_used_bytes(engine->frame_stack);
+
+        if (frame_stack_bytes > simulator->stats.max_frame_stack_bytes)
+            simulator->stats.max_frame_stack_bytes = frame_stack_bytes;
+    }
+
     rut_memory_stack_rewind(engine->frame_stack);
 }
 
+void
+rig_simulator_set_collect_stats(rig_simulator_t *simulator,
+                                bool collect_stats)
+{
+    simulator->collect_stats = collect_stats;
+}
+
+void
+rig_simulator_get_stats(rig_simulator_t *simulator,
+                        rig_simulator_frame_stats_t *stats)
+{
+    *stats = simulator->stats;
+}
+
+void
+rig_simulator_reset_stats(rig_simulator_t *simulator)
+{
+    memset(&simulator->stats, 0, sizeof(simulator->stats));
+}
+
 static void
 handle_frame_req_ack(const Rig__FrameRequestAck *ack,
                      void *closure_data)
@@ -1182,6 +1399,10 @@ rig_simulator_reload_frontend_ui(rig_simulator_t *simulator,
 
     rig_pb_serialized_ui_destroy(pb_ui);
 
+    /* Forget previous values of the objects being replaced */
+    rig_property_delta_reset(simulator->property_delta);
+    simulator->delta_reset_pending = true;
+
     rig_pb_serializer_destroy(serializer);
 
     rig_engine_op_apply_context_set_ui(&simulator->apply_op_ctx, ui);
@@ -64,6 +64,7 @@ enum rig_simulator_run_mode {
 #include "rig-pb.h"
 #include "rig-frontend.h"
 #include "rig-js.h"
+#include "rig-property-delta.h"
 
 /*
  * Simulator actions are sent back as requests to the frontend at the
@@ -73,6 +74,26 @@ typedef enum _rig_simulator_action_type_t {
     RIG_SIMULATOR_ACTION_TYPE_REPORT_EDIT_FAILURE = 1,
 } rig_simulator_action_type_t;
 
+/* Counters and timings accumulated for each frame run while stats
+ * collection is enabled with rig_simulator_set_collect_stats(), until
+ * reset with rig_simulator_reset_stats() */
+typedef struct _rig_simulator_frame_stats_t {
+    int n_frames;
+    int n_property_changes;
+    int n_ops;
+
+    int64_t update_ns; /* timelines, input, code modules and bindings */
+    int64_t serialize_ns; /* building the Rig__UIDiff */
+    int64_t send_ns; /* packing and writing the Rig__UIDiff */
+    int64_t encode_ns; /* delta encoding and compressing property changes,
+                          included in serialize_ns */
+
+    size_t ui_diff_bytes;
+    size_t max_ui_diff_bytes;
+
+    size_t max_frame_stack_bytes;
+} rig_simulator_frame_stats_t;
+
 /* The "simulator" is the process responsible for updating object
  * properties either in response to user input, the progression of
  * animations or running other forms of simulation such as physics.
@@ -100,9 +121,15 @@ struct _rig_simulator_t {
 #endif
 
     struct {
-        int dummy;
+        uint32_t ui_diff_encodings; /* rig_ui_diff_encoding_t mask */
     } frontend_features;
 
+    /* State for delta encoding property changes, mirrored by the
+     * frontend */
+    rig_property_delta_t *property_delta;
+    c_byte_array_t *encoded_changes;
+    bool delta_reset_pending;
+
     rig_pb_stream_t *stream;
     rig_rpc_peer_t *simulator_peer;
 
@@ -139,6 +166,9 @@ struct _rig_simulator_t {
     c_list_t connected_closures;
 
     rig_js_runtime_t *js;
+
+    bool collect_stats;
+    rig_simulator_frame_stats_t stats;
 };
 
 extern rut_type_t rig_simulator_type;
@@ -151,6 +181,14 @@ void rig_simulator_run(rig_simulator_t *simulator);
 
 void rig_simulator_run_frame(rut_shell_t *shell, void *user_data);
 
+void rig_simulator_set_collect_stats(rig_simulator_t *simulator,
+                                     bool collect_stats);
+
+void rig_simulator_get_stats(rig_simulator_t *simulator,
+                             rig_simulator_frame_stats_t *stats);
+
+void rig_simulator_reset_stats(rig_simulator_t *simulator);
+
 void rig_simulator_queue_redraw_hook(rut_shell_t *shell, void *user_data);
 
 void rig_simulator_print_mappings(rig_simulator_t *simulator);
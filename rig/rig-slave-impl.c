@@ -134,6 +134,68 @@ unregister_edit_id_cb(uint64_t edit_mode_id, void *user_data)
         c_hash_table_remove_value(slave->play_object_to_edit_id_map, object);
 }
 
+typedef struct _slave_blob_t {
+    uint64_t hash;
+    size_t len;
+    uint8_t data[];
+} slave_blob_t;
+
+static const uint8_t *
+lookup_blob_cb(uint64_t hash, size_t *len, void *user_data)
+{
+    rig_slave_t *slave = user_data;
+    slave_blob_t *blob = c_hash_table_lookup(slave->blob_cache, &hash);
+
+    if (!blob)
+        return NULL;
+
+    *len = blob->len;
+    return blob->data;
+}
+
+static c_hash_table_t *
+blob_cache_new(void)
+{
+    return c_hash_table_new_full(c_int64_hash,
+                                 c_int64_equal, /* key equal */
+                                 NULL, /* key destroy */
+                                 c_free); /* value destroy */
+}
+
+/* Replaces the blob cache with just the blobs of the given UI, so the
+ * cache never grows beyond what the current UI references. Blobs sent
+ * without data are carried over from the previous cache. */
+static void
+update_blob_cache(rig_slave_t *slave, const Rig__UI *pb_ui)
+{
+    c_hash_table_t *cache = blob_cache_new();
+
+    for (int i = 0; i < pb_ui->n_blobs; i++) {
+        Rig__Blob *pb_blob = pb_ui->blobs[i];
+        slave_blob_t *blob;
+
+        if (c_hash_table_lookup(cache, &pb_blob->hash))
+            continue;
+
+        if (pb_blob->has_data) {
+            blob = c_malloc(sizeof(slave_blob_t) + pb_blob->data.len);
+            blob->hash = pb_blob->hash;
+            blob->len = pb_blob->data.len;
+            memcpy(blob->data, pb_blob->data.data, pb_blob->data.len);
+        } else {
+            blob = c_hash_table_lookup(slave->blob_cache, &pb_blob->hash);
+            if (!blob)
+                continue;
+            c_hash_table_steal(slave->blob_cache, &pb_blob->hash);
+        }
+
+        c_hash_table_insert(cache, &blob->hash, blob);
+    }
+
+    c_hash_table_destroy(slave->blob_cache);
+    slave->blob_cache = cache;
+}
+
 static void
 load_ui(rig_slave_t *slave)
 {
@@ -176,10 +238,15 @@ load_ui(rig_slave_t *slave)
     rig_pb_unserializer_set_id_to_object_callback(
         unserializer, lookup_object_cb, slave);
 
+    rig_pb_unserializer_set_blob_lookup_callback(
+        unserializer, lookup_blob_cb, slave);
+
     ui = rig_pb_unserialize_ui(unserializer, pb_ui);
 
     rig_pb_unserializer_destroy(unserializer);
 
+    update_blob_cache(slave, pb_ui);
+
     rig_engine_set_play_mode_ui(engine, ui);
 
     rig_frontend_reload_simulator_ui(slave->frontend, ui, true /* play mode */);
@@ -290,11 +357,10 @@ ui_updated_cb(rig_frontend_t *frontend, void *user_data)
     rut_closure_disconnect_FIXME(slave->ui_update_closure);
     slave->ui_update_closure = NULL;
 
-    /* We don't apply all pending edits now, and instead wait until
-     * we are setting up the next simulator frame, since we can
-     * only forward the simulator one set of edits at a time and
-     * we want to apply the edits in the frontend at the same time
-     * they are forwarded to the simulator...
+    /* We don't apply the pending edits now, and instead wait until
+     * we are setting up the next simulator frame, since we want to
+     * apply the edits in the frontend at the same time they are
+     * forwarded to the simulator...
      */
     rut_shell_queue_redraw(slave->engine->shell);
 }
@@ -344,6 +410,29 @@ slave__debug_control(Rig__Slave_Service *service,
     closure(&ack, closure_data);
 }
 
+static void
+slave__query_blobs(Rig__Slave_Service *service,
+                   const Rig__BlobQuery *query,
+                   Rig__BlobQueryResult_Closure closure,
+                   void *closure_data)
+{
+    rig_slave_t *slave = rig_pb_rpc_closure_get_connection_data(closure_data);
+    Rig__BlobQueryResult result = RIG__BLOB_QUERY_RESULT__INIT;
+
+    c_return_if_fail(query != NULL);
+
+    result.known_hashes = c_new(uint64_t, query->n_hashes);
+
+    for (int i = 0; i < query->n_hashes; i++) {
+        if (c_hash_table_lookup(slave->blob_cache, &query->hashes[i]))
+            result.known_hashes[result.n_known_hashes++] = query->hashes[i];
+    }
+
+    closure(&result, closure_data);
+
+    c_free(result.known_hashes);
+}
+
 static Rig__Slave_Service rig_slave_service = RIG__SLAVE__INIT(slave__);
 
 static void
@@ -692,26 +781,45 @@ object_delete_cb(rut_object_t *object, void *user_data)
     }
 }
 
+/* Applies all of the pending edits in the frontend, in the order
+ * they were received, and merges their operations into a single
+ * Rig__UIEdit so they can all be forwarded to the simulator with one
+ * frame. The edits are left queued so their results can be reported
+ * once the frame has been sent, see report_pending_edits(). */
 static void
 handle_pending_edit_operations(rig_slave_t *slave,
                                rig_pb_serializer_t *serializer,
-                               pending_edit_t *pending_edit,
                                Rig__FrameSetup *setup)
 {
-    /* Note: Since a slave device is effectively always running in
-     * play-mode the state of the UI is unpredictable and it's
-     * always possible that edits made in an editor can no longer be
-     * applied to the current state of a slave device (for example
-     * an object being edited may have been deleted by some UI
-     * logic)
-     *
-     * We apply edits on a best-effort basis, and if they fail we
-     * report that status back to the editor so that it can inform
-     * the user who can choose to reset the slave.
-     */
-    if (!rig_engine_map_pb_ui_edit(
-            &slave->map_op_ctx, &slave->apply_op_ctx, pending_edit->edit)) {
-        pending_edit->status = false;
+    rut_queue_item_t *item;
+    Rig__UIEdit *pb_edit;
+    int n_ops = 0;
+
+    c_list_for_each(item, &slave->pending_edits->items, list_node)
+    {
+        pending_edit_t *pending_edit = item->data;
+
+        /* Note: Since a slave device is effectively always running in
+         * play-mode the state of the UI is unpredictable and it's
+         * always possible that edits made in an editor can no longer be
+         * applied to the current state of a slave device (for example
+         * an object being edited may have been deleted by some UI
+         * logic)
+         *
+         * We apply edits on a best-effort basis, and if they fail we
+         * report that status back to the editor so that it can inform
+         * the user who can choose to reset the slave.
+         *
+         * Note: we map each edit separately so we know which edits
+         * failed.
+         */
+        if (!rig_engine_map_pb_ui_edit(&slave->map_op_ctx,
+                                       &slave->apply_op_ctx,
+                                       pending_edit->edit)) {
+            pending_edit->status = false;
+        }
+
+        n_ops += pending_edit->edit->n_ops;
     }
 
     /* Note: we disregard whether we failed to apply the edits
@@ -720,8 +828,45 @@ handle_pending_edit_operations(rig_slave_t *slave,
      * user they can decided if they want to reset the slave
      * device.
      */
-    /* FIXME: protoc-c should declare this member as const */
-    setup->play_edit = (Rig__UIEdit *)pending_edit->edit;
+    pb_edit = rig_pb_new(serializer, Rig__UIEdit, rig__uiedit__init);
+    pb_edit->n_ops = 0;
+    pb_edit->ops = rut_memory_stack_memalign(serializer->stack,
+                                             sizeof(void *) * n_ops,
+                                             C_ALIGNOF(void *));
+
+    c_list_for_each(item, &slave->pending_edits->items, list_node)
+    {
+        pending_edit_t *pending_edit = item->data;
+
+        memcpy(pb_edit->ops + pb_edit->n_ops,
+               pending_edit->edit->ops,
+               sizeof(void *) * pending_edit->edit->n_ops);
+        pb_edit->n_ops += pending_edit->edit->n_ops;
+    }
+
+    setup->play_edit = pb_edit;
+}
+
+/* Reports the results of the first @n_edits pending edits, which have
+ * been forwarded to the simulator, back to the editor */
+static void
+report_pending_edits(rig_slave_t *slave, int n_edits)
+{
+    int i;
+
+    for (i = 0; i < n_edits; i++) {
+        pending_edit_t *pending_edit = rut_queue_pop_head(slave->pending_edits);
+        Rig__UIEditResult result = RIG__UIEDIT_RESULT__INIT;
+
+        if (pending_edit->status == false) {
+            result.has_status = true;
+            result.status = false;
+        }
+
+        pending_edit->closure(&result, pending_edit->closure_data);
+
+        c_slice_free(pending_edit_t, pending_edit);
+    }
 }
 
 static void
@@ -739,7 +884,7 @@ rig_slave_paint(rut_shell_t *shell, void *user_data)
         rut_input_queue_t *input_queue = rut_shell_get_input_queue(shell);
         Rig__FrameSetup setup = RIG__FRAME_SETUP__INIT;
         rig_pb_serializer_t *serializer;
-        pending_edit_t *pending_edit = NULL;
+        int n_edits = slave->pending_edits->len;
 
         serializer = rig_pb_serializer_new(engine);
 
@@ -757,33 +902,14 @@ rig_slave_paint(rut_shell_t *shell, void *user_data)
             frontend->has_resized = false;
         }
 
-        /* Forward any received edits to the simulator too.
-         *
-         * Note: Although we may have a backlog of edits from the
-         * editor, we can currently only send one Rig__UIEdit per
-         * frame...
-         */
-        if (slave->pending_edits->len) {
-            pending_edit = rut_queue_pop_head(slave->pending_edits);
-
-            handle_pending_edit_operations(
-                slave, serializer, pending_edit, &setup);
-        }
+        /* Forward all received edits to the simulator too, so that
+         * a burst of edits from the editor is applied in one frame */
+        if (n_edits)
+            handle_pending_edit_operations(slave, serializer, &setup);
 
         rig_frontend_run_simulator_frame(frontend, serializer, &setup);
 
-        if (pending_edit) {
-            Rig__UIEditResult result = RIG__UIEDIT_RESULT__INIT;
-
-            if (pending_edit->status == false) {
-                result.has_status = true;
-                result.status = false;
-            }
-
-            pending_edit->closure(&result, pending_edit->closure_data);
-
-            c_slice_free(pending_edit_t, pending_edit);
-        }
+        report_pending_edits(slave, n_edits);
 
         rig_pb_serializer_destroy(serializer);
 
@@ -808,11 +934,8 @@ rig_slave_paint(rut_shell_t *shell, void *user_data)
 
     rut_shell_end_redraw(shell);
 
-    /* XXX: It would probably be better if we could send multiple
-     * Rig__UIEdits in one go when setting up a simulator frame so we
-     * wouldn't need to use this trick of continuously queuing redraws
-     * to flush the edits through to the simulator.
-     */
+    /* Edits received while the simulator was busy will be forwarded
+     * with the next frame */
     if (rig_engine_check_timelines(engine) || slave->pending_edits->len) {
         rut_shell_queue_redraw(shell);
     }
@@ -826,6 +949,8 @@ _rig_slave_free(void *object)
     if (slave->frontend)
         rut_object_unref(slave->frontend);
 
+    c_hash_table_destroy(slave->blob_cache);
+
     rut_object_unref(slave->shell);
     rut_object_unref(slave->shell);
 
@@ -850,6 +975,8 @@ rig_slave_new(int width, int height, int scale)
     slave->request_height = height;
     slave->request_scale = scale;
 
+    slave->blob_cache = blob_cache_new();
+
     slave->shell = rut_shell_new(rig_slave_paint,
                                  slave);
 
@@ -43,11 +43,127 @@
 
 #include "rig.pb-c.h"
 
+static Rig__UI *
+serialize_ui(rig_slave_master_t *master, rig_pb_serializer_t *serializer)
+{
+    rig_engine_t *engine = master->engine;
+
+    rig_pb_serializer_set_use_pointer_ids_enabled(serializer, true);
+
+    /* Buffer contents are sent as blobs so that any the slave already
+     * has can be skipped */
+    rig_pb_serializer_set_blobs_enabled(serializer, true);
+
+    /* NB: We always use the edit-mode-ui as the basis for any ui sent
+     * to a slave device so that the slave device can maintain a mapping
+     * from edit-mode IDs to its play-mode IDs so that we can handle
+     * edit operations in the slave.
+     */
+    return rig_pb_serialize_ui(serializer, true, engine->edit_mode_ui);
+}
+
+static void
+drop_pending_ui(rig_slave_master_t *master)
+{
+    if (master->pending_ui) {
+        rig_pb_serialized_ui_destroy(master->pending_ui);
+        master->pending_ui = NULL;
+        rig_pb_serializer_destroy(master->pending_serializer);
+        master->pending_serializer = NULL;
+    }
+}
+
 static void
 handle_load_response(const Rig__LoadResult *result,
                      void *closure_data)
 {
+    rig_slave_master_t *master = closure_data;
+
     c_debug("UI loaded by slave\n");
+
+    master->ui_push_pending = false;
+
+    if (master->reload_queued) {
+        master->reload_queued = false;
+        rig_slave_master_reload_ui(master);
+    }
+}
+
+static void
+handle_query_blobs_response(const Rig__BlobQueryResult *result,
+                            void *closure_data)
+{
+    rig_slave_master_t *master = closure_data;
+    ProtobufCService *service =
+        rig_pb_rpc_client_get_service(master->peer->pb_rpc_client);
+    Rig__UI *pb_ui = master->pending_ui;
+    c_hash_table_t *known;
+
+    /* The UI was dropped because it changed while waiting */
+    if (!pb_ui) {
+        master->ui_push_pending = false;
+        master->reload_queued = false;
+        rig_slave_master_reload_ui(master);
+        return;
+    }
+
+    c_debug("Slave already has %d blobs\n", (int)result->n_known_hashes);
+
+    known = c_hash_table_new(c_int64_hash, c_int64_equal);
+    for (int i = 0; i < result->n_known_hashes; i++)
+        c_hash_table_insert(known,
+                            &result->known_hashes[i],
+                            &result->known_hashes[i]);
+
+    for (int i = 0; i < pb_ui->n_blobs; i++) {
+        Rig__Blob *pb_blob = pb_ui->blobs[i];
+
+        if (c_hash_table_lookup(known, &pb_blob->hash))
+            pb_blob->has_data = false;
+    }
+
+    c_hash_table_destroy(known);
+
+    rig__slave__load(service, pb_ui, handle_load_response, master);
+
+    drop_pending_ui(master);
+}
+
+/* The slave only keeps the blobs of the last UI it loaded so before
+ * pushing a UI we ask which of its blobs the slave already has. The
+ * UI is only serialized once, with all of its blob data, and the data
+ * of blobs the slave has is omitted when it is sent. */
+static void
+query_slave_blobs(rig_slave_master_t *master)
+{
+    ProtobufCService *service =
+        rig_pb_rpc_client_get_service(master->peer->pb_rpc_client);
+    Rig__BlobQuery query = RIG__BLOB_QUERY__INIT;
+    Rig__UI *pb_ui;
+
+    master->pending_serializer = rig_pb_serializer_new(master->engine);
+    master->pending_ui = pb_ui =
+        serialize_ui(master, master->pending_serializer);
+
+    query.n_hashes = pb_ui->n_blobs;
+    query.hashes = c_new(uint64_t, pb_ui->n_blobs);
+    for (int i = 0; i < pb_ui->n_blobs; i++)
+        query.hashes[i] = pb_ui->blobs[i]->hash;
+
+    master->ui_push_pending = true;
+
+    rig__slave__query_blobs(service, &query,
+                            handle_query_blobs_response, master);
+
+    c_free(query.hashes);
+}
+
+static void
+reset_ui_push(rig_slave_master_t *master)
+{
+    drop_pending_ui(master);
+    master->ui_push_pending = false;
+    master->reload_queued = false;
 }
 
 static void
@@ -61,9 +177,12 @@ master_peer_connected(rig_pb_rpc_client_t *pb_client, void *user_data)
                             rig_slave_master_connected_func_t,
                             master);
 
+    /* The slave may still have blobs cached from a previous
+     * connection, which the blob query will tell us */
+    reset_ui_push(master);
     rig_slave_master_reload_ui(master);
 
-    c_debug("XXXXXXXXXXXX Slave Connected and serialized UI sent!");
+    c_debug("XXXXXXXXXXXX Slave Connected and blob query sent!");
 }
 
 static void
@@ -76,6 +195,8 @@ master_stop_service(rig_slave_master_t *master)
 
     master->connected = false;
 
+    reset_ui_push(master);
+
     rut_closure_list_invoke(&master->on_error_closures,
                             rig_slave_master_error_func_t,
                             master);
@@ -267,31 +388,17 @@ rig_slave_master_add_on_error_callback(rig_slave_master_t *master,
 void
 rig_slave_master_reload_ui(rig_slave_master_t *master)
 {
-    rig_pb_serializer_t *serializer;
-    rig_engine_t *engine = master->engine;
-    ProtobufCService *service =
-        rig_pb_rpc_client_get_service(master->peer->pb_rpc_client);
-    Rig__UI *pb_ui;
-
     if (!master->connected)
         return;
 
-    serializer = rig_pb_serializer_new(engine);
-
-    rig_pb_serializer_set_use_pointer_ids_enabled(serializer, true);
-
-    /* NB: We always use the edit-mode-ui as the basis for any ui sent
-     * to a slave device so that the slave device can maintain a mapping
-     * from edit-mode IDs to its play-mode IDs so that we can handle
-     * edit operations in the slave.
-     */
-    pb_ui = rig_pb_serialize_ui(serializer, true, engine->edit_mode_ui);
-
-    rig__slave__load(service, pb_ui, handle_load_response, NULL);
-
-    rig_pb_serialized_ui_destroy(pb_ui);
+    if (master->ui_push_pending) {
+        /* A UI that hasn't been sent yet is out of date now */
+        drop_pending_ui(master);
+        master->reload_queued = true;
+        return;
+    }
 
-    rig_pb_serializer_destroy(serializer);
+    query_slave_blobs(master);
 }
 
 static void
@@ -311,5 +418,12 @@ rig_slave_master_forward_pb_ui_edit(rig_slave_master_t *master,
     if (!master->connected)
         return;
 
+    /* The slave would apply the edit before loading a UI that was
+     * serialized without it, so the UI is serialized again instead */
+    if (master->pending_ui) {
+        rig_slave_master_reload_ui(master);
+        return;
+    }
+
     rig__slave__edit(service, pb_ui_edit, handle_edit_response, NULL);
 }
@@ -37,6 +37,7 @@
 #include "rig-slave-address.h"
 #include "rig-rpc-network.h"
 #include "rig-engine.h"
+#include "rig-pb.h"
 
 typedef struct _rig_slave_master_t {
     rut_object_base_t _base;
@@ -56,6 +57,17 @@ typedef struct _rig_slave_master_t {
 
     c_hash_table_t *registry;
 
+    /* A UI serialized with all of its blob data, waiting to be sent
+     * once the slave has said which of those blobs it already has */
+    rig_pb_serializer_t *pending_serializer;
+    Rig__UI *pending_ui;
+
+    /* Set from querying the slave's blobs until the slave has loaded
+     * the UI, since the slave only changes its blob cache while
+     * loading. Reloads requested meanwhile are queued. */
+    bool ui_push_pending;
+    bool reload_queued;
+
 } rig_slave_master_t;
 
 rig_slave_master_t *
@@ -87,6 +87,10 @@ struct _rig_slave_t {
     c_hash_table_t *edit_id_to_play_object_map;
     c_hash_table_t *play_object_to_edit_id_map;
 
+    /* The buffer contents of the last UI loaded, indexed by content
+     * hash so the master can avoid resending them */
+    c_hash_table_t *blob_cache;
+
     rig_pb_unserializer_t *ui_unserializer;
 
     rig_engine_op_map_context_t map_op_ctx;
@@ -171,6 +171,13 @@ struct _rig_shaped_paragraph_t {
 
     UChar *utf16_text;
 
+    /* Used to match up unchanged paragraphs when the text is reshaped */
+    unsigned int hash;
+    rig_sized_face_set_t *faceset;
+
+    /* The current wrapping of this paragraph, if any */
+    rig_wrapped_paragraph_t *wrapped;
+
     rig_text_run_t text_run;
 
     c_llist_t *markup;
@@ -214,6 +221,9 @@ struct _rig_wrapped_paragraph_t {
      * x offset from right to left for the paragraph. */
     hb_position_t flow_offset;
 
+    /* The sum of the leading for all lines */
+    hb_position_t height;
+
     c_list_t fixed_runs;
 
 };
@@ -97,6 +97,11 @@ typedef struct _shape_context_t {
     c_list_t shaped_paras;
     rig_shaped_paragraph_t *current_para;
 
+    /* Paragraphs from the previous shaping that may be reused,
+     * indexed by their hash */
+    c_list_t old_paras;
+    c_hash_table_t *old_paras_hash;
+
 } shape_context_t;
 
 typedef enum _alignment_t {
@@ -909,6 +914,8 @@ shaped_paragraph_new(shape_context_t *ctx,
     itemizer_t itemizer;
 
     shaped_para->utf16_text = utf16_para;
+    shaped_para->faceset = ctx->faceset;
+    shaped_para->wrapped = NULL;
 
     shaped_para->text_run.start = 0;
     shaped_para->text_run.end = utf16_para_len;
@@ -1184,14 +1191,74 @@ shaped_run_find_next_wrap_pos(wrap_state_t *wrap_state,
     }
 }
 
+static unsigned int
+hash_utf16(const UChar *utf16_text, int len)
+{
+    unsigned int hash = 2166136261u; /* FNV-1a */
+    int i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= utf16_text[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* Finds a paragraph from the previous shaping with the same content
+ * and formatting, which can be reused instead of being reshaped */
+static rig_shaped_paragraph_t *
+take_old_paragraph(shape_context_t *ctx,
+                   unsigned int hash,
+                   const UChar *utf16_para,
+                   int utf16_para_len)
+{
+    void *key = C_UINT_TO_POINTER(hash);
+    c_llist_t *paras = c_hash_table_lookup(ctx->old_paras_hash, key);
+    c_llist_t *l;
+
+    for (l = paras; l; l = l->next) {
+        rig_shaped_paragraph_t *old_para = l->data;
+
+        if (old_para->faceset == ctx->faceset &&
+            old_para->markup == NULL &&
+            old_para->text_run.end == utf16_para_len &&
+            memcmp(old_para->utf16_text,
+                   utf16_para,
+                   utf16_para_len * sizeof(UChar)) == 0) {
+            paras = c_llist_delete_link(paras, l);
+            if (paras)
+                c_hash_table_insert(ctx->old_paras_hash, key, paras);
+            else
+                c_hash_table_remove(ctx->old_paras_hash, key);
+
+            c_list_remove(&old_para->link);
+
+            return old_para;
+        }
+    }
+
+    return NULL;
+}
+
 static void
 shape_paragraph_cb(UChar *utf16_para, int utf16_para_len, void *user_data)
 {
     shape_context_t *ctx = user_data;
     rig_text_engine_t *text_engine = ctx->text_engine;
     rig_shaped_paragraph_t *shaped_para;
+    unsigned int hash = hash_utf16(utf16_para, utf16_para_len);
+
+    shaped_para =
+        take_old_paragraph(ctx, hash, utf16_para, utf16_para_len);
+
+    if (shaped_para)
+        c_free(utf16_para);
+    else {
+        shaped_para = shaped_paragraph_new(ctx, utf16_para, utf16_para_len);
+        shaped_para->hash = hash;
+    }
 
-    shaped_para = shaped_paragraph_new(ctx, utf16_para, utf16_para_len);
     c_list_insert(text_engine->shaped_paras.prev, &shaped_para->link);
 }
 
@@ -1527,7 +1594,7 @@ newline_cb(wrap_state_t *wrap_state)
     }
 
     wrap_state->baseline += wrap_state->max_leading;
-    wrap_state->text_engine->height += wrap_state->max_leading;
+    wrap_state->wrapped_para->height += wrap_state->max_leading;
 
     c_list_for_each(fixed_run, &wrap_state->unaligned, link)
     {
@@ -1644,6 +1711,7 @@ wrap_paragraph(rig_text_engine_t *text_engine,
     wrapped_para = c_slice_new(rig_wrapped_paragraph_t);
     wrapped_para->shaped_para = para;
     wrapped_para->wrap_width = wrap_width;
+    wrapped_para->height = 0;
 
     c_list_init(&wrapped_para->fixed_runs);
 
@@ -1660,6 +1728,8 @@ fixed_run_free(rig_fixed_run_t *run)
     c_slice_free(rig_fixed_run_t, run);
 }
 
+/* Note: this also unlinks the paragraph from the text engine's list
+ * of wrapped paragraphs */
 static void
 wrapped_paragraph_free(rig_wrapped_paragraph_t *para)
 {
@@ -1670,36 +1740,41 @@ wrapped_paragraph_free(rig_wrapped_paragraph_t *para)
         fixed_run_free(run);
     }
 
+    if (para->shaped_para->wrapped == para)
+        para->shaped_para->wrapped = NULL;
+
+    c_list_remove(&para->link);
+
     c_slice_free(rig_wrapped_paragraph_t, para);
 }
 
+/* Note: this also frees any wrapping of the paragraph */
 static void
-queue_wrap(rig_text_engine_t *text_engine)
+discard_shaped_paragraph(rig_shaped_paragraph_t *para)
 {
-    rig_wrapped_paragraph_t *wrapped_para, *tmp_wrapped_para;
+    if (para->wrapped)
+        wrapped_paragraph_free(para->wrapped);
 
-    c_list_for_each_safe(wrapped_para, tmp_wrapped_para,
-                           &text_engine->wrapped_paras, link)
-    {
-        wrapped_paragraph_free(wrapped_para);
-    }
+    c_list_remove(&para->link);
+
+    shaped_paragraph_free(para);
+}
 
+/* Paragraphs are only rewrapped if their shaping or the wrap width
+ * has changed */
+static void
+queue_wrap(rig_text_engine_t *text_engine)
+{
     text_engine->needs_wrap = 1;
 }
 
+/* Paragraphs whose text and formatting haven't changed will be
+ * reused when the text is reshaped */
 static void
 queue_shape(rig_text_engine_t *text_engine)
 {
-    rig_shaped_paragraph_t *shaped_para, *tmp_shaped_para;
-
     queue_wrap(text_engine);
 
-    c_list_for_each_safe(shaped_para, tmp_shaped_para,
-                           &text_engine->shaped_paras, link)
-    {
-        shaped_paragraph_free(shaped_para);
-    }
-
     text_engine->needs_shape = 1;
 }
 
@@ -1707,8 +1782,13 @@ static void
 _rig_text_engine_free(void *object)
 {
     rig_text_engine_t *text_engine = object;
+    rig_shaped_paragraph_t *shaped_para, *tmp_shaped_para;
 
-    queue_shape(text_engine);
+    c_list_for_each_safe(shaped_para, tmp_shaped_para,
+                         &text_engine->shaped_paras, link)
+    {
+        discard_shaped_paragraph(shaped_para);
+    }
 
     rut_closure_list_disconnect_all_FIXME(&text_engine->on_wrap_closures);
 
@@ -1759,12 +1839,33 @@ rig_text_engine_set_utf8_static(rig_text_engine_t *text_engine,
 {
     text_engine->utf8_text = utf8_text;
     text_engine->utf8_text_len = len >= 0 ? len : strlen(utf8_text);
+
+    queue_shape(text_engine);
+}
+
+void
+rig_text_engine_set_wrap_width(rig_text_engine_t *text_engine, int width)
+{
+    if (text_engine->wrap_width == width)
+        return;
+
+    text_engine->wrap_width = width;
+
+    /* Note: the shaping is unaffected by the wrap width */
+    queue_wrap(text_engine);
+}
+
+static void
+free_old_paras_cb(void *key, void *value, void *user_data)
+{
+    c_llist_free(value);
 }
 
 void
 rig_text_engine_shape(rig_text_engine_state_t *text_state,
                       rig_text_engine_t *text_engine)
 {
+    rig_shaped_paragraph_t *shaped_para, *tmp_shaped_para;
     shape_context_t ctx;
 
     if (!text_engine->needs_shape)
@@ -1778,6 +1879,22 @@ rig_text_engine_shape(rig_text_engine_state_t *text_state,
 
     c_list_init(&ctx.shaped_paras);
 
+    /* Move the current paragraphs aside so that any that are
+     * unchanged can be reused... */
+    c_list_init(&ctx.old_paras);
+    c_list_append_list(&ctx.old_paras, &text_engine->shaped_paras);
+    c_list_init(&text_engine->shaped_paras);
+
+    ctx.old_paras_hash = c_hash_table_new(NULL, NULL);
+    c_list_for_each(shaped_para, &ctx.old_paras, link)
+    {
+        void *key = C_UINT_TO_POINTER(shaped_para->hash);
+        c_llist_t *paras = c_hash_table_lookup(ctx.old_paras_hash, key);
+
+        c_hash_table_insert(ctx.old_paras_hash, key,
+                            c_llist_prepend(paras, shaped_para));
+    }
+
     ctx.hb_buf = hb_buffer_create();
 
     foreach_paragraph(ctx.state,
@@ -1786,7 +1903,16 @@ rig_text_engine_shape(rig_text_engine_state_t *text_state,
 
     hb_buffer_destroy(ctx.hb_buf);
 
+    c_hash_table_foreach(ctx.old_paras_hash, free_old_paras_cb, NULL);
+    c_hash_table_destroy(ctx.old_paras_hash);
+
+    c_list_for_each_safe(shaped_para, tmp_shaped_para, &ctx.old_paras, link)
+    {
+        discard_shaped_paragraph(shaped_para);
+    }
+
     text_engine->needs_shape = 0;
+    text_engine->needs_wrap = 1;
 }
 
 void
@@ -1794,6 +1920,8 @@ rig_text_engine_wrap(rig_text_engine_state_t *text_state,
                      rig_text_engine_t *text_engine)
 {
     rig_shaped_paragraph_t *shaped_para;
+    rig_wrapped_paragraph_t *wrapped_para, *tmp_wrapped_para;
+    c_list_t wrapped_paras;
 
     if (text_engine->needs_shape)
         rig_text_engine_shape(text_state, text_engine);
@@ -1804,14 +1932,42 @@ rig_text_engine_wrap(rig_text_engine_state_t *text_state,
     text_engine->width = text_engine->wrap_width;
     text_engine->height = 0;
 
+    c_list_init(&wrapped_paras);
+
     c_list_for_each(shaped_para, &text_engine->shaped_paras, link)
     {
-        rig_wrapped_paragraph_t *wrapped_para =
-            wrap_paragraph(text_engine, text_state,
-                           shaped_para, text_engine->wrap_width);
-        c_list_insert(text_engine->wrapped_paras.prev, &wrapped_para->link);
+        wrapped_para = shaped_para->wrapped;
+
+        /* Only paragraphs that have been reshaped or that were wrapped
+         * with a different width need to be rewrapped */
+        if (wrapped_para &&
+            wrapped_para->wrap_width != text_engine->wrap_width)
+            wrapped_paragraph_free(wrapped_para);
+
+        wrapped_para = shaped_para->wrapped;
+        if (wrapped_para)
+            c_list_remove(&wrapped_para->link);
+        else {
+            wrapped_para = wrap_paragraph(text_engine, text_state,
+                                          shaped_para,
+                                          text_engine->wrap_width);
+            shaped_para->wrapped = wrapped_para;
+        }
+
+        c_list_insert(wrapped_paras.prev, &wrapped_para->link);
+
+        text_engine->height += wrapped_para->height;
+    }
+
+    /* Anything left over is no longer associated with a paragraph */
+    c_list_for_each_safe(wrapped_para, tmp_wrapped_para,
+                         &text_engine->wrapped_paras, link)
+    {
+        wrapped_paragraph_free(wrapped_para);
     }
 
+    c_list_append_list(&text_engine->wrapped_paras, &wrapped_paras);
+
     text_engine->needs_wrap = 0;
 
     rut_closure_list_invoke(&text_engine->on_wrap_closures,
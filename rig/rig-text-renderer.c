@@ -57,6 +57,15 @@ struct _rig_text_renderer_state_t {
     rig_glyph_cache_t *glyph_cache;
     rig_text_pipeline_cache_t *pipeline_cache;
 
+    /* Maps a rig_text_engine_t to its text_draw_cache_t */
+    c_hash_table_t *draw_caches;
+    c_list_t draw_cache_list;
+
+    /* Incremented whenever a glyph atlas is reorganized so that
+     * cached glyph geometry can be recognised as stale */
+    unsigned int atlas_age;
+    rut_closure_t reorganize_closure;
+
     // cg_pipeline_t *debug_pipeline;
 };
 
@@ -522,33 +531,6 @@ print_utf16(const UChar *utf16_text, int len)
     c_free(utf8_text);
 }
 
-static void
-wrapped_para_ensure_glyphs(rig_text_renderer_state_t *render_state,
-                           rig_wrapped_paragraph_t *para)
-{
-    rig_glyph_cache_t *glyph_cache = render_state->glyph_cache;
-    rig_fixed_run_t *run;
-
-    c_list_for_each(run, &para->fixed_runs, link)
-    {
-        rig_glyph_info_t *glyphs = run->glyph_run.glyphs;
-        int n_glyphs = run->glyph_run.n_glyphs;
-        rig_shaped_run_t *shaped_run = run->shaped_run;
-        rig_sized_face_set_t *faceset = shaped_run->faceset;
-        rig_sized_face_t *face = shaped_run->face;
-        int i;
-
-        for (i = 0; i < n_glyphs; i++) {
-            glyph_cache_lookup(render_state,
-                               glyph_cache,
-                               true, /* create */
-                               faceset,
-                               face,
-                               glyphs[i].glyph_index);
-        }
-    }
-}
-
 typedef struct _SpannerRenderState {
     int width;
     int height;
@@ -653,22 +635,216 @@ render_dirty_glyph_to_cache_cb(rig_sized_face_t *face,
     c_free(spanner_state.data);
 }
 
+/* Glyphs are drawn with one primitive for each atlas texture used by
+ * a text component. The primitives are cached until the text is
+ * re-wrapped or a glyph atlas is reorganized. */
+
+/* The largest number of glyphs that can be drawn with 16bit indices */
+#define MAX_GLYPHS_PER_BATCH (65536 / 4)
+
+typedef struct _glyph_batch_t {
+    cg_texture_t *texture;
+    cg_pipeline_t *pipeline;
+
+    /* Only used while building the batch */
+    c_array_t *vertices;
+
+    cg_primitive_t *primitive;
+} glyph_batch_t;
+
+typedef struct _text_draw_cache_t {
+    c_list_t link;
+
+    rig_text_renderer_state_t *render_state;
+    rig_text_engine_t *text_engine;
+    rut_closure_t *on_wrap_closure;
+
+    /* The glyph cache entries for every glyph of every fixed run,
+     * resolved once each time the text is wrapped */
+    c_array_t *glyphs;
+    bool glyphs_valid;
+
+    c_array_t *batches;
+    unsigned int atlas_age;
+    bool batches_valid;
+} text_draw_cache_t;
+
+static void
+clear_glyph_batches(text_draw_cache_t *draw_cache)
+{
+    int i;
+
+    for (i = 0; i < draw_cache->batches->len; i++) {
+        glyph_batch_t *batch =
+            &c_array_index(draw_cache->batches, glyph_batch_t, i);
+
+        cg_object_unref(batch->texture);
+        cg_object_unref(batch->pipeline);
+        if (batch->vertices)
+            c_array_free(batch->vertices, true);
+        if (batch->primitive)
+            cg_object_unref(batch->primitive);
+    }
+
+    c_array_set_size(draw_cache->batches, 0);
+    draw_cache->batches_valid = false;
+}
+
+static void
+text_wrapped_cb(rig_text_engine_t *text_engine, void *user_data)
+{
+    text_draw_cache_t *draw_cache = user_data;
+
+    draw_cache->glyphs_valid = false;
+    clear_glyph_batches(draw_cache);
+}
+
+static void
+text_draw_cache_free(void *user_data)
+{
+    text_draw_cache_t *draw_cache = user_data;
+
+    c_hash_table_remove(draw_cache->render_state->draw_caches,
+                        draw_cache->text_engine);
+    c_list_remove(&draw_cache->link);
+
+    clear_glyph_batches(draw_cache);
+    c_array_free(draw_cache->batches, true);
+    c_array_free(draw_cache->glyphs, true);
+
+    c_slice_free(text_draw_cache_t, draw_cache);
+}
+
+static text_draw_cache_t *
+get_text_draw_cache(rig_text_renderer_state_t *render_state,
+                    rig_text_engine_t *text_engine)
+{
+    text_draw_cache_t *draw_cache =
+        c_hash_table_lookup(render_state->draw_caches, text_engine);
+
+    if (draw_cache)
+        return draw_cache;
+
+    draw_cache = c_slice_new0(text_draw_cache_t);
+    draw_cache->render_state = render_state;
+    draw_cache->text_engine = text_engine;
+    draw_cache->glyphs =
+        c_array_new(false, false, sizeof(rig_glyph_cache_value_t *));
+    draw_cache->batches = c_array_new(false, false, sizeof(glyph_batch_t));
+
+    /* The closure is disconnected when the text engine is destroyed
+     * which will also free the cache */
+    draw_cache->on_wrap_closure =
+        rig_text_engine_add_on_wrap_callback(text_engine,
+                                             text_wrapped_cb,
+                                             draw_cache,
+                                             text_draw_cache_free);
+
+    c_hash_table_insert(render_state->draw_caches, text_engine, draw_cache);
+    c_list_insert(&render_state->draw_cache_list, &draw_cache->link);
+
+    return draw_cache;
+}
+
+static void
+atlas_reorganized_cb(void *user_data)
+{
+    rig_text_renderer_state_t *render_state = user_data;
+
+    render_state->atlas_age++;
+}
+
+static void
+resolve_glyphs(rig_text_renderer_state_t *render_state,
+               text_draw_cache_t *draw_cache)
+{
+    rig_text_engine_t *text_engine = draw_cache->text_engine;
+    rig_wrapped_paragraph_t *para;
+
+    c_array_set_size(draw_cache->glyphs, 0);
+
+    c_list_for_each(para, &text_engine->wrapped_paras, link)
+    {
+        rig_fixed_run_t *run;
+
+        c_list_for_each(run, &para->fixed_runs, link)
+        {
+            rig_glyph_info_t *glyphs = run->glyph_run.glyphs;
+            int n_glyphs = run->glyph_run.n_glyphs;
+            rig_shaped_run_t *shaped_run = run->shaped_run;
+            int i;
+
+            for (i = 0; i < n_glyphs; i++) {
+                rig_glyph_cache_value_t *value =
+                    glyph_cache_lookup(render_state,
+                                       render_state->glyph_cache,
+                                       true, /* create */
+                                       shaped_run->faceset,
+                                       shaped_run->face,
+                                       glyphs[i].glyph_index);
+
+                c_array_append_val(draw_cache->glyphs, value);
+            }
+        }
+    }
+
+    draw_cache->glyphs_valid = true;
+}
+
+static glyph_batch_t *
+get_glyph_batch(text_draw_cache_t *draw_cache, cg_texture_t *texture)
+{
+    rig_text_renderer_state_t *render_state = draw_cache->render_state;
+    glyph_batch_t *batch;
+    int i;
+
+    for (i = 0; i < draw_cache->batches->len; i++) {
+        batch = &c_array_index(draw_cache->batches, glyph_batch_t, i);
+
+        if (batch->texture == texture &&
+            batch->vertices->len < MAX_GLYPHS_PER_BATCH * 4)
+            return batch;
+    }
+
+    c_array_set_size(draw_cache->batches, draw_cache->batches->len + 1);
+    batch = &c_array_index(draw_cache->batches, glyph_batch_t, i);
+
+    batch->texture = cg_object_ref(texture);
+    batch->pipeline =
+        rig_text_pipeline_cache_get(render_state->pipeline_cache, texture);
+    batch->vertices = c_array_new(false, false, sizeof(cg_vertex_p2t2_t));
+    batch->primitive = NULL;
+
+    return batch;
+}
+
+static void
+add_glyph_quad(glyph_batch_t *batch,
+               float x1, float y1, float x2, float y2,
+               rig_glyph_cache_value_t *value)
+{
+    int len = batch->vertices->len;
+    cg_vertex_p2t2_t *v;
+
+    c_array_set_size(batch->vertices, len + 4);
+    v = &c_array_index(batch->vertices, cg_vertex_p2t2_t, len);
+
+    /* Vertex order as expected by cg_get_rectangle_indices() */
+    v[0].x = x1; v[0].y = y1; v[0].s = value->tx1; v[0].t = value->ty1;
+    v[1].x = x1; v[1].y = y2; v[1].s = value->tx1; v[1].t = value->ty2;
+    v[2].x = x2; v[2].y = y2; v[2].s = value->tx2; v[2].t = value->ty2;
+    v[3].x = x2; v[3].y = y1; v[3].s = value->tx2; v[3].t = value->ty1;
+}
+
 static hb_position_t
-draw_wrapped_para(rig_text_renderer_state_t *render_state,
-                  rig_paint_context_t *paint_ctx,
-                  hb_position_t baseline_offset,
-                  rig_wrapped_paragraph_t *para)
+batch_wrapped_para(text_draw_cache_t *draw_cache,
+                   hb_position_t baseline_offset,
+                   rig_wrapped_paragraph_t *para,
+                   int *glyph_pos)
 {
-    cg_framebuffer_t *fb = rut_camera_get_framebuffer(paint_ctx->camera);
     hb_position_t baseline = baseline_offset;
     rig_fixed_run_t *run;
 
-    wrapped_para_ensure_glyphs(render_state, para);
-
-    _glyph_cache_set_dirty_glyphs(render_state->glyph_cache,
-                                  render_dirty_glyph_to_cache_cb,
-                                  render_state);
-
     c_list_for_each(run, &para->fixed_runs, link)
     {
         rig_glyph_info_t *glyphs = run->glyph_run.glyphs;
@@ -686,19 +862,14 @@ draw_wrapped_para(rig_text_renderer_state_t *render_state,
         baseline = baseline_offset + run->baseline;
 
         for (i = 0; i < n_glyphs; i++) {
-            rig_glyph_cache_value_t *cached_glyph;
+            rig_glyph_cache_value_t *cached_glyph =
+                c_array_index(draw_cache->glyphs,
+                              rig_glyph_cache_value_t *,
+                              (*glyph_pos)++);
             rig_glyph_info_t *glyph = &glyphs[i];
-            cg_pipeline_t *pipeline;
             hb_position_t glyph_x;
             float x, y;
 
-            cached_glyph = glyph_cache_lookup(render_state,
-                                              render_state->glyph_cache,
-                                              true, /* create */
-                                              shaped_run->faceset,
-                                              shaped_run->face,
-                                              glyphs[i].glyph_index);
-
             if (rtl) {
                 x_advance += glyph->x_advance;
                 glyph_x = start_x + run_width - x_advance + glyph->x_offset;
@@ -707,6 +878,10 @@ draw_wrapped_para(rig_text_renderer_state_t *render_state,
                 x_advance += glyph->x_advance;
             }
 
+            /* Zero-sized glyphs aren't allocated any atlas space */
+            if (cached_glyph == NULL || cached_glyph->texture == NULL)
+                continue;
+
             if (hinting) {
                 x = (int)((round_26_6(glyph_x) / 64) + cached_glyph->draw_x);
                 y = (int)((round_26_6(baseline) / 64) - cached_glyph->draw_y);
@@ -715,43 +890,93 @@ draw_wrapped_para(rig_text_renderer_state_t *render_state,
                 y = (baseline / 64.f) - cached_glyph->draw_y;
             }
 
-            pipeline = rig_text_pipeline_cache_get(render_state->pipeline_cache,
-                                                   cached_glyph->texture);
-
-            cg_framebuffer_draw_textured_rectangle(
-                fb,
-                pipeline,
-                x,
-                y - cached_glyph->draw_height,
-                x + cached_glyph->draw_width,
-                y,
-                cached_glyph->tx1,
-                cached_glyph->ty1,
-                cached_glyph->tx2,
-                cached_glyph->ty2);
+            add_glyph_quad(get_glyph_batch(draw_cache, cached_glyph->texture),
+                           x,
+                           y - cached_glyph->draw_height,
+                           x + cached_glyph->draw_width,
+                           y,
+                           cached_glyph);
         }
     }
 
     return baseline;
 }
 
+static void
+build_glyph_batches(rig_text_renderer_state_t *render_state,
+                    text_draw_cache_t *draw_cache)
+{
+    rig_text_engine_t *text_engine = draw_cache->text_engine;
+    cg_device_t *dev = render_state->glyph_cache->dev;
+    hb_position_t baseline_offset = 0;
+    rig_wrapped_paragraph_t *para;
+    int glyph_pos = 0;
+    int i;
+
+    clear_glyph_batches(draw_cache);
+
+    c_list_for_each(para, &text_engine->wrapped_paras, link)
+    {
+        baseline_offset = batch_wrapped_para(draw_cache, baseline_offset,
+                                             para, &glyph_pos);
+
+        /* TODO: Add more space between paragraphs... */
+    }
+
+    for (i = 0; i < draw_cache->batches->len; i++) {
+        glyph_batch_t *batch =
+            &c_array_index(draw_cache->batches, glyph_batch_t, i);
+        int n_vertices = batch->vertices->len;
+        int n_glyphs = n_vertices / 4;
+
+        batch->primitive =
+            cg_primitive_new_p2t2(dev,
+                                  CG_VERTICES_MODE_TRIANGLES,
+                                  n_vertices,
+                                  (cg_vertex_p2t2_t *)batch->vertices->data);
+        cg_primitive_set_indices(batch->primitive,
+                                 cg_get_rectangle_indices(dev, n_glyphs),
+                                 n_glyphs * 6);
+
+        c_array_free(batch->vertices, true);
+        batch->vertices = NULL;
+    }
+
+    draw_cache->atlas_age = render_state->atlas_age;
+    draw_cache->batches_valid = true;
+}
+
 void
 rig_text_renderer_draw(rig_paint_context_t *paint_ctx,
                        rig_text_renderer_state_t *render_state,
                        rig_text_t *text)
 {
+    cg_framebuffer_t *fb = rut_camera_get_framebuffer(paint_ctx->camera);
     rig_text_engine_t *text_engine = text->text_engine;
-    hb_position_t baseline_offset = 0;
-    rig_wrapped_paragraph_t *para;
+    text_draw_cache_t *draw_cache =
+        get_text_draw_cache(render_state, text_engine);
+    int i;
 
     rig_text_engine_wrap(render_state->engine_state, text_engine);
 
-    c_list_for_each(para, &text_engine->wrapped_paras, link)
-    {
-        baseline_offset =
-            draw_wrapped_para(render_state, paint_ctx, baseline_offset, para);
+    if (!draw_cache->glyphs_valid)
+        resolve_glyphs(render_state, draw_cache);
 
-        /* TODO: Add more space between paragraphs... */
+    /* Note: adding new glyphs to the cache may have reorganized an
+     * atlas which will have also marked the moved glyphs as dirty */
+    _glyph_cache_set_dirty_glyphs(render_state->glyph_cache,
+                                  render_dirty_glyph_to_cache_cb,
+                                  render_state);
+
+    if (!draw_cache->batches_valid ||
+        draw_cache->atlas_age != render_state->atlas_age)
+        build_glyph_batches(render_state, draw_cache);
+
+    for (i = 0; i < draw_cache->batches->len; i++) {
+        glyph_batch_t *batch =
+            &c_array_index(draw_cache->batches, glyph_batch_t, i);
+
+        cg_primitive_draw(batch->primitive, fb, batch->pipeline);
     }
 }
 
@@ -772,12 +997,28 @@ rig_text_renderer_state_new(rig_frontend_t *frontend)
     render_state->pipeline_cache = rig_text_pipeline_cache_new(
         shell->cg_device, true /* use mipmaping */);
 
+    render_state->draw_caches = c_hash_table_new(NULL, NULL);
+    c_list_init(&render_state->draw_cache_list);
+
+    rut_closure_init(&render_state->reorganize_closure,
+                     atlas_reorganized_cb,
+                     render_state);
+    _glyph_cache_add_reorganize_closure(render_state->glyph_cache,
+                                        &render_state->reorganize_closure);
+
     return render_state;
 }
 
 void
 rig_text_renderer_state_destroy(rig_text_renderer_state_t *render_state)
 {
+    text_draw_cache_t *draw_cache, *tmp;
+
+    /* Disconnecting the on-wrap closures frees the caches */
+    c_list_for_each_safe(draw_cache, tmp, &render_state->draw_cache_list, link)
+        rut_closure_disconnect_FIXME(draw_cache->on_wrap_closure);
+    c_hash_table_destroy(render_state->draw_caches);
+
     rig_glyph_cache_free(render_state->glyph_cache);
     rig_text_pipeline_cache_free(render_state->pipeline_cache);
 
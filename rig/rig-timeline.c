@@ -56,6 +56,17 @@ struct _rig_timeline_t {
     bool running;
     double elapsed;
 
+    /* While running, the timeline's indices into the engine's
+     * running_timelines array and timeline_events heap, otherwise -1.
+     * The event_index may also be -1 while the timeline's end is
+     * being handled in _rig_timeline_progress_running(). */
+    int running_index;
+    int event_index;
+
+    /* When the timeline will next reach its end, in terms of the
+     * engine's timeline_clock */
+    double event_time;
+
     rig_introspectable_props_t introspectable;
     rig_property_t properties[RUT_TIMELINE_N_PROPS];
 };
@@ -93,13 +104,141 @@ static rig_property_spec_t _rig_timeline_prop_specs[] = {
     { 0 } /* XXX: Needed for runtime counting of the number of properties */
 };
 
+#define EVENT_TIME(events, index)                                          \
+    (((rig_timeline_t *)c_ptr_array_index(events, index))->event_time)
+
+static void
+swap_events(c_ptr_array_t *events, int a, int b)
+{
+    rig_timeline_t *timeline_a = c_ptr_array_index(events, a);
+    rig_timeline_t *timeline_b = c_ptr_array_index(events, b);
+
+    c_ptr_array_index(events, a) = timeline_b;
+    c_ptr_array_index(events, b) = timeline_a;
+    timeline_a->event_index = b;
+    timeline_b->event_index = a;
+}
+
+static void
+sift_event_up(c_ptr_array_t *events, int index)
+{
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+
+        if (EVENT_TIME(events, parent) <= EVENT_TIME(events, index))
+            break;
+
+        swap_events(events, parent, index);
+        index = parent;
+    }
+}
+
+static void
+sift_event_down(c_ptr_array_t *events, int index)
+{
+    while (true) {
+        int left = index * 2 + 1;
+        int right = left + 1;
+        int smallest = index;
+
+        if (left < events->len &&
+            EVENT_TIME(events, left) < EVENT_TIME(events, smallest))
+            smallest = left;
+        if (right < events->len &&
+            EVENT_TIME(events, right) < EVENT_TIME(events, smallest))
+            smallest = right;
+
+        if (smallest == index)
+            break;
+
+        swap_events(events, index, smallest);
+        index = smallest;
+    }
+}
+
+#undef EVENT_TIME
+
+/* (Re)schedules the point at which the running @timeline will reach
+ * its end, assuming it continues to be progressed */
+static void
+schedule_event(rig_timeline_t *timeline)
+{
+    rig_engine_t *engine = timeline->engine;
+    c_ptr_array_t *events = engine->timeline_events;
+    double remaining;
+
+    if (timeline->direction > 0)
+        remaining = timeline->length - timeline->elapsed;
+    else
+        remaining = timeline->elapsed;
+
+    timeline->event_time =
+        engine->timeline_clock + remaining / abs(timeline->direction);
+
+    if (timeline->event_index < 0) {
+        timeline->event_index = events->len;
+        c_ptr_array_add(events, timeline);
+    }
+
+    sift_event_up(events, timeline->event_index);
+    sift_event_down(events, timeline->event_index);
+}
+
+static void
+unschedule_event(rig_timeline_t *timeline)
+{
+    c_ptr_array_t *events = timeline->engine->timeline_events;
+    int index = timeline->event_index;
+    int last = events->len - 1;
+
+    if (index < 0)
+        return;
+
+    if (index != last)
+        swap_events(events, index, last);
+    c_ptr_array_remove_index_fast(events, last);
+    timeline->event_index = -1;
+
+    if (index != last) {
+        sift_event_up(events, index);
+        sift_event_down(events, index);
+    }
+}
+
+static void
+add_running_timeline(rig_timeline_t *timeline)
+{
+    c_ptr_array_t *running = timeline->engine->running_timelines;
+
+    timeline->running_index = running->len;
+    c_ptr_array_add(running, timeline);
+
+    schedule_event(timeline);
+}
+
+static void
+remove_running_timeline(rig_timeline_t *timeline)
+{
+    c_ptr_array_t *running = timeline->engine->running_timelines;
+    int index = timeline->running_index;
+
+    c_ptr_array_remove_index_fast(running, index);
+    if (index < running->len) {
+        rig_timeline_t *moved = c_ptr_array_index(running, index);
+        moved->running_index = index;
+    }
+    timeline->running_index = -1;
+
+    unschedule_event(timeline);
+}
+
 static void
 _rig_timeline_free(void *object)
 {
     rig_timeline_t *timeline = object;
 
-    timeline->engine->timelines =
-        c_sllist_remove(timeline->engine->timelines, timeline);
+    if (timeline->running)
+        remove_running_timeline(timeline);
     rut_object_unref(timeline->engine);
 
     rig_introspectable_destroy(timeline);
@@ -137,11 +276,14 @@ rig_timeline_new(rig_engine_t *engine, float length)
 
     timeline->elapsed = 0;
 
+    timeline->running_index = -1;
+    timeline->event_index = -1;
+
     rig_introspectable_init(
         timeline, _rig_timeline_prop_specs, timeline->properties);
 
     timeline->engine = rut_object_ref(engine);
-    engine->timelines = c_sllist_prepend(engine->timelines, timeline);
+    add_running_timeline(timeline);
 
     return timeline;
 }
@@ -163,6 +305,11 @@ rig_timeline_set_running(rut_object_t *object, bool running)
 
     timeline->running = running;
 
+    if (running)
+        add_running_timeline(timeline);
+    else
+        remove_running_timeline(timeline);
+
     rig_property_dirty(timeline->engine->property_ctx,
                        &timeline->properties[RUT_TIMELINE_PROP_RUNNING]);
 }
@@ -273,6 +420,9 @@ rig_timeline_set_elapsed(rut_object_t *obj, double elapsed)
         rig_property_dirty(timeline->engine->property_ctx,
                            &timeline->properties[RUT_TIMELINE_PROP_PROGRESS]);
     }
+
+    if (timeline->running)
+        schedule_event(timeline);
 }
 
 double
@@ -341,15 +491,82 @@ rig_timeline_get_loop_enabled(rut_object_t *object)
 }
 
 void
-_rig_timeline_progress(rig_timeline_t *timeline, double delta)
+_rig_timeline_progress_running(rig_engine_t *engine, double delta)
 {
-    double elapsed;
+    c_ptr_array_t *running = engine->running_timelines;
+    c_ptr_array_t *events = engine->timeline_events;
+    c_ptr_array_t *scratch = engine->timelines_scratch;
+    int n_ending;
+    int i;
+
+    engine->timeline_clock += delta;
+
+    /* NB: Binding callbacks may start, stop or even destroy timelines
+     * while we are progressing them so we work from a snapshot of
+     * which timelines to progress, holding a reference on each of
+     * them until we are done.
+     *
+     * First we pop the timelines that will reach their end, and need
+     * to stop or loop...
+     */
+    c_ptr_array_set_size(scratch, 0);
+    while (events->len) {
+        rig_timeline_t *timeline = c_ptr_array_index(events, 0);
+
+        if (timeline->event_time >= engine->timeline_clock)
+            break;
+
+        unschedule_event(timeline);
+        c_ptr_array_add(scratch, rut_object_ref(timeline));
+    }
+    n_ending = scratch->len;
 
-    if (!timeline->running)
-        return;
+    /* Then any remaining running timelines can simply be progressed
+     * without needing to validate their new elapsed time... */
+    for (i = 0; i < running->len; i++) {
+        rig_timeline_t *timeline = c_ptr_array_index(running, i);
 
-    elapsed = rig_timeline_get_elapsed(timeline);
-    elapsed += (delta * timeline->direction);
+        if (timeline->event_index >= 0)
+            c_ptr_array_add(scratch, rut_object_ref(timeline));
+    }
 
-    rig_timeline_set_elapsed(timeline, elapsed);
+    for (i = n_ending; i < scratch->len; i++) {
+        rig_timeline_t *timeline = c_ptr_array_index(scratch, i);
+        double elapsed;
+
+        if (!timeline->running)
+            continue;
+
+        elapsed = timeline->elapsed + delta * timeline->direction;
+
+        /* Be careful that rounding errors can't take us out of range */
+        if (elapsed < 0 || elapsed > timeline->length) {
+            rig_timeline_set_elapsed(timeline, elapsed);
+            continue;
+        }
+
+        if (elapsed != timeline->elapsed) {
+            timeline->elapsed = elapsed;
+            rig_property_dirty(engine->property_ctx,
+                               &timeline->properties[RUT_TIMELINE_PROP_ELAPSED]);
+            rig_property_dirty(
+                engine->property_ctx,
+                &timeline->properties[RUT_TIMELINE_PROP_PROGRESS]);
+        }
+    }
+
+    /* Finally the timelines reaching their end are stopped or looped
+     * and rescheduled by rig_timeline_set_elapsed() */
+    for (i = 0; i < n_ending; i++) {
+        rig_timeline_t *timeline = c_ptr_array_index(scratch, i);
+
+        if (timeline->running) {
+            rig_timeline_set_elapsed(
+                timeline, timeline->elapsed + delta * timeline->direction);
+        }
+    }
+
+    for (i = 0; i < scratch->len; i++)
+        rut_object_unref(c_ptr_array_index(scratch, i));
+    c_ptr_array_set_size(scratch, 0);
 }
@@ -60,4 +60,5 @@ void rig_timeline_set_loop_enabled(rut_object_t *timeline, bool enabled);
 
 bool rig_timeline_get_loop_enabled(rut_object_t *timeline);
 
-void _rig_timeline_progress(rig_timeline_t *timeline, double delta);
+/* Progresses all of the engine's running timelines by @delta */
+void _rig_timeline_progress_running(rig_engine_t *engine, double delta);
@@ -42,6 +42,20 @@
 
 #include "components/rig-material.h"
 
+/* An entry in the scene level picking hierarchy for each entity that
+ * has an input component and a pickable mesh */
+typedef struct _pick_leaf_t {
+    rig_entity_t *entity;
+    rut_mesh_t *mesh;
+
+    /* The inverse of the entity's world transform, used to map rays
+     * into the space of the mesh */
+    c_matrix_t inverse_transform;
+} pick_leaf_t;
+
+static void free_entity_label_index(rig_ui_t *ui);
+static void free_pick_index(rig_ui_t *ui);
+
 struct _rig_ui_grab {
     c_list_t list_node;
     rig_input_grab_callback_t callback;
@@ -94,6 +108,13 @@ _rig_ui_free(void *object)
     if (ui->dso_data)
         c_free(ui->dso_data);
 
+    free_entity_label_index(ui);
+
+    free_pick_index(ui);
+    c_array_free(ui->pick_leaves, true);
+    c_hash_table_destroy(ui->pick_leaf_index);
+    c_hash_table_destroy(ui->pick_dirty_entities);
+
     rut_object_free(rig_ui_t, object);
 }
 
@@ -124,6 +145,9 @@ rig_ui_reap(rig_ui_t *ui)
         ui->scene = NULL;
     }
 
+    free_entity_label_index(ui);
+    free_pick_index(ui);
+
     for (l = ui->controllers; l; l = l->next) {
         rig_controller_t *controller = l->data;
         rig_controller_reap(controller, engine);
@@ -170,6 +194,10 @@ rig_ui_new(rig_engine_t *engine)
         ui->renderer = engine->frontend->renderer;
 
     ui->pick_matrix_stack = rut_matrix_stack_new(engine->shell);
+    ui->pick_leaves = c_array_new(false, false, sizeof(pick_leaf_t));
+    ui->pick_leaf_index = c_hash_table_new(NULL, /* direct hash */
+                                           NULL); /* direct key equal */
+    ui->pick_dirty_entities = c_hash_table_new(NULL, NULL);
     c_list_init(&ui->grabs);
 
     c_list_init(&ui->code_modules);
@@ -188,37 +216,236 @@ rig_ui_set_dso_data(rig_ui_t *ui, uint8_t *data, int len)
     ui->dso_len = len;
 }
 
-typedef struct {
-    const char *label;
-    rig_entity_t *entity;
-} find_entity_data_t;
+static int
+get_graph_depth(rut_object_t *object)
+{
+    int depth = 0;
 
-static rut_traverse_visit_flags_t
-find_entity_cb(rut_object_t *object, int depth, void *user_data)
+    while ((object = rut_graphable_get_parent(object)))
+        depth++;
+
+    return depth;
+}
+
+/* Whether @a is visited before @b in a depth first traversal of the
+ * graph they both belong to */
+static bool
+precedes_depth_first(rut_object_t *a, rut_object_t *b)
 {
-    find_entity_data_t *data = user_data;
+    int depth_a = get_graph_depth(a);
+    int depth_b = get_graph_depth(b);
+    rut_object_t *parent;
+    rut_graphable_props_t *props;
+    rut_queue_item_t *item;
+
+    /* Ancestors are visited before their descendants */
+    for (; depth_a > depth_b; depth_a--) {
+        a = rut_graphable_get_parent(a);
+        if (a == b)
+            return false;
+    }
+    for (; depth_b > depth_a; depth_b--) {
+        b = rut_graphable_get_parent(b);
+        if (b == a)
+            return true;
+    }
+
+    while ((parent = rut_graphable_get_parent(a)) !=
+           rut_graphable_get_parent(b)) {
+        a = parent;
+        b = rut_graphable_get_parent(b);
+    }
 
-    if (rut_object_get_type(object) == &rig_entity_type &&
-        !strcmp(data->label, rig_entity_get_label(object))) {
-        data->entity = object;
-        return RUT_TRAVERSE_VISIT_BREAK;
+    if (!parent)
+        return false;
+
+    /* NB: rig_ui_entity_added_notify() is called before a new child
+     * is appended to its parent's children, so it isn't found here
+     * but it does come after all of its siblings */
+    props = rut_object_get_properties(parent, RUT_TRAIT_ID_GRAPHABLE);
+    c_list_for_each(item, &props->children.items, list_node) {
+        if (item->data == a)
+            return true;
+        if (item->data == b)
+            return false;
+    }
+
+    return false;
+}
+
+/* NB: the entities of a label are kept in depth first order so that
+ * when labels aren't unique the first entity found in a depth first
+ * traversal of the scene is consistently preferred. @in_order can be
+ * set while the index is being built by a depth first traversal, when
+ * @entity is known to come after any entity already indexed. */
+static void
+add_entity_label(rig_ui_t *ui, rig_entity_t *entity, bool in_order)
+{
+    const char *label = rig_entity_get_label(entity);
+    c_llist_t *entities = c_hash_table_lookup(ui->entity_labels, label);
+    c_llist_t *l;
+
+    if (!entities) {
+        c_hash_table_insert(ui->entity_labels,
+                            c_strdup(label),
+                            c_llist_prepend(NULL, entity));
+        return;
     }
 
+    if (in_order) {
+        c_llist_append(entities, entity);
+        return;
+    }
+
+    for (l = entities; l; l = l->next) {
+        if (precedes_depth_first(entity, l->data))
+            break;
+    }
+
+    if (l == entities) {
+        c_hash_table_replace(ui->entity_labels,
+                             c_strdup(label),
+                             c_llist_prepend(entities, entity));
+    } else
+        c_llist_insert_before(entities, l, entity);
+}
+
+static void
+remove_entity_label(rig_ui_t *ui, rig_entity_t *entity, const char *label)
+{
+    c_llist_t *entities = c_hash_table_lookup(ui->entity_labels, label);
+    c_llist_t *remaining = c_llist_remove(entities, entity);
+
+    if (!remaining)
+        c_hash_table_remove(ui->entity_labels, label);
+    else if (remaining != entities)
+        c_hash_table_replace(ui->entity_labels, c_strdup(label), remaining);
+}
+
+static rut_traverse_visit_flags_t
+index_entity_label_cb(rut_object_t *object, int depth, void *user_data)
+{
+    if (rut_object_get_type(object) == &rig_entity_type)
+        add_entity_label(user_data, object, true /* in order */);
+
     return RUT_TRAVERSE_VISIT_CONTINUE;
 }
 
+static rut_traverse_visit_flags_t
+add_entity_label_cb(rut_object_t *object, int depth, void *user_data)
+{
+    if (rut_object_get_type(object) == &rig_entity_type)
+        add_entity_label(user_data, object, false /* in order */);
+
+    return RUT_TRAVERSE_VISIT_CONTINUE;
+}
+
+static rut_traverse_visit_flags_t
+remove_entity_label_cb(rut_object_t *object, int depth, void *user_data)
+{
+    if (rut_object_get_type(object) == &rig_entity_type)
+        remove_entity_label(user_data, object, rig_entity_get_label(object));
+
+    return RUT_TRAVERSE_VISIT_CONTINUE;
+}
+
+static void
+free_entity_label_index(rig_ui_t *ui)
+{
+    c_hash_table_iter_t iter;
+    void *value;
+
+    if (!ui->entity_labels)
+        return;
+
+    c_hash_table_iter_init(&iter, ui->entity_labels);
+    while (c_hash_table_iter_next(&iter, NULL, &value))
+        c_llist_free(value);
+
+    c_hash_table_destroy(ui->entity_labels);
+    ui->entity_labels = NULL;
+}
+
 rig_entity_t *
 rig_ui_find_entity(rig_ui_t *ui, const char *label)
 {
-    find_entity_data_t data = { .label = label, .entity = NULL };
+    c_llist_t *entities;
+
+    if (!ui->scene)
+        return NULL;
+
+    if (!ui->entity_labels) {
+        ui->entity_labels = c_hash_table_new_full(c_str_hash,
+                                                  c_str_equal,
+                                                  c_free,
+                                                  NULL); /* value destroy */
+
+        rut_graphable_traverse(ui->scene,
+                               RUT_TRAVERSE_DEPTH_FIRST,
+                               index_entity_label_cb,
+                               NULL, /* after_children_cb */
+                               ui);
+    }
+
+    entities = c_hash_table_lookup(ui->entity_labels, label);
+
+    return entities ? entities->data : NULL;
+}
+
+static bool
+is_in_scene(rig_ui_t *ui, rut_object_t *object)
+{
+    return ui->scene && rut_graphable_get_root(object) == ui->scene;
+}
+
+void
+rig_ui_entity_added_notify(rig_ui_t *ui,
+                           rig_entity_t *parent,
+                           rut_object_t *child)
+{
+    if (!is_in_scene(ui, parent))
+        return;
+
+    if (ui->entity_labels) {
+        rut_graphable_traverse(child,
+                               RUT_TRAVERSE_DEPTH_FIRST,
+                               add_entity_label_cb,
+                               NULL, /* after_children_cb */
+                               ui);
+    }
+
+    free_pick_index(ui);
+}
+
+void
+rig_ui_entity_removed_notify(rig_ui_t *ui,
+                             rig_entity_t *parent,
+                             rut_object_t *child)
+{
+    if (!is_in_scene(ui, parent))
+        return;
+
+    if (ui->entity_labels) {
+        rut_graphable_traverse(child,
+                               RUT_TRAVERSE_DEPTH_FIRST,
+                               remove_entity_label_cb,
+                               NULL, /* after_children_cb */
+                               ui);
+    }
 
-    rut_graphable_traverse(ui->scene,
-                           RUT_TRAVERSE_DEPTH_FIRST,
-                           find_entity_cb,
-                           NULL, /* after_children_cb */
-                           &data);
+    free_pick_index(ui);
+}
 
-    return data.entity;
+void
+rig_ui_entity_label_changed_notify(rig_ui_t *ui,
+                                   rig_entity_t *entity,
+                                   const char *old_label)
+{
+    if (!ui->entity_labels || !is_in_scene(ui, entity))
+        return;
+
+    remove_entity_label(ui, entity, old_label ? old_label : "");
+    add_entity_label(ui, entity, false /* in order */);
 }
 
 void
@@ -482,187 +709,350 @@ rig_ui_code_modules_handle_input(rig_ui_t *ui, rut_input_event_t *event)
     }
 }
 
-static void
-transform_ray(c_matrix_t *transform,
-              bool inverse_transform,
-              float ray_origin[3],
-              float ray_direction[3])
+static rut_mesh_t *
+get_pick_mesh(rig_entity_t *entity)
 {
-    c_matrix_t inverse, normal_matrix, *m;
+    rut_component_t *geometry;
 
-    m = transform;
-    if (inverse_transform) {
-        c_matrix_get_inverse(transform, &inverse);
-        m = &inverse;
+    if (!rig_entity_get_component(entity, RIG_COMPONENT_TYPE_INPUT))
+        return NULL;
+
+    geometry = rig_entity_get_component(entity, RIG_COMPONENT_TYPE_GEOMETRY);
+    if (!geometry || !rut_object_is(geometry, RUT_TRAIT_ID_MESHABLE))
+        return NULL;
+
+    return rut_meshable_get_mesh(geometry);
+}
+
+/* Updates a leaf for the current mesh and transform of its entity and
+ * returns the world space bounds of the mesh */
+static void
+update_pick_leaf(pick_leaf_t *leaf,
+                 rut_mesh_t *mesh,
+                 const c_matrix_t *transform,
+                 float bounds[6])
+{
+    rut_bvh_t *mesh_bvh;
+    float mesh_bounds[6];
+    int i;
+
+    if (leaf->mesh != mesh) {
+        if (mesh)
+            rut_object_ref(mesh);
+        if (leaf->mesh)
+            rut_object_unref(leaf->mesh);
+        leaf->mesh = mesh;
     }
 
-    c_matrix_transform_points(m,
-                               3, /* num components for input */
-                               sizeof(float) * 3, /* input stride */
-                               ray_origin,
-                               sizeof(float) * 3, /* output stride */
-                               ray_origin,
-                               1 /* n_points */);
+    c_matrix_get_inverse(transform, &leaf->inverse_transform);
 
-    c_matrix_get_inverse(m, &normal_matrix);
-    c_matrix_transpose(&normal_matrix);
+    mesh_bvh = mesh ? rut_mesh_get_bvh(mesh, NULL) : NULL;
+    if (!mesh_bvh || rut_bvh_get_n_primitives(mesh_bvh) == 0) {
+        /* Give the leaf inverted bounds so no ray can hit it */
+        bounds[0] = bounds[1] = bounds[2] = FLT_MAX;
+        bounds[3] = bounds[4] = bounds[5] = -FLT_MAX;
+        return;
+    }
 
-    rut_util_transform_normal(&normal_matrix,
-                              &ray_direction[0],
-                              &ray_direction[1],
-                              &ray_direction[2]);
+    rut_bvh_get_bounds(mesh_bvh, mesh_bounds);
+
+    for (i = 0; i < 8; i++) {
+        float x = mesh_bounds[(i & 1) ? 3 : 0];
+        float y = mesh_bounds[(i & 2) ? 4 : 1];
+        float z = mesh_bounds[(i & 4) ? 5 : 2];
+        float w = 1;
+
+        c_matrix_transform_point(transform, &x, &y, &z, &w);
+
+        if (i == 0) {
+            bounds[0] = bounds[3] = x;
+            bounds[1] = bounds[4] = y;
+            bounds[2] = bounds[5] = z;
+        } else {
+            bounds[0] = MIN(bounds[0], x);
+            bounds[1] = MIN(bounds[1], y);
+            bounds[2] = MIN(bounds[2], z);
+            bounds[3] = MAX(bounds[3], x);
+            bounds[4] = MAX(bounds[4], y);
+            bounds[5] = MAX(bounds[5], z);
+        }
+    }
 }
 
-typedef struct _pick_context_t {
+typedef struct _pick_index_state_t {
     rig_ui_t *ui;
-    rig_engine_t *engine;
-    rut_object_t *camera;
     rut_matrix_stack_t *matrix_stack;
-    float x;
-    float y;
-    float *ray_origin;
-    float *ray_direction;
-    rig_entity_t *selected_entity;
-    float selected_distance;
-    int selected_index;
-} pick_context_t;
+
+    /* When building we collect the bounds of every leaf, otherwise
+     * we are refitting the existing leaves of a sub-graph */
+    c_array_t *bounds;
+} pick_index_state_t;
 
 static rut_traverse_visit_flags_t
-entitygraph_pre_pick_cb(rut_object_t *object, int depth, void *user_data)
+pick_index_pre_cb(rut_object_t *object, int depth, void *user_data)
 {
-    pick_context_t *pick_ctx = user_data;
+    pick_index_state_t *state = user_data;
+    rig_ui_t *ui = state->ui;
+    rut_mesh_t *mesh;
+    c_matrix_t transform;
+    float bounds[6];
 
     if (rut_object_is(object, RUT_TRAIT_ID_TRANSFORMABLE)) {
         const c_matrix_t *matrix = rut_transformable_get_matrix(object);
-        rut_matrix_stack_push(pick_ctx->matrix_stack);
-        rut_matrix_stack_multiply(pick_ctx->matrix_stack, matrix);
+        rut_matrix_stack_push(state->matrix_stack);
+        rut_matrix_stack_multiply(state->matrix_stack, matrix);
     }
 
-    if (rut_object_get_type(object) == &rig_entity_type) {
-        rig_entity_t *entity = object;
-        rut_component_t *geometry;
-        rut_mesh_t *mesh;
-        int index;
-        float distance;
-        bool hit;
-        float transformed_ray_origin[3];
-        float transformed_ray_direction[3];
-        c_matrix_t transform;
-        rut_object_t *input;
-
-        input = rig_entity_get_component(entity, RIG_COMPONENT_TYPE_INPUT);
-        if (!input)
-            return RUT_TRAVERSE_VISIT_CONTINUE;
-
-#if 0
-        if (rut_object_is(input, RUT_TRAIT_ID_PICKABLE)) {
-            rut_matrix_stack_get(pick_ctx->matrix_stack, &transform);
-
-            if (rut_pickable_pick(input,
-                                  pick_ctx->camera,
-                                  &transform,
-                                  pick_ctx->x,
-                                  pick_ctx->y)) {
-                pick_ctx->selected_entity = entity;
-                return RUT_TRAVERSE_VISIT_BREAK;
-            } else
-                return RUT_TRAVERSE_VISIT_CONTINUE;
-        }
-#endif
+    if (rut_object_get_type(object) != &rig_entity_type)
+        return RUT_TRAVERSE_VISIT_CONTINUE;
 
-        geometry = rig_entity_get_component(entity, RIG_COMPONENT_TYPE_GEOMETRY);
+    if (state->bounds) {
+        pick_leaf_t leaf;
 
-        if (!(geometry && rut_object_is(geometry, RUT_TRAIT_ID_MESHABLE) &&
-              (mesh = rut_meshable_get_mesh(geometry))))
-        {
+        mesh = get_pick_mesh(object);
+        if (!mesh) {
+            /* Entities that can't be picked are still indexed so we
+             * can cheaply tell when they move within the scene */
+            c_hash_table_insert(ui->pick_leaf_index, object, NULL);
             return RUT_TRAVERSE_VISIT_CONTINUE;
         }
 
-        /* transform the ray into the model space */
-        memcpy(transformed_ray_origin, pick_ctx->ray_origin, 3 * sizeof(float));
-        memcpy(transformed_ray_direction,
-               pick_ctx->ray_direction,
-               3 * sizeof(float));
+        leaf.entity = object;
+        leaf.mesh = NULL;
 
-        rut_matrix_stack_get(pick_ctx->matrix_stack, &transform);
-        //c_debug("Inputtable transform:");
-        //c_matrix_print(&transform);
+        rut_matrix_stack_get(state->matrix_stack, &transform);
+        update_pick_leaf(&leaf, mesh, &transform, bounds);
 
-        transform_ray(&transform,
-                      true, /* inverse of the transform */
-                      transformed_ray_origin,
-                      transformed_ray_direction);
+        c_array_append_val(ui->pick_leaves, leaf);
+        c_array_append_vals(state->bounds, bounds, 6);
 
-#if 0
-        c_debug ("transformed ray %f,%f,%f %f,%f,%f\n",
-                 transformed_ray_origin[0],
-                 transformed_ray_origin[1],
-                 transformed_ray_origin[2],
-                 transformed_ray_direction[0],
-                 transformed_ray_direction[1],
-                 transformed_ray_direction[2]);
-#endif
+        /* NB: we store index + 1 so we can distinguish a NULL lookup */
+        c_hash_table_insert(ui->pick_leaf_index,
+                            object,
+                            C_UINT_TO_POINTER(ui->pick_leaves->len));
+    } else {
+        unsigned int index = C_POINTER_TO_UINT(
+            c_hash_table_lookup(ui->pick_leaf_index, object));
+        pick_leaf_t *leaf;
 
-        /* intersect the transformed ray with the model engine */
-        hit = rut_util_intersect_mesh(mesh,
-                                      transformed_ray_origin,
-                                      transformed_ray_direction,
-                                      &index,
-                                      &distance);
-
-        if (hit) {
-            const c_matrix_t *view =
-                rut_camera_get_view_transform(pick_ctx->camera);
-            float w = 1;
-
-            //c_debug("Hit something");
-
-            /* to compare intersection distances we find the actual point of ray
-             * intersection in model coordinates and transform that into eye
-             * coordinates */
-
-            transformed_ray_direction[0] *= distance;
-            transformed_ray_direction[1] *= distance;
-            transformed_ray_direction[2] *= distance;
-
-            transformed_ray_direction[0] += transformed_ray_origin[0];
-            transformed_ray_direction[1] += transformed_ray_origin[1];
-            transformed_ray_direction[2] += transformed_ray_origin[2];
-
-            c_matrix_transform_point(&transform,
-                                      &transformed_ray_direction[0],
-                                      &transformed_ray_direction[1],
-                                      &transformed_ray_direction[2],
-                                      &w);
-            c_matrix_transform_point(view,
-                                      &transformed_ray_direction[0],
-                                      &transformed_ray_direction[1],
-                                      &transformed_ray_direction[2],
-                                      &w);
-            distance = transformed_ray_direction[2];
-
-            if (distance > pick_ctx->selected_distance) {
-                pick_ctx->selected_entity = entity;
-                pick_ctx->selected_distance = distance;
-                pick_ctx->selected_index = index;
-            }
-        }
+        if (!index)
+            return RUT_TRAVERSE_VISIT_CONTINUE;
+
+        leaf = &c_array_index(ui->pick_leaves, pick_leaf_t, index - 1);
+
+        rut_matrix_stack_get(state->matrix_stack, &transform);
+        update_pick_leaf(leaf, get_pick_mesh(object), &transform, bounds);
+
+        rut_bvh_refit(ui->pick_bvh, index - 1, bounds);
     }
 
     return RUT_TRAVERSE_VISIT_CONTINUE;
 }
 
 static rut_traverse_visit_flags_t
-entitygraph_post_pick_cb(rut_object_t *object, int depth, void *user_data)
+pick_index_post_cb(rut_object_t *object, int depth, void *user_data)
 {
     if (rut_object_is(object, RUT_TRAIT_ID_TRANSFORMABLE)) {
-        pick_context_t *pick_ctx = user_data;
-        rut_matrix_stack_pop(pick_ctx->matrix_stack);
+        pick_index_state_t *state = user_data;
+        rut_matrix_stack_pop(state->matrix_stack);
     }
 
     return RUT_TRAVERSE_VISIT_CONTINUE;
 }
 
+static void
+free_pick_index(rig_ui_t *ui)
+{
+    int i;
+
+    if (!ui->pick_bvh)
+        return;
+
+    for (i = 0; i < ui->pick_leaves->len; i++) {
+        pick_leaf_t *leaf = &c_array_index(ui->pick_leaves, pick_leaf_t, i);
+
+        if (leaf->mesh)
+            rut_object_unref(leaf->mesh);
+    }
+    c_array_set_size(ui->pick_leaves, 0);
+
+    c_hash_table_remove_all(ui->pick_leaf_index);
+    c_hash_table_remove_all(ui->pick_dirty_entities);
+
+    rut_bvh_free(ui->pick_bvh);
+    ui->pick_bvh = NULL;
+}
+
+static void
+build_pick_index(rig_ui_t *ui)
+{
+    pick_index_state_t state;
+
+    state.ui = ui;
+    state.matrix_stack = ui->pick_matrix_stack;
+    state.bounds = c_array_new(false, false, sizeof(float));
+
+    if (ui->scene) {
+        rut_matrix_stack_load_identity(state.matrix_stack);
+        rut_graphable_traverse(ui->scene,
+                               RUT_TRAVERSE_DEPTH_FIRST,
+                               pick_index_pre_cb,
+                               pick_index_post_cb,
+                               &state);
+    }
+
+    ui->pick_bvh = rut_bvh_new((float *)state.bounds->data,
+                               ui->pick_leaves->len);
+
+    c_array_free(state.bounds, true);
+}
+
+static bool
+has_dirty_ancestor(rig_ui_t *ui, rut_object_t *entity)
+{
+    rut_object_t *parent;
+
+    for (parent = rut_graphable_get_parent(entity);
+         parent;
+         parent = rut_graphable_get_parent(parent))
+    {
+        if (c_hash_table_lookup(ui->pick_dirty_entities, parent))
+            return true;
+    }
+
+    return false;
+}
+
+static void
+refit_pick_index(rig_ui_t *ui)
+{
+    pick_index_state_t state;
+    c_hash_table_iter_t iter;
+    void *key;
+
+    if (c_hash_table_size(ui->pick_dirty_entities) == 0)
+        return;
+
+    state.ui = ui;
+    state.matrix_stack = ui->pick_matrix_stack;
+    state.bounds = NULL;
+
+    c_hash_table_iter_init(&iter, ui->pick_dirty_entities);
+    while (c_hash_table_iter_next(&iter, &key, NULL)) {
+        rut_object_t *entity = key;
+        rut_object_t *parent;
+        c_matrix_t parent_transform;
+
+        /* The sub-graph will be refit along with its ancestor */
+        if (has_dirty_ancestor(ui, entity))
+            continue;
+
+        parent = rut_graphable_get_parent(entity);
+        if (parent)
+            rut_graphable_get_transform(parent, &parent_transform);
+        else
+            c_matrix_init_identity(&parent_transform);
+
+        rut_matrix_stack_set(state.matrix_stack, &parent_transform);
+        rut_graphable_traverse(entity,
+                               RUT_TRAVERSE_DEPTH_FIRST,
+                               pick_index_pre_cb,
+                               pick_index_post_cb,
+                               &state);
+    }
+
+    c_hash_table_remove_all(ui->pick_dirty_entities);
+}
+
+void
+rig_ui_entity_bounds_changed_notify(rig_ui_t *ui, rig_entity_t *entity)
+{
+    if (!ui->pick_bvh)
+        return;
+
+    /* Every entity in the scene is indexed and the index is discarded
+     * whenever the structure of the scene changes, so this avoids
+     * walking up to the root for entities outside of the scene */
+    if (!c_hash_table_contains(ui->pick_leaf_index, entity))
+        return;
+
+    c_hash_table_insert(ui->pick_dirty_entities, entity, entity);
+}
+
+void
+rig_ui_entity_graph_changed_notify(rig_ui_t *ui, rig_entity_t *entity)
+{
+    /* If the root of the scene has been replaced then none of the
+     * labels we've indexed are valid any more */
+    if (entity == ui->scene)
+        free_entity_label_index(ui);
+
+    if (!ui->pick_bvh)
+        return;
+
+    if (ui->scene && rut_graphable_get_root(entity) != ui->scene)
+        return;
+
+    /* Structural changes can add or remove pickable entities so we
+     * simply rebuild the index on the next pick */
+    free_pick_index(ui);
+}
+
+typedef struct _pick_context_t {
+    rig_ui_t *ui;
+    rig_entity_t *selected_entity;
+    int selected_index;
+} pick_context_t;
+
+static bool
+pick_leaf_cb(int primitive,
+             const float ray_origin[3],
+             const float ray_direction[3],
+             float *t,
+             void *user_data)
+{
+    pick_context_t *pick_ctx = user_data;
+    pick_leaf_t *leaf =
+        &c_array_index(pick_ctx->ui->pick_leaves, pick_leaf_t, primitive);
+    float transformed_ray_origin[3];
+    float transformed_ray_direction[3];
+    float distance;
+    int index;
+
+    /* Transform the ray into model space. NB: the direction is
+     * transformed without being normalized so that distances along
+     * the ray are comparable between different entities */
+    memcpy(transformed_ray_origin, ray_origin, 3 * sizeof(float));
+    memcpy(transformed_ray_direction, ray_direction, 3 * sizeof(float));
+
+    c_matrix_transform_points(&leaf->inverse_transform,
+                              3, /* num components for input */
+                              sizeof(float) * 3, /* input stride */
+                              transformed_ray_origin,
+                              sizeof(float) * 3, /* output stride */
+                              transformed_ray_origin,
+                              1 /* n_points */);
+    rut_util_transform_normal(&leaf->inverse_transform,
+                              &transformed_ray_direction[0],
+                              &transformed_ray_direction[1],
+                              &transformed_ray_direction[2]);
+
+    if (rut_util_intersect_mesh(leaf->mesh,
+                                transformed_ray_origin,
+                                transformed_ray_direction,
+                                &index,
+                                &distance) &&
+        distance < *t)
+    {
+        *t = distance;
+        pick_ctx->selected_entity = leaf->entity;
+        pick_ctx->selected_index = index;
+        return true;
+    }
+
+    return false;
+}
+
 rig_entity_t *
 pick(rig_ui_t *ui,
      rut_object_t *camera,
@@ -671,30 +1061,33 @@ pick(rig_ui_t *ui,
      float ray_origin[3],
      float ray_direction[3])
 {
-    rig_engine_t *engine = ui->engine;
     pick_context_t pick_ctx;
+    float distance;
+
+    /* Only the engine's current UI is notified of entity changes so
+     * we can't keep the index of any other UI up to date */
+    if (ui->engine->ui != ui)
+        free_pick_index(ui);
+
+    if (!ui->pick_bvh)
+        build_pick_index(ui);
+    else
+        refit_pick_index(ui);
 
     pick_ctx.ui = ui;
-    pick_ctx.engine = engine;
-    pick_ctx.camera = camera;
-    pick_ctx.matrix_stack = ui->pick_matrix_stack;
-    pick_ctx.x = x;
-    pick_ctx.y = y;
-    pick_ctx.selected_distance = -FLT_MAX;
     pick_ctx.selected_entity = NULL;
-    pick_ctx.ray_origin = ray_origin;
-    pick_ctx.ray_direction = ray_direction;
 
-    rut_graphable_traverse(ui->scene,
-                           RUT_TRAVERSE_DEPTH_FIRST,
-                           entitygraph_pre_pick_cb,
-                           entitygraph_post_pick_cb,
-                           &pick_ctx);
+    rut_bvh_intersect_ray(ui->pick_bvh,
+                          ray_origin,
+                          ray_direction,
+                          pick_leaf_cb,
+                          &pick_ctx,
+                          &distance);
 
 #if 0
     if (pick_ctx.selected_entity) {
         c_message("Hit entity, triangle #%d, distance %.2f",
-                  pick_ctx.selected_index, pick_ctx.selected_distance);
+                  pick_ctx.selected_index, distance);
     }
 #endif
 
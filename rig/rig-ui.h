@@ -98,8 +98,22 @@ struct _rig_ui_t {
     /* TODO: remove the limitation of rendering with only one light */
     rig_entity_t *light;
 
+    /* An index of entities by label, built lazily by
+     * rig_ui_find_entity() */
+    c_hash_table_t *entity_labels; /* label -> c_llist_t of entities */
+
     rut_matrix_stack_t *pick_matrix_stack;
 
+    /* A hierarchy over the world space bounds of all pickable
+     * entities. This is built lazily by pick(), refit for any
+     * entities in pick_dirty_entities and discarded whenever the
+     * structure of the scene changes. */
+    rut_bvh_t *pick_bvh;
+    c_array_t *pick_leaves;
+    c_hash_table_t *pick_leaf_index; /* scene entity -> leaf index + 1,
+                                        or 0 if not pickable */
+    c_hash_table_t *pick_dirty_entities;
+
     /* List of grabs that are currently in place. This are in order from
      * highest to lowest priority. */
     c_list_t grabs;
@@ -143,6 +157,23 @@ void rig_ui_entity_component_pre_remove_notify(rig_ui_t *ui,
                                                rut_object_t *component);
 void rig_ui_register_all_entity_components(rig_ui_t *ui, rig_entity_t *entity);
 
+/* Notifies the UI that the transform or pickable geometry of an entity
+ * (and so implicitly its descendants) has changed */
+void rig_ui_entity_bounds_changed_notify(rig_ui_t *ui, rig_entity_t *entity);
+
+/* Notifies the UI that an entity has gained or lost components */
+void rig_ui_entity_graph_changed_notify(rig_ui_t *ui, rig_entity_t *entity);
+
+void rig_ui_entity_added_notify(rig_ui_t *ui,
+                                rig_entity_t *parent,
+                                rut_object_t *child);
+void rig_ui_entity_removed_notify(rig_ui_t *ui,
+                                  rig_entity_t *parent,
+                                  rut_object_t *child);
+void rig_ui_entity_label_changed_notify(rig_ui_t *ui,
+                                        rig_entity_t *entity,
+                                        const char *old_label);
+
 void rig_ui_code_modules_load(rig_ui_t *ui);
 void rig_ui_code_modules_update(rig_ui_t *ui, rig_code_module_update_t *state);
 void rig_ui_code_modules_handle_input(rig_ui_t *ui, rut_input_event_t *event);
@@ -0,0 +1,394 @@
+/*
+ * Rut
+ *
+ * Rig Utilities
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <rut-config.h>
+
+#include <float.h>
+
+#include <clib.h>
+
+#include "rut-bvh.h"
+
+/* The maximum number of primitives that will be grouped into a
+ * single leaf node */
+#define LEAF_SIZE 4
+
+typedef struct _rut_bvh_node_t {
+    float bounds[6];
+
+    int parent;
+
+    /* For a leaf this is an offset into bvh->order where the leaf's
+     * primitives start, otherwise this is the index of the left
+     * child */
+    int first;
+    int right;
+
+    /* The number of primitives in a leaf, or 0 for internal nodes */
+    int count;
+} rut_bvh_node_t;
+
+struct _rut_bvh_t {
+    rut_bvh_node_t *nodes;
+    int n_nodes;
+
+    float *bounds;
+    int n_primitives;
+
+    /* The primitive indices ordered so each leaf refers to a
+     * contiguous range */
+    int *order;
+
+    /* Maps each primitive to the leaf node that contains it */
+    int *leaves;
+
+    int depth;
+};
+
+static void
+bounds_init_empty(float bounds[6])
+{
+    bounds[0] = bounds[1] = bounds[2] = FLT_MAX;
+    bounds[3] = bounds[4] = bounds[5] = -FLT_MAX;
+}
+
+static void
+bounds_union(float bounds[6], const float other[6])
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (other[i] < bounds[i])
+            bounds[i] = other[i];
+        if (other[i + 3] > bounds[i + 3])
+            bounds[i + 3] = other[i + 3];
+    }
+}
+
+static void
+update_leaf_bounds(rut_bvh_t *bvh, rut_bvh_node_t *node)
+{
+    int i;
+
+    bounds_init_empty(node->bounds);
+    for (i = 0; i < node->count; i++) {
+        int primitive = bvh->order[node->first + i];
+        bounds_union(node->bounds, bvh->bounds + primitive * 6);
+    }
+}
+
+static float
+get_centroid(rut_bvh_t *bvh, int primitive, int axis)
+{
+    const float *bounds = bvh->bounds + primitive * 6;
+
+    return (bounds[axis] + bounds[axis + 3]) * 0.5f;
+}
+
+typedef struct _sort_state_t {
+    rut_bvh_t *bvh;
+    int axis;
+} sort_state_t;
+
+static int
+compare_centroids_cb(const void *a, const void *b, void *user_data)
+{
+    sort_state_t *state = user_data;
+    float ca = get_centroid(state->bvh, *(const int *)a, state->axis);
+    float cb = get_centroid(state->bvh, *(const int *)b, state->axis);
+
+    return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+static int
+build_node(rut_bvh_t *bvh, int start, int end, int parent, int depth)
+{
+    int index = bvh->n_nodes++;
+    rut_bvh_node_t *node = &bvh->nodes[index];
+    int count = end - start;
+    float centroid_bounds[6];
+    float split;
+    int axis, mid, i;
+
+    node->parent = parent;
+
+    if (depth > bvh->depth)
+        bvh->depth = depth;
+
+    if (count <= LEAF_SIZE) {
+        node->first = start;
+        node->right = -1;
+        node->count = count;
+        update_leaf_bounds(bvh, node);
+
+        for (i = start; i < end; i++)
+            bvh->leaves[bvh->order[i]] = index;
+
+        return index;
+    }
+
+    bounds_init_empty(centroid_bounds);
+    for (i = start; i < end; i++) {
+        float centroid[6];
+        int j;
+
+        for (j = 0; j < 3; j++)
+            centroid[j] = centroid[j + 3] = get_centroid(bvh, bvh->order[i], j);
+        bounds_union(centroid_bounds, centroid);
+    }
+
+    axis = 0;
+    for (i = 1; i < 3; i++) {
+        if (centroid_bounds[i + 3] - centroid_bounds[i] >
+            centroid_bounds[axis + 3] - centroid_bounds[axis])
+            axis = i;
+    }
+
+    /* Split at the spatial median of the centroids along the longest
+     * axis... */
+    split = (centroid_bounds[axis] + centroid_bounds[axis + 3]) * 0.5f;
+    mid = start;
+    for (i = start; i < end; i++) {
+        if (get_centroid(bvh, bvh->order[i], axis) < split) {
+            int tmp = bvh->order[i];
+            bvh->order[i] = bvh->order[mid];
+            bvh->order[mid++] = tmp;
+        }
+    }
+
+    /* ...unless that leaves the tree badly unbalanced, in which case
+     * we fall back to splitting the primitives into two equal halves
+     * so that the depth of the tree stays logarithmic */
+    if (mid - start < count / 4 || end - mid < count / 4) {
+        sort_state_t state = { bvh, axis };
+
+        c_qsort_with_data(bvh->order + start,
+                          count,
+                          sizeof(int),
+                          compare_centroids_cb,
+                          &state);
+        mid = start + count / 2;
+    }
+
+    node->count = 0;
+    node->first = build_node(bvh, start, mid, index, depth + 1);
+    node->right = build_node(bvh, mid, end, index, depth + 1);
+
+    /* NB: node pointers stay valid since the nodes are preallocated */
+    memcpy(node->bounds, bvh->nodes[node->first].bounds, sizeof(node->bounds));
+    bounds_union(node->bounds, bvh->nodes[node->right].bounds);
+
+    return index;
+}
+
+rut_bvh_t *
+rut_bvh_new(const float *bounds, int n_primitives)
+{
+    rut_bvh_t *bvh = c_slice_new0(rut_bvh_t);
+    int i;
+
+    bvh->n_primitives = n_primitives;
+
+    if (n_primitives == 0)
+        return bvh;
+
+    bvh->bounds = c_memdup(bounds, sizeof(float) * 6 * n_primitives);
+    bvh->order = c_malloc(sizeof(int) * n_primitives);
+    bvh->leaves = c_malloc(sizeof(int) * n_primitives);
+
+    /* A binary tree with n leaves has exactly 2n - 1 nodes and we
+     * will never have more leaves than primitives */
+    bvh->nodes = c_malloc(sizeof(rut_bvh_node_t) * (2 * n_primitives - 1));
+
+    for (i = 0; i < n_primitives; i++)
+        bvh->order[i] = i;
+
+    build_node(bvh, 0, n_primitives, -1, 0);
+
+    return bvh;
+}
+
+void
+rut_bvh_free(rut_bvh_t *bvh)
+{
+    c_free(bvh->nodes);
+    c_free(bvh->bounds);
+    c_free(bvh->order);
+    c_free(bvh->leaves);
+
+    c_slice_free(rut_bvh_t, bvh);
+}
+
+int
+rut_bvh_get_n_primitives(rut_bvh_t *bvh)
+{
+    return bvh->n_primitives;
+}
+
+void
+rut_bvh_get_bounds(rut_bvh_t *bvh, float bounds[6])
+{
+    if (bvh->n_nodes)
+        memcpy(bounds, bvh->nodes[0].bounds, sizeof(float) * 6);
+    else
+        memset(bounds, 0, sizeof(float) * 6);
+}
+
+void
+rut_bvh_refit(rut_bvh_t *bvh, int primitive, const float bounds[6])
+{
+    int index;
+
+    c_return_if_fail(primitive >= 0 && primitive < bvh->n_primitives);
+
+    memcpy(bvh->bounds + primitive * 6, bounds, sizeof(float) * 6);
+
+    index = bvh->leaves[primitive];
+    update_leaf_bounds(bvh, &bvh->nodes[index]);
+
+    for (index = bvh->nodes[index].parent;
+         index != -1;
+         index = bvh->nodes[index].parent)
+    {
+        rut_bvh_node_t *node = &bvh->nodes[index];
+
+        memcpy(node->bounds, bvh->nodes[node->first].bounds, sizeof(node->bounds));
+        bounds_union(node->bounds, bvh->nodes[node->right].bounds);
+    }
+}
+
+/* A slab test that returns the distance along the ray at which it
+ * enters the given bounds, or FLT_MAX if it misses them or only
+ * enters them beyond max_t.
+ *
+ * NB: if the ray direction has a zero component the corresponding
+ * inverse is infinite and comparisons against any resulting NaN
+ * evaluate as false so that axis is effectively ignored. */
+static float
+intersect_bounds(const float bounds[6],
+                 const float ray_origin[3],
+                 const float inv_direction[3],
+                 float max_t)
+{
+    float t_near = 0;
+    float t_far = max_t;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        float t0 = (bounds[i] - ray_origin[i]) * inv_direction[i];
+        float t1 = (bounds[i + 3] - ray_origin[i]) * inv_direction[i];
+
+        if (t0 > t1) {
+            float tmp = t0;
+            t0 = t1;
+            t1 = tmp;
+        }
+
+        if (t0 > t_near)
+            t_near = t0;
+        if (t1 < t_far)
+            t_far = t1;
+    }
+
+    return t_near <= t_far ? t_near : FLT_MAX;
+}
+
+bool
+rut_bvh_intersect_ray(rut_bvh_t *bvh,
+                      const float ray_origin[3],
+                      const float ray_direction[3],
+                      rut_bvh_intersect_callback_t callback,
+                      void *user_data,
+                      float *t_out)
+{
+    float inv_direction[3];
+    float t = FLT_MAX;
+    bool found = false;
+    int *stack;
+    int n_stacked = 0;
+    int i;
+
+    if (!bvh->n_nodes)
+        return false;
+
+    for (i = 0; i < 3; i++)
+        inv_direction[i] = 1.0f / ray_direction[i];
+
+    if (intersect_bounds(bvh->nodes[0].bounds,
+                         ray_origin, inv_direction, t) == FLT_MAX)
+        return false;
+
+    /* We push at most two nodes for every level we descend */
+    stack = c_alloca(sizeof(int) * (bvh->depth + 2));
+    stack[n_stacked++] = 0;
+
+    while (n_stacked) {
+        rut_bvh_node_t *node = &bvh->nodes[stack[--n_stacked]];
+        rut_bvh_node_t *left, *right;
+        float t_left, t_right;
+
+        if (node->count) {
+            for (i = 0; i < node->count; i++) {
+                int primitive = bvh->order[node->first + i];
+                const float *bounds = bvh->bounds + primitive * 6;
+
+                if (intersect_bounds(bounds, ray_origin, inv_direction, t) ==
+                    FLT_MAX)
+                    continue;
+
+                if (callback(primitive, ray_origin, ray_direction,
+                             &t, user_data))
+                    found = true;
+            }
+            continue;
+        }
+
+        left = &bvh->nodes[node->first];
+        right = &bvh->nodes[node->right];
+        t_left = intersect_bounds(left->bounds, ray_origin, inv_direction, t);
+        t_right = intersect_bounds(right->bounds, ray_origin, inv_direction, t);
+
+        /* Push the nearest child last so it gets visited first and can
+         * hopefully cull the other one */
+        if (t_left < t_right) {
+            if (t_right != FLT_MAX)
+                stack[n_stacked++] = node->right;
+            stack[n_stacked++] = node->first;
+        } else {
+            if (t_left != FLT_MAX)
+                stack[n_stacked++] = node->first;
+            if (t_right != FLT_MAX)
+                stack[n_stacked++] = node->right;
+        }
+    }
+
+    if (found && t_out)
+        *t_out = t;
+
+    return found;
+}
@@ -0,0 +1,106 @@
+/*
+ * Rut
+ *
+ * Rig Utilities
+ *
+ * Copyright (C) 2016 Robert Bragg
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _RUT_BVH_H_
+#define _RUT_BVH_H_
+
+#include <clib.h>
+
+C_BEGIN_DECLS
+
+/*
+ * A static bounding volume hierarchy over a set of axis aligned
+ * boxes, for accelerating ray queries.
+ *
+ * Primitives are identified by their index into the array of bounds
+ * that the hierarchy was built from and each set of bounds is given
+ * as six floats: the minimum x, y, z followed by the maximum x, y, z.
+ *
+ * The topology of the tree is fixed once built but the bounds of
+ * individual primitives can be updated with rut_bvh_refit() which is
+ * cheap enough to do for objects that move around, so long as they
+ * don't move so far that the tree becomes a poor fit.
+ */
+typedef struct _rut_bvh_t rut_bvh_t;
+
+/*
+ * rut_bvh_intersect_callback_t:
+ * @primitive: The index of a primitive whose bounds the ray intersects
+ * @ray_origin: The origin of the ray
+ * @ray_direction: The direction of the ray
+ * @t: The distance along the ray of the nearest hit found so far
+ * @user_data: The private data passed to rut_bvh_intersect_ray()
+ *
+ * If the ray hits @primitive closer than *@t then the callback should
+ * update *@t and return %true, otherwise it should return %false.
+ */
+typedef bool (*rut_bvh_intersect_callback_t)(int primitive,
+                                             const float ray_origin[3],
+                                             const float ray_direction[3],
+                                             float *t,
+                                             void *user_data);
+
+rut_bvh_t *rut_bvh_new(const float *bounds, int n_primitives);
+
+void rut_bvh_free(rut_bvh_t *bvh);
+
+int rut_bvh_get_n_primitives(rut_bvh_t *bvh);
+
+/* Queries the bounds enclosing all of the primitives */
+void rut_bvh_get_bounds(rut_bvh_t *bvh, float bounds[6]);
+
+/* Updates the bounds of a single primitive and all of the nodes
+ * that enclose it */
+void rut_bvh_refit(rut_bvh_t *bvh, int primitive, const float bounds[6]);
+
+/*
+ * rut_bvh_intersect_ray:
+ * @bvh: A #rut_bvh_t
+ * @ray_origin: The origin of the ray
+ * @ray_direction: The direction of the ray
+ * @callback: A function to test the ray against a single primitive
+ * @user_data: Private data to pass to @callback
+ * @t_out: (out): Returns the distance along the ray of the nearest hit
+ *
+ * Visits the primitives whose bounds are intersected by the ray in a
+ * roughly front to back order, skipping any that lie further away
+ * than the nearest hit found so far. Only hits in front of the ray
+ * origin are considered.
+ *
+ * Return value: %true if @callback reported any hit.
+ */
+bool rut_bvh_intersect_ray(rut_bvh_t *bvh,
+                           const float ray_origin[3],
+                           const float ray_direction[3],
+                           rut_bvh_intersect_callback_t callback,
+                           void *user_data,
+                           float *t_out);
+
+C_END_DECLS
+
+#endif /* _RUT_BVH_H_ */
@@ -38,6 +38,7 @@
 typedef enum _rut_exception_domain_t {
     RUT_IO_EXCEPTION = 1,
     RUT_ADB_EXCEPTION,
+    RUT_BINDING_EXCEPTION,
     RUT_N_EXCEPTION_DOMAINS
 } rut_exception_domain_t;
 
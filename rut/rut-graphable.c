@@ -80,6 +80,8 @@ rut_graphable_add_child(rut_object_t *parent, rut_object_t *child)
         rut_graphable_remove_child(child);
 
     child_props->parent = parent;
+    rut_transformable_invalidate_graph(child);
+
     if (child_vtable && child_vtable->parent_changed)
         child_vtable->parent_changed(child, old_parent, parent);
 
@@ -110,6 +112,8 @@ rut_graphable_remove_child(rut_object_t *child)
      *  that might itself call rut_graphable_remove_child() */
     child_props->parent = NULL;
 
+    rut_transformable_invalidate_graph(child);
+
     if (parent_vtable->child_removed)
         parent_vtable->child_removed(parent, child);
 
@@ -302,39 +306,21 @@ void
 rut_graphable_apply_transform(rut_object_t *graphable,
                               c_matrix_t *transform_matrix)
 {
-    int depth = 0;
-    rut_object_t **transform_nodes;
     rut_object_t *node = graphable;
-    int i;
 
-    do {
+    /* The world matrix of the nearest transformable node already
+     * accounts for all of its transformable ancestors */
+    while (node && !rut_object_is(node, RUT_TRAIT_ID_TRANSFORMABLE)) {
         rut_graphable_props_t *graphable_priv =
             rut_object_get_properties(node, RUT_TRAIT_ID_GRAPHABLE);
 
-        depth++;
-
-        node = graphable_priv->parent;
-    } while (node);
-
-    transform_nodes = c_alloca(sizeof(rut_object_t *) * depth);
-
-    node = graphable;
-    i = 0;
-    do {
-        rut_graphable_props_t *graphable_priv;
-
-        if (rut_object_is(node, RUT_TRAIT_ID_TRANSFORMABLE))
-            transform_nodes[i++] = node;
-
-        graphable_priv =
-            rut_object_get_properties(node, RUT_TRAIT_ID_GRAPHABLE);
         node = graphable_priv->parent;
-    } while (node);
+    }
 
-    for (i--; i >= 0; i--) {
-        const c_matrix_t *matrix =
-            rut_transformable_get_matrix(transform_nodes[i]);
-        c_matrix_multiply(transform_matrix, transform_matrix, matrix);
+    if (node) {
+        c_matrix_multiply(transform_matrix,
+                          transform_matrix,
+                          rut_transformable_get_world_matrix(node));
     }
 }
 
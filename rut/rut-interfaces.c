@@ -36,6 +36,19 @@
 #include "rut-camera.h"
 #include "rut-refcount-debug.h"
 
+#ifdef RIG_ENABLE_DEBUG
+static rut_transformable_stats_t _rut_transformable_stats;
+#endif
+
+void
+rut_transformable_init(rut_object_t *object)
+{
+    rut_transformable_props_t *props =
+        rut_object_get_properties(object, RUT_TRAIT_ID_TRANSFORMABLE);
+
+    props->world_dirty = true;
+}
+
 const c_matrix_t *
 rut_transformable_get_matrix(rut_object_t *object)
 {
@@ -45,6 +58,106 @@ rut_transformable_get_matrix(rut_object_t *object)
     return transformable->get_matrix(object);
 }
 
+static rut_traverse_visit_flags_t
+invalidate_world_matrix_cb(rut_object_t *object, int depth, void *user_data)
+{
+    rut_transformable_props_t *props;
+
+    if (!rut_object_is(object, RUT_TRAIT_ID_TRANSFORMABLE))
+        return RUT_TRAVERSE_VISIT_CONTINUE;
+
+    props = rut_object_get_properties(object, RUT_TRAIT_ID_TRANSFORMABLE);
+
+    /* Everything below an already dirty node must also be dirty */
+    if (props->world_dirty)
+        return RUT_TRAVERSE_VISIT_SKIP_CHILDREN;
+
+    props->world_dirty = true;
+
+    return RUT_TRAVERSE_VISIT_CONTINUE;
+}
+
+void
+rut_transformable_invalidate_graph(rut_object_t *root)
+{
+    rut_graphable_traverse(root,
+                           RUT_TRAVERSE_DEPTH_FIRST,
+                           invalidate_world_matrix_cb,
+                           NULL, /* after children */
+                           NULL); /* user data */
+}
+
+void
+rut_transformable_changed(rut_object_t *object)
+{
+    rut_transformable_props_t *props =
+        rut_object_get_properties(object, RUT_TRAIT_ID_TRANSFORMABLE);
+
+    if (props->world_dirty)
+        return;
+
+    rut_transformable_invalidate_graph(object);
+}
+
+static rut_object_t *
+find_transformable_ancestor(rut_object_t *object)
+{
+    rut_object_t *node = rut_graphable_get_parent(object);
+
+    while (node && !rut_object_is(node, RUT_TRAIT_ID_TRANSFORMABLE))
+        node = rut_graphable_get_parent(node);
+
+    return node;
+}
+
+const c_matrix_t *
+rut_transformable_get_world_matrix(rut_object_t *object)
+{
+    rut_transformable_props_t *props =
+        rut_object_get_properties(object, RUT_TRAIT_ID_TRANSFORMABLE);
+    rut_object_t *ancestor;
+    const c_matrix_t *matrix;
+
+    if (!props->world_dirty) {
+#ifdef RIG_ENABLE_DEBUG
+        _rut_transformable_stats.n_world_matrix_hits++;
+#endif
+        return &props->world_matrix;
+    }
+
+    matrix = rut_transformable_get_matrix(object);
+
+    ancestor = find_transformable_ancestor(object);
+    if (ancestor) {
+        c_matrix_multiply(&props->world_matrix,
+                          rut_transformable_get_world_matrix(ancestor),
+                          matrix);
+    } else
+        props->world_matrix = *matrix;
+
+    props->world_dirty = false;
+
+#ifdef RIG_ENABLE_DEBUG
+    _rut_transformable_stats.n_world_matrix_recomputes++;
+#endif
+
+    return &props->world_matrix;
+}
+
+#ifdef RIG_ENABLE_DEBUG
+void
+rut_transformable_get_stats(rut_transformable_stats_t *stats)
+{
+    *stats = _rut_transformable_stats;
+}
+
+void
+rut_transformable_reset_stats(void)
+{
+    memset(&_rut_transformable_stats, 0, sizeof(_rut_transformable_stats));
+}
+#endif
+
 void
 rut_sizable_set_size(rut_object_t *object, float width, float height)
 {
@@ -44,8 +44,49 @@ typedef struct rut_transformable_vtable_t {
     const c_matrix_t *(*get_matrix)(rut_object_t *object);
 } rut_transformable_vtable_t;
 
+/* Transformables cache their world matrix (the product of their own
+ * matrix with that of all transformable ancestors).
+ *
+ * If world_dirty is set then the world matrices of all transformable
+ * descendants are also dirty, which lets invalidation stop early when
+ * it reaches a node that is already dirty. */
+typedef struct _rut_transformable_props_t {
+    c_matrix_t world_matrix;
+    bool world_dirty;
+} rut_transformable_props_t;
+
+void rut_transformable_init(rut_object_t *object);
+
 const c_matrix_t *rut_transformable_get_matrix(rut_object_t *object);
 
+/* Must be called whenever the matrix returned by
+ * rut_transformable_get_matrix() changes so that the cached world
+ * matrices of the object and its descendants are invalidated. */
+void rut_transformable_changed(rut_object_t *object);
+
+/* Invalidates the cached world matrices of all transformables in the
+ * sub-graph under root, including root itself; used when the
+ * sub-graph is reparented. */
+void rut_transformable_invalidate_graph(rut_object_t *root);
+
+const c_matrix_t *rut_transformable_get_world_matrix(rut_object_t *object);
+
+#ifdef RIG_ENABLE_DEBUG
+/* Debug counters for rut_transformable_get_world_matrix(), accumulated
+ * until reset with rut_transformable_reset_stats().
+ *
+ * XXX: The counters are global and not atomic so they are only
+ * meaningful if world matrices are only queried by one thread. */
+typedef struct _rut_transformable_stats_t {
+    int n_world_matrix_hits;
+    int n_world_matrix_recomputes;
+} rut_transformable_stats_t;
+
+void rut_transformable_get_stats(rut_transformable_stats_t *stats);
+
+void rut_transformable_reset_stats(void);
+#endif
+
 typedef void (*rut_sizeable_preferred_size_callback_t)(rut_object_t *sizable,
                                                     void *user_data);
 
@@ -156,6 +156,21 @@ rut_memory_sub_stack_free(rut_memory_sub_stack_t *sub_stack)
     c_slice_free(rut_memory_sub_stack_t, sub_stack);
 }
 
+size_t
+rut_memory_stack_get_used_bytes(rut_memory_stack_t *stack)
+{
+    rut_memory_sub_stack_t *sub_stack;
+    size_t used = 0;
+
+    c_list_for_each(sub_stack, &stack->sub_stacks, link) {
+        used += sub_stack->offset;
+        if (sub_stack == stack->sub_stack)
+            break;
+    }
+
+    return used;
+}
+
 void
 rut_memory_stack_rewind(rut_memory_stack_t *stack)
 {
@@ -117,6 +117,10 @@ rut_memory_stack_foreach_region(rut_memory_stack_t *stack,
 }
 #endif /* __cplusplus */
 
+/* Returns the number of bytes allocated from the stack since it was
+ * last rewound (the unused tails of full sub-stacks aren't counted) */
+size_t rut_memory_stack_get_used_bytes(rut_memory_stack_t *stack);
+
 void rut_memory_stack_rewind(rut_memory_stack_t *stack);
 
 void rut_memory_stack_free(rut_memory_stack_t *stack);
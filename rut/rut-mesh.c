@@ -134,6 +134,8 @@ _rut_mesh_free(rut_object_t *object)
     rut_mesh_t *mesh = object;
     int i;
 
+    rut_mesh_changed(mesh);
+
     for (i = 0; i < mesh->n_attributes; i++)
         rut_object_unref(mesh->attributes[i]);
 
@@ -272,6 +274,8 @@ rut_mesh_set_indices(rut_mesh_t *mesh,
     mesh->indices_buffer = rut_object_ref(buffer);
     mesh->indices_type = type;
     mesh->n_indices = n_indices;
+
+    rut_mesh_changed(mesh);
 }
 
 void
@@ -294,6 +298,8 @@ rut_mesh_set_attributes(rut_mesh_t *mesh,
 
     mesh->attributes = attributes_real;
     mesh->n_attributes = n_attributes;
+
+    rut_mesh_changed(mesh);
 }
 
 static void
@@ -678,6 +684,96 @@ rut_mesh_foreach_triangle(rut_mesh_t *mesh,
 #undef SWAP_TRIANGLE_VERTICES
 }
 
+void
+rut_mesh_changed(rut_mesh_t *mesh)
+{
+    if (mesh->bvh) {
+        rut_bvh_free(mesh->bvh);
+        mesh->bvh = NULL;
+    }
+
+    if (mesh->bvh_triangles) {
+        c_free(mesh->bvh_triangles);
+        mesh->bvh_triangles = NULL;
+    }
+}
+
+typedef struct _collect_triangles_state_t {
+    c_array_t *triangles;
+    c_array_t *bounds;
+    int n_components;
+} collect_triangles_state_t;
+
+static bool
+collect_triangle_cb(void **attributes_v0,
+                    void **attributes_v1,
+                    void **attributes_v2,
+                    int index_v0,
+                    int index_v1,
+                    int index_v2,
+                    void *user_data)
+{
+    collect_triangles_state_t *state = user_data;
+    float *positions[3] = { attributes_v0[0], attributes_v1[0], attributes_v2[0] };
+    float triangle[9];
+    float bounds[6];
+    int i, j;
+
+    for (i = 0; i < 3; i++) {
+        triangle[i * 3] = positions[i][0];
+        triangle[i * 3 + 1] = positions[i][1];
+        triangle[i * 3 + 2] = state->n_components > 2 ? positions[i][2] : 0;
+    }
+
+    for (j = 0; j < 3; j++) {
+        bounds[j] = bounds[j + 3] = triangle[j];
+
+        for (i = 1; i < 3; i++) {
+            float v = triangle[i * 3 + j];
+
+            if (v < bounds[j])
+                bounds[j] = v;
+            if (v > bounds[j + 3])
+                bounds[j + 3] = v;
+        }
+    }
+
+    c_array_append_vals(state->triangles, triangle, 9);
+    c_array_append_vals(state->bounds, bounds, 6);
+
+    return true;
+}
+
+rut_bvh_t *
+rut_mesh_get_bvh(rut_mesh_t *mesh, const float **triangles)
+{
+    if (!mesh->bvh) {
+        rut_attribute_t *position =
+            rut_mesh_find_attribute(mesh, "cg_position_in");
+        collect_triangles_state_t state;
+
+        if (!position || !position->is_buffered)
+            return NULL;
+
+        state.n_components = position->buffered.n_components;
+        state.triangles = c_array_new(false, false, sizeof(float));
+        state.bounds = c_array_new(false, false, sizeof(float));
+
+        rut_mesh_foreach_triangle(mesh, collect_triangle_cb, &state,
+                                  "cg_position_in", NULL);
+
+        mesh->bvh = rut_bvh_new((float *)state.bounds->data,
+                                state.bounds->len / 6);
+        mesh->bvh_triangles = (float *)c_array_free(state.triangles, false);
+        c_array_free(state.bounds, true);
+    }
+
+    if (triangles)
+        *triangles = mesh->bvh_triangles;
+
+    return mesh->bvh;
+}
+
 static cg_attribute_type_t
 get_cg_attribute_type(rut_attribute_type_t type)
 {
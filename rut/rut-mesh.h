@@ -38,6 +38,7 @@ typedef struct _rut_attribute_t rut_attribute_t;
 typedef struct _rut_mesh_t rut_mesh_t;
 
 #include "rut-shell.h"
+#include "rut-bvh.h"
 
 typedef enum {
     RUT_ATTRIBUTE_TYPE_BYTE,
@@ -103,6 +104,11 @@ struct _rut_mesh_t {
     cg_indices_type_t indices_type;
     int n_indices;
     rut_buffer_t *indices_buffer;
+
+    /* A triangle hierarchy for picking, built lazily by
+     * rut_mesh_get_bvh() and discarded by rut_mesh_changed() */
+    rut_bvh_t *bvh;
+    float *bvh_triangles;
 };
 
 void _rut_buffer_init_type(void);
@@ -158,6 +164,26 @@ void rut_mesh_set_indices(rut_mesh_t *mesh,
                           rut_buffer_t *buffer,
                           int n_indices);
 
+/* This should be called whenever the vertex data or topology of a
+ * mesh is modified so that any cached state can be discarded */
+void rut_mesh_changed(rut_mesh_t *mesh);
+
+/*
+ * rut_mesh_get_bvh:
+ * @mesh: A #rut_mesh_t
+ * @triangles: (out) (allow-none): Returns the positions of each triangle
+ *             as an array of 9 floats per triangle
+ *
+ * Returns a bounding volume hierarchy over the triangles of @mesh,
+ * where each primitive of the hierarchy corresponds to the triangle
+ * with the same index as visited by rut_mesh_foreach_triangle(). The
+ * hierarchy is built on demand and cached until rut_mesh_changed().
+ *
+ * Return value: A #rut_bvh_t owned by @mesh or %NULL if @mesh has no
+ *               "cg_position_in" attribute.
+ */
+rut_bvh_t *rut_mesh_get_bvh(rut_mesh_t *mesh, const float **triangles);
+
 /* Performs a deep copy of all the buffers */
 rut_mesh_t *rut_mesh_copy(rut_mesh_t *mesh);
 
@@ -38,6 +38,7 @@ struct _rut_transform_t {
     rut_object_base_t _base;
 
     rut_graphable_props_t graphable;
+    rut_transformable_props_t transformable;
 
     c_matrix_t matrix;
 };
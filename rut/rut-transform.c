@@ -68,8 +68,10 @@ _rut_transform_init_type(void)
                        RUT_TRAIT_ID_GRAPHABLE,
                        offsetof(TYPE, graphable),
                        &graphable_vtable);
-    rut_type_add_trait(
-        type, RUT_TRAIT_ID_TRANSFORMABLE, 0, &transformable_vtable);
+    rut_type_add_trait(type,
+                       RUT_TRAIT_ID_TRANSFORMABLE,
+                       offsetof(TYPE, transformable),
+                       &transformable_vtable);
 
 #undef TYPE
 }
@@ -81,6 +83,7 @@ rut_transform_new(rut_shell_t *shell)
         rut_transform_t, &rut_transform_type, _rut_transform_init_type);
 
     rut_graphable_init(transform);
+    rut_transformable_init(transform);
 
     c_matrix_init_identity(&transform->matrix);
 
@@ -91,6 +94,7 @@ void
 rut_transform_translate(rut_transform_t *transform, float x, float y, float z)
 {
     c_matrix_translate(&transform->matrix, x, y, z);
+    rut_transformable_changed(transform);
 }
 
 void
@@ -100,6 +104,7 @@ rut_transform_quaternion_rotate(rut_transform_t *transform,
     c_matrix_t rotation;
     c_matrix_init_from_quaternion(&rotation, quaternion);
     c_matrix_multiply(&transform->matrix, &transform->matrix, &rotation);
+    rut_transformable_changed(transform);
 }
 
 void
@@ -107,11 +112,13 @@ rut_transform_rotate(
     rut_transform_t *transform, float angle, float x, float y, float z)
 {
     c_matrix_rotate(&transform->matrix, angle, x, y, z);
+    rut_transformable_changed(transform);
 }
 void
 rut_transform_scale(rut_transform_t *transform, float x, float y, float z)
 {
     c_matrix_scale(&transform->matrix, x, y, z);
+    rut_transformable_changed(transform);
 }
 
 void
@@ -119,12 +126,14 @@ rut_transform_transform(rut_transform_t *transform,
                         const c_matrix_t *matrix)
 {
     c_matrix_multiply(&transform->matrix, &transform->matrix, matrix);
+    rut_transformable_changed(transform);
 }
 
 void
 rut_transform_init_identity(rut_transform_t *transform)
 {
     c_matrix_init_identity(&transform->matrix);
+    rut_transformable_changed(transform);
 }
 
 const c_matrix_t *
@@ -278,50 +278,36 @@ rut_util_intersect_triangle(float v0[3],
 }
 
 typedef struct _intersect_state_t {
-    float *ray_origin;
-    float *ray_direction;
-    float min_t;
-    int index;
+    const float *triangles;
     int hit_index;
-    bool found;
 } intersect_state_t;
 
 static bool
-intersect_triangle_cb(void **attributes_v0,
-                      void **attributes_v1,
-                      void **attributes_v2,
-                      int index_v0,
-                      int index_v1,
-                      int index_v2,
+intersect_triangle_cb(int triangle,
+                      const float ray_origin[3],
+                      const float ray_direction[3],
+                      float *t_max,
                       void *user_data)
 {
     intersect_state_t *state = user_data;
-    float *pos_v0 = attributes_v0[0];
-    float *pos_v1 = attributes_v1[0];
-    float *pos_v2 = attributes_v2[0];
-    float u, v, t;
+    float *v = (float *)state->triangles + triangle * 9;
+    float u, w, t;
     bool hit;
 
-    hit = rut_util_intersect_triangle(pos_v0,
-                                      pos_v1,
-                                      pos_v2,
-                                      state->ray_origin,
-                                      state->ray_direction,
-                                      &u,
-                                      &v,
-                                      &t);
+    hit = rut_util_intersect_triangle(v, v + 3, v + 6,
+                                      (float *)ray_origin,
+                                      (float *)ray_direction,
+                                      &u, &w, &t);
 
     /* found a closer triangle. t > 0 means that we don't want results
      * behind the ray origin */
-    if (hit && t > 0 && t < state->min_t) {
-        state->min_t = t;
-        state->found = true;
-        state->hit_index = state->index;
+    if (hit && t > 0 && t < *t_max) {
+        *t_max = t;
+        state->hit_index = triangle;
+        return true;
     }
 
-    state->index++;
-
-    return true;
+    return false;
 }
 
 bool
@@ -332,21 +318,22 @@ rut_util_intersect_mesh(rut_mesh_t *mesh,
                         float *t_out)
 {
     intersect_state_t state;
+    rut_bvh_t *bvh = rut_mesh_get_bvh(mesh, &state.triangles);
+    float t;
 
-    state.ray_origin = ray_origin;
-    state.ray_direction = ray_direction;
-    state.min_t = FLT_MAX;
-    state.found = false;
-    state.index = 0;
-
-    c_warn_if_fail(mesh->n_vertices < 10000);
+    if (!bvh)
+        return false;
 
-    rut_mesh_foreach_triangle(
-        mesh, intersect_triangle_cb, &state, "cg_position_in", NULL);
+    state.hit_index = 0;
 
-    if (state.found) {
+    if (rut_bvh_intersect_ray(bvh,
+                              ray_origin,
+                              ray_direction,
+                              intersect_triangle_cb,
+                              &state,
+                              &t)) {
         if (t_out)
-            *t_out = state.min_t;
+            *t_out = t;
 
         if (index)
             *index = state.hit_index;
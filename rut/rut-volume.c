@@ -485,7 +485,7 @@ _rut_volume_complete(rut_volume_t *volume)
  * rut_box_clamp_to_pixel()</note>
  */
 void
-_rut_volume_get_bounding_box(rut_volume_t *volume, rut_box_t *box)
+rut_volume_get_bounding_box(rut_volume_t *volume, rut_box_t *box)
 {
     float x_min, y_min, x_max, y_max;
     rut_vector3_t *vertices;
@@ -536,7 +536,7 @@ _rut_volume_get_bounding_box(rut_volume_t *volume, rut_box_t *box)
 }
 
 void
-_rut_volume_project(rut_volume_t *volume,
+rut_volume_project(rut_volume_t *volume,
                     const c_matrix_t *modelview,
                     const c_matrix_t *projection,
                     const float *viewport)
@@ -576,7 +576,7 @@ _rut_volume_project(rut_volume_t *volume,
 }
 
 void
-_rut_volume_transform(rut_volume_t *volume, const c_matrix_t *matrix)
+rut_volume_transform(rut_volume_t *volume, const c_matrix_t *matrix)
 {
     int transform_count;
 
@@ -746,6 +746,22 @@ rut_volume_cull(rut_volume_t *volume,
         return RUT_CULL_RESULT_IN;
 }
 
+rut_cull_result_t
+rut_volume_cull_with_modelview(const rut_volume_t *volume,
+                               const c_matrix_t *modelview,
+                               const rut_plane_t *planes)
+{
+    rut_volume_t eye_volume;
+
+    if (volume->is_empty)
+        return RUT_CULL_RESULT_OUT;
+
+    _rut_volume_copy_static(volume, &eye_volume);
+    rut_volume_transform(&eye_volume, modelview);
+
+    return rut_volume_cull(&eye_volume, planes);
+}
+
 void
 _rut_volume_get_stable_bounding_int_rectangle(rut_volume_t *volume,
                                               float *viewport,
@@ -759,9 +775,9 @@ _rut_volume_get_stable_bounding_int_rectangle(rut_volume_t *volume,
 
     _rut_volume_copy_static(volume, &projected_volume);
 
-    _rut_volume_project(&projected_volume, modelview, projection, viewport);
+    rut_volume_project(&projected_volume, modelview, projection, viewport);
 
-    _rut_volume_get_bounding_box(&projected_volume, box);
+    rut_volume_get_bounding_box(&projected_volume, box);
 
     /* The aim here is that for a given rectangle defined with floating point
      * coordinates we want to determine a stable quantized size in pixels
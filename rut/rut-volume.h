@@ -215,6 +215,24 @@ void rut_volume_axis_align(rut_volume_t *volume);
 
 rut_cull_result_t rut_volume_cull(rut_volume_t *pv, const rut_plane_t *planes);
 
+/**
+ * rut_volume_cull_with_modelview:
+ * @volume: A #rut_volume_t in model coordinates
+ * @modelview: A transform from model coordinates to eye coordinates
+ * @planes: Four eye coordinate clip planes, such as returned by
+ *          rut_get_eye_planes_for_screen_poly()
+ *
+ * Transforms a temporary copy of @volume into eye coordinates and
+ * culls it against the given @planes, leaving @volume untouched so
+ * that it can be cached.
+ *
+ * Return value: whether @volume is inside, outside or partially
+ *   inside the region bounded by @planes.
+ */
+rut_cull_result_t rut_volume_cull_with_modelview(const rut_volume_t *volume,
+                                                 const c_matrix_t *modelview,
+                                                 const rut_plane_t *planes);
+
 C_END_DECLS
 
 #endif /* _RUT_VOLUME_H_ */
@@ -56,6 +56,7 @@
 #include "rut-geometry.h"
 #include "rut-color.h"
 #include "rut-gaussian-blurrer.h"
+#include "rut-bvh.h"
 #include "rut-mesh.h"
 #include "rut-mesh-ply.h"
 #include "rut-mimable.h"
@@ -130,6 +130,13 @@ main (int argc, char **argv)
 
   ADD_CG_TEST(test_texture_rg, TEST_CG_REQUIREMENT_TEXTURE_RG);
 
+  ADD_CG_TEST(test_rig_lighting, 0);
+  ADD_CG_TEST(test_rig_binding, 0);
+  ADD_CG_TEST(test_rig_property, 0);
+  ADD_CG_TEST(test_rig_property_delta, 0);
+  ADD_CG_TEST(test_rig_transformable, 0);
+  ADD_CG_TEST(test_rig_ui_load, 0);
+
   c_printerr("Unknown test name \"%s\"\n", argv[1]);
 
   return 1;
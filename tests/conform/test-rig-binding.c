@@ -0,0 +1,530 @@
+#include <config.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-engine.h"
+#include "rig-binding-program.h"
+#include "rig-binding.h"
+#include "rig-code.h"
+#include "rig-entity.h"
+#ifdef USE_LLVM
+#include <cmodule.h>
+
+#include "rig-llvm.h"
+#endif
+
+#include "test-cg-fixtures.h"
+
+/* Expressions compiled for the bytecode interpreter should give the
+ * same results as the C code that the LLVM backend compiles for a
+ * binding, which we get here by compiling the same expressions
+ * natively. When built with LLVM the expressions are also compiled by
+ * the LLVM backend itself. */
+
+typedef struct _values_t {
+  int padding; /* A data_offset of 0 isn't valid */
+
+  float x;
+  float y;
+  int n;
+  bool flag;
+  double d;
+
+  float out_float;
+  int out_int;
+  bool out_bool;
+} values_t;
+
+enum {
+  PROP_X,
+  PROP_Y,
+  PROP_N,
+  PROP_FLAG,
+  PROP_D,
+  N_INPUTS,
+  PROP_OUT_FLOAT = N_INPUTS,
+  PROP_OUT_INT,
+  PROP_OUT_BOOL,
+  N_PROPS
+};
+
+static rig_property_spec_t specs[] = {
+  { .name = "x", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof(values_t, x) },
+  { .name = "y", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof(values_t, y) },
+  { .name = "n", .type = RUT_PROPERTY_TYPE_INTEGER,
+    .data_offset = offsetof(values_t, n) },
+  { .name = "flag", .type = RUT_PROPERTY_TYPE_BOOLEAN,
+    .data_offset = offsetof(values_t, flag) },
+  { .name = "d", .type = RUT_PROPERTY_TYPE_DOUBLE,
+    .data_offset = offsetof(values_t, d) },
+  { .name = "out_float", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof(values_t, out_float) },
+  { .name = "out_int", .type = RUT_PROPERTY_TYPE_INTEGER,
+    .data_offset = offsetof(values_t, out_int) },
+  { .name = "out_bool", .type = RUT_PROPERTY_TYPE_BOOLEAN,
+    .data_offset = offsetof(values_t, out_bool) },
+};
+
+#define TEST_EXPRESSIONS(X)                                             \
+  X (arithmetic, float, PROP_OUT_FLOAT, x * 2 + y / 3 - 1.5)           \
+  X (int_division, int, PROP_OUT_INT, n / 3 + n % 3)                   \
+  X (negative_division, int, PROP_OUT_INT, -n * 7 / 2)                 \
+  X (constant_folding, float, PROP_OUT_FLOAT, 3 / 2 + x * (1 + 2.5))  \
+  X (ternary, float, PROP_OUT_FLOAT, x > y ? x - y : y - x)            \
+  X (logic, bool, PROP_OUT_BOOL, (flag && n > 2) || !flag)             \
+  X (comparisons, int, PROP_OUT_INT, (x <= y) + (n == 3) * 2 + (n != 0)) \
+  X (math, float, PROP_OUT_FLOAT, sinf(x) * cosf(y) + sqrtf(fabsf(y))) \
+  X (math2, float, PROP_OUT_FLOAT, pow(x, 2) + atan2(y, x) + floorf(y)) \
+  X (fmod, float, PROP_OUT_FLOAT, fmodf(x, 0.75f) + fmax(x, y))         \
+  X (casts, int, PROP_OUT_INT, (int)(x * 10) / 4 + (int)d)             \
+  X (float_cast, float, PROP_OUT_FLOAT, (float)n / 4 + d * 0.5)         \
+  X (abs, int, PROP_OUT_INT, abs(n - 5) + abs(-3))                     \
+  X (truncate, int, PROP_OUT_INT, x * 3)                               \
+  X (bool_to_float, float, PROP_OUT_FLOAT, flag + M_PI)
+
+#define NATIVE_FUNC(NAME, CTYPE, PROP, EXPR)                            \
+  static double                                                         \
+  native_##NAME (float x, float y, int n, bool flag, double d)          \
+  {                                                                     \
+    CTYPE out;                                                          \
+    out = EXPR;                                                         \
+    return out;                                                         \
+  }
+
+TEST_EXPRESSIONS (NATIVE_FUNC)
+
+typedef struct _test_case_t {
+  const char *name;
+  const char *expression;
+  int out_prop;
+  double (*native) (float x, float y, int n, bool flag, double d);
+} test_case_t;
+
+#define TEST_CASE(NAME, CTYPE, PROP, EXPR) \
+  { #NAME, #EXPR, PROP, native_##NAME },
+
+static const test_case_t test_cases[] = {
+  TEST_EXPRESSIONS (TEST_CASE)
+};
+
+/* The code generated for bindings doesn't include any system headers
+ * and rig-codegen.h defines bool as an int so we declare what the
+ * expressions need ourselves and avoid bool in the signatures */
+typedef double (*llvm_expression_func_t) (float x, float y, int n, int flag,
+                                          double d);
+
+#ifdef USE_LLVM
+#define LLVM_SOURCE(NAME, CTYPE, PROP, EXPR)                            \
+  "double llvm_" #NAME " (float x, float y, int n, int flag, double d)\n" \
+  "{\n"                                                                 \
+  "  " #CTYPE " out;\n"                                                 \
+  "  out = " #EXPR ";\n"                                                \
+  "  return out;\n"                                                     \
+  "}\n"
+
+static const char llvm_source[] =
+  "float sinf (float);\n"
+  "float cosf (float);\n"
+  "float sqrtf (float);\n"
+  "float fabsf (float);\n"
+  "float floorf (float);\n"
+  "float fmodf (float, float);\n"
+  "double pow (double, double);\n"
+  "double atan2 (double, double);\n"
+  "double fmax (double, double);\n"
+  "int abs (int);\n"
+  "#define M_PI 3.14159265358979323846\n"
+  TEST_EXPRESSIONS (LLVM_SOURCE);
+
+/* Compiles all of the test expressions with the LLVM backend and
+ * resolves a function for each test case. Returns NULL if the backend
+ * can't currently produce a DSO, in which case there is nothing to
+ * compare against. */
+static c_module_t *
+compile_llvm_expressions (llvm_expression_func_t *funcs)
+{
+  char *dso_filename = NULL;
+  uint8_t *dso_data = NULL;
+  size_t dso_len;
+  rig_llvm_module_t *module;
+  c_module_t *dso;
+  int i;
+
+  module = rig_llvm_compile_to_dso (llvm_source,
+                                    &dso_filename,
+                                    &dso_data,
+                                    &dso_len);
+  if (!module)
+    {
+      if (test_verbose ())
+        c_print ("Skipping LLVM comparison: failed to build a DSO\n");
+      return NULL;
+    }
+
+  /* XXX: like rig-code.c we don't free the llvm module since that
+   * currently crashes */
+
+  dso = c_module_open (dso_filename);
+  c_assert (dso);
+
+  for (i = 0; i < C_N_ELEMENTS (test_cases); i++)
+    {
+      char *symbol = c_strdup_printf ("llvm_%s", test_cases[i].name);
+
+      c_assert (c_module_symbol (dso, symbol, (void **)&funcs[i]));
+      c_free (symbol);
+    }
+
+  c_free (dso_data);
+  c_free (dso_filename);
+
+  return dso;
+}
+#endif /* USE_LLVM */
+
+static const char *bad_expressions[] = {
+  "out[0] = x;", /* vector outputs aren't supported */
+  "x +",
+  "foo(x)",
+  "x % y", /* invalid in C */
+  "out = z;",
+  "out = x; out = y;",
+  "pow(x)",
+};
+
+static double
+get_output (values_t *values, int prop)
+{
+  switch (prop)
+    {
+    case PROP_OUT_FLOAT:
+      return values->out_float;
+    case PROP_OUT_INT:
+      return values->out_int;
+    case PROP_OUT_BOOL:
+      return values->out_bool;
+    }
+
+  c_assert_not_reached ();
+  return 0;
+}
+
+static void
+check_result (const test_case_t *test,
+              float x, float y, int n, bool flag, double d,
+              double result,
+              const char *backend,
+              double expected)
+{
+  if (fabs (result - expected) <= 1e-4 * MAX (1, fabs (expected)))
+    return;
+
+  c_print ("\"%s\": x=%f, y=%f, n=%d, flag=%d, d=%f: "
+           "interpreted %f, %s %f\n",
+           test->expression, x, y, n, flag, d,
+           result, backend, expected);
+  c_assert_not_reached ();
+}
+
+static void
+check_expression (const test_case_t *test,
+                  llvm_expression_func_t llvm,
+                  rig_property_context_t *ctx,
+                  values_t *values,
+                  rig_property_t *props,
+                  rig_property_t **inputs,
+                  const char **input_names,
+                  rig_property_type_t *input_types)
+{
+  static const float xs[] = { -2.5, 0, 1.25, 3.75 };
+  static const float ys[] = { 0.5, -1.75, 4 };
+  static const int ns[] = { -7, 0, 3, 10 };
+  static const double ds[] = { -1.5, 0.1, 2.75 };
+  rig_property_t *out = &props[test->out_prop];
+  rig_binding_program_t *programs[2];
+  char *statement;
+  int i, j, k, l, m, p;
+
+  /* Both the statement form that the editor generates and a bare
+   * expression should be accepted */
+  statement = c_strdup_printf ("out = %s;", test->expression);
+  programs[0] = rig_binding_program_new (statement,
+                                         out->spec->type,
+                                         N_INPUTS,
+                                         input_names,
+                                         input_types,
+                                         NULL);
+  programs[1] = rig_binding_program_new (test->expression,
+                                         out->spec->type,
+                                         N_INPUTS,
+                                         input_names,
+                                         input_types,
+                                         NULL);
+  c_assert (programs[0]);
+  c_assert (programs[1]);
+  c_free (statement);
+
+  for (i = 0; i < C_N_ELEMENTS (xs); i++)
+    for (j = 0; j < C_N_ELEMENTS (ys); j++)
+      for (k = 0; k < C_N_ELEMENTS (ns); k++)
+        for (l = 0; l < 2; l++)
+          for (m = 0; m < C_N_ELEMENTS (ds); m++)
+            for (p = 0; p < 2; p++)
+              {
+                double expected = test->native (xs[i], ys[j], ns[k], l, ds[m]);
+                double result;
+
+                values->x = xs[i];
+                values->y = ys[j];
+                values->n = ns[k];
+                values->flag = l;
+                values->d = ds[m];
+
+                rig_binding_program_apply (programs[p], ctx, out, inputs);
+                result = get_output (values, test->out_prop);
+
+                check_result (test, xs[i], ys[j], ns[k], l, ds[m],
+                              result, "native", expected);
+
+                if (llvm)
+                  check_result (test, xs[i], ys[j], ns[k], l, ds[m],
+                                result, "LLVM",
+                                llvm (xs[i], ys[j], ns[k], l, ds[m]));
+              }
+
+  rig_binding_program_free (programs[0]);
+  rig_binding_program_free (programs[1]);
+}
+
+/* The native code linked for the binding in check_relink(), whose
+ * function name is derived from the binding id */
+#define RELINK_BINDING_ID 1
+#define RELINK_SOURCE                                                   \
+  "void\n"                                                              \
+  "_binding1 (rig_property_t *_property, void *_user_data)\n"           \
+  "{\n"                                                                 \
+  "  rig_property_context_t *_property_ctx = _user_data;\n"             \
+  "  float out[3] = { 1, 2, 3 };\n"                                     \
+  "  rig_property_set_vec3 (_property_ctx, _property, out);\n"          \
+  "}\n"
+
+static rig_engine_t *
+create_engine (void)
+{
+  rut_shell_t *shell;
+  rig_engine_t *engine;
+
+  rut_init ();
+
+  shell = rut_shell_new (NULL, /* main shell */
+                         NULL, /* paint */
+                         NULL); /* user data */
+  rut_shell_set_is_headless (shell, true);
+
+  engine = rig_engine_new_for_frontend (shell, NULL);
+
+  return engine;
+}
+
+static void
+destroy_engine (rig_engine_t *engine)
+{
+  rut_shell_t *shell = engine->shell;
+
+  rut_object_unref (engine);
+  rut_object_unref (shell);
+}
+
+/* A binding that couldn't be activated must still be activated once
+ * its expression is changed to something we can evaluate, and must
+ * stop updating once deactivated */
+static void
+check_reactivate (rig_engine_t *engine)
+{
+  rig_entity_t *source = rig_entity_new (engine);
+  rig_entity_t *target = rig_entity_new (engine);
+  rig_binding_t *binding =
+    rig_binding_new (engine,
+                     rig_introspectable_lookup_property (target, "scale"),
+                     2);
+
+  rig_binding_add_dependency (binding,
+                              rig_introspectable_lookup_property (source,
+                                                                  "scale"),
+                              "s");
+
+  rig_binding_set_expression (binding, "foo(s)");
+  rig_binding_activate (binding);
+
+  rig_entity_set_scale (source, 2);
+  c_assert_cmpfloat (rig_entity_get_scale (target), ==, 1);
+
+  rig_binding_set_expression (binding, "s * 2");
+
+  rig_entity_set_scale (source, 3);
+  c_assert_cmpfloat (rig_entity_get_scale (target), ==, 6);
+
+  rig_binding_deactivate (binding);
+
+  rig_entity_set_scale (source, 4);
+  c_assert_cmpfloat (rig_entity_get_scale (target), ==, 6);
+
+  rut_object_unref (binding);
+  rut_object_unref (source);
+  rut_object_unref (target);
+}
+
+#ifdef USE_LLVM
+/* A binding that only LLVM can evaluate must be activated when the
+ * code for its latest expression is linked, even though it couldn't
+ * be activated while that code was being compiled */
+static void
+check_relink (rig_engine_t *engine)
+{
+  rig_entity_t *source = rig_entity_new (engine);
+  rig_entity_t *target = rig_entity_new (engine);
+  rig_binding_t *binding =
+    rig_binding_new (engine,
+                     rig_introspectable_lookup_property (target, "position"),
+                     RELINK_BINDING_ID);
+  char *dso_filename = NULL;
+  uint8_t *dso_data = NULL;
+  size_t dso_len;
+  const float *position;
+
+  rig_binding_add_dependency (binding,
+                              rig_introspectable_lookup_property (source,
+                                                                  "position"),
+                              "pos");
+
+  rig_binding_set_expression (binding, "out[0] = pos[0];");
+  rig_binding_activate (binding);
+
+  /* Editing the vec3 binding can't be handled by the interpreter */
+  rig_binding_set_expression (binding,
+                              "out[0] = 1; out[1] = 2; out[2] = 3;");
+
+  if (rig_llvm_compile_to_dso (RELINK_SOURCE,
+                               &dso_filename,
+                               &dso_data,
+                               &dso_len))
+    {
+      rig_code_update_dso (engine, dso_data, dso_len);
+
+      rig_entity_set_position (source, (float[3]) { 4, 5, 6 });
+
+      position = rig_entity_get_position (target);
+      c_assert_cmpfloat (position[0], ==, 1);
+      c_assert_cmpfloat (position[1], ==, 2);
+      c_assert_cmpfloat (position[2], ==, 3);
+
+      c_free (dso_data);
+      c_free (dso_filename);
+    }
+  else if (test_verbose ())
+    c_print ("Skipping relink check: failed to build a DSO\n");
+
+  rig_binding_deactivate (binding);
+  rig_code_update_dso (engine, NULL, 0);
+
+  rut_object_unref (binding);
+  rut_object_unref (source);
+  rut_object_unref (target);
+}
+#endif /* USE_LLVM */
+
+void
+test_rig_binding (void)
+{
+  rig_property_context_t ctx;
+  values_t values;
+  rig_property_t props[N_PROPS];
+  rig_property_t *inputs[N_INPUTS];
+  const char *input_names[N_INPUTS];
+  rig_property_type_t input_types[N_INPUTS];
+  llvm_expression_func_t llvm_funcs[C_N_ELEMENTS (test_cases)] = { NULL };
+#ifdef USE_LLVM
+  c_module_t *llvm_dso = compile_llvm_expressions (llvm_funcs);
+#endif
+  rig_engine_t *engine;
+  int i;
+
+  memset (&values, 0, sizeof (values));
+
+  rig_property_context_init (&ctx);
+
+  for (i = 0; i < N_PROPS; i++)
+    rig_property_init (&props[i], &specs[i], &values, i);
+
+  for (i = 0; i < N_INPUTS; i++)
+    {
+      inputs[i] = &props[i];
+      input_names[i] = specs[i].name;
+      input_types[i] = specs[i].type;
+    }
+
+  for (i = 0; i < C_N_ELEMENTS (test_cases); i++)
+    check_expression (&test_cases[i], llvm_funcs[i], &ctx, &values,
+                      props, inputs, input_names, input_types);
+
+  /* Anything outside of the supported subset should be rejected so
+   * that we can fall back to LLVM */
+  for (i = 0; i < C_N_ELEMENTS (bad_expressions); i++)
+    {
+      rut_exception_t *e = NULL;
+      rig_binding_program_t *program =
+        rig_binding_program_new (bad_expressions[i],
+                                 RUT_PROPERTY_TYPE_FLOAT,
+                                 N_INPUTS,
+                                 input_names,
+                                 input_types,
+                                 &e);
+
+      c_assert (program == NULL);
+      c_assert (e != NULL);
+      c_assert (e->domain == RUT_BINDING_EXCEPTION);
+
+      if (test_verbose ())
+        c_print ("%s\n", e->message);
+
+      rut_exception_free (e);
+    }
+
+  /* Only scalar outputs are supported */
+  {
+    rut_exception_t *e = NULL;
+
+    c_assert (rig_binding_program_new ("x", RUT_PROPERTY_TYPE_VEC3,
+                                       N_INPUTS, input_names, input_types,
+                                       &e) == NULL);
+    c_assert (e != NULL);
+    c_assert (strstr (e->message, "at offset 0 ") != NULL);
+    rut_exception_free (e);
+  }
+
+  rig_property_context_destroy (&ctx);
+
+#ifdef USE_LLVM
+  if (llvm_dso)
+    c_module_close (llvm_dso);
+#endif
+
+  engine = create_engine ();
+
+  check_reactivate (engine);
+#ifdef USE_LLVM
+  check_relink (engine);
+#endif
+
+  destroy_engine (engine);
+
+  if (test_verbose ())
+    c_print ("OK\n");
+}
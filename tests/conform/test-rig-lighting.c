@@ -0,0 +1,339 @@
+#include <config.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cglib/cglib.h>
+
+#include <rut.h>
+
+#include "rig-engine.h"
+#include "rig-entity.h"
+#include "rig-ui.h"
+#include "rig-lighting.h"
+#include "components/rig-camera.h"
+#include "components/rig-light.h"
+
+#include "test-cg-fixtures.h"
+
+/* More than RIG_MAX_LIGHTS, one of which has no camera and so can't
+ * be used */
+#define N_SCENE_LIGHTS (RIG_MAX_LIGHTS + 2)
+#define CAMERALESS_LIGHT 2
+
+#define ATLAS_SIZE 256
+
+static bool
+snippet_mentions (cg_snippet_t *snippet, const char *name)
+{
+  const char *declarations = cg_snippet_get_declarations (snippet);
+  const char *post = cg_snippet_get_post (snippet);
+
+  return ((declarations && strstr (declarations, name)) ||
+          (post && strstr (post, name)));
+}
+
+static void
+check_snippets (int n_lights)
+{
+  rig_lighting_snippets_t snippets;
+  char name[64];
+  int model;
+  int i;
+
+  rig_lighting_snippets_init (&snippets, n_lights);
+
+  c_assert_cmpint (snippets.n_lights, ==, n_lights);
+
+  /* Every light's uniforms should be declared, and no more */
+  for (i = 0; i <= n_lights; i++)
+    {
+      bool expected = i < n_lights;
+
+      snprintf (name, sizeof (name), "light%d_shadow_matrix", i);
+      c_assert (snippet_mentions (snippets.light_coords_vertex, name) ==
+                expected);
+
+      snprintf (name, sizeof (name), "light%d_direction_norm", i);
+      c_assert (snippet_mentions (snippets.normal_map_vertex, name) ==
+                expected);
+
+      for (model = 0; model < RIG_N_LIGHTING_MODELS; model++)
+        {
+          snprintf (name, sizeof (name), "light%d_diffuse", i);
+          c_assert (snippet_mentions (snippets.fragment[model][0], name) ==
+                    expected);
+          c_assert (snippet_mentions (snippets.fragment[model][1], name) ==
+                    expected);
+
+          snprintf (name, sizeof (name), "light%d_shadow_tile", i);
+          c_assert (!snippet_mentions (snippets.fragment[model][0], name));
+          c_assert (snippet_mentions (snippets.fragment[model][1], name) ==
+                    expected);
+        }
+    }
+
+  /* Only the simple model should get by without the material */
+  c_assert (!snippet_mentions (snippets.fragment[RIG_LIGHTING_MODEL_SIMPLE][0],
+                               "material_diffuse"));
+  c_assert (snippet_mentions (snippets.fragment[RIG_LIGHTING_MODEL_MATERIAL][0],
+                              "material_diffuse"));
+
+  rig_lighting_snippets_destroy (&snippets);
+}
+
+static void
+check_shadow_tiles (int n_lights)
+{
+  float tiles[RIG_MAX_LIGHTS][4];
+  int i, j;
+
+  for (i = 0; i < n_lights; i++)
+    {
+      float *tile = tiles[i];
+
+      rig_lighting_get_shadow_tile (n_lights, i, tile);
+
+      /* Each tile must lie within the atlas... */
+      c_assert (tile[0] >= 0 && tile[0] + tile[2] <= 1);
+      c_assert (tile[1] >= 0 && tile[1] + tile[3] <= 1);
+      c_assert (tile[2] > 0 && tile[3] > 0);
+
+      /* ...and not overlap any other light's tile */
+      for (j = 0; j < i; j++)
+        {
+          float *other = tiles[j];
+
+          c_assert (tile[0] >= other[0] + other[2] ||
+                    other[0] >= tile[0] + tile[2] ||
+                    tile[1] >= other[1] + other[3] ||
+                    other[1] >= tile[1] + tile[3]);
+        }
+    }
+
+  /* A single light gets the whole atlas */
+  if (n_lights == 1)
+    {
+      c_assert_cmpfloat (tiles[0][2], ==, 1);
+      c_assert_cmpfloat (tiles[0][3], ==, 1);
+    }
+}
+
+static void
+check_uniform_locations (int n_lights)
+{
+  cg_pipeline_t *pipeline = cg_pipeline_new (test_dev);
+  int locations[RIG_MAX_LIGHTS];
+  char name[64];
+  int i, j;
+
+  for (i = 0; i < n_lights; i++)
+    {
+      locations[i] =
+        rig_lighting_get_uniform_location (pipeline, i, "diffuse");
+
+      snprintf (name, sizeof (name), "light%d_diffuse", i);
+      c_assert_cmpint (locations[i], ==,
+                       cg_pipeline_get_uniform_location (pipeline, name));
+
+      for (j = 0; j < i; j++)
+        c_assert_cmpint (locations[i], !=, locations[j]);
+    }
+
+  /* The tile uniforms are set once, when a pipeline is created */
+  rig_lighting_set_shadow_tile_uniforms (pipeline, n_lights);
+
+  cg_object_unref (pipeline);
+}
+
+static rig_engine_t *
+create_engine (void)
+{
+  rut_shell_t *shell;
+
+  rut_init ();
+
+  shell = rut_shell_new (NULL, /* main shell */
+                         NULL, /* paint */
+                         NULL); /* user data */
+  rut_shell_set_is_headless (shell, true);
+
+  return rig_engine_new_for_frontend (shell, NULL);
+}
+
+static void
+destroy_engine (rig_engine_t *engine)
+{
+  rut_shell_t *shell = engine->shell;
+
+  rut_object_unref (engine);
+  rut_object_unref (shell);
+}
+
+/* Adds a light with a distinct diffuse color to the scene. Every
+ * other light is a spot light and is turned to face along the x
+ * axis. */
+static rig_entity_t *
+add_light (rig_engine_t *engine, rig_ui_t *ui, int index)
+{
+  rig_entity_t *entity = rig_entity_new (engine);
+  rig_light_t *light = rig_light_new (engine);
+  cg_color_t diffuse = { index / 10.0f, 0.5f, 1, 1 };
+  float position[3] = { index, 0, 10 };
+
+  rig_entity_set_position (entity, position);
+  if (index % 2)
+    {
+      rig_entity_rotate_y_axis (entity, 90);
+      rig_light_set_kind (light, RIG_LIGHT_KIND_SPOT);
+    }
+
+  rig_light_set_diffuse (light, &diffuse);
+  rig_entity_add_component (entity, light);
+  rut_object_unref (light);
+
+  if (index != CAMERALESS_LIGHT)
+    {
+      rig_camera_t *camera = rig_camera_new (engine,
+                                             -1, /* ortho/vp width */
+                                             -1, /* ortho/vp height */
+                                             NULL);
+
+      rig_entity_add_component (entity, camera);
+      rut_object_unref (camera);
+    }
+
+  rut_graphable_add_child (ui->scene, entity);
+  rut_object_unref (entity);
+
+  rig_ui_register_all_entity_components (ui, entity);
+
+  return entity;
+}
+
+static void
+check_floats (const float *values, const float *expected, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    c_assert (fabsf (values[i] - expected[i]) < 0.0001f);
+}
+
+/* The nop driver never uploads uniforms so this checks the values
+ * each light sets on a pipeline drawn with the gathered lights */
+static void
+check_scene_uniforms (rig_entity_t **lights, int n_lights)
+{
+  cg_pipeline_t *pipeline = cg_pipeline_new (test_dev);
+  rig_light_t *light_components[RIG_MAX_LIGHTS];
+  int i;
+
+  for (i = 0; i < n_lights; i++)
+    light_components[i] =
+      rig_entity_get_component (lights[i], RIG_COMPONENT_TYPE_LIGHT);
+
+  rig_lighting_set_shadow_tile_uniforms (pipeline, n_lights);
+  rig_lighting_set_light_uniforms (pipeline, light_components, n_lights);
+
+  for (i = 0; i < n_lights; i++)
+    {
+      rig_light_t *light = light_components[i];
+      rig_light_uniforms_t uniforms;
+      /* add_light() positions each light by its index */
+      int index = rig_entity_get_position (lights[i])[0];
+      bool spot = index % 2;
+      float diffuse[4] = { index / 10.0f, 0.5f, 1, 1 };
+      /* Spot lights have been turned to face along the x axis */
+      float direction[3] = { spot ? 1 : 0, 0, spot ? 0 : 1 };
+
+      rig_light_get_uniforms (light, &uniforms);
+
+      check_floats (uniforms.diffuse, diffuse, 4);
+      check_floats (uniforms.direction_norm, direction, 3);
+      c_assert_cmpfloat (uniforms.spot, ==, spot ? 1 : 0);
+    }
+
+  cg_object_unref (pipeline);
+}
+
+/* Builds a scene with more lights than can be used and checks which
+ * lights the renderer picks, which tile of the shadow map atlas each
+ * of them renders to and the light uniforms of a pipeline drawn with
+ * them */
+static void
+check_scene (void)
+{
+  rig_engine_t *engine = create_engine ();
+  rig_ui_t *ui = rig_ui_new (engine);
+  rig_entity_t *scene_lights[N_SCENE_LIGHTS];
+  rig_entity_t *lights[RIG_MAX_LIGHTS];
+  cg_texture_2d_t *atlas_texture;
+  cg_offscreen_t *atlas;
+  int n_lights;
+  int i, j;
+
+  ui->scene = rig_entity_new (engine);
+
+  for (i = 0; i < N_SCENE_LIGHTS; i++)
+    scene_lights[i] = add_light (engine, ui, i);
+
+  n_lights = rig_lighting_gather_lights (ui, lights);
+  c_assert_cmpint (n_lights, ==, RIG_MAX_LIGHTS);
+
+  for (i = 0; i < n_lights; i++)
+    {
+      c_assert (lights[i] != scene_lights[CAMERALESS_LIGHT]);
+
+      for (j = 0; j < i; j++)
+        c_assert (lights[i] != lights[j]);
+    }
+
+  atlas_texture =
+    cg_texture_2d_new_with_size (test_dev, ATLAS_SIZE, ATLAS_SIZE);
+  atlas = cg_offscreen_new_with_texture (atlas_texture);
+
+  for (i = 0; i < n_lights; i++)
+    {
+      rut_object_t *camera =
+        rig_entity_get_component (lights[i], RIG_COMPONENT_TYPE_CAMERA);
+      const float *viewport;
+      float tile[4];
+
+      rig_lighting_set_shadow_camera (lights[i], atlas, n_lights, i);
+      rig_lighting_get_shadow_tile (n_lights, i, tile);
+
+      c_assert (rut_camera_get_framebuffer (camera) == atlas);
+
+      viewport = rut_camera_get_viewport (camera);
+      for (j = 0; j < 4; j++)
+        c_assert_cmpfloat (viewport[j], ==, tile[j] * ATLAS_SIZE);
+    }
+
+  check_scene_uniforms (lights, n_lights);
+
+  cg_object_unref (atlas);
+  cg_object_unref (atlas_texture);
+
+  rut_object_unref (ui);
+  destroy_engine (engine);
+}
+
+void
+test_rig_lighting (void)
+{
+  int n_lights;
+
+  for (n_lights = 1; n_lights <= RIG_MAX_LIGHTS; n_lights++)
+    {
+      check_snippets (n_lights);
+      check_shadow_tiles (n_lights);
+      check_uniform_locations (n_lights);
+    }
+
+  check_scene ();
+
+  if (test_verbose ())
+    c_print ("OK\n");
+}
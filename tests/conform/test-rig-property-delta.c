@@ -0,0 +1,362 @@
+#include <config.h>
+
+#include <string.h>
+
+#include <rut.h>
+
+#include "rig-property-delta.h"
+
+#include "test-cg-fixtures.h"
+
+/* Checks that property changes encoded by a rig_property_delta_t are
+ * decoded back to the same values by a second rig_property_delta_t
+ * that mirrors it, as done between the simulator and frontend. */
+
+#define OBJECT_A 10
+#define OBJECT_B 42
+
+typedef struct _state_t {
+  rig_property_delta_t *encoder;
+  rig_property_delta_t *decoder;
+  c_byte_array_t *buf;
+  rut_memory_stack_t *stack;
+
+  /* Some fake objects to encode object values */
+  int objects[2];
+} state_t;
+
+static uint64_t
+object_to_id_cb (void *object, void *user_data)
+{
+  state_t *state = user_data;
+
+  return object == &state->objects[0] ? OBJECT_A : OBJECT_B;
+}
+
+static void
+init_state (state_t *state)
+{
+  state->encoder = rig_property_delta_new ();
+  rig_property_delta_set_object_to_id_callback (state->encoder,
+                                                object_to_id_cb,
+                                                state);
+  state->decoder = rig_property_delta_new ();
+  state->buf = c_byte_array_new ();
+  state->stack = rut_memory_stack_new (1024);
+}
+
+static void
+fini_state (state_t *state)
+{
+  rig_property_delta_free (state->encoder);
+  rig_property_delta_free (state->decoder);
+  c_byte_array_free (state->buf, true);
+  rut_memory_stack_free (state->stack);
+}
+
+/* Encodes a single change as the only change of a frame and returns
+ * the number of bytes it took */
+static int
+encode_change (state_t *state,
+               uint64_t object_id,
+               int prop_id,
+               const rut_boxed_t *value)
+{
+  c_byte_array_set_size (state->buf, 0);
+
+  rig_property_delta_begin_frame (state->encoder);
+  rig_property_delta_encode (state->encoder, state->buf,
+                             object_id, prop_id, value);
+
+  return state->buf->len;
+}
+
+static bool
+decode_change (state_t *state,
+               int len,
+               uint64_t *object_id,
+               int *prop_id,
+               rut_boxed_t *value,
+               uint64_t *value_object_id)
+{
+  const uint8_t *data = state->buf->data;
+  bool ret;
+
+  rig_property_delta_begin_frame (state->decoder);
+  ret = rig_property_delta_decode (state->decoder,
+                                   &data, data + len,
+                                   state->stack,
+                                   object_id, prop_id,
+                                   value, value_object_id);
+  if (ret)
+    c_assert (data == state->buf->data + len);
+
+  return ret;
+}
+
+/* Round trips a change and checks the decoded value matches */
+static int
+round_trip (state_t *state,
+            uint64_t object_id,
+            int prop_id,
+            const rut_boxed_t *value,
+            rut_boxed_t *decoded)
+{
+  int len = encode_change (state, object_id, prop_id, value);
+  uint64_t decoded_object_id;
+  uint64_t value_object_id = 0;
+  int decoded_prop_id;
+
+  c_assert (decode_change (state, len,
+                           &decoded_object_id, &decoded_prop_id,
+                           decoded, &value_object_id));
+  c_assert_cmpint (decoded_object_id, ==, object_id);
+  c_assert_cmpint (decoded_prop_id, ==, prop_id);
+  c_assert_cmpint (decoded->type, ==, value->type);
+
+  if (value->type == RUT_PROPERTY_TYPE_OBJECT)
+    {
+      /* Object values are only decoded to ids */
+      c_assert (decoded->d.object_val == NULL);
+      c_assert_cmpint (value_object_id, ==,
+                       value->d.object_val ?
+                       object_to_id_cb (value->d.object_val, state) : 0);
+    }
+
+  return len;
+}
+
+static void
+test_numeric (state_t *state)
+{
+  rut_boxed_t value, decoded;
+  int unchanged_len, changed_len;
+
+  value.type = RUT_PROPERTY_TYPE_VEC3;
+  value.d.vec3_val[0] = 1.5f;
+  value.d.vec3_val[1] = -2;
+  value.d.vec3_val[2] = 1000;
+
+  round_trip (state, OBJECT_A, 3, &value, &decoded);
+  c_assert (memcmp (decoded.d.vec3_val, value.d.vec3_val,
+                    sizeof (float) * 3) == 0);
+
+  /* Resending the same value should XOR every word to zero, which
+   * only costs a byte per word */
+  unchanged_len = round_trip (state, OBJECT_A, 3, &value, &decoded);
+  c_assert_cmpint (unchanged_len, ==, 3 + 3);
+  c_assert (memcmp (decoded.d.vec3_val, value.d.vec3_val,
+                    sizeof (float) * 3) == 0);
+
+  value.d.vec3_val[1] = 7;
+  changed_len = round_trip (state, OBJECT_A, 3, &value, &decoded);
+  c_assert_cmpint (changed_len, >, unchanged_len);
+  c_assert (memcmp (decoded.d.vec3_val, value.d.vec3_val,
+                    sizeof (float) * 3) == 0);
+
+  /* The same property of another object must have its own previous
+   * value */
+  value.type = RUT_PROPERTY_TYPE_FLOAT;
+  value.d.float_val = 0.25f;
+  round_trip (state, OBJECT_B, 3, &value, &decoded);
+  c_assert_cmpfloat (decoded.d.float_val, ==, 0.25f);
+
+  value.type = RUT_PROPERTY_TYPE_DOUBLE;
+  value.d.double_val = 1e100;
+  round_trip (state, OBJECT_B, 4, &value, &decoded);
+  c_assert_cmpfloat (decoded.d.double_val, ==, 1e100);
+
+  value.type = RUT_PROPERTY_TYPE_BOOLEAN;
+  value.d.boolean_val = true;
+  round_trip (state, OBJECT_B, 5, &value, &decoded);
+  c_assert (decoded.d.boolean_val);
+
+  value.type = RUT_PROPERTY_TYPE_COLOR;
+  value.d.color_val.red = 1;
+  value.d.color_val.green = 0.5f;
+  value.d.color_val.blue = 0;
+  value.d.color_val.alpha = 0.75f;
+  round_trip (state, OBJECT_B, 6, &value, &decoded);
+  c_assert (memcmp (&decoded.d.color_val, &value.d.color_val,
+                    sizeof (value.d.color_val)) == 0);
+}
+
+static void
+test_text (state_t *state)
+{
+  rut_boxed_t value, decoded;
+
+  value.type = RUT_PROPERTY_TYPE_TEXT;
+
+  value.d.text_val = "hello";
+  round_trip (state, OBJECT_A, 1, &value, &decoded);
+  c_assert_cmpstr (decoded.d.text_val, ==, "hello");
+
+  value.d.text_val = "";
+  round_trip (state, OBJECT_A, 1, &value, &decoded);
+  c_assert_cmpstr (decoded.d.text_val, ==, "");
+
+  value.d.text_val = NULL;
+  round_trip (state, OBJECT_A, 1, &value, &decoded);
+  c_assert (decoded.d.text_val == NULL);
+}
+
+static void
+test_objects (state_t *state)
+{
+  rut_boxed_t value, decoded;
+
+  value.type = RUT_PROPERTY_TYPE_OBJECT;
+
+  value.d.object_val = &state->objects[1];
+  round_trip (state, OBJECT_A, 2, &value, &decoded);
+
+  value.d.object_val = &state->objects[0];
+  round_trip (state, OBJECT_B, 2, &value, &decoded);
+
+  value.d.object_val = NULL;
+  round_trip (state, OBJECT_A, 2, &value, &decoded);
+}
+
+/* Object ids are delta encoded within a frame */
+static void
+test_multiple_changes (state_t *state)
+{
+  uint64_t ids[] = { OBJECT_B, OBJECT_A, OBJECT_A, OBJECT_B };
+  const uint8_t *data;
+  const uint8_t *end;
+  int i;
+
+  c_byte_array_set_size (state->buf, 0);
+
+  rig_property_delta_begin_frame (state->encoder);
+  for (i = 0; i < C_N_ELEMENTS (ids); i++)
+    {
+      rut_boxed_t value;
+
+      value.type = RUT_PROPERTY_TYPE_INTEGER;
+      value.d.integer_val = i * 100;
+      rig_property_delta_encode (state->encoder, state->buf,
+                                 ids[i], 7, &value);
+    }
+
+  data = state->buf->data;
+  end = data + state->buf->len;
+
+  rig_property_delta_begin_frame (state->decoder);
+  for (i = 0; i < C_N_ELEMENTS (ids); i++)
+    {
+      rut_boxed_t value;
+      uint64_t object_id;
+      uint64_t value_object_id;
+      int prop_id;
+
+      c_assert (rig_property_delta_decode (state->decoder, &data, end,
+                                           state->stack,
+                                           &object_id, &prop_id,
+                                           &value, &value_object_id));
+      c_assert_cmpint (object_id, ==, ids[i]);
+      c_assert_cmpint (prop_id, ==, 7);
+      c_assert_cmpint (value.d.integer_val, ==, i * 100);
+    }
+
+  c_assert (data == end);
+}
+
+/* Every truncation of a change must be detected, after which both
+ * sides need to be reset to get back in sync */
+static void
+test_truncated_and_resync (state_t *state)
+{
+  rut_boxed_t value, decoded;
+  uint64_t object_id, value_object_id;
+  int prop_id;
+  int len;
+  int i;
+
+  value.type = RUT_PROPERTY_TYPE_TEXT;
+  value.d.text_val = "truncated";
+  len = encode_change (state, OBJECT_A, 1, &value);
+
+  for (i = 0; i < len; i++)
+    c_assert (!decode_change (state, i, &object_id, &prop_id,
+                              &decoded, &value_object_id));
+
+  value.type = RUT_PROPERTY_TYPE_VEC4;
+  value.d.vec4_val[0] = 1;
+  value.d.vec4_val[1] = 2;
+  value.d.vec4_val[2] = 3;
+  value.d.vec4_val[3] = 4;
+  len = encode_change (state, OBJECT_A, 8, &value);
+
+  for (i = 0; i < len; i++)
+    c_assert (!decode_change (state, i, &object_id, &prop_id,
+                              &decoded, &value_object_id));
+
+  /* The failed decodes may have corrupted the decoder's mirror of
+   * the previous values, so resync like the frontend does */
+  rig_property_delta_reset (state->encoder);
+  rig_property_delta_reset (state->decoder);
+
+  value.d.vec4_val[3] = 5;
+  round_trip (state, OBJECT_A, 8, &value, &decoded);
+  c_assert (memcmp (decoded.d.vec4_val, value.d.vec4_val,
+                    sizeof (float) * 4) == 0);
+
+  value.d.vec4_val[0] = 6;
+  round_trip (state, OBJECT_A, 8, &value, &decoded);
+  c_assert (memcmp (decoded.d.vec4_val, value.d.vec4_val,
+                    sizeof (float) * 4) == 0);
+}
+
+/* Forgetting an object must drop its previous values on both sides,
+ * without affecting other objects */
+static void
+test_forget (state_t *state)
+{
+  rut_boxed_t value, decoded;
+  int full_len, unchanged_len;
+
+  value.type = RUT_PROPERTY_TYPE_VEC3;
+  value.d.vec3_val[0] = 1.5f;
+  value.d.vec3_val[1] = -2;
+  value.d.vec3_val[2] = 1000;
+
+  full_len = round_trip (state, OBJECT_A, 9, &value, &decoded);
+  round_trip (state, OBJECT_B, 9, &value, &decoded);
+  unchanged_len = round_trip (state, OBJECT_A, 9, &value, &decoded);
+  c_assert_cmpint (unchanged_len, <, full_len);
+
+  rig_property_delta_forget_object (state->encoder, OBJECT_A);
+  rig_property_delta_forget_object (state->decoder, OBJECT_A);
+
+  c_assert_cmpint (round_trip (state, OBJECT_A, 9, &value, &decoded), ==,
+                   full_len);
+  c_assert (memcmp (decoded.d.vec3_val, value.d.vec3_val,
+                    sizeof (float) * 3) == 0);
+
+  c_assert_cmpint (round_trip (state, OBJECT_B, 9, &value, &decoded), ==,
+                   unchanged_len);
+  c_assert (memcmp (decoded.d.vec3_val, value.d.vec3_val,
+                    sizeof (float) * 3) == 0);
+}
+
+void
+test_rig_property_delta (void)
+{
+  state_t state;
+
+  init_state (&state);
+
+  test_numeric (&state);
+  test_text (&state);
+  test_objects (&state);
+  test_multiple_changes (&state);
+  test_truncated_and_resync (&state);
+  test_forget (&state);
+
+  fini_state (&state);
+
+  if (test_verbose ())
+    c_print ("OK\n");
+}
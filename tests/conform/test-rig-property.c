@@ -0,0 +1,240 @@
+#include <config.h>
+
+#include <string.h>
+
+#include <rut.h>
+
+#include "rig-property.h"
+
+#include "test-cg-fixtures.h"
+
+/* Checks the deferred binding updates of a rig_property_context_t:
+ * bindings are queued when a dependency changes and are only updated
+ * by rig_property_context_flush_bindings(). */
+
+typedef struct _values_t {
+  int padding; /* A data_offset of 0 isn't valid */
+
+  float a;
+  float b;
+  float c;
+  float x;
+} values_t;
+
+enum {
+  PROP_A,
+  PROP_B,
+  PROP_C,
+  PROP_X,
+  N_PROPS
+};
+
+static rig_property_spec_t specs[] = {
+  { .name = "a", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof (values_t, a) },
+  { .name = "b", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof (values_t, b) },
+  { .name = "c", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof (values_t, c) },
+  { .name = "x", .type = RUT_PROPERTY_TYPE_FLOAT,
+    .data_offset = offsetof (values_t, x) },
+};
+
+typedef struct _state_t {
+  rig_property_context_t ctx;
+  values_t values;
+  rig_property_t props[N_PROPS];
+  int n_updates;
+} state_t;
+
+static void
+copy_a_cb (rig_property_t *target, void *user_data)
+{
+  state_t *state = user_data;
+
+  state->n_updates++;
+  rig_property_set_float (&state->ctx, target, state->values.a);
+}
+
+static void
+copy_b_cb (rig_property_t *target, void *user_data)
+{
+  state_t *state = user_data;
+
+  state->n_updates++;
+  rig_property_set_float (&state->ctx, target, state->values.b);
+}
+
+static void
+increment_c_cb (rig_property_t *target, void *user_data)
+{
+  state_t *state = user_data;
+
+  state->n_updates++;
+  rig_property_set_float (&state->ctx, target, state->values.c + 1);
+}
+
+/* Updates c from x and also sets a as a side effect */
+static void
+set_a_from_x_cb (rig_property_t *target, void *user_data)
+{
+  state_t *state = user_data;
+
+  state->n_updates++;
+  rig_property_set_float (&state->ctx, target, state->values.x);
+  rig_property_set_float (&state->ctx, &state->props[PROP_A],
+                          state->values.x);
+}
+
+static void
+init_state (state_t *state)
+{
+  int i;
+
+  memset (state, 0, sizeof (*state));
+
+  rig_property_context_init (&state->ctx);
+  rig_property_context_set_deferred_bindings (&state->ctx, true);
+
+  for (i = 0; i < N_PROPS; i++)
+    rig_property_init (&state->props[i], &specs[i], &state->values, i);
+}
+
+static void
+fini_state (state_t *state)
+{
+  int i;
+
+  for (i = 0; i < N_PROPS; i++)
+    rig_property_destroy (&state->props[i]);
+
+  rig_property_context_destroy (&state->ctx);
+}
+
+/* A bound property destroyed while it is queued for an update must
+ * not be touched when the queue is flushed */
+static void
+test_destroy_queued (void)
+{
+  state_t state;
+
+  init_state (&state);
+
+  rig_property_set_binding (&state.props[PROP_B], copy_a_cb, &state,
+                            &state.props[PROP_A], NULL);
+  rig_property_set_binding (&state.props[PROP_C], copy_a_cb, &state,
+                            &state.props[PROP_A], NULL);
+
+  rig_property_set_float (&state.ctx, &state.props[PROP_A], 1);
+  c_assert_cmpint (state.n_updates, ==, 0);
+  c_assert (state.props[PROP_B].queued_count);
+
+  /* Poison the property so any use after being destroyed is likely
+   * to crash */
+  rig_property_destroy (&state.props[PROP_B]);
+  c_assert (!state.props[PROP_B].queued_count);
+  memset (&state.props[PROP_B], 0xaa, sizeof (rig_property_t));
+
+  rig_property_context_flush_bindings (&state.ctx);
+
+  /* Only the binding of c should have been updated */
+  c_assert_cmpint (state.n_updates, ==, 1);
+  c_assert_cmpfloat (state.values.c, ==, 1);
+  c_assert_cmpfloat (state.values.b, ==, 0);
+
+  rig_property_init (&state.props[PROP_B], &specs[PROP_B], &state.values,
+                     PROP_B);
+  fini_state (&state);
+}
+
+/* Removing a binding while it is queued should also drop the update */
+static void
+test_remove_queued_binding (void)
+{
+  state_t state;
+
+  init_state (&state);
+
+  rig_property_set_binding (&state.props[PROP_B], copy_a_cb, &state,
+                            &state.props[PROP_A], NULL);
+
+  rig_property_set_float (&state.ctx, &state.props[PROP_A], 2);
+  rig_property_remove_binding (&state.props[PROP_B]);
+  c_assert (!state.props[PROP_B].queued_count);
+
+  rig_property_context_flush_bindings (&state.ctx);
+
+  c_assert_cmpint (state.n_updates, ==, 0);
+  c_assert_cmpfloat (state.values.b, ==, 0);
+
+  fini_state (&state);
+}
+
+/* A binding that gets dirtied again after it has been updated must
+ * be updated again within the same flush */
+static void
+test_redirty_updated (void)
+{
+  state_t state;
+
+  init_state (&state);
+
+  rig_property_set_binding (&state.props[PROP_B], copy_a_cb, &state,
+                            &state.props[PROP_A], NULL);
+  rig_property_set_binding (&state.props[PROP_C], set_a_from_x_cb, &state,
+                            &state.props[PROP_X], NULL);
+
+  /* c is queued before b so b is updated first and is then dirtied
+   * again when c's binding changes a */
+  rig_property_set_float (&state.ctx, &state.props[PROP_X], 3);
+  rig_property_set_float (&state.ctx, &state.props[PROP_A], 1);
+
+  rig_property_context_flush_bindings (&state.ctx);
+
+  c_assert_cmpfloat (state.values.c, ==, 3);
+  c_assert_cmpfloat (state.values.a, ==, 3);
+  c_assert_cmpfloat (state.values.b, ==, 3);
+  c_assert_cmpint (state.n_updates, ==, 3);
+  c_assert (!state.props[PROP_B].queued_count);
+
+  fini_state (&state);
+}
+
+/* A real cycle must be broken instead of flushing forever */
+static void
+test_cycle (void)
+{
+  state_t state;
+
+  init_state (&state);
+
+  rig_property_set_binding (&state.props[PROP_B], copy_a_cb, &state,
+                            &state.props[PROP_A], NULL);
+  rig_property_set_binding (&state.props[PROP_C], copy_b_cb, &state,
+                            &state.props[PROP_B], NULL);
+  /* a never settles since it's always set to one more than itself */
+  rig_property_set_binding (&state.props[PROP_A], increment_c_cb, &state,
+                            &state.props[PROP_C], NULL);
+
+  rig_property_set_float (&state.ctx, &state.props[PROP_A], 1);
+
+  rig_property_context_flush_bindings (&state.ctx);
+
+  c_assert (!state.props[PROP_A].queued_count);
+  c_assert (!state.props[PROP_B].queued_count);
+  c_assert (!state.props[PROP_C].queued_count);
+
+  fini_state (&state);
+}
+
+void
+test_rig_property (void)
+{
+  test_destroy_queued ();
+  test_remove_queued_binding ();
+  test_redirty_updated ();
+  test_cycle ();
+
+  if (test_verbose ())
+    c_print ("OK\n");
+}
@@ -0,0 +1,117 @@
+#include <config.h>
+
+#include <rut.h>
+
+#include "rut-transform.h"
+
+#include "test-cg-fixtures.h"
+
+/* Checks that the cached world matrices of transformables are
+ * invalidated when an ancestor moves or a sub-graph is reparented */
+
+typedef struct _state_t {
+  rut_transform_t *parent;
+  rut_transform_t *child;
+  rut_transform_t *sibling;
+  rut_transform_t *grandchild;
+} state_t;
+
+static rut_transform_t *
+add_transform (rut_transform_t *parent, float x, float y, float z)
+{
+  rut_transform_t *transform = rut_transform_new (NULL);
+
+  rut_transform_translate (transform, x, y, z);
+
+  if (parent)
+    {
+      rut_graphable_add_child (parent, transform);
+      rut_object_unref (transform);
+    }
+
+  return transform;
+}
+
+static void
+check_world_position (rut_transform_t *transform, float x, float y, float z)
+{
+  const c_matrix_t *world = rut_transformable_get_world_matrix (transform);
+
+  c_assert_cmpfloat (world->xw, ==, x);
+  c_assert_cmpfloat (world->yw, ==, y);
+  c_assert_cmpfloat (world->zw, ==, z);
+}
+
+#ifdef RIG_ENABLE_DEBUG
+static void
+check_stats (int n_hits, int n_recomputes)
+{
+  rut_transformable_stats_t stats;
+
+  rut_transformable_get_stats (&stats);
+  c_assert_cmpint (stats.n_world_matrix_hits, ==, n_hits);
+  c_assert_cmpint (stats.n_world_matrix_recomputes, ==, n_recomputes);
+
+  rut_transformable_reset_stats ();
+}
+#endif
+
+void
+test_rig_transformable (void)
+{
+  state_t state;
+
+  state.parent = add_transform (NULL, 1, 0, 0);
+  state.child = add_transform (state.parent, 0, 2, 0);
+  state.sibling = add_transform (state.parent, 0, 0, 4);
+  state.grandchild = add_transform (state.child, 0, 0, 3);
+
+  check_world_position (state.grandchild, 1, 2, 3);
+  check_world_position (state.sibling, 1, 0, 4);
+
+#ifdef RIG_ENABLE_DEBUG
+  rut_transformable_reset_stats ();
+
+  /* Nothing has moved so everything should come from the cache */
+  check_world_position (state.grandchild, 1, 2, 3);
+  check_stats (1, 0);
+#endif
+
+  /* Moving the parent must update all of its descendants */
+  rut_transform_translate (state.parent, 10, 0, 0);
+
+  check_world_position (state.grandchild, 11, 2, 3);
+  check_world_position (state.child, 11, 2, 0);
+  check_world_position (state.sibling, 11, 0, 4);
+  check_world_position (state.parent, 11, 0, 0);
+
+#ifdef RIG_ENABLE_DEBUG
+  /* Each node should only have been recomputed once */
+  check_stats (3, 4);
+#endif
+
+  /* Moving the child must not affect its sibling */
+  rut_transform_translate (state.child, 0, 5, 0);
+
+  check_world_position (state.grandchild, 11, 7, 3);
+  check_world_position (state.sibling, 11, 0, 4);
+
+#ifdef RIG_ENABLE_DEBUG
+  check_stats (2, 2);
+#endif
+
+  /* Reparenting must pick up the transform of the new parent */
+  rut_graphable_add_child (state.sibling, state.grandchild);
+  check_world_position (state.grandchild, 11, 0, 7);
+
+  /* Keep the grandchild alive once it's removed from the graph */
+  rut_object_ref (state.grandchild);
+  rut_graphable_remove_child (state.grandchild);
+  check_world_position (state.grandchild, 0, 0, 3);
+
+  rut_object_unref (state.grandchild);
+  rut_object_unref (state.parent);
+
+  if (test_verbose ())
+    c_print ("OK\n");
+}
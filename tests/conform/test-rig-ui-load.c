@@ -0,0 +1,392 @@
+#include <config.h>
+
+#include <string.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-engine.h"
+#include "rig-entity.h"
+#include "rig-controller.h"
+#include "rig-ui.h"
+#include "rig-pb.h"
+
+#include "rig.pb-c.h"
+
+#include "test-cg-fixtures.h"
+
+/* Round trips a UI with some nested entities, buffers (pairs of them
+ * sharing their contents so they are saved as shared blobs) and
+ * animated controllers through the serializer. The packed data is
+ * loaded both by unpacking it with rig__ui__unpack() for
+ * rig_pb_unserialize_ui() and by streaming it through
+ * rig_pb_unserialize_ui_data() and both loaded UIs must match the
+ * original. Data with an invalid blob must fail to load. */
+
+#define N_ENTITIES 50
+#define N_BUFFERS 5
+#define BUFFER_SIZE 1024
+#define N_CONTROLLERS 3
+
+static rig_engine_t *
+create_engine (void)
+{
+  rut_shell_t *shell;
+
+  rut_init ();
+
+  shell = rut_shell_new (NULL, /* main shell */
+                         NULL, /* paint */
+                         NULL); /* user data */
+  rut_shell_set_is_headless (shell, true);
+
+  return rig_engine_new_for_frontend (shell, NULL);
+}
+
+static void
+destroy_engine (rig_engine_t *engine)
+{
+  rut_shell_t *shell = engine->shell;
+
+  rut_object_unref (engine);
+  rut_object_unref (shell);
+}
+
+static rig_ui_t *
+create_ui (rig_engine_t *engine)
+{
+  rig_ui_t *ui = rig_ui_new (engine);
+  rig_entity_t *parent = NULL;
+  int i;
+
+  ui->scene = rig_entity_new (engine);
+
+  for (i = 0; i < N_ENTITIES; i++)
+    {
+      rig_entity_t *entity = rig_entity_new (engine);
+      float position[3] = { i, i * 2, i * 3 };
+      char *label = c_strdup_printf ("entity-%d", i);
+
+      rig_entity_set_label (entity, label);
+      rig_entity_set_position (entity, position);
+      c_free (label);
+
+      /* Nest some entities so the scene isn't flat */
+      if (parent && i % 10)
+        rut_graphable_add_child (parent, entity);
+      else
+        {
+          rut_graphable_add_child (ui->scene, entity);
+          parent = entity;
+        }
+      rut_object_unref (entity);
+    }
+
+  for (i = 0; i < N_BUFFERS; i++)
+    {
+      rut_buffer_t *buffer = rut_buffer_new (BUFFER_SIZE);
+
+      /* Pairs of buffers share the same contents */
+      memset (buffer->data, i / 2, buffer->size);
+
+      rig_ui_add_buffer (ui, buffer);
+      rut_object_unref (buffer);
+    }
+
+  for (i = 0; i < N_CONTROLLERS; i++)
+    {
+      char *label = c_strdup_printf ("controller-%d", i);
+      rig_controller_t *controller = rig_controller_new (engine, label);
+      rut_object_t *entity = rut_graphable_first (ui->scene);
+      int j;
+
+      c_free (label);
+
+      /* Each controller animates one more entity than the last */
+      for (j = 0; j <= i && entity; j++)
+        {
+          rig_property_t *property =
+            rig_introspectable_get_property (entity, RUT_ENTITY_PROP_SCALE);
+          rut_boxed_t start, end;
+
+          start.type = end.type = property->spec->type;
+          start.d.float_val = 1;
+          end.d.float_val = j + 2;
+
+          rig_controller_add_property (controller, property);
+          rig_controller_set_property_method (controller, property,
+                                              RIG_CONTROLLER_METHOD_PATH);
+          rig_controller_insert_path_value (controller, property,
+                                            0, &start);
+          rig_controller_insert_path_value (controller, property,
+                                            1, &end);
+
+          entity = rut_graphable_nth (ui->scene, j + 1);
+        }
+
+      rig_ui_add_controller (ui, controller);
+      rut_object_unref (controller);
+    }
+
+  return ui;
+}
+
+static uint8_t *
+save_ui (rig_engine_t *engine, rig_ui_t *ui, size_t *len)
+{
+  rig_pb_serializer_t *serializer = rig_pb_serializer_new (engine);
+  Rig__UI *pb_ui;
+  uint8_t *data;
+
+  rig_pb_serializer_set_blobs_enabled (serializer, true);
+
+  pb_ui = rig_pb_serialize_ui (serializer, ui);
+
+  c_assert_cmpint (pb_ui->n_blobs, ==, (N_BUFFERS + 1) / 2);
+
+  *len = rig__ui__get_packed_size (pb_ui);
+  data = c_malloc (*len);
+  rig__ui__pack (pb_ui, data);
+
+  rig_pb_serialized_ui_destroy (pb_ui);
+  rig_pb_serializer_destroy (serializer);
+
+  return data;
+}
+
+static void
+register_object_cb (rig_ui_t *ui, void *object, uint64_t id, void *user_data)
+{
+  c_hash_table_t *id_map = user_data;
+  uint64_t *key = c_new (uint64_t, 1);
+
+  *key = id;
+  c_hash_table_insert (id_map, key, object);
+}
+
+static void
+unregister_object_cb (rig_ui_t *ui, uint64_t id, void *user_data)
+{
+  c_hash_table_remove (user_data, &id);
+}
+
+static void *
+lookup_object_cb (rig_ui_t *ui, uint64_t id, void *user_data)
+{
+  return c_hash_table_lookup (user_data, &id);
+}
+
+/* Loads the UI with rig_pb_unserialize_ui() if @unpack is set or with
+ * rig_pb_unserialize_ui_data() otherwise */
+static rig_ui_t *
+load_ui (rig_engine_t *engine, const uint8_t *data, size_t len, bool unpack)
+{
+  c_hash_table_t *id_map =
+    c_hash_table_new_full (c_int64_hash, c_int64_equal, c_free, NULL);
+  rig_pb_unserializer_t *unserializer =
+    rig_pb_unserializer_new (engine,
+                             register_object_cb,
+                             unregister_object_cb,
+                             lookup_object_cb,
+                             id_map);
+  rig_ui_t *ui;
+
+  if (unpack)
+    {
+      Rig__UI *pb_ui = rig__ui__unpack (NULL, len, data);
+
+      c_assert (pb_ui);
+      ui = rig_pb_unserialize_ui (unserializer, pb_ui);
+      rig__ui__free_unpacked (pb_ui, NULL);
+    }
+  else
+    ui = rig_pb_unserialize_ui_data (unserializer, data, len);
+
+  rig_pb_unserializer_destroy (unserializer);
+  c_hash_table_destroy (id_map);
+
+  return ui;
+}
+
+static rut_traverse_visit_flags_t
+collect_entities_cb (rut_object_t *object, int depth, void *user_data)
+{
+  c_ptr_array_t *entities = user_data;
+
+  if (rut_object_get_type (object) == &rig_entity_type)
+    c_ptr_array_add (entities, object);
+
+  return RUT_TRAVERSE_VISIT_CONTINUE;
+}
+
+static c_ptr_array_t *
+get_entities (rig_ui_t *ui)
+{
+  c_ptr_array_t *entities = c_ptr_array_new ();
+
+  rut_graphable_traverse (ui->scene,
+                          RUT_TRAVERSE_DEPTH_FIRST,
+                          collect_entities_cb,
+                          NULL, /* after_children_cb */
+                          entities);
+
+  return entities;
+}
+
+static void
+compare_entities (rig_ui_t *a, rig_ui_t *b)
+{
+  c_ptr_array_t *entities_a = get_entities (a);
+  c_ptr_array_t *entities_b = get_entities (b);
+  int i;
+
+  c_assert_cmpint (entities_a->len, ==, entities_b->len);
+
+  for (i = 0; i < entities_a->len; i++)
+    {
+      rig_entity_t *entity_a = c_ptr_array_index (entities_a, i);
+      rig_entity_t *entity_b = c_ptr_array_index (entities_b, i);
+
+      c_assert_cmpstr (rig_entity_get_label (entity_a), ==,
+                       rig_entity_get_label (entity_b));
+      c_assert (memcmp (rig_entity_get_position (entity_a),
+                        rig_entity_get_position (entity_b),
+                        sizeof (float) * 3) == 0);
+      c_assert (!rut_graphable_get_parent (entity_a) ==
+                !rut_graphable_get_parent (entity_b));
+    }
+
+  c_ptr_array_free (entities_a, true);
+  c_ptr_array_free (entities_b, true);
+}
+
+static bool
+has_buffer (rig_ui_t *ui, rut_buffer_t *buffer)
+{
+  c_llist_t *l;
+
+  for (l = ui->buffers; l; l = l->next)
+    {
+      rut_buffer_t *other = l->data;
+
+      if (other->size == buffer->size &&
+          memcmp (other->data, buffer->data, buffer->size) == 0)
+        return true;
+    }
+
+  return false;
+}
+
+static void
+compare_buffers (rig_ui_t *a, rig_ui_t *b)
+{
+  c_llist_t *l;
+
+  c_assert_cmpint (c_llist_length (a->buffers), ==,
+                   c_llist_length (b->buffers));
+
+  for (l = a->buffers; l; l = l->next)
+    c_assert (has_buffer (b, l->data));
+}
+
+static rig_controller_t *
+find_controller (rig_ui_t *ui, const char *label)
+{
+  c_llist_t *l;
+
+  for (l = ui->controllers; l; l = l->next)
+    {
+      rig_controller_t *controller = l->data;
+
+      if (strcmp (controller->label, label) == 0)
+        return controller;
+    }
+
+  return NULL;
+}
+
+static void
+compare_controllers (rig_ui_t *a, rig_ui_t *b)
+{
+  c_llist_t *l;
+
+  c_assert_cmpint (c_llist_length (a->controllers), ==,
+                   c_llist_length (b->controllers));
+
+  for (l = a->controllers; l; l = l->next)
+    {
+      rig_controller_t *controller_a = l->data;
+      rig_controller_t *controller_b =
+        find_controller (b, controller_a->label);
+
+      c_assert (controller_b);
+      c_assert_cmpint (c_hash_table_size (controller_a->properties), ==,
+                       c_hash_table_size (controller_b->properties));
+    }
+}
+
+static void
+compare_ui (rig_ui_t *a, rig_ui_t *b)
+{
+  c_assert (b);
+
+  compare_entities (a, b);
+  compare_buffers (a, b);
+  compare_controllers (a, b);
+}
+
+/* Appends a blobs field whose contents don't have a hash */
+static uint8_t *
+append_invalid_blob (const uint8_t *data, size_t len, size_t *new_len)
+{
+  const ProtobufCFieldDescriptor *field =
+    protobuf_c_message_descriptor_get_field_by_name (&rig__ui__descriptor,
+                                                     "blobs");
+  uint8_t *invalid = c_malloc (len + 8);
+  uint32_t tag = (field->id << 3) | PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED;
+  size_t i = len;
+
+  memcpy (invalid, data, len);
+
+  /* Field ids in rig.proto are small so the tag fits in a byte */
+  c_assert (tag < 0x80);
+  invalid[i++] = tag;
+  invalid[i++] = 1; /* length */
+  invalid[i++] = 0; /* an invalid tag */
+
+  *new_len = i;
+
+  return invalid;
+}
+
+void
+test_rig_ui_load (void)
+{
+  rig_engine_t *engine = create_engine ();
+  rig_ui_t *ui, *loaded_ui;
+  uint8_t *data, *invalid;
+  size_t len, invalid_len;
+
+  ui = create_ui (engine);
+  data = save_ui (engine, ui, &len);
+
+  loaded_ui = load_ui (engine, data, len, true);
+  compare_ui (ui, loaded_ui);
+  rut_object_unref (loaded_ui);
+
+  loaded_ui = load_ui (engine, data, len, false);
+  compare_ui (ui, loaded_ui);
+  rut_object_unref (loaded_ui);
+
+  invalid = append_invalid_blob (data, len, &invalid_len);
+  c_assert (load_ui (engine, invalid, invalid_len, false) == NULL);
+
+  c_free (invalid);
+  c_free (data);
+  rut_object_unref (ui);
+
+  destroy_engine (engine);
+
+  if (test_verbose ())
+    c_print ("OK\n");
+}
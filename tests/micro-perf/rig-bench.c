@@ -0,0 +1,59 @@
+#include <rig-config.h>
+
+#include <stdlib.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-bench.h"
+
+typedef struct _bench_shell_t {
+    rut_shell_init_callback_t init;
+    void *user_data;
+} bench_shell_t;
+
+static void
+idle_paint_cb(rut_shell_t *shell, void *user_data)
+{
+    rut_shell_remove_paint_idle(shell);
+}
+
+static void
+bench_run_cb(rut_shell_t *shell, void *user_data)
+{
+    bench_shell_t *bench_shell = user_data;
+    cg_error_t *error = NULL;
+
+    /* Headless shells don't create a cglib device themselves */
+    shell->cg_device = cg_device_new();
+    if (!cg_device_connect(shell->cg_device, &error))
+        c_error("Failed to create cglib device: %s", error->message);
+
+    bench_shell->init(shell, bench_shell->user_data);
+
+    c_free(bench_shell);
+}
+
+rut_shell_t *
+rig_bench_shell_new(rut_shell_init_callback_t init,
+                    rut_shell_paint_callback_t paint,
+                    void *user_data)
+{
+    bench_shell_t *bench_shell = c_new(bench_shell_t, 1);
+    rut_shell_t *shell;
+
+    /* Don't override an explicit choice of driver... */
+    setenv("CG_DRIVER", "nop", 0);
+    setenv("CG_RENDERER", "stub", 0);
+
+    rut_init();
+
+    shell = rut_shell_new(NULL, paint ? paint : idle_paint_cb, user_data);
+    rut_shell_set_is_headless(shell, true);
+
+    bench_shell->init = init;
+    bench_shell->user_data = user_data;
+    rut_shell_set_on_run_callback(shell, bench_run_cb, bench_shell);
+
+    return shell;
+}
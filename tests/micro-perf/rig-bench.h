@@ -0,0 +1,17 @@
+#ifndef _RIG_BENCH_H_
+#define _RIG_BENCH_H_
+
+#include <rut.h>
+
+/* Shared setup for the micro benchmarks that run a rut shell. They
+ * all run headless and use the nop cglib driver, unless another one
+ * is chosen with CG_DRIVER, so they can run without a GPU. */
+
+/* Initializes rut and creates a headless shell. @init is called once
+ * the mainloop is running, after a cglib device has been connected.
+ * @paint may be NULL for benchmarks that don't paint anything. */
+rut_shell_t *rig_bench_shell_new(rut_shell_init_callback_t init,
+                                 rut_shell_paint_callback_t paint,
+                                 void *user_data);
+
+#endif /* _RIG_BENCH_H_ */
@@ -0,0 +1,161 @@
+#include <rig-config.h>
+
+#include <stdlib.h>
+#include <math.h>
+#include <getopt.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-engine.h"
+#include "rig-path.h"
+
+/* Measures keyframe lookups in long, motion-capture style paths (one
+ * key per sample at a fixed rate) for forward playback, reverse
+ * playback and random seeks/scrubbing. Each is compared against the
+ * linear scan from a cursor that paths used to be limited to. */
+
+#define DEFAULT_N_KEYS 100000
+#define DEFAULT_N_LOOKUPS 1000000
+#define SAMPLE_RATE 120.0
+
+typedef struct _linear_cursor_t {
+    int pos;
+} linear_cursor_t;
+
+/* The previous list based search: walk from the cursor towards t */
+static rig_node_t *
+linear_find(rig_path_t *path, linear_cursor_t *cursor, float t)
+{
+    int pos = cursor->pos;
+
+    while (pos > 0 && rig_path_get_node(path, pos)->t > t)
+        pos--;
+    while (pos + 1 < path->length && rig_path_get_node(path, pos + 1)->t <= t)
+        pos++;
+
+    cursor->pos = pos;
+
+    return rig_path_get_node(path, pos);
+}
+
+static float *
+create_times(int n_lookups, float length, const char *pattern)
+{
+    float *times = c_new(float, n_lookups);
+    int i;
+
+    for (i = 0; i < n_lookups; i++) {
+        if (strcmp(pattern, "forwards") == 0)
+            times[i] = length * i / n_lookups;
+        else if (strcmp(pattern, "backwards") == 0)
+            times[i] = length * (n_lookups - i) / n_lookups;
+        else
+            times[i] = length * (rand() / (float)RAND_MAX);
+    }
+
+    return times;
+}
+
+static void
+run_pattern(rig_path_t *path, int n_lookups, const char *pattern)
+{
+    float length = path->length / SAMPLE_RATE;
+    float *times = create_times(n_lookups, length, pattern);
+    rig_path_direction_t direction =
+        strcmp(pattern, "backwards") == 0 ? RIG_PATH_DIRECTION_BACKWARDS :
+        RIG_PATH_DIRECTION_FORWARDS;
+    linear_cursor_t cursor = { 0 };
+    int64_t start, search_ns, linear_ns;
+    rig_node_t *n0, *n1;
+    float check = 0;
+    int i;
+
+    path->pos = -1;
+
+    start = c_get_monotonic_time();
+    for (i = 0; i < n_lookups; i++) {
+        rig_path_find_control_points2(path, times[i], direction, &n0, &n1);
+        check += n0->t;
+    }
+    search_ns = c_get_monotonic_time() - start;
+
+    start = c_get_monotonic_time();
+    for (i = 0; i < n_lookups; i++)
+        check += linear_find(path, &cursor, times[i])->t;
+    linear_ns = c_get_monotonic_time() - start;
+
+    c_print("%-10s: search = %8.1fns/lookup, linear scan = %10.1fns/lookup "
+            "(%.0f)\n",
+            pattern,
+            search_ns / (double)n_lookups,
+            linear_ns / (double)n_lookups,
+            check);
+
+    c_free(times);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: test-path-search [OPTION]...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -k,--keys=N          Number of keys (default %d)\n",
+            DEFAULT_N_KEYS);
+    fprintf(stderr, "  -l,--lookups=N       Number of lookups (default %d)\n",
+            DEFAULT_N_LOOKUPS);
+    fprintf(stderr, "  -h,--help            Display this help message\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        { "keys",    required_argument, NULL, 'k' },
+        { "lookups", required_argument, NULL, 'l' },
+        { "help",    no_argument,       NULL, 'h' },
+        { 0,         0,                 NULL,  0  }
+    };
+    int n_keys = DEFAULT_N_KEYS;
+    int n_lookups = DEFAULT_N_LOOKUPS;
+    rig_path_t *path;
+    int64_t start;
+    int c, i;
+
+    while ((c = getopt_long(argc, argv, "k:l:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'k':
+            n_keys = atoi(optarg);
+            break;
+        case 'l':
+            n_lookups = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (n_keys < 1 || n_lookups < 1)
+        usage();
+
+    rut_init();
+
+    /* The engine is only needed for rig_path_lerp_property() */
+    path = rig_path_new(NULL, RUT_PROPERTY_TYPE_FLOAT);
+
+    start = c_get_monotonic_time();
+    for (i = 0; i < n_keys; i++)
+        rig_path_insert_float(path, i / SAMPLE_RATE, sinf(i / SAMPLE_RATE));
+    c_print("keys = %d, lookups = %d\n", n_keys, n_lookups);
+    c_print("insert: %.1fns/key\n",
+            (c_get_monotonic_time() - start) / (double)n_keys);
+
+    run_pattern(path, n_lookups, "forwards");
+    run_pattern(path, n_lookups, "backwards");
+    run_pattern(path, n_lookups, "random");
+
+    rut_object_unref(path);
+
+    return 0;
+}
@@ -0,0 +1,308 @@
+#include <rig-config.h>
+
+#include <stdlib.h>
+#include <math.h>
+#include <getopt.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-frontend.h"
+#include "rig-engine.h"
+#include "rig-entity.h"
+#include "rig-renderer.h"
+#include "rig-ui.h"
+#include "components/rig-camera.h"
+#include "components/rig-light.h"
+#include "components/rig-material.h"
+#include "components/rig-nine-slice.h"
+
+#include "rig-bench.h"
+
+/* Checks that the renderer shares pipelines between entities with the
+ * same material state: N entities whose materials all have the same
+ * settings are painted for K frames. The number of pipelines created
+ * must stay far below N and no more may be created after the first
+ * frame, otherwise we exit with a non-zero status.
+ *
+ * Also reports the per-pass draw, pipeline switch and uniform upload
+ * counts of the last frame. */
+
+#define DEFAULT_N_ENTITIES 1000
+#define DEFAULT_N_FRAMES 10
+
+#define FB_SIZE 512
+
+/* One pipeline per pass that the entities are drawn in, with some
+ * slack, which is still far below any useful number of entities */
+#define MAX_SHARED_PIPELINES 8
+
+static const char *pass_names[RIG_N_PASSES] = {
+    "color unblended",
+    "color blended",
+    "shadow",
+    "dof depth"
+};
+
+typedef struct _bench_t {
+    rut_shell_t *shell;
+    rig_frontend_t *frontend;
+
+    rig_entity_t *camera;
+    cg_framebuffer_t *fb;
+
+    int n_entities;
+    int n_frames;
+
+    int frame;
+    int first_frame_pipelines;
+    int later_pipelines;
+    int64_t total_start;
+
+    rig_renderer_pass_stats_t last_stats[RIG_N_PASSES];
+} bench_t;
+
+static rig_entity_t *
+add_entity(rig_ui_t *ui, const float position[3])
+{
+    rig_entity_t *entity = rig_entity_new(ui->engine);
+
+    rig_entity_set_position(entity, position);
+    rut_graphable_add_child(ui->scene, entity);
+    rut_object_unref(entity);
+
+    return entity;
+}
+
+static void
+add_component(rig_entity_t *entity, rut_object_t *component)
+{
+    rig_entity_add_component(entity, component);
+    rut_object_unref(component);
+}
+
+static void
+create_scene(bench_t *bench)
+{
+    rig_engine_t *engine = bench->frontend->engine;
+    rig_ui_t *ui = engine->ui;
+    int n_columns = ceilf(sqrtf(bench->n_entities));
+    float cell_size = FB_SIZE / (float)n_columns;
+    cg_texture_t *texture;
+    rig_entity_t *light;
+    int i;
+
+    texture = cg_texture_2d_new_with_size(bench->shell->cg_device,
+                                          FB_SIZE, FB_SIZE);
+    bench->fb = cg_offscreen_new_with_texture(texture);
+    cg_object_unref(texture);
+
+    bench->camera = add_entity(ui, (float[3]){ 0, 0, 0 });
+    add_component(bench->camera,
+                  rig_camera_new(engine, FB_SIZE, FB_SIZE, bench->fb));
+    rig_ui_register_all_entity_components(ui, bench->camera);
+
+    /* The renderer ignores lights without a camera since that defines
+     * the light's shadow map */
+    light = add_entity(ui, (float[3]){ 0, 0, 50 });
+    add_component(light, rig_light_new(engine));
+    add_component(light, rig_camera_new(engine, FB_SIZE, FB_SIZE, NULL));
+    rig_ui_register_all_entity_components(ui, light);
+
+    for (i = 0; i < bench->n_entities; i++) {
+        float position[3] = {
+            (i % n_columns + 0.5f) * cell_size,
+            (i / n_columns + 0.5f) * cell_size,
+            0
+        };
+        rig_entity_t *entity = add_entity(ui, position);
+
+        /* A component can only belong to one entity so each entity
+         * gets its own material, but they all have the same state */
+        add_component(entity, rig_material_new(engine));
+        add_component(entity,
+                      rig_nine_slice_new(engine,
+                                         0, 0, 0, 0, /* borders */
+                                         cell_size / 2,
+                                         cell_size / 2));
+        rig_ui_register_all_entity_components(ui, entity);
+    }
+}
+
+static int
+count_pipelines_created(rig_renderer_t *renderer)
+{
+    int n_created = 0;
+    int i;
+
+    for (i = 0; i < RIG_N_PASSES; i++) {
+        rig_renderer_pass_stats_t stats;
+
+        rig_renderer_get_pass_stats(renderer, i, &stats);
+        n_created += stats.n_pipelines_created;
+    }
+
+    return n_created;
+}
+
+static bool
+print_stats(bench_t *bench)
+{
+    int64_t elapsed = c_get_monotonic_time() - bench->total_start;
+    bool ok = true;
+    int i;
+
+    c_print("entities = %d, frames = %d\n", bench->n_entities, bench->frame);
+    c_print("mean frame = %.3fms\n", elapsed / 1e6 / bench->frame);
+
+    for (i = 0; i < RIG_N_PASSES; i++) {
+        rig_renderer_pass_stats_t *stats = &bench->last_stats[i];
+
+        c_print("%s: draws = %d, pipeline switches = %d, "
+                "uniform uploads = %d\n",
+                pass_names[i],
+                stats->n_draws,
+                stats->n_pipeline_switches,
+                stats->n_uniform_uploads);
+    }
+
+    c_print("pipelines created: first frame = %d, later frames = %d\n",
+            bench->first_frame_pipelines,
+            bench->later_pipelines);
+
+    if (bench->first_frame_pipelines > MAX_SHARED_PIPELINES) {
+        c_print("FAIL: expected at most %d pipelines for %d entities "
+                "sharing the same material state\n",
+                MAX_SHARED_PIPELINES, bench->n_entities);
+        ok = false;
+    }
+
+    if (bench->later_pipelines) {
+        c_print("FAIL: pipelines were created after the first frame\n");
+        ok = false;
+    }
+
+    return ok;
+}
+
+static void
+bench_paint(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+    rig_frontend_t *frontend = bench->frontend;
+    rig_engine_t *engine = frontend->engine;
+    rig_renderer_t *renderer = frontend->renderer;
+    rig_paint_context_t paint_ctx;
+    int n_created;
+    int i;
+
+    rut_shell_remove_paint_idle(shell);
+
+    if (!bench->total_start)
+        bench->total_start = c_get_monotonic_time();
+
+    memset(&paint_ctx, 0, sizeof(paint_ctx));
+    paint_ctx.camera =
+        rig_entity_get_component(bench->camera, RIG_COMPONENT_TYPE_CAMERA);
+    paint_ctx.engine = engine;
+    paint_ctx.renderer = renderer;
+    paint_ctx.pass = RIG_PASS_COLOR_BLENDED;
+
+    rig_renderer_reset_stats(renderer);
+
+    rig_entity_set_camera_view_from_transform(bench->camera);
+    cg_framebuffer_clear4f(bench->fb,
+                           CG_BUFFER_BIT_COLOR | CG_BUFFER_BIT_DEPTH,
+                           0, 0, 0, 1);
+    rig_renderer_paint_camera(&paint_ctx, bench->camera);
+
+    n_created = count_pipelines_created(renderer);
+    if (bench->frame == 0)
+        bench->first_frame_pipelines = n_created;
+    else
+        bench->later_pipelines += n_created;
+
+    for (i = 0; i < RIG_N_PASSES; i++)
+        rig_renderer_get_pass_stats(renderer, i, &bench->last_stats[i]);
+
+    rig_engine_garbage_collect(engine);
+    rut_memory_stack_rewind(engine->frame_stack);
+
+    bench->frame++;
+
+    if (bench->frame < bench->n_frames)
+        rut_shell_queue_redraw(shell);
+    else
+        rut_shell_quit(shell);
+}
+
+static void
+bench_init(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+
+    bench->frontend = rig_frontend_new(shell);
+
+    create_scene(bench);
+
+    rut_shell_queue_redraw(shell);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: test-renderer-state [OPTION]...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -e,--entities=N      Number of entities (default %d)\n",
+            DEFAULT_N_ENTITIES);
+    fprintf(stderr, "  -f,--frames=K        Number of frames (default %d)\n",
+            DEFAULT_N_FRAMES);
+    fprintf(stderr, "  -h,--help            Display this help message\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_t bench;
+    struct option long_opts[] = {
+        { "entities", required_argument, NULL, 'e' },
+        { "frames",   required_argument, NULL, 'f' },
+        { "help",     no_argument,       NULL, 'h' },
+        { 0,          0,                 NULL,  0  }
+    };
+    bool ok;
+    int c;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.n_entities = DEFAULT_N_ENTITIES;
+    bench.n_frames = DEFAULT_N_FRAMES;
+
+    while ((c = getopt_long(argc, argv, "e:f:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'e':
+            bench.n_entities = atoi(optarg);
+            break;
+        case 'f':
+            bench.n_frames = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (bench.n_entities < 1 || bench.n_frames < 1)
+        usage();
+
+    bench.shell = rig_bench_shell_new(bench_init, bench_paint, &bench);
+
+    rut_shell_main(bench.shell);
+
+    ok = print_stats(&bench);
+
+    cg_object_unref(bench.fb);
+    rut_object_unref(bench.frontend);
+    rut_object_unref(bench.shell);
+
+    return ok ? 0 : 1;
+}
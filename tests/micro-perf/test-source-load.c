@@ -0,0 +1,315 @@
+#include <rig-config.h>
+
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-frontend.h"
+#include "rig-engine.h"
+#include "components/rig-source.h"
+
+#include "rig-bench.h"
+
+/* Measures the wall-clock time to load a project with many image
+ * sources: N animated GIF sources of S x S pixels with F frames each
+ * are created at once and we wait until they have all been decoded
+ * and are ready.
+ *
+ * Source decoding runs in the uv threadpool so run with
+ * UV_THREADPOOL_SIZE=1 to compare against serial decoding. */
+
+#define DEFAULT_N_SOURCES 200
+#define DEFAULT_SIZE 256
+#define DEFAULT_N_FRAMES 4
+
+/* We write uncompressed LZW data with 9 bit codes, resetting the
+ * decoder's table with a clear code often enough that it never needs
+ * to grow the code size */
+#define LZW_CLEAR_CODE 256
+#define LZW_EOI_CODE 257
+#define LZW_CODES_PER_CLEAR 250
+
+typedef struct _bench_t {
+    rut_shell_t *shell;
+    rig_frontend_t *frontend;
+
+    int n_sources;
+    int size;
+    int n_frames;
+
+    c_byte_array_t *gif_data;
+
+    rig_source_t **sources;
+    rut_closure_t *ready_closures;
+    rut_closure_t *error_closures;
+
+    int n_ready;
+    int n_errors;
+    int64_t start;
+} bench_t;
+
+typedef struct _bit_writer_t {
+    c_byte_array_t *block;
+    uint32_t bits;
+    int n_bits;
+} bit_writer_t;
+
+static void
+append_le16(c_byte_array_t *buf, int value)
+{
+    uint8_t bytes[2] = { value & 0xff, (value >> 8) & 0xff };
+
+    c_byte_array_append(buf, bytes, 2);
+}
+
+static void
+write_code(bit_writer_t *writer, int code)
+{
+    writer->bits |= code << writer->n_bits;
+    writer->n_bits += 9;
+
+    while (writer->n_bits >= 8) {
+        uint8_t byte = writer->bits & 0xff;
+
+        c_byte_array_append(writer->block, &byte, 1);
+        writer->bits >>= 8;
+        writer->n_bits -= 8;
+    }
+}
+
+static void
+append_frame(c_byte_array_t *buf, int size, int frame)
+{
+    uint8_t gce[] = { 0x21, 0xf9, 0x04, 0x00, 10, 0, 0x00, 0x00 };
+    bit_writer_t writer = { c_byte_array_new(), 0, 0 };
+    uint8_t min_code_size = 8;
+    int n_codes = 0;
+    int x, y, i;
+
+    c_byte_array_append(buf, gce, sizeof(gce));
+
+    /* Image descriptor */
+    c_byte_array_append(buf, (uint8_t *)",", 1);
+    append_le16(buf, 0);
+    append_le16(buf, 0);
+    append_le16(buf, size);
+    append_le16(buf, size);
+    c_byte_array_append(buf, (uint8_t *)"\0", 1);
+
+    c_byte_array_append(buf, &min_code_size, 1);
+
+    for (y = 0; y < size; y++) {
+        for (x = 0; x < size; x++) {
+            if (n_codes++ % LZW_CODES_PER_CLEAR == 0)
+                write_code(&writer, LZW_CLEAR_CODE);
+            write_code(&writer, (x ^ y ^ (frame * 37)) & 0xff);
+        }
+    }
+    write_code(&writer, LZW_EOI_CODE);
+    if (writer.n_bits) {
+        uint8_t byte = writer.bits & 0xff;
+        c_byte_array_append(writer.block, &byte, 1);
+    }
+
+    /* Split into sub-blocks of up to 255 bytes */
+    for (i = 0; i < writer.block->len; i += 255) {
+        uint8_t len = MIN(255, writer.block->len - i);
+
+        c_byte_array_append(buf, &len, 1);
+        c_byte_array_append(buf, writer.block->data + i, len);
+    }
+    c_byte_array_append(buf, (uint8_t *)"\0", 1);
+
+    c_byte_array_free(writer.block, true);
+}
+
+static c_byte_array_t *
+create_gif(int size, int n_frames)
+{
+    c_byte_array_t *buf = c_byte_array_new();
+    uint8_t netscape_ext[] = {
+        0x21, 0xff, 0x0b,
+        'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+        0x03, 0x01, 0x00, 0x00, 0x00
+    };
+    uint8_t flags[] = {
+        0xf7, /* global color table of 256 entries */
+        0x00, /* background color */
+        0x00 /* aspect ratio */
+    };
+    int i;
+
+    c_byte_array_append(buf, (uint8_t *)"GIF89a", 6);
+    append_le16(buf, size);
+    append_le16(buf, size);
+    c_byte_array_append(buf, flags, sizeof(flags));
+
+    for (i = 0; i < 256; i++) {
+        uint8_t rgb[3] = { i, 255 - i, (i * 7) & 0xff };
+
+        c_byte_array_append(buf, rgb, 3);
+    }
+
+    c_byte_array_append(buf, netscape_ext, sizeof(netscape_ext));
+
+    for (i = 0; i < n_frames; i++)
+        append_frame(buf, size, i);
+
+    c_byte_array_append(buf, (uint8_t *)";", 1);
+
+    return buf;
+}
+
+static void
+maybe_finish(bench_t *bench)
+{
+    int64_t elapsed;
+
+    if (bench->n_ready + bench->n_errors < bench->n_sources)
+        return;
+
+    elapsed = c_get_monotonic_time() - bench->start;
+
+    c_print("sources = %d, size = %dx%d, frames = %d, gif size = %d bytes\n",
+            bench->n_sources,
+            bench->size,
+            bench->size,
+            bench->n_frames,
+            bench->gif_data->len);
+    c_print("load time = %.3fms\n", elapsed / 1e6);
+    c_print("sources per second = %.1f\n",
+            bench->n_sources / (elapsed / 1e9));
+    if (bench->n_errors)
+        c_print("errors = %d\n", bench->n_errors);
+
+    rut_shell_quit(bench->shell);
+}
+
+static void
+source_ready_cb(rig_source_t *source, void *user_data)
+{
+    bench_t *bench = user_data;
+
+    bench->n_ready++;
+    maybe_finish(bench);
+}
+
+static void
+source_error_cb(rig_source_t *source, const char *message, void *user_data)
+{
+    bench_t *bench = user_data;
+
+    bench->n_errors++;
+    maybe_finish(bench);
+}
+
+static void
+bench_init(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+    rig_engine_t *engine;
+    int i;
+
+    bench->frontend = rig_frontend_new(shell);
+    engine = bench->frontend->engine;
+
+    bench->start = c_get_monotonic_time();
+
+    for (i = 0; i < bench->n_sources; i++) {
+        rig_source_t *source = rig_source_new(engine,
+                                              "image/gif",
+                                              NULL, /* url */
+                                              bench->gif_data->data,
+                                              bench->gif_data->len,
+                                              bench->size,
+                                              bench->size);
+
+        rut_closure_init(&bench->ready_closures[i], source_ready_cb, bench);
+        rig_source_add_ready_callback(source, &bench->ready_closures[i]);
+        rut_closure_init(&bench->error_closures[i], source_error_cb, bench);
+        rig_source_add_on_error_callback(source, &bench->error_closures[i]);
+
+        bench->sources[i] = source;
+    }
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: test-source-load [OPTION]...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -n,--sources=N       Number of sources (default %d)\n",
+            DEFAULT_N_SOURCES);
+    fprintf(stderr, "  -s,--size=S          Width and height of each image "
+            "(default %d)\n", DEFAULT_SIZE);
+    fprintf(stderr, "  -f,--frames=F        Frames per image (default %d)\n",
+            DEFAULT_N_FRAMES);
+    fprintf(stderr, "  -h,--help            Display this help message\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_t bench;
+    struct option long_opts[] = {
+        { "sources", required_argument, NULL, 'n' },
+        { "size",    required_argument, NULL, 's' },
+        { "frames",  required_argument, NULL, 'f' },
+        { "help",    no_argument,       NULL, 'h' },
+        { 0,         0,                 NULL,  0  }
+    };
+    int c, i;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.n_sources = DEFAULT_N_SOURCES;
+    bench.size = DEFAULT_SIZE;
+    bench.n_frames = DEFAULT_N_FRAMES;
+
+    while ((c = getopt_long(argc, argv, "n:s:f:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            bench.n_sources = atoi(optarg);
+            break;
+        case 's':
+            bench.size = atoi(optarg);
+            break;
+        case 'f':
+            bench.n_frames = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (bench.n_sources < 1 || bench.size < 1 || bench.size > 65535 ||
+        bench.n_frames < 1)
+        usage();
+
+    bench.gif_data = create_gif(bench.size, bench.n_frames);
+    bench.sources = c_new0(rig_source_t *, bench.n_sources);
+    bench.ready_closures = c_new0(rut_closure_t, bench.n_sources);
+    bench.error_closures = c_new0(rut_closure_t, bench.n_sources);
+
+    bench.shell = rig_bench_shell_new(bench_init,
+                                      NULL, /* paint */
+                                      &bench);
+
+    rut_shell_main(bench.shell);
+
+    for (i = 0; i < bench.n_sources; i++) {
+        if (bench.sources[i])
+            rut_object_unref(bench.sources[i]);
+    }
+    rut_object_unref(bench.frontend);
+    rut_object_unref(bench.shell);
+
+    c_free(bench.sources);
+    c_free(bench.ready_closures);
+    c_free(bench.error_closures);
+    c_byte_array_free(bench.gif_data, true);
+
+    return 0;
+}
@@ -0,0 +1,310 @@
+#include <rig-config.h>
+
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <uv.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-protobuf-c-stream.h"
+
+#include "rig-bench.h"
+
+/* Measures the cost of sending many small messages per frame over a
+ * loopback tcp rig_pb_stream, similar to the rpc traffic between a
+ * frontend and simulator. Each frame writes N messages of M bytes and
+ * the next frame starts once they have all been received by the other
+ * end. Reports how many flushes there were per frame, where each
+ * flush is one uv_write() of one or more messages, and the
+ * throughput.
+ *
+ * With --no-coalesce each message is written directly with its own
+ * uv_write(), bypassing the stream's coalescing, as a baseline. */
+
+#define DEFAULT_N_MESSAGES 50
+#define DEFAULT_MESSAGE_SIZE 64
+#define DEFAULT_N_FRAMES 2000
+
+typedef struct _bench_t bench_t;
+
+typedef struct _message_t {
+    rig_pb_stream_write_closure_t closure;
+    uv_write_t write_req;
+    bench_t *bench;
+} message_t;
+
+struct _bench_t {
+    rut_shell_t *shell;
+
+    uv_tcp_t server;
+    rig_pb_stream_t *client_stream;
+    rig_pb_stream_t *server_stream;
+
+    int n_messages;
+    int message_size;
+    int n_frames;
+    bool no_coalesce;
+
+    uint8_t *data;
+    message_t *messages;
+
+    int frame;
+    int n_written;
+    size_t n_received;
+    int64_t start;
+
+    /* Flushes made by the benchmark itself with --no-coalesce */
+    uint64_t n_direct_writes;
+};
+
+static void
+print_stats(bench_t *bench)
+{
+    int64_t elapsed = c_get_monotonic_time() - bench->start;
+    rig_pb_stream_t *stream = bench->client_stream;
+    double secs = elapsed / 1e9;
+    double n_bytes = (double)bench->frame * bench->n_messages *
+        bench->message_size;
+    uint64_t n_flushes = stream->n_flushes + bench->n_direct_writes;
+
+    c_print("messages per frame = %d, message size = %d, frames = %d%s\n",
+            bench->n_messages,
+            bench->message_size,
+            bench->frame,
+            bench->no_coalesce ? " (not coalesced)" : "");
+    c_print("fps = %f\n", bench->frame / secs);
+    c_print("write closures per frame = %.1f\n",
+            stream->n_write_closures / (double)bench->frame);
+    c_print("flushes per frame = %.1f\n", n_flushes / (double)bench->frame);
+    c_print("throughput = %.1f messages/s, %.3f MB/s\n",
+            bench->frame * bench->n_messages / secs,
+            n_bytes / secs / (1024 * 1024));
+}
+
+static void
+maybe_finish_frame(bench_t *bench)
+{
+    size_t frame_bytes = (size_t)bench->n_messages * bench->message_size;
+
+    if (bench->n_written < bench->n_messages ||
+        bench->n_received < frame_bytes)
+        return;
+
+    bench->n_written = 0;
+    bench->n_received -= frame_bytes;
+    bench->frame++;
+
+    if (bench->frame < bench->n_frames)
+        rut_shell_queue_redraw(bench->shell);
+    else {
+        print_stats(bench);
+        rut_shell_quit(bench->shell);
+    }
+}
+
+static void
+write_done_cb(rig_pb_stream_write_closure_t *closure)
+{
+    message_t *message = c_container_of(closure, message_t, closure);
+    bench_t *bench = message->bench;
+
+    bench->n_written++;
+    maybe_finish_frame(bench);
+}
+
+static void
+direct_write_done_cb(uv_write_t *write_req, int status)
+{
+    message_t *message = write_req->data;
+
+    write_done_cb(&message->closure);
+}
+
+/* Writes a message straight to the stream's socket without going
+ * through rig_pb_stream_write() */
+static void
+write_direct(bench_t *bench, message_t *message)
+{
+    uv_stream_t *socket = (uv_stream_t *)&bench->client_stream->tcp.socket;
+
+    message->write_req.data = message;
+    uv_write(&message->write_req, socket, &message->closure.buf, 1,
+             direct_write_done_cb);
+    bench->n_direct_writes++;
+}
+
+static void
+server_read_cb(rig_pb_stream_t *stream,
+               const uint8_t *buf,
+               size_t len,
+               void *user_data)
+{
+    bench_t *bench = user_data;
+
+    bench->n_received += len;
+    maybe_finish_frame(bench);
+}
+
+static void
+bench_redraw(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+    int i;
+
+    rut_shell_remove_paint_idle(shell);
+
+    if (!bench->server_stream || bench->frame >= bench->n_frames)
+        return;
+
+    if (!bench->start)
+        bench->start = c_get_monotonic_time();
+
+    for (i = 0; i < bench->n_messages; i++) {
+        message_t *message = &bench->messages[i];
+
+        if (bench->no_coalesce)
+            write_direct(bench, message);
+        else
+            rig_pb_stream_write(bench->client_stream, &message->closure);
+    }
+}
+
+static void
+server_connection_cb(uv_stream_t *server, int status)
+{
+    bench_t *bench = server->data;
+
+    if (status < 0) {
+        c_error("Failed to accept connection: %s", uv_strerror(status));
+        return;
+    }
+
+    bench->server_stream = rig_pb_stream_new(bench->shell);
+    rig_pb_stream_accept_tcp_connection(bench->server_stream, &bench->server);
+    rig_pb_stream_set_read_callback(bench->server_stream,
+                                    server_read_cb,
+                                    bench);
+
+    rut_shell_queue_redraw(bench->shell);
+}
+
+static void
+bench_init(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+    uv_loop_t *loop = rut_uv_shell_get_loop(shell);
+    struct sockaddr_in addr;
+    int namelen = sizeof(addr);
+    char *port;
+    int err;
+
+    uv_tcp_init(loop, &bench->server);
+    bench->server.data = bench;
+
+    uv_ip4_addr("127.0.0.1", 0, &addr);
+    uv_tcp_bind(&bench->server, (struct sockaddr *)&addr, 0);
+
+    err = uv_listen((uv_stream_t *)&bench->server, 1, server_connection_cb);
+    if (err < 0) {
+        c_error("Failed to listen on loopback: %s", uv_strerror(err));
+        return;
+    }
+
+    uv_tcp_getsockname(&bench->server, (struct sockaddr *)&addr, &namelen);
+    port = c_strdup_printf("%u", ntohs(addr.sin_port));
+
+    bench->client_stream = rig_pb_stream_new(shell);
+    rig_pb_stream_set_tcp_transport(bench->client_stream, "127.0.0.1", port);
+
+    c_free(port);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: test-stream-write [OPTION]...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -n,--messages=N      Messages written per frame "
+            "(default %d)\n", DEFAULT_N_MESSAGES);
+    fprintf(stderr, "  -s,--size=M          Size of each message in bytes "
+            "(default %d)\n", DEFAULT_MESSAGE_SIZE);
+    fprintf(stderr, "  -f,--frames=K        Number of frames (default %d)\n",
+            DEFAULT_N_FRAMES);
+    fprintf(stderr, "  -c,--no-coalesce     Write each message with its own "
+            "uv_write()\n");
+    fprintf(stderr, "  -h,--help            Display this help message\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_t bench;
+    struct option long_opts[] = {
+        { "messages",    required_argument, NULL, 'n' },
+        { "size",        required_argument, NULL, 's' },
+        { "frames",      required_argument, NULL, 'f' },
+        { "no-coalesce", no_argument,       NULL, 'c' },
+        { "help",        no_argument,       NULL, 'h' },
+        { 0,             0,                 NULL,  0  }
+    };
+    int c, i;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.n_messages = DEFAULT_N_MESSAGES;
+    bench.message_size = DEFAULT_MESSAGE_SIZE;
+    bench.n_frames = DEFAULT_N_FRAMES;
+
+    while ((c = getopt_long(argc, argv, "n:s:f:ch", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            bench.n_messages = atoi(optarg);
+            break;
+        case 's':
+            bench.message_size = atoi(optarg);
+            break;
+        case 'f':
+            bench.n_frames = atoi(optarg);
+            break;
+        case 'c':
+            bench.no_coalesce = true;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (bench.n_messages < 1 || bench.n_frames < 1 ||
+        bench.message_size < 1)
+        usage();
+
+    /* The messages are re-sent every frame and all share the same
+     * content */
+    bench.data = c_malloc0(bench.message_size);
+
+    bench.messages = c_new0(message_t, bench.n_messages);
+    for (i = 0; i < bench.n_messages; i++) {
+        message_t *message = &bench.messages[i];
+
+        message->closure.buf.base = (char *)bench.data;
+        message->closure.buf.len = bench.message_size;
+        message->closure.done_callback = write_done_cb;
+        message->bench = &bench;
+    }
+
+    bench.shell = rig_bench_shell_new(bench_init, bench_redraw, &bench);
+
+    rut_shell_main(bench.shell);
+
+    if (bench.server_stream)
+        rut_object_unref(bench.server_stream);
+    rut_object_unref(bench.client_stream);
+    rut_object_unref(bench.shell);
+
+    c_free(bench.messages);
+    c_free(bench.data);
+
+    return 0;
+}
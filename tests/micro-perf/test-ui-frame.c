@@ -0,0 +1,368 @@
+#include <rig-config.h>
+
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-frontend.h"
+#include "rig-simulator.h"
+#include "rig-engine.h"
+#include "rig-controller.h"
+#include "rig-entity.h"
+#include "rig-pb.h"
+
+#include "rig.pb-c.h"
+
+#include "rig-bench.h"
+
+/* Measures the simulator -> frontend frame pipeline without any
+ * rendering: a generated UI of N entities, each with M properties
+ * animated by a looping controller, is run for K frames with the
+ * simulator sharing the frontend's mainloop and connected via the
+ * in-thread stream transport. */
+
+#define DEFAULT_N_ENTITIES 1000
+#define DEFAULT_N_PROPERTIES 2
+#define DEFAULT_N_FRAMES 500
+
+#define MAX_PROPERTIES 3
+
+typedef struct _bench_t {
+    rut_shell_t *shell;
+    rig_frontend_t *frontend;
+    rig_simulator_t *simulator;
+
+    rut_closure_t connected_closure;
+
+    int n_entities;
+    int n_properties;
+    int n_frames;
+    uint32_t ui_diff_encodings;
+
+    int frame;
+    int64_t frame_start;
+    int64_t frame_ns;
+    int64_t max_frame_ns;
+    int64_t total_start;
+
+    size_t max_frame_stack_bytes;
+} bench_t;
+
+static void
+add_animated_property(rig_controller_t *controller,
+                      rig_entity_t *entity,
+                      int prop_id,
+                      int index)
+{
+    rig_property_t *property =
+        rig_introspectable_get_property(entity, prop_id);
+    rut_boxed_t start, end;
+
+    start.type = end.type = property->spec->type;
+
+    switch (prop_id) {
+    case RUT_ENTITY_PROP_POSITION:
+        start.d.vec3_val[0] = index;
+        start.d.vec3_val[1] = 0;
+        start.d.vec3_val[2] = 0;
+        end.d.vec3_val[0] = index;
+        end.d.vec3_val[1] = 100;
+        end.d.vec3_val[2] = 0;
+        break;
+    case RUT_ENTITY_PROP_SCALE:
+        start.d.float_val = 1;
+        end.d.float_val = 2;
+        break;
+    case RUT_ENTITY_PROP_ROTATION:
+        c_quaternion_init_from_z_rotation(&start.d.quaternion_val, 0);
+        c_quaternion_init_from_z_rotation(&end.d.quaternion_val, 90);
+        break;
+    }
+
+    rig_controller_add_property(controller, property);
+    rig_controller_set_property_method(controller, property,
+                                       RIG_CONTROLLER_METHOD_PATH);
+    rig_controller_insert_path_value(controller, property, 0, &start);
+    rig_controller_insert_path_value(controller, property, 1, &end);
+}
+
+static void
+simulator_connected_cb(rig_simulator_t *simulator, void *user_data)
+{
+    bench_t *bench = user_data;
+    rig_engine_t *engine = simulator->engine;
+    int prop_ids[MAX_PROPERTIES] = {
+        RUT_ENTITY_PROP_POSITION,
+        RUT_ENTITY_PROP_SCALE,
+        RUT_ENTITY_PROP_ROTATION
+    };
+    rig_controller_t *controller;
+    rig_ui_t *ui;
+    int i, j;
+
+    /* Start with an empty UI that we then populate before
+     * forwarding to the frontend... */
+    rig_simulator_load_file(simulator, NULL);
+    ui = engine->ui;
+
+    controller = rig_controller_new(engine, "Bench Controller");
+    rig_controller_set_length(controller, 1);
+    rig_controller_set_loop(controller, true);
+    rig_controller_set_active(controller, true);
+    rig_controller_set_running(controller, true);
+
+    for (i = 0; i < bench->n_entities; i++) {
+        rig_entity_t *entity = rig_entity_new(engine);
+
+        rut_graphable_add_child(ui->scene, entity);
+        rut_object_unref(entity);
+
+        for (j = 0; j < bench->n_properties; j++)
+            add_animated_property(controller, entity, prop_ids[j], i);
+    }
+
+    rig_ui_add_controller(ui, controller);
+    rut_object_unref(controller);
+
+    rig_simulator_reload_frontend_ui(simulator, ui);
+
+    rig_simulator_set_collect_stats(simulator, true);
+}
+
+static void
+local_sim_init_cb(rig_simulator_t *simulator, void *user_data)
+{
+    bench_t *bench = user_data;
+
+    bench->simulator = simulator;
+
+    rut_closure_init(&bench->connected_closure,
+                     simulator_connected_cb,
+                     bench);
+    rig_simulator_add_connected_callback(simulator,
+                                         &bench->connected_closure);
+}
+
+static void
+print_stats(bench_t *bench)
+{
+    rig_simulator_frame_stats_t sim_stats;
+    rig_frontend_ui_update_stats_t frontend_stats;
+    int64_t elapsed = c_get_monotonic_time() - bench->total_start;
+    int n_sim_frames, n_updates;
+
+    rig_simulator_get_stats(bench->simulator, &sim_stats);
+    rig_frontend_get_stats(bench->frontend, &frontend_stats);
+
+    n_sim_frames = MAX(sim_stats.n_frames, 1);
+    n_updates = MAX(frontend_stats.n_updates, 1);
+
+    c_print("entities = %d, animated properties = %d, frames = %d\n",
+            bench->n_entities,
+            bench->n_entities * bench->n_properties,
+            bench->frame);
+    c_print("fps = %f\n", bench->frame / (elapsed / 1e9));
+    c_print("frame round trip: mean = %.3fms, max = %.3fms\n",
+            bench->frame_ns / 1e6 / MAX(bench->frame, 1),
+            bench->max_frame_ns / 1e6);
+    c_print("simulator update: mean = %.3fms\n",
+            sim_stats.update_ns / 1e6 / n_sim_frames);
+    c_print("simulator serialize: mean = %.3fms\n",
+            sim_stats.serialize_ns / 1e6 / n_sim_frames);
+    c_print("simulator encode: mean = %.3fms\n",
+            sim_stats.encode_ns / 1e6 / n_sim_frames);
+    c_print("simulator send: mean = %.3fms\n",
+            sim_stats.send_ns / 1e6 / n_sim_frames);
+    c_print("frontend apply: mean = %.3fms\n",
+            frontend_stats.apply_ns / 1e6 / n_updates);
+    c_print("frontend decode: mean = %.3fms\n",
+            frontend_stats.decode_ns / 1e6 / n_updates);
+    c_print("property changes per frame = %.1f\n",
+            sim_stats.n_property_changes / (double)n_sim_frames);
+    c_print("ops per frame = %.1f\n",
+            sim_stats.n_ops / (double)n_sim_frames);
+    c_print("Rig__UIDiff bytes: mean = %.1f, max = %d\n",
+            sim_stats.ui_diff_bytes / (double)n_sim_frames,
+            (int)sim_stats.max_ui_diff_bytes);
+    c_print("simulator frame stack high water = %d bytes\n",
+            (int)sim_stats.max_frame_stack_bytes);
+    c_print("frontend frame stack high water = %d bytes\n",
+            (int)bench->max_frame_stack_bytes);
+}
+
+static void
+ui_update_cb(rig_frontend_t *frontend, void *user_data)
+{
+    bench_t *bench = user_data;
+    int64_t frame_ns;
+
+    /* Also called after the initial UI load, before any frame */
+    if (!bench->frame_start)
+        return;
+
+    frame_ns = c_get_monotonic_time() - bench->frame_start;
+    bench->frame_ns += frame_ns;
+    if (frame_ns > bench->max_frame_ns)
+        bench->max_frame_ns = frame_ns;
+
+    bench->frame_start = 0;
+    bench->frame++;
+
+    if (bench->frame < bench->n_frames)
+        rut_shell_queue_redraw(bench->shell);
+    else {
+        print_stats(bench);
+        rut_shell_quit(bench->shell);
+    }
+}
+
+static void
+bench_redraw(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+    rig_frontend_t *frontend = bench->frontend;
+    rig_engine_t *engine = frontend->engine;
+
+    rut_shell_remove_paint_idle(shell);
+
+    /* We wait until the generated UI has been loaded before running
+     * any simulator frames. */
+    if (engine->ui && !frontend->sim_update_pending &&
+        bench->frame < bench->n_frames) {
+        Rig__FrameSetup setup = RIG__FRAME_SETUP__INIT;
+        rig_pb_serializer_t *serializer;
+
+        if (!bench->total_start) {
+            rig_frontend_set_collect_stats(frontend, true);
+            bench->total_start = c_get_monotonic_time();
+        }
+
+        serializer = rig_pb_serializer_new(engine);
+
+        setup.has_progress = true;
+        setup.progress = 1.0 / 60.0;
+
+        bench->frame_start = c_get_monotonic_time();
+        rig_frontend_run_simulator_frame(frontend, serializer, &setup);
+
+        rig_pb_serializer_destroy(serializer);
+
+        rut_memory_stack_rewind(engine->sim_frame_stack);
+    }
+
+    rig_engine_progress_timelines(engine, 1.0 / 60.0);
+
+    rig_engine_garbage_collect(engine);
+
+    if (bench->total_start) {
+        size_t frame_stack_bytes =
+            rut_memory_stack_get_used_bytes(engine->frame_stack);
+
+        if (frame_stack_bytes > bench->max_frame_stack_bytes)
+            bench->max_frame_stack_bytes = frame_stack_bytes;
+    }
+
+    rut_memory_stack_rewind(engine->frame_stack);
+}
+
+static void
+bench_init(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+
+    bench->frontend = rig_frontend_new(shell);
+
+    rig_frontend_set_ui_diff_encodings(bench->frontend,
+                                       bench->ui_diff_encodings);
+
+    rig_frontend_add_ui_update_callback(bench->frontend,
+                                        ui_update_cb,
+                                        bench,
+                                        NULL); /* destroy */
+
+    rig_frontend_spawn_simulator(bench->frontend,
+                                 RIG_SIMULATOR_RUN_MODE_MAINLOOP,
+                                 NULL, /* address */
+                                 -1, /* port */
+                                 local_sim_init_cb,
+                                 bench,
+                                 NULL); /* ui filename */
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: test-ui-frame [OPTION]...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -e,--entities=N      Number of entities (default %d)\n",
+            DEFAULT_N_ENTITIES);
+    fprintf(stderr, "  -p,--properties=M    Animated properties per entity, "
+            "1-%d (default %d)\n", MAX_PROPERTIES, DEFAULT_N_PROPERTIES);
+    fprintf(stderr, "  -f,--frames=K        Number of frames (default %d)\n",
+            DEFAULT_N_FRAMES);
+    fprintf(stderr, "  -r,--raw             Don't delta encode property "
+            "changes\n");
+    fprintf(stderr, "  -Z,--no-zlib         Don't compress property changes\n");
+    fprintf(stderr, "  -h,--help            Display this help message\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_t bench;
+    struct option long_opts[] = {
+        { "entities",   required_argument, NULL, 'e' },
+        { "properties", required_argument, NULL, 'p' },
+        { "frames",     required_argument, NULL, 'f' },
+        { "raw",        no_argument,       NULL, 'r' },
+        { "no-zlib",    no_argument,       NULL, 'Z' },
+        { "help",       no_argument,       NULL, 'h' },
+        { 0,            0,                 NULL,  0  }
+    };
+    int c;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.n_entities = DEFAULT_N_ENTITIES;
+    bench.n_properties = DEFAULT_N_PROPERTIES;
+    bench.n_frames = DEFAULT_N_FRAMES;
+    bench.ui_diff_encodings =
+        RIG_UI_DIFF_ENCODING_DELTA | RIG_UI_DIFF_ENCODING_ZLIB;
+
+    while ((c = getopt_long(argc, argv, "e:p:f:rZh", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'e':
+            bench.n_entities = atoi(optarg);
+            break;
+        case 'p':
+            bench.n_properties = atoi(optarg);
+            break;
+        case 'f':
+            bench.n_frames = atoi(optarg);
+            break;
+        case 'r':
+            bench.ui_diff_encodings = 0;
+            break;
+        case 'Z':
+            bench.ui_diff_encodings &= ~RIG_UI_DIFF_ENCODING_ZLIB;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (bench.n_entities < 1 || bench.n_frames < 1 ||
+        bench.n_properties < 1 || bench.n_properties > MAX_PROPERTIES)
+        usage();
+
+    bench.shell = rig_bench_shell_new(bench_init, bench_redraw, &bench);
+
+    rut_shell_main(bench.shell);
+
+    rut_object_unref(bench.frontend);
+    rut_object_unref(bench.shell);
+
+    return 0;
+}
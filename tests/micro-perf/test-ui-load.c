@@ -0,0 +1,383 @@
+#include <rig-config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <clib.h>
+#include <rut.h>
+
+#include "rig-frontend.h"
+#include "rig-engine.h"
+#include "rig-entity.h"
+#include "rig-controller.h"
+#include "rig-ui.h"
+#include "rig-pb.h"
+
+#include "rig.pb-c.h"
+
+#include "rig-bench.h"
+
+/* Saves a generated UI with N entities, B buffers (half of them
+ * sharing their contents so they are saved as shared blobs) and C
+ * animated controllers and then loads the packed data both by
+ * unpacking it with rig__ui__unpack() for rig_pb_unserialize_ui() and
+ * by streaming it through rig_pb_unserialize_ui_data(), reporting how
+ * long each way of loading took and how much the peak resident memory
+ * grew while loading.
+ *
+ * The loaded UIs are checked against the original by the
+ * test_rig_ui_load conformance test. */
+
+#define DEFAULT_N_ENTITIES 1000
+#define DEFAULT_N_BUFFERS 16
+#define DEFAULT_BUFFER_SIZE 65536
+#define DEFAULT_N_CONTROLLERS 4
+
+typedef struct _bench_t {
+    rut_shell_t *shell;
+    rig_frontend_t *frontend;
+
+    int n_entities;
+    int n_buffers;
+    int buffer_size;
+    int n_controllers;
+
+    bool ok;
+} bench_t;
+
+static rig_ui_t *
+create_ui(bench_t *bench)
+{
+    rig_engine_t *engine = bench->frontend->engine;
+    rig_ui_t *ui = rig_ui_new(engine);
+    rig_entity_t *parent = NULL;
+    int i;
+
+    ui->scene = rig_entity_new(engine);
+
+    for (i = 0; i < bench->n_entities; i++) {
+        rig_entity_t *entity = rig_entity_new(engine);
+        float position[3] = { i, i * 2, i * 3 };
+        char *label = c_strdup_printf("entity-%d", i);
+
+        rig_entity_set_label(entity, label);
+        rig_entity_set_position(entity, position);
+        c_free(label);
+
+        /* Nest some entities so the scene isn't flat */
+        if (parent && i % 10)
+            rut_graphable_add_child(parent, entity);
+        else {
+            rut_graphable_add_child(ui->scene, entity);
+            parent = entity;
+        }
+        rut_object_unref(entity);
+    }
+
+    for (i = 0; i < bench->n_buffers; i++) {
+        rut_buffer_t *buffer = rut_buffer_new(bench->buffer_size);
+
+        /* Pairs of buffers share the same contents */
+        memset(buffer->data, i / 2, buffer->size);
+
+        rig_ui_add_buffer(ui, buffer);
+        rut_object_unref(buffer);
+    }
+
+    for (i = 0; i < bench->n_controllers; i++) {
+        char *label = c_strdup_printf("controller-%d", i);
+        rig_controller_t *controller = rig_controller_new(engine, label);
+        rut_object_t *entity = rut_graphable_first(ui->scene);
+        rig_property_t *property;
+        rut_boxed_t start, end;
+
+        c_free(label);
+
+        /* Each controller animates one more entity than the last */
+        for (int j = 0; j <= i && entity; j++) {
+            property = rig_introspectable_get_property(entity,
+                                                       RUT_ENTITY_PROP_SCALE);
+
+            start.type = end.type = property->spec->type;
+            start.d.float_val = 1;
+            end.d.float_val = j + 2;
+
+            rig_controller_add_property(controller, property);
+            rig_controller_set_property_method(controller, property,
+                                               RIG_CONTROLLER_METHOD_PATH);
+            rig_controller_insert_path_value(controller, property, 0, &start);
+            rig_controller_insert_path_value(controller, property, 1, &end);
+
+            entity = rut_graphable_nth(ui->scene, j + 1);
+        }
+
+        rig_ui_add_controller(ui, controller);
+        rut_object_unref(controller);
+    }
+
+    return ui;
+}
+
+static uint8_t *
+save_ui(bench_t *bench, rig_ui_t *ui, size_t *len)
+{
+    rig_pb_serializer_t *serializer =
+        rig_pb_serializer_new(bench->frontend->engine);
+    Rig__UI *pb_ui;
+    uint8_t *data;
+
+    rig_pb_serializer_set_blobs_enabled(serializer, true);
+
+    pb_ui = rig_pb_serialize_ui(serializer, ui);
+
+    *len = rig__ui__get_packed_size(pb_ui);
+    data = c_malloc(*len);
+    rig__ui__pack(pb_ui, data);
+
+    rig_pb_serialized_ui_destroy(pb_ui);
+    rig_pb_serializer_destroy(serializer);
+
+    return data;
+}
+
+static void
+register_object_cb(rig_ui_t *ui, void *object, uint64_t id, void *user_data)
+{
+    c_hash_table_t *id_map = user_data;
+    uint64_t *key = c_new(uint64_t, 1);
+
+    *key = id;
+    c_hash_table_insert(id_map, key, object);
+}
+
+static void
+unregister_object_cb(rig_ui_t *ui, uint64_t id, void *user_data)
+{
+    c_hash_table_remove(user_data, &id);
+}
+
+static void *
+lookup_object_cb(rig_ui_t *ui, uint64_t id, void *user_data)
+{
+    return c_hash_table_lookup(user_data, &id);
+}
+
+/* Returns the value in kB of a field such as VmRSS from
+ * /proc/self/status or -1 if it isn't available */
+static long
+read_status_kb(const char *name)
+{
+    FILE *file = fopen("/proc/self/status", "r");
+    size_t name_len = strlen(name);
+    char line[256];
+    long kb = -1;
+
+    if (!file)
+        return -1;
+
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            kb = strtol(line + name_len + 1, NULL, 10);
+            break;
+        }
+    }
+
+    fclose(file);
+
+    return kb;
+}
+
+/* Resets the peak resident set size (VmHWM) to the current resident
+ * set size so the peak can be measured for each way of loading
+ * separately. This needs Linux >= 4.0 */
+static bool
+reset_peak_rss(void)
+{
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    bool ret;
+
+    if (!file)
+        return false;
+
+    ret = fputs("5", file) >= 0;
+
+    return fclose(file) == 0 && ret;
+}
+
+/* Loads the UI with rig_pb_unserialize_ui() if @unpack is set or with
+ * rig_pb_unserialize_ui_data() otherwise. @peak_kb is set to how much
+ * the peak resident memory grew while loading or to -1 if that can't
+ * be measured */
+static rig_ui_t *
+load_ui(bench_t *bench,
+        const uint8_t *data,
+        size_t len,
+        bool unpack,
+        int64_t *elapsed,
+        long *peak_kb)
+{
+    c_hash_table_t *id_map =
+        c_hash_table_new_full(c_int64_hash, c_int64_equal, c_free, NULL);
+    rig_pb_unserializer_t *unserializer =
+        rig_pb_unserializer_new(bench->frontend->engine,
+                                register_object_cb,
+                                unregister_object_cb,
+                                lookup_object_cb,
+                                id_map);
+    long start_kb = reset_peak_rss() ? read_status_kb("VmRSS") : -1;
+    int64_t start = c_get_monotonic_time();
+    long peak;
+    rig_ui_t *ui;
+
+    if (unpack) {
+        Rig__UI *pb_ui = rig__ui__unpack(NULL, len, data);
+
+        ui = pb_ui ? rig_pb_unserialize_ui(unserializer, pb_ui) : NULL;
+
+        if (pb_ui)
+            rig__ui__free_unpacked(pb_ui, NULL);
+    } else
+        ui = rig_pb_unserialize_ui_data(unserializer, data, len);
+
+    *elapsed = c_get_monotonic_time() - start;
+
+    peak = read_status_kb("VmHWM");
+    *peak_kb = start_kb >= 0 && peak >= 0 ? peak - start_kb : -1;
+
+    rig_pb_unserializer_destroy(unserializer);
+    c_hash_table_destroy(id_map);
+
+    return ui;
+}
+
+static void
+print_load(const char *name, bench_t *bench, rig_ui_t *ui,
+           int64_t elapsed, long peak_kb)
+{
+    if (!ui) {
+        c_print("FAIL: %s: failed to load\n", name);
+        bench->ok = false;
+        return;
+    }
+
+    if (peak_kb >= 0)
+        c_print("%s = %.3fms, peak memory +%ldkB\n",
+                name, elapsed / 1e6, peak_kb);
+    else
+        c_print("%s = %.3fms, peak memory n/a\n", name, elapsed / 1e6);
+}
+
+static void
+bench_init(rut_shell_t *shell, void *user_data)
+{
+    bench_t *bench = user_data;
+    rig_ui_t *ui, *unpacked_ui, *streamed_ui;
+    int64_t unpack_ns, stream_ns;
+    long unpack_kb, stream_kb;
+    uint8_t *data;
+    size_t len;
+
+    bench->frontend = rig_frontend_new(shell);
+
+    ui = create_ui(bench);
+    data = save_ui(bench, ui, &len);
+
+    /* Stream first so that it can't reuse the resident memory freed
+     * after unpacking, which would hide its peak */
+    streamed_ui = load_ui(bench, data, len, false, &stream_ns, &stream_kb);
+    unpacked_ui = load_ui(bench, data, len, true, &unpack_ns, &unpack_kb);
+
+    c_print("entities = %d, buffers = %d x %d bytes, controllers = %d\n",
+            bench->n_entities, bench->n_buffers, bench->buffer_size,
+            bench->n_controllers);
+    c_print("serialized size = %d bytes\n", (int)len);
+    print_load("rig_pb_unserialize_ui (with unpacking)", bench,
+               unpacked_ui, unpack_ns, unpack_kb);
+    print_load("rig_pb_unserialize_ui_data", bench,
+               streamed_ui, stream_ns, stream_kb);
+
+    if (streamed_ui)
+        rut_object_unref(streamed_ui);
+    if (unpacked_ui)
+        rut_object_unref(unpacked_ui);
+    rut_object_unref(ui);
+
+    c_free(data);
+
+    rut_shell_quit(shell);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: test-ui-load [OPTION]...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -e,--entities=N      Number of entities (default %d)\n",
+            DEFAULT_N_ENTITIES);
+    fprintf(stderr, "  -b,--buffers=B       Number of buffers (default %d)\n",
+            DEFAULT_N_BUFFERS);
+    fprintf(stderr, "  -s,--buffer-size=S   Size of each buffer in bytes "
+            "(default %d)\n", DEFAULT_BUFFER_SIZE);
+    fprintf(stderr, "  -c,--controllers=C   Number of controllers "
+            "(default %d)\n", DEFAULT_N_CONTROLLERS);
+    fprintf(stderr, "  -h,--help            Display this help message\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_t bench;
+    struct option long_opts[] = {
+        { "entities",    required_argument, NULL, 'e' },
+        { "buffers",     required_argument, NULL, 'b' },
+        { "buffer-size", required_argument, NULL, 's' },
+        { "controllers", required_argument, NULL, 'c' },
+        { "help",        no_argument,       NULL, 'h' },
+        { 0,             0,                 NULL,  0  }
+    };
+    int c;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.n_entities = DEFAULT_N_ENTITIES;
+    bench.n_buffers = DEFAULT_N_BUFFERS;
+    bench.buffer_size = DEFAULT_BUFFER_SIZE;
+    bench.n_controllers = DEFAULT_N_CONTROLLERS;
+    bench.ok = true;
+
+    while ((c = getopt_long(argc, argv, "e:b:s:c:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'e':
+            bench.n_entities = atoi(optarg);
+            break;
+        case 'b':
+            bench.n_buffers = atoi(optarg);
+            break;
+        case 's':
+            bench.buffer_size = atoi(optarg);
+            break;
+        case 'c':
+            bench.n_controllers = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (bench.n_entities < 1 || bench.n_buffers < 0 ||
+        bench.buffer_size < 1 || bench.n_controllers < 0)
+        usage();
+
+    bench.shell = rig_bench_shell_new(bench_init,
+                                      NULL, /* paint */
+                                      &bench);
+
+    rut_shell_main(bench.shell);
+
+    rut_object_unref(bench.frontend);
+    rut_object_unref(bench.shell);
+
+    return bench.ok ? 0 : 1;
+}